@@ -17,6 +17,14 @@ extern llvm::cl::opt<bool> UseCexCache;
 
 extern llvm::cl::opt<bool> UseCache;
 
+extern llvm::cl::opt<bool> UseQueryCanonicalization;
+
+extern llvm::cl::opt<std::string> PersistentQueryCache;
+
+extern llvm::cl::opt<bool> UseArrayExpansion;
+
+extern llvm::cl::opt<unsigned> ArrayExpansionMaxSize;
+
 extern llvm::cl::opt<bool> UseIndependentSolver; 
 
 extern llvm::cl::opt<bool> DebugValidateSolver;
@@ -27,6 +35,10 @@ extern llvm::cl::opt<double> MaxCoreSolverTime;
 
 extern llvm::cl::opt<bool> UseForkedCoreSolver;
 
+extern llvm::cl::opt<bool> UseSolverWorkerPool;
+
+extern llvm::cl::opt<bool> UseIncrementalSolver;
+
 extern llvm::cl::opt<bool> CoreSolverOptimizeDivides;
 
 ///The different query logging solvers that can switched on/off
@@ -11,6 +11,12 @@
 #define KLEE_CONSTRAINTS_H
 
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/PersistentVector.h"
+#include "klee/util/ExprKnownBits.h"
+
+#include <map>
+#include <set>
+#include <vector>
 
 // FIXME: Currently we use ConstraintManager for two things: to pass
 // sets of constraints around, and to optimize constraints. We should
@@ -19,10 +25,72 @@
 namespace klee {
 
 class ExprVisitor;
+
+/// ConstraintPartition - A union-find over the symbolic array bytes read by
+/// a set of constraints, which groups the constraints into classes which are
+/// independent of each other. Constraints reading the same byte of an array,
+/// or reading an array at a symbolic index and at any other index, end up in
+/// the same class.
+///
+/// The partition is extended as constraints are appended to the set, so
+/// finding the constraints a query depends on does not require recomputing
+/// the independent sets of all constraints.
+class ConstraintPartition {
+public:
+  static const unsigned NoClass = ~0U;
+
+  unsigned refCount;
+
+  ConstraintPartition() : refCount(0) {}
+  ConstraintPartition(const ConstraintPartition &b)
+    : refCount(0), parent(b.parent), arrays(b.arrays),
+      constraintNodes(b.constraintNodes) {}
+
+  /// addConstraint - Record \a e as the next constraint of the set.
+  void addConstraint(const ref<Expr> &e);
+
+  /// size - Return the number of constraints in the partition.
+  unsigned size() const { return constraintNodes.size(); }
+
+  /// getClass - Return the class of the \a i-th constraint, or NoClass if it
+  /// does not read any symbolic byte.
+  unsigned getClass(unsigned i) const {
+    unsigned node = constraintNodes[i];
+    return node == NoClass ? NoClass : find(node);
+  }
+
+  /// getClasses - Collect the classes of the constraints which \a e depends
+  /// on, i.e. which read any of the symbolic bytes read by \a e.
+  void getClasses(const ref<Expr> &e, std::set<unsigned> &classes) const;
+
+private:
+  struct ArrayNodes {
+    /// The node of the symbolic index reads of the array, or NoClass. Once
+    /// it exists, all the bytes of the array are in its class.
+    unsigned whole;
+    /// The nodes of the constant index reads of the array, by index.
+    std::map<unsigned, unsigned> bytes;
+
+    ArrayNodes() : whole(NoClass) {}
+  };
+
+  // Path compression only changes the representation, so it is done even
+  // for partitions shared between several constraint sets.
+  mutable std::vector<unsigned> parent;
+  std::map<const Array*, ArrayNodes> arrays;
+  std::vector<unsigned> constraintNodes;
+
+  unsigned find(unsigned node) const;
+  void unite(unsigned a, unsigned b);
+  unsigned getByteNode(const Array *array, unsigned index);
+  unsigned getWholeNode(const Array *array);
+};
   
 class ConstraintManager {
 public:
-  typedef std::vector< ref<Expr> > constraints_ty;
+  /// The constraints are shared between copies of the manager, so that
+  /// copying it on a fork does not copy them.
+  typedef PersistentVector< ref<Expr> > constraints_ty;
   typedef constraints_ty::iterator iterator;
   typedef constraints_ty::const_iterator const_iterator;
 
@@ -31,11 +99,13 @@ public:
   // create from constraints with no optimization
   explicit
   ConstraintManager(const std::vector< ref<Expr> > &_constraints) :
-    constraints(_constraints) {}
+    constraints(_constraints.begin(), _constraints.end()) {}
 
-  ConstraintManager(const ConstraintManager &cs) : constraints(cs.constraints) {}
+  ConstraintManager(const ConstraintManager &cs)
+    : constraints(cs.constraints), partition(cs.partition),
+      knownBits(cs.knownBits) {}
 
-  typedef std::vector< ref<Expr> >::const_iterator constraint_iterator;
+  typedef constraints_ty::const_iterator constraint_iterator;
 
   // given a constraint which is known to be valid, attempt to 
   // simplify the existing constraint set
@@ -64,14 +134,29 @@ public:
   bool operator==(const ConstraintManager &other) const {
     return constraints == other.constraints;
   }
+
+  /// getPartition - Return the partition of the constraints into independent
+  /// classes. It is built on first use and then kept up to date as
+  /// constraints are added; copies of the manager share it until one of them
+  /// adds a constraint.
+  const ConstraintPartition &getPartition() const;
+
+  /// getKnownBits - Return the known bits and intervals implied by the
+  /// constraints. Like the partition, it is built on first use, kept up to
+  /// date as constraints are added, and shared between copies.
+  const ConstraintKnownBits &getKnownBits() const;
   
 private:
-  std::vector< ref<Expr> > constraints;
+  constraints_ty constraints;
+  mutable ref<ConstraintPartition> partition;
+  mutable ref<ConstraintKnownBits> knownBits;
 
   // returns true iff the constraints were modified
   bool rewriteConstraints(ExprVisitor &visitor);
 
   void addConstraintInternal(ref<Expr> e);
+
+  void appendConstraint(ref<Expr> e);
 };
 
 }
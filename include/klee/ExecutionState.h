@@ -12,6 +12,9 @@
 
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+#include "klee/Internal/ADT/ImmutableSet.h"
+#include "klee/Internal/ADT/PersistentVector.h"
 #include "klee/Internal/ADT/TreeStream.h"
 
 // FIXME: We do not want to be exposing these? :(
@@ -40,7 +43,14 @@ struct StackFrame {
   CallPathNode *callPathNode;
 
   std::vector<const MemoryObject *> allocas;
+
+private:
+  /// The registers, shared with the copies of the frame until one of them
+  /// writes to them.
   Cell *locals;
+  unsigned *localsRefCount;
+
+public:
 
   /// Minimum distance to an uncovered instruction once the function
   /// returns. This is not a good place for this but is used to
@@ -59,6 +69,22 @@ struct StackFrame {
   StackFrame(KInstIterator caller, KFunction *kf);
   StackFrame(const StackFrame &s);
   ~StackFrame();
+
+  StackFrame &operator=(const StackFrame &s);
+
+  const Cell *getLocals() const { return locals; }
+  /// Whether the registers are shared with another frame.
+  bool sharesLocals() const { return *localsRefCount != 1; }
+  /// Return the registers for writing, copying them first if they are
+  /// shared with another frame.
+  Cell *getWriteableLocals() {
+    if (*localsRefCount != 1)
+      unshareLocals();
+    return locals;
+  }
+
+private:
+  void unshareLocals();
 };
 
 /// @brief ExecutionState representing a path under exploration
@@ -70,7 +96,7 @@ private:
   // unsupported, use copy constructor
   ExecutionState &operator=(const ExecutionState &);
 
-  std::map<std::string, std::string> fnAliases;
+  ImmutableMap<std::string, std::string> fnAliases;
 
 public:
   // Execution - Control Flow specific
@@ -127,26 +153,28 @@ public:
   /// @brief Disables forking for this state. Set by user code
   bool forkDisabled;
 
+  typedef ImmutableMap<const std::string *, ImmutableSet<unsigned> >
+    covered_lines_ty;
+
   /// @brief Set containing which lines in which files are covered by this state
-  std::map<const std::string *, std::set<unsigned> > coveredLines;
+  covered_lines_ty coveredLines;
 
   /// @brief Pointer to the process tree of the current state
   PTreeNode *ptreeNode;
 
   /// @brief Ordered list of symbolics: used to generate test cases.
-  //
-  // FIXME: Move to a shared list structure (not critical).
-  std::vector<std::pair<const MemoryObject *, const Array *> > symbolics;
+  PersistentVector<std::pair<ref<const MemoryObject>, const Array *> >
+    symbolics;
 
   /// @brief Set of used array names for this state.  Used to avoid collisions.
-  std::set<std::string> arrayNames;
+  ImmutableSet<std::string> arrayNames;
 
   std::string getFnAlias(std::string fn);
   void addFnAlias(std::string old_fn, std::string new_fn);
   void removeFnAlias(std::string fn);
 
 private:
-  ExecutionState() : ptreeNode(0) {}
+  ExecutionState();
 
 public:
   ExecutionState(KFunction *kf);
@@ -165,6 +193,7 @@ public:
   void popFrame();
 
   void addSymbolic(const MemoryObject *mo, const Array *array);
+  void addCoveredLine(const std::string *file, unsigned line);
   void addConstraint(ref<Expr> e) { constraints.addConstraint(e); }
 
   bool merge(const ExecutionState &b);
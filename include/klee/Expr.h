@@ -35,6 +35,7 @@ class Array;
 class ArrayCache;
 class ConstantExpr;
 class ObjectState;
+class UpdateNodeIndex;
 
 template<class T> class ref;
 
@@ -92,6 +93,18 @@ public:
   static unsigned count;
   static const unsigned MAGIC_HASH_CONSTANT = 39;
 
+  /// hashConsing - Whether newly allocated expressions which are structurally
+  /// identical to an expression in use share its node, so that equal
+  /// expressions are also equal pointers (-hash-cons-exprs). Expressions
+  /// allocated while it is off are never shared, so it can be changed at
+  /// any time.
+  static bool hashConsing;
+
+  /// rewriting - Whether the expressions built by the create() functions
+  /// are simplified with the rules of the default ExprRewriter
+  /// (-rewrite-exprs).
+  static bool rewriting;
+
   /// The type of an expression is simply its width, in bits. 
   typedef unsigned Width; 
   
@@ -179,7 +192,11 @@ protected:
   
 public:
   Expr() : refCount(0) { Expr::count++; }
-  virtual ~Expr() { Expr::count--; } 
+  virtual ~Expr();
+
+  /// Expressions are allocated from slabs, see getExprAllocator().
+  static void *operator new(size_t size);
+  static void operator delete(void *p, size_t size);
 
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
@@ -252,10 +269,56 @@ public:
   struct CreateArg;
   static ref<Expr> createFromKind(Kind k, std::vector<CreateArg> args);
 
+  /// getNumLive - Return the number of live expressions of kind \a k.
+  static uint64_t getNumLive(Kind k) { return numLive[k]; }
+
+  /// printKindStats - Print the live and peak number of expressions of each
+  /// kind which was allocated, one line each starting with \a prefix.
+  static void printKindStats(llvm::raw_ostream &os, const char *prefix);
+
   static bool isValidKidWidth(unsigned kid, Width w) { return true; }
   static bool needsResultType() { return false; }
 
   static bool classof(const Expr *) { return true; }
+
+protected:
+  /// noteDestroyed - Count the destruction of an expression of kind \a k.
+  /// Called by the destructors of the concrete classes, as the kind is no
+  /// longer known in ~Expr.
+  static void noteDestroyed(Kind k) { --numLive[k]; }
+
+  /// hashCons - Return the expression in use which is structurally identical
+  /// to the newly allocated \a e, or record \a e as that expression, if
+  /// hash-consing is enabled. Every new expression passes through here,
+  /// which counts it.
+  template<class T>
+  static ref<T> hashCons(const ref<T> &e) {
+    noteCreated(e->getKind());
+    if (!hashConsing)
+      return e;
+    return ref<T>(static_cast<T*>(lookupOrInsert(e.get())));
+  }
+
+  /// rewrite - Simplify \a e, just built by a create() function, with the
+  /// rewrite rules if rewriting is enabled.
+  static ref<Expr> rewrite(const ref<Expr> &e) {
+    if (!rewriting)
+      return e;
+    return applyRewriteRules(e);
+  }
+
+private:
+  /// The number of live and the highest number of simultaneously live
+  /// expressions of each kind.
+  static uint64_t numLive[LastKind + 1], numPeak[LastKind + 1];
+
+  static void noteCreated(Kind k) {
+    if (++numLive[k] > numPeak[k])
+      numPeak[k] = numLive[k];
+  }
+
+  static Expr *lookupOrInsert(Expr *e);
+  static ref<Expr> applyRewriteRules(const ref<Expr> &e);
 };
 
 struct Expr::CreateArg {
@@ -388,10 +451,12 @@ public:
   static const unsigned numKids = 1;
   ref<Expr> src;
 
+  ~NotOptimizedExpr() { noteDestroyed(kind); }
+
   static ref<Expr> alloc(const ref<Expr> &src) {
     ref<Expr> r(new NotOptimizedExpr(src));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(ref<Expr> src);
@@ -430,6 +495,10 @@ public:
 private:
   /// size of this update sequence, including this update
   unsigned size;
+
+  /// The newest updates at each constant index, built on demand for long
+  /// sequences, see UpdateList::findConstantUpdate().
+  mutable UpdateNodeIndex *lookup;
   
 public:
   UpdateNode(const UpdateNode *_next, 
@@ -441,8 +510,12 @@ public:
   int compare(const UpdateNode &b) const;  
   unsigned hash() const { return hashValue; }
 
+  /// Update nodes are allocated from slabs, see getUpdateNodeAllocator().
+  static void *operator new(size_t size);
+  static void operator delete(void *p, size_t size);
+
 private:
-  UpdateNode() : refCount(0) {}
+  UpdateNode() : refCount(0), lookup(0) {}
   ~UpdateNode();
 
   unsigned computeHash();
@@ -525,6 +598,17 @@ public:
   
   void extend(const ref<Expr> &index, const ref<Expr> &value);
 
+  /// findConstantUpdate - Return the newest update at the constant index
+  /// \a index among the updates newer than any update at a symbolic index,
+  /// or null if there is none. \a rest is set to the newest update at a
+  /// symbolic index, where a search for the value at \a index has to
+  /// continue, or null.
+  ///
+  /// Long update lists are searched with an index, which is built once and
+  /// handed on to the list extending it.
+  const UpdateNode *findConstantUpdate(uint64_t index,
+                                       const UpdateNode *&rest) const;
+
   int compare(const UpdateList &b) const;
   unsigned hash() const;
 private:
@@ -542,10 +626,12 @@ public:
   ref<Expr> index;
 
 public:
+  ~ReadExpr() { noteDestroyed(kind); }
+
   static ref<Expr> alloc(const UpdateList &updates, const ref<Expr> &index) {
     ref<Expr> r(new ReadExpr(updates, index));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(const UpdateList &updates, ref<Expr> i);
@@ -586,11 +672,13 @@ public:
   ref<Expr> cond, trueExpr, falseExpr;
 
 public:
+  ~SelectExpr() { noteDestroyed(kind); }
+
   static ref<Expr> alloc(const ref<Expr> &c, const ref<Expr> &t, 
                          const ref<Expr> &f) {
     ref<Expr> r(new SelectExpr(c, t, f));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(ref<Expr> c, ref<Expr> t, ref<Expr> f);
@@ -644,10 +732,12 @@ private:
   ref<Expr> left, right;  
 
 public:
+  ~ConcatExpr() { noteDestroyed(kind); }
+
   static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {
     ref<Expr> c(new ConcatExpr(l, r));
     c->computeHash();
-    return c;
+    return hashCons(c);
   }
   
   static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);
@@ -703,10 +793,12 @@ public:
   Width width;
 
 public:  
+  ~ExtractExpr() { noteDestroyed(kind); }
+
   static ref<Expr> alloc(const ref<Expr> &e, unsigned o, Width w) {
     ref<Expr> r(new ExtractExpr(e, o, w));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   /// Creates an ExtractExpr with the given bit offset and width
@@ -754,10 +846,12 @@ public:
   ref<Expr> expr;
 
 public:  
+  ~NotExpr() { noteDestroyed(kind); }
+
   static ref<Expr> alloc(const ref<Expr> &e) {
     ref<Expr> r(new NotExpr(e));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(const ref<Expr> &e);
@@ -831,10 +925,11 @@ public:                                                          \
   static const unsigned numKids = 1;                             \
 public:                                                          \
     _class_kind ## Expr(ref<Expr> e, Width w) : CastExpr(e,w) {} \
+    ~_class_kind ## Expr() { noteDestroyed(kind); }          \
     static ref<Expr> alloc(const ref<Expr> &e, Width w) {        \
       ref<Expr> r(new _class_kind ## Expr(e, w));                \
       r->computeHash();                                          \
-      return r;                                                  \
+      return hashCons(r);                                        \
     }                                                            \
     static ref<Expr> create(const ref<Expr> &e, Width w);        \
     Kind getKind() const { return _class_kind; }                 \
@@ -863,10 +958,11 @@ public:                                                              \
 public:                                                              \
     _class_kind ## Expr(const ref<Expr> &l,                          \
                         const ref<Expr> &r) : BinaryExpr(l,r) {}     \
+    ~_class_kind ## Expr() { noteDestroyed(kind); }              \
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) { \
       ref<Expr> res(new _class_kind ## Expr (l, r));                 \
       res->computeHash();                                            \
-      return res;                                                    \
+      return hashCons(res);                                          \
     }                                                                \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r); \
     Width getWidth() const { return left->getWidth(); }              \
@@ -907,10 +1003,11 @@ public:                                                              \
 public:                                                              \
     _class_kind ## Expr(const ref<Expr> &l,                          \
                         const ref<Expr> &r) : CmpExpr(l,r) {}        \
+    ~_class_kind ## Expr() { noteDestroyed(kind); }              \
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) { \
       ref<Expr> res(new _class_kind ## Expr (l, r));                 \
       res->computeHash();                                            \
-      return res;                                                    \
+      return hashCons(res);                                          \
     }                                                                \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r); \
     Kind getKind() const { return _class_kind; }                     \
@@ -950,7 +1047,7 @@ private:
   ConstantExpr(const llvm::APInt &v) : value(v) {}
 
 public:
-  ~ConstantExpr() {}
+  ~ConstantExpr() { noteDestroyed(kind); }
 
   Width getWidth() const { return value.getBitWidth(); }
   Kind getKind() const { return Constant; }
@@ -1011,7 +1108,7 @@ public:
   static ref<ConstantExpr> alloc(const llvm::APInt &v) {
     ref<ConstantExpr> r(new ConstantExpr(v));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
 
   static ref<ConstantExpr> alloc(const llvm::APFloat &f) {
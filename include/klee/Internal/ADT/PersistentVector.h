@@ -0,0 +1,276 @@
+//===-- PersistentVector.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __UTIL_PERSISTENTVECTOR_H__
+#define __UTIL_PERSISTENTVECTOR_H__
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+
+namespace klee {
+  /// PersistentVector - An append-only vector whose copies share their
+  /// elements.
+  ///
+  /// The elements are stored in the leaves of a trie with 32-way branches,
+  /// except for the last up to 32 elements which are kept in a separate
+  /// tail leaf. Copying the vector only takes references to the root and the
+  /// tail. Appending modifies the nodes on the path to the new element in
+  /// place if they are not shared, and copies them otherwise, so that
+  /// appending to one of two copies costs O(log n) and leaves the other
+  /// copy unchanged. Indexing walks the trie in O(log n).
+  template<class T>
+  class PersistentVector {
+    static const unsigned Bits = 5;
+    static const unsigned Width = 1 << Bits;
+    static const unsigned Mask = Width - 1;
+
+    struct Node {
+      unsigned refCount;
+      Node() : refCount(1) {}
+    };
+
+    struct Leaf : Node {
+      T values[Width];
+    };
+
+    struct Branch : Node {
+      Node *children[Width];
+      Branch() { std::fill(children, children + Width, (Node*) 0); }
+    };
+
+  public:
+    typedef T value_type;
+    class const_iterator;
+    typedef const_iterator iterator;
+
+  private:
+    unsigned count;
+    /// The shift of the index at the root; the leaves are at shift zero.
+    unsigned shift;
+    /// The root of the trie, created when the first tail is moved into it.
+    Branch *root;
+    Leaf *tail;
+
+    /// The index of the first element in the tail.
+    unsigned tailOffset() const {
+      return count < Width ? 0 : ((count - 1) >> Bits) << Bits;
+    }
+
+    static void release(Node *node, unsigned level) {
+      if (!node || --node->refCount != 0)
+        return;
+      if (level) {
+        Branch *b = static_cast<Branch*>(node);
+        for (unsigned i = 0; i != Width; ++i)
+          release(b->children[i], level - Bits);
+        delete b;
+      } else {
+        delete static_cast<Leaf*>(node);
+      }
+    }
+
+    /// Make \a b writeable, copying it if it is shared.
+    static Branch *unshare(Branch *b) {
+      if (b->refCount == 1)
+        return b;
+      Branch *copy = new Branch(*b);
+      copy->refCount = 1;
+      for (unsigned i = 0; i != Width; ++i)
+        if (copy->children[i])
+          ++copy->children[i]->refCount;
+      --b->refCount;
+      return copy;
+    }
+
+    /// Return a path of fresh branches from \a level down to \a leaf.
+    static Node *newPath(unsigned level, Leaf *leaf) {
+      if (!level)
+        return leaf;
+      Branch *b = new Branch();
+      b->children[0] = newPath(level - Bits, leaf);
+      return b;
+    }
+
+    /// Insert the full tail \a leaf under \a parent at \a level, where it
+    /// is the leaf of the elements before the tail offset of count.
+    Branch *pushTail(unsigned level, Branch *parent, Leaf *leaf) {
+      parent = unshare(parent);
+      unsigned subidx = ((count - 1) >> level) & Mask;
+      Node *&child = parent->children[subidx];
+      if (level == Bits)
+        child = leaf;
+      else if (child)
+        child = pushTail(level - Bits, static_cast<Branch*>(child), leaf);
+      else
+        child = newPath(level - Bits, leaf);
+      return parent;
+    }
+
+    const T *leafFor(unsigned i) const {
+      if (i >= tailOffset())
+        return tail->values;
+      const Node *node = root;
+      for (unsigned level = shift; level; level -= Bits)
+        node = static_cast<const Branch*>(node)->children[(i >> level) & Mask];
+      return static_cast<const Leaf*>(node)->values;
+    }
+
+  public:
+    PersistentVector() : count(0), shift(Bits), root(0), tail(0) {}
+
+    PersistentVector(const PersistentVector &b)
+      : count(b.count), shift(b.shift), root(b.root), tail(b.tail) {
+      if (root)
+        ++root->refCount;
+      if (tail)
+        ++tail->refCount;
+    }
+
+    template<class InputIt>
+    PersistentVector(InputIt begin, InputIt end)
+      : count(0), shift(Bits), root(0), tail(0) {
+      for (; begin != end; ++begin)
+        push_back(*begin);
+    }
+
+    ~PersistentVector() {
+      release(root, shift);
+      release(tail, 0);
+    }
+
+    PersistentVector &operator=(const PersistentVector &b) {
+      PersistentVector copy(b);
+      swap(copy);
+      return *this;
+    }
+
+    void swap(PersistentVector &b) {
+      std::swap(count, b.count);
+      std::swap(shift, b.shift);
+      std::swap(root, b.root);
+      std::swap(tail, b.tail);
+    }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    const T &operator[](unsigned i) const {
+      assert(i < count && "index out of range");
+      return leafFor(i)[i & Mask];
+    }
+    const T &back() const { return (*this)[count - 1]; }
+
+    void push_back(const T &value) {
+      unsigned offset = count - tailOffset();
+      if (!tail) {
+        tail = new Leaf();
+      } else if (offset == Width) {
+        // The tail is full, move it into the trie.
+        if (!root) {
+          root = new Branch();
+          root->children[0] = tail;
+        } else if ((count >> Bits) > (1u << shift)) {
+          Branch *newRoot = new Branch();
+          newRoot->children[0] = root;
+          newRoot->children[1] = newPath(shift, tail);
+          root = newRoot;
+          shift += Bits;
+        } else {
+          root = pushTail(shift, root, tail);
+        }
+        tail = new Leaf();
+        offset = 0;
+      } else if (tail->refCount != 1) {
+        Leaf *copy = new Leaf(*tail);
+        copy->refCount = 1;
+        --tail->refCount;
+        tail = copy;
+      }
+      tail->values[offset] = value;
+      ++count;
+    }
+
+    void clear() {
+      PersistentVector empty;
+      swap(empty);
+    }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+    bool operator==(const PersistentVector &b) const {
+      if (count != b.count)
+        return false;
+      if (root == b.root && tail == b.tail)
+        return true;
+      return std::equal(begin(), end(), b.begin());
+    }
+    bool operator!=(const PersistentVector &b) const { return !(*this == b); }
+  };
+
+  /// A random access iterator over a persistent vector, which remembers the
+  /// leaf of the last element it accessed.
+  template<class T>
+  class PersistentVector<T>::const_iterator {
+    const PersistentVector *vector;
+    unsigned index;
+    mutable const T *leaf;
+    mutable unsigned leafBase;
+
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const T *pointer;
+    typedef const T &reference;
+
+    const_iterator() : vector(0), index(0), leaf(0), leafBase(0) {}
+    const_iterator(const PersistentVector *_vector, unsigned _index)
+      : vector(_vector), index(_index), leaf(0), leafBase(0) {}
+
+    reference operator*() const {
+      if (!leaf || index - leafBase >= Width) {
+        leaf = vector->leafFor(index);
+        leafBase = index & ~Mask;
+      }
+      return leaf[index - leafBase];
+    }
+    pointer operator->() const { return &**this; }
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+    const_iterator &operator++() { ++index; return *this; }
+    const_iterator operator++(int) { const_iterator it(*this); ++index; return it; }
+    const_iterator &operator--() { --index; return *this; }
+    const_iterator operator--(int) { const_iterator it(*this); --index; return it; }
+    const_iterator &operator+=(difference_type n) { index += n; return *this; }
+    const_iterator &operator-=(difference_type n) { index -= n; return *this; }
+    const_iterator operator+(difference_type n) const {
+      const_iterator it(*this);
+      return it += n;
+    }
+    const_iterator operator-(difference_type n) const {
+      const_iterator it(*this);
+      return it -= n;
+    }
+    difference_type operator-(const const_iterator &b) const {
+      return (difference_type) index - (difference_type) b.index;
+    }
+
+    bool operator==(const const_iterator &b) const { return index == b.index; }
+    bool operator!=(const const_iterator &b) const { return index != b.index; }
+    bool operator<(const const_iterator &b) const { return index < b.index; }
+    bool operator>(const const_iterator &b) const { return index > b.index; }
+    bool operator<=(const const_iterator &b) const { return index <= b.index; }
+    bool operator>=(const const_iterator &b) const { return index >= b.index; }
+  };
+}
+
+#endif
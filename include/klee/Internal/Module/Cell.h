@@ -15,8 +15,62 @@
 namespace klee {
   class MemoryObject;
 
+  /// Cell - The value of a register. Concrete values of up to 64 bits are
+  /// kept as an immediate, so that the interpreter can compute on them
+  /// without allocating expressions; a ConstantExpr is only built when a
+  /// client asks for the value as an expression.
   struct Cell {
-    ref<Expr> value;
+  private:
+    /// The value as an expression. For an immediate, it is null until the
+    /// expression is first asked for.
+    mutable ref<Expr> expr;
+    uint64_t immediate;
+    /// The width of the immediate, or 0 if the cell does not hold one.
+    Expr::Width width;
+
+  public:
+    Cell() : immediate(0), width(0) {}
+
+    /// isNull - Whether the register has not been assigned.
+    bool isNull() const { return !width && expr.isNull(); }
+
+    bool isImmediate() const { return width != 0; }
+
+    uint64_t getImmediate() const {
+      assert(isImmediate() && "not an immediate");
+      return immediate;
+    }
+
+    Expr::Width getWidth() const {
+      return width ? width : expr->getWidth();
+    }
+
+    /// getValue - Return the value as an expression.
+    const ref<Expr> &getValue() const {
+      if (expr.isNull() && width)
+        expr = ConstantExpr::create(immediate, width);
+      return expr;
+    }
+
+    void setValue(const ref<Expr> &e) {
+      expr = e;
+      ConstantExpr *CE = dyn_cast_or_null<ConstantExpr>(e.get());
+      if (CE && CE->getWidth() <= 64) {
+        immediate = CE->getZExtValue();
+        width = CE->getWidth();
+      } else {
+        width = 0;
+      }
+    }
+
+    /// setImmediate - Set the value to \a value, which must have no bits set
+    /// beyond \a w.
+    void setImmediate(uint64_t value, Expr::Width w) {
+      assert(w && w <= 64 && "invalid immediate width");
+      expr = 0;
+      immediate = value;
+      width = w;
+    }
   };
 }
 
@@ -19,10 +19,32 @@ namespace llvm {
 }
 
 namespace klee {
+  class ExecutionState;
   class Executor;
   struct InstructionInfo;
+  struct KInstruction;
   class KModule;
+  class MemoryObject;
+  class ObjectState;
 
+  /// ResolutionCache - The object a memory access last resolved to, for
+  /// accesses at constant addresses.
+  struct ResolutionCache {
+    /// The epoch of the address space the object was bound in, or zero if
+    /// nothing was resolved yet.
+    uint64_t epoch;
+    /// The address and size of the object.
+    uint64_t base, size;
+    const MemoryObject *mo;
+    const ObjectState *os;
+
+    ResolutionCache() : epoch(0), base(0), size(0), mo(0), os(0) {}
+  };
+
+
+  /// An Executor member function interpreting one kind of instruction.
+  typedef void (Executor::*InstructionHandler)(ExecutionState &state,
+                                               KInstruction *ki);
 
   /// KInstruction - Intermediate instruction representation used
   /// during execution.
@@ -37,6 +59,18 @@ namespace klee {
     int *operands;
     /// Destination register index.
     unsigned dest;
+    /// The opcode of inst and, for comparisons, its predicate, decoded
+    /// once by Executor::bindInstructionConstants.
+    unsigned opcode;
+    unsigned predicate;
+    /// The handler of opcode, which Executor::executeInstruction calls
+    /// directly instead of switching on the opcode.
+    InstructionHandler handler;
+    /// The width in bits of the result of inst, or zero if it has none.
+    unsigned width;
+    /// The last resolution of the address of a load or store, see
+    /// Executor::executeMemoryOperation.
+    ResolutionCache resolution;
 
   public:
     virtual ~KInstruction(); 
@@ -213,7 +213,10 @@ namespace klee {
     /// (required for using timeouts).
     /// \param optimizeDivides - Whether constant division operations should
     /// be optimized into add/shift/multiply operations.
-    STPSolver(bool useForkedSTP, bool optimizeDivides = true);
+    /// \param incremental - Whether the constraints of a query should be kept
+    /// asserted for the following queries which extend them.
+    STPSolver(bool useForkedSTP, bool optimizeDivides = true,
+              bool incremental = false);
 
     /// getConstraintLog - Return the constraint log for the given state in CVC
     /// format.
@@ -230,7 +233,10 @@ namespace klee {
   class Z3Solver : public Solver {
   public:
     /// Z3Solver - Construct a new Z3Solver.
-    Z3Solver();
+    ///
+    /// \param incremental - Whether the constraints of a query should be kept
+    /// asserted for the following queries which extend them.
+    Z3Solver(bool incremental = false);
 
     /// Get the query in SMT-LIBv2 format.
     /// \return A C-style string. The caller is responsible for freeing this.
@@ -289,6 +295,34 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createFastCexSolver(Solver *s);
 
+  /// createCanonicalizingSolver - Create a solver which renames the symbolic
+  /// arrays of each query by first occurrence and orders the operands of
+  /// commutative operations canonically before passing it on, so that the
+  /// caches below it see the same query for queries which only differ in
+  /// those respects.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createCanonicalizingSolver(Solver *s);
+
+  /// createPersistentCachingSolver - Create a solver which caches query
+  /// results in a memory mapped file, shared between runs and between
+  /// concurrent processes. Queries which only differ in the names of their
+  /// arrays share an entry. If the file cannot be used, \a s is returned.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param path - The file backing the cache, created if needed.
+  Solver *createPersistentCachingSolver(Solver *s, std::string path);
+
+  /// createArrayExpansionSolver - Create a solver which replaces the reads
+  /// from arrays of at most \a maxSize elements with selects over their
+  /// updates and elements, so that the underlying solver need not reason
+  /// about arrays. Reads beyond the end of an array become fresh variables,
+  /// related by Ackermann constraints.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param maxSize - The size of the largest array expanded.
+  Solver *createArrayExpansionSolver(Solver *s, unsigned maxSize);
+
   /// createIndependentSolver - Create a solver which will eliminate any
   /// unnecessary constraints before propogating the query to the underlying
   /// solver.
@@ -311,6 +345,14 @@ namespace klee {
   /// fails.
   Solver *createDummySolver();
 
+  /// createWorkerPoolSolver - Create a complete solver which runs the given
+  /// core solver in a pool of persistent worker processes. Queries are
+  /// passed to the workers through shared memory and timeouts are enforced
+  /// by killing and restarting the worker.
+  ///
+  /// \param cst - The core solver to run in the workers (stp or z3).
+  Solver *createWorkerPoolSolver(CoreSolverType cst);
+
   // Create a solver based on the supplied ``CoreSolverType``.
   Solver *createCoreSolver(CoreSolverType cst);
 }
@@ -17,12 +17,16 @@ namespace stats {
 
   extern Statistic cexCacheTime;
   extern Statistic queries;
+  extern Statistic queryAssertionsPushed;
+  extern Statistic queryAssertionsReused;
   extern Statistic queriesInvalid;
   extern Statistic queriesValid;
   extern Statistic queryCacheHits;
   extern Statistic queryCacheMisses;
   extern Statistic queryCexCacheHits;
   extern Statistic queryCexCacheMisses;
+  extern Statistic queryPersistentCacheHits;
+  extern Statistic queryPersistentCacheMisses;
   extern Statistic queryConstructTime;
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
@@ -0,0 +1,90 @@
+//===-- ExprBatchEvaluator.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRBATCHEVALUATOR_H
+#define KLEE_EXPRBATCHEVALUATOR_H
+
+#include "klee/Expr.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <vector>
+
+namespace klee {
+  class Assignment;
+
+/// ExprBatchEvaluator - Evaluates an expression under many assignments at
+/// once.
+///
+/// The expression is compiled once into a linear sequence of instructions,
+/// one per distinct subexpression, each computing its value for a block of
+/// assignments at a time. The values of a subexpression under the
+/// assignments of a block are contiguous, so that each instruction is a
+/// simple loop over them which the compiler can vectorize.
+///
+/// Only expressions whose subexpressions are all at most 64 bits wide are
+/// supported. The value under an assignment is unknown where
+/// Assignment::evaluate() would not return a constant: when the expression
+/// reads bytes the assignment does not bind and it allows free values, or
+/// when it divides by zero. Unknown values are also reported, more
+/// conservatively, for out of range shifts and overflowing signed
+/// divisions; callers evaluate those assignments one by one.
+class ExprBatchEvaluator {
+public:
+  /// The number of assignments evaluated together.
+  static const unsigned BlockSize = 64;
+
+private:
+  struct Instruction {
+    Expr::Kind kind;
+    Expr::Width width;
+    /// The width of the operands, for casts and comparisons.
+    Expr::Width operandWidth;
+    unsigned ops[3];
+    /// The value of a constant, the offset of an extract, or the read of a
+    /// read.
+    uint64_t imm;
+  };
+
+  struct Read {
+    const Array *root;
+    /// The index of the array in arrays.
+    unsigned array;
+    /// The instructions computing the index and value of each update,
+    /// newest first.
+    std::vector<std::pair<unsigned, unsigned> > updates;
+  };
+
+  std::vector<Instruction> instructions;
+  std::vector<Read> reads;
+  std::vector<const Array*> arrays;
+  bool supported;
+
+  unsigned compile(const ref<Expr> &e,
+                   llvm::DenseMap<const Expr*, unsigned> &compiled);
+  void evaluateBlock(const Assignment *const *assignments, unsigned count,
+                     uint64_t *values, unsigned char *known) const;
+
+public:
+  explicit ExprBatchEvaluator(const ref<Expr> &e);
+
+  /// isSupported - Whether the expression could be compiled.
+  bool isSupported() const { return supported; }
+
+  /// evaluate - Compute the value of the expression under each of
+  /// \a assignments. \a known[i] is set if the value under the i-th
+  /// assignment is known, and \a values[i] to that value.
+  void evaluate(const std::vector<const Assignment*> &assignments,
+                std::vector<uint64_t> &values,
+                std::vector<unsigned char> &known) const;
+};
+
+}
+
+#endif /* KLEE_EXPRBATCHEVALUATOR_H */
@@ -0,0 +1,103 @@
+//===-- ExprKnownBits.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRKNOWNBITS_H
+#define KLEE_EXPRKNOWNBITS_H
+
+#include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
+
+namespace klee {
+
+/// KnownBits - An over-approximation of the values an expression of up to
+/// 64 bits may take: the bits known to be zero, the bits known to be one,
+/// and an unsigned interval. Nothing is known about wider expressions,
+/// which are represented with a width of 0.
+struct KnownBits {
+  Expr::Width width;
+  uint64_t zeros, ones;
+  uint64_t min, max;
+
+  KnownBits() : width(0), zeros(0), ones(0), min(0), max(0) {}
+
+  /// top - Return the value of a \a w bit expression about which nothing is
+  /// known.
+  static KnownBits top(Expr::Width w);
+
+  /// constant - Return the value of the \a w bit constant \a value.
+  static KnownBits constant(uint64_t value, Expr::Width w);
+
+  uint64_t mask() const {
+    return width ? ~0ULL >> (64 - width) : 0;
+  }
+
+  bool isConstant() const { return width && min == max; }
+
+  /// isTrue, isFalse - Whether a boolean expression is known to be true,
+  /// respectively false.
+  bool isTrue() const { return width == 1 && min == 1; }
+  bool isFalse() const { return width == 1 && max == 0; }
+
+  /// meet - Refine the value with \a b, which is known to hold for the same
+  /// expression. Returns false, leaving the value unchanged, if the two
+  /// contradict each other.
+  bool meet(const KnownBits &b);
+
+  /// normalize - Tighten the interval with the known bits and vice versa.
+  /// Returns false if the value is empty.
+  bool normalize();
+};
+
+/// ConstraintKnownBits - The known bits and unsigned intervals implied by a
+/// set of constraints, used to decide expressions without asking a solver.
+///
+/// Facts are learned from the common shapes of path conditions (equalities
+/// with constants, masked bit tests, and unsigned comparisons with
+/// constants) and pushed down through concatenations and zero extensions,
+/// so that they reach the individual bytes read from arrays. An expression
+/// is then evaluated bottom up over the abstract domain, using the facts
+/// of its subexpressions. Evaluations are cached until the next constraint
+/// is added.
+class ConstraintKnownBits {
+public:
+  unsigned refCount;
+
+  ConstraintKnownBits() : refCount(0), numConstraints(0) {}
+  /// The evaluation cache is not copied, as the copy is about to learn a
+  /// new constraint.
+  ConstraintKnownBits(const ConstraintKnownBits &b)
+    : refCount(0), facts(b.facts), numConstraints(b.numConstraints) {}
+
+  /// addConstraint - Learn the facts implied by \a e being true.
+  void addConstraint(const ref<Expr> &e);
+
+  /// size - Return the number of constraints learned from.
+  unsigned size() const { return numConstraints; }
+
+  /// evaluate - Return an over-approximation of the values \a e may take
+  /// under the constraints.
+  KnownBits evaluate(const ref<Expr> &e) const;
+
+private:
+  ExprHashMap<KnownBits> facts;
+  mutable ExprHashMap<KnownBits> cache;
+  unsigned numConstraints;
+
+  void learn(const ref<Expr> &e, const KnownBits &value);
+  void learnTrue(const ref<Expr> &e);
+  void learnFalse(const ref<Expr> &e);
+  void learnMin(const ref<Expr> &e, uint64_t min);
+  void learnMax(const ref<Expr> &e, uint64_t max);
+
+  KnownBits compute(const ref<Expr> &e) const;
+};
+
+}
+
+#endif /* KLEE_EXPRKNOWNBITS_H */
@@ -0,0 +1,79 @@
+//===-- ExprRewriter.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRREWRITER_H
+#define KLEE_EXPRREWRITER_H
+
+#include "klee/Expr.h"
+
+#include <vector>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace klee {
+
+/// ExprRewriteRule - A local simplification of expressions of one kind. A
+/// rule is tried on an expression whose kind, kid kinds, and width match
+/// its pattern; it then either returns the simplified expression, built
+/// with the create() functions, or null if it does not apply after all.
+struct ExprRewriteRule {
+  typedef ref<Expr> (*ApplyFn)(const ref<Expr> &e);
+
+  const char *name;
+  Expr::Kind kind;
+  /// The kinds of the first two kids, or Expr::InvalidKind to match any.
+  Expr::Kind kidKinds[2];
+  /// The range of widths of the expression.
+  Expr::Width minWidth, maxWidth;
+  ApplyFn apply;
+};
+
+/// ExprRewriter - Applies a set of rewrite rules to the root of freshly
+/// built expressions until none applies. The kids of an expression being
+/// built are already rewritten, so rewriting the root is enough; the
+/// expressions built by the rules are rewritten in turn as they are
+/// created.
+///
+/// The default rewriter, used by the create() functions when
+/// Expr::rewriting is set, holds the built-in rules. Further rules may be
+/// added to it before any expression is built.
+class ExprRewriter {
+public:
+  /// The maximum number of rules applied to one root.
+  static const unsigned MaxSteps = 16;
+
+private:
+  std::vector<ExprRewriteRule> rules;
+  std::vector<uint64_t> hits;
+  /// The indices of the rules of each kind.
+  std::vector<unsigned> rulesByKind[Expr::LastKind + 1];
+
+  bool matches(const ExprRewriteRule &rule, const ref<Expr> &e) const;
+
+public:
+  ExprRewriter() {}
+
+  void addRule(const ExprRewriteRule &rule);
+
+  /// rewrite - Return \a e simplified by the rules.
+  ref<Expr> rewrite(ref<Expr> e);
+
+  /// printStats - Print the number of hits of each rule which was used, one
+  /// line each starting with \a prefix.
+  void printStats(llvm::raw_ostream &os, const char *prefix) const;
+
+  /// getDefault - Return the rewriter with the built-in rules.
+  static ExprRewriter &getDefault();
+};
+
+}
+
+#endif /* KLEE_EXPRREWRITER_H */
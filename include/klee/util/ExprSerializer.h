@@ -0,0 +1,113 @@
+//===-- ExprSerializer.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRSERIALIZER_H
+#define KLEE_EXPRSERIALIZER_H
+
+#include "klee/Expr.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <string>
+#include <vector>
+
+namespace klee {
+  class ArrayCache;
+
+  /// ExprSerializer - Flatten expressions, together with the update lists and
+  /// arrays they reference, into a compact byte stream.
+  ///
+  /// Every node of the expression DAG is written exactly once, no matter how
+  /// many times it is shared, so the stream size is linear in the number of
+  /// distinct nodes. Definitions are emitted lazily in front of the first
+  /// reference to them, which means that a stream is always read back in the
+  /// same order it was written (see ExprDeserializer). A single serializer
+  /// can be used for several expressions, in which case nodes are shared
+  /// between all of them.
+  ///
+  /// Arrays are numbered in order of first occurrence. When array names are
+  /// omitted, expressions which only differ in the names of their arrays
+  /// produce identical streams, which makes the stream usable as a canonical
+  /// cache key. A stream which is read back by the same process while its
+  /// arrays are alive can instead refer to them by address, so that reading
+  /// it yields the very same arrays.
+  class ExprSerializer {
+    std::vector<unsigned char> &out;
+    bool anonymousArrays;
+    bool arraysByAddress;
+
+    llvm::DenseMap<const Expr*, unsigned> exprIDs;
+    llvm::DenseMap<const UpdateNode*, unsigned> updateIDs;
+    llvm::DenseMap<const Array*, unsigned> arrayIDs;
+
+    unsigned defineExpr(const ref<Expr> &e);
+    unsigned defineUpdates(const UpdateNode *head);
+    unsigned defineArray(const Array *array);
+
+  public:
+    explicit ExprSerializer(std::vector<unsigned char> &_out,
+                            bool _anonymousArrays = false,
+                            bool _arraysByAddress = false)
+      : out(_out), anonymousArrays(_anonymousArrays),
+        arraysByAddress(_arraysByAddress) {}
+
+    /// write - Append a reference to the given expression, preceded by the
+    /// definitions of any of its nodes which were not written before.
+    void write(const ref<Expr> &e);
+
+    /// write - Append a reference to the given array.
+    void write(const Array *array);
+
+    /// write - Append a reference to the given update list, whose root may
+    /// be null.
+    void write(const UpdateList &updates);
+
+    void writeU8(uint8_t v) { out.push_back(v); }
+    void writeU32(uint32_t v);
+    void writeU64(uint64_t v);
+    void writeString(const std::string &s);
+  };
+
+  /// ExprDeserializer - Rebuild expressions from a stream produced by
+  /// ExprSerializer.
+  ///
+  /// Arrays are created through the supplied ArrayCache, which therefore must
+  /// outlive every expression that is read. Expressions are rebuilt with the
+  /// \c alloc methods, so they are structurally identical to the serialized
+  /// ones and no simplification is re-applied.
+  class ExprDeserializer {
+    const unsigned char *pos, *end;
+    ArrayCache &arrayCache;
+
+    std::vector<ref<Expr> > exprs;
+    std::vector<UpdateList> updates;
+    std::vector<const Array*> arrays;
+
+    void readDefinition(uint8_t tag);
+
+  public:
+    ExprDeserializer(const unsigned char *begin, const unsigned char *_end,
+                     ArrayCache &_arrayCache)
+      : pos(begin), end(_end), arrayCache(_arrayCache) {}
+
+    ref<Expr> readExpr();
+    const Array *readArray();
+    UpdateList readUpdateList();
+
+    uint8_t readU8();
+    uint32_t readU32();
+    uint64_t readU64();
+    std::string readString();
+
+    /// atEnd - Return true if the whole stream has been consumed.
+    bool atEnd() const { return pos == end; }
+  };
+}
+
+#endif /* KLEE_EXPRSERIALIZER_H */
@@ -0,0 +1,122 @@
+//===-- SlabAllocator.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SLABALLOCATOR_H
+#define KLEE_SLABALLOCATOR_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace klee {
+
+/// SlabAllocator - An allocator for large numbers of small, short lived
+/// objects, such as expressions. Blocks are carved out of large slabs and
+/// freed blocks are kept on a free list per size class (a multiple of
+/// Granularity bytes) for reuse, so allocation and deallocation are a few
+/// instructions and objects carry no malloc header. Slabs are only given
+/// back to the system when the allocator is destroyed. Requests larger than
+/// the largest size class go to the global operator new; the size classes
+/// reach up to the full pages of object states, with their masks, which
+/// forks and copy-on-write allocate most.
+///
+/// The allocator is not thread safe.
+class SlabAllocator {
+public:
+  static const size_t Granularity = 8;
+  static const unsigned NumClasses = 48;
+  static const size_t MaxSize = Granularity * NumClasses;
+  static const size_t SlabSize = 64 * 1024;
+
+private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  const char *name;
+  FreeBlock *freeLists[NumClasses];
+  char *slabBegin, *slabEnd;
+  std::vector<void*> slabs;
+
+  /// Number of live and the highest number of simultaneously live objects
+  /// per size class, the last class counting all larger objects.
+  uint64_t live[NumClasses + 1], peak[NumClasses + 1];
+
+  void *allocateSlow(unsigned sizeClass);
+
+  static unsigned getSizeClass(size_t size) {
+    return (size - 1) / Granularity;
+  }
+
+  void *allocateLarge(size_t size);
+  void deallocateLarge(void *p);
+
+public:
+  explicit SlabAllocator(const char *_name);
+  ~SlabAllocator();
+
+  void *allocate(size_t size) {
+    if (size > MaxSize)
+      return allocateLarge(size);
+
+    unsigned sizeClass = getSizeClass(size);
+    if (++live[sizeClass] > peak[sizeClass])
+      peak[sizeClass] = live[sizeClass];
+    if (FreeBlock *b = freeLists[sizeClass]) {
+      freeLists[sizeClass] = b->next;
+      return b;
+    }
+    size_t blockSize = (sizeClass + 1) * Granularity;
+    if ((size_t) (slabEnd - slabBegin) >= blockSize) {
+      void *p = slabBegin;
+      slabBegin += blockSize;
+      return p;
+    }
+    return allocateSlow(sizeClass);
+  }
+
+  void deallocate(void *p, size_t size) {
+    if (size > MaxSize)
+      return deallocateLarge(p);
+
+    unsigned sizeClass = getSizeClass(size);
+    --live[sizeClass];
+    FreeBlock *b = static_cast<FreeBlock*>(p);
+    b->next = freeLists[sizeClass];
+    freeLists[sizeClass] = b;
+  }
+
+  /// printStats - Print the live and peak number of objects of each size
+  /// class which was used, one line each starting with \a prefix.
+  void printStats(llvm::raw_ostream &os, const char *prefix) const;
+
+  /// getNumLive - Return the number of live objects carved out of slabs.
+  uint64_t getNumLive() const;
+
+  /// getSlabBytes - Return the number of bytes allocated for slabs.
+  uint64_t getSlabBytes() const { return (uint64_t) slabs.size() * SlabSize; }
+};
+
+/// getExprAllocator - Return the allocator of the Expr class hierarchy.
+SlabAllocator &getExprAllocator();
+
+/// getUpdateNodeAllocator - Return the allocator of UpdateNodes.
+SlabAllocator &getUpdateNodeAllocator();
+
+/// getMemoryAllocator - Return the allocator of the memory objects and
+/// object states of the executor and of their pages.
+SlabAllocator &getMemoryAllocator();
+
+}
+
+#endif /* KLEE_SLABALLOCATOR_H */
@@ -31,6 +31,28 @@ UseCache("use-cache",
          llvm::cl::init(true),
          llvm::cl::desc("Use validity caching (default=on)"));
 
+llvm::cl::opt<bool>
+UseQueryCanonicalization("use-query-canonicalization",
+                         llvm::cl::init(false),
+                         llvm::cl::desc("Rename symbolic arrays and order commutative operands canonically before the caches, so that queries only differing in those respects share cache entries (default=off)"));
+
+llvm::cl::opt<std::string>
+PersistentQueryCache("persistent-query-cache",
+                     llvm::cl::desc("Cache solver results in the given file, "
+                                    "shared between runs and concurrent "
+                                    "processes (default=off)"),
+                     llvm::cl::value_desc("path"));
+
+llvm::cl::opt<bool>
+UseArrayExpansion("use-array-expansion",
+                  llvm::cl::init(false),
+                  llvm::cl::desc("Replace the reads from small arrays with selects over their elements before the core solver (default=off)"));
+
+llvm::cl::opt<unsigned>
+ArrayExpansionMaxSize("array-expansion-max-size",
+                      llvm::cl::init(128),
+                      llvm::cl::desc("The size of the largest array expanded by -use-array-expansion (default=128)"));
+
 llvm::cl::opt<bool>
 UseIndependentSolver("use-independent-solver",
                      llvm::cl::init(true),
@@ -59,6 +81,16 @@ UseForkedCoreSolver("use-forked-solver",
              llvm::cl::desc("Run the core SMT solver in a forked process (default=on)"),
              llvm::cl::init(true));
 
+llvm::cl::opt<bool>
+UseSolverWorkerPool("use-solver-worker-pool",
+             llvm::cl::desc("Run the core SMT solver (stp or z3) in persistent worker processes instead of forking for every query (default=off)"),
+             llvm::cl::init(false));
+
+llvm::cl::opt<bool>
+UseIncrementalSolver("use-incremental-solver",
+             llvm::cl::desc("Keep the path constraints asserted in the core SMT solver (stp or z3) between queries, only asserting the constraints a query adds to the previous ones (default=off)"),
+             llvm::cl::init(false));
+
 llvm::cl::opt<bool>
 CoreSolverOptimizeDivides("solver-optimize-divides", 
                  llvm::cl::desc("Optimize constant divides into add/shift/multiplies before passing to core SMT solver (default=off)"),
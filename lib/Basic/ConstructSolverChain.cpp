@@ -36,6 +36,12 @@ Solver *constructSolverChain(Solver *coreSolver, std::string querySMT2LogPath,
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (UseArrayExpansion)
+    solver = createArrayExpansionSolver(solver, ArrayExpansionMaxSize);
+
+  if (!PersistentQueryCache.empty())
+    solver = createPersistentCachingSolver(solver, PersistentQueryCache);
+
   if (UseFastCexSolver)
     solver = createFastCexSolver(solver);
 
@@ -45,6 +51,9 @@ Solver *constructSolverChain(Solver *coreSolver, std::string querySMT2LogPath,
   if (UseCache)
     solver = createCachingSolver(solver);
 
+  if (UseQueryCanonicalization)
+    solver = createCanonicalizingSolver(solver);
+
   if (UseIndependentSolver)
     solver = createIndependentSolver(solver);
 
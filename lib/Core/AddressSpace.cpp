@@ -19,14 +19,21 @@ using namespace klee;
 
 ///
 
+uint64_t AddressSpace::nextEpoch() {
+  static uint64_t epochs = 0;
+  return ++epochs;
+}
+
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
   objects = objects.replace(std::make_pair(mo, os));
+  epoch = nextEpoch();
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
   objects = objects.remove(mo);
+  epoch = nextEpoch();
 }
 
 const ObjectState *AddressSpace::findObject(const MemoryObject *mo) const {
@@ -45,6 +52,7 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
     ObjectState *n = new ObjectState(*os);
     n->copyOnWriteOwner = cowKey;
     objects = objects.replace(std::make_pair(mo, n));
+    epoch = nextEpoch();
     return n;    
   }
 }
@@ -74,8 +82,11 @@ bool AddressSpace::resolveOne(ExecutionState &state,
                               TimingSolver *solver,
                               ref<Expr> address,
                               ObjectPair &result,
-                              bool &success) {
+                              bool &success,
+                              ref<ConstantExpr> *value) {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(address)) {
+    if (value)
+      *value = CE;
     success = resolveOne(CE, result);
     return true;
   } else {
@@ -86,6 +97,8 @@ bool AddressSpace::resolveOne(ExecutionState &state,
     ref<ConstantExpr> cex;
     if (!solver->getValue(state, address, cex))
       return false;
+    if (value)
+      *value = cex;
     uint64_t example = cex->getZExtValue();
     MemoryObject hack(example);
     const MemoryMap::value_type *res = objects.lookup_previous(&hack);
@@ -291,40 +304,62 @@ bool AddressSpace::resolve(ExecutionState &state,
 // transparently avoid screwing up symbolics (if the byte is symbolic
 // then its concrete cache byte isn't being used) but is just a hack.
 
-void AddressSpace::copyOutConcretes() {
-  for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); 
-       it != ie; ++it) {
-    const MemoryObject *mo = it->first;
+void AddressSpace::copyOutConcrete(const MemoryObject *mo,
+                                   const ObjectState *os) const {
+  if (!mo->isUserSpecified && !os->readOnly) {
+    uint8_t *address = (uint8_t*) (unsigned long) mo->address;
+    os->copyConcretesOut(address);
+  }
+}
 
-    if (!mo->isUserSpecified) {
-      ObjectState *os = it->second;
-      uint8_t *address = (uint8_t*) (unsigned long) mo->address;
+bool AddressSpace::copyInConcrete(const MemoryObject *mo,
+                                  const ObjectState *os) {
+  if (!mo->isUserSpecified) {
+    uint8_t *address = (uint8_t*) (unsigned long) mo->address;
 
-      if (!os->readOnly)
-        memcpy(address, os->concreteStore, mo->size);
+    if (os->concretesDiffer(address)) {
+      if (os->readOnly) {
+        return false;
+      } else {
+        ObjectState *wos = getWriteable(mo, os);
+        wos->copyConcretesIn(address);
+      }
     }
   }
+
+  return true;
+}
+
+void AddressSpace::copyOutConcretes() {
+  for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); 
+       it != ie; ++it)
+    copyOutConcrete(it->first, it->second);
 }
 
 bool AddressSpace::copyInConcretes() {
   for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); 
-       it != ie; ++it) {
-    const MemoryObject *mo = it->first;
+       it != ie; ++it)
+    if (!copyInConcrete(it->first, it->second))
+      return false;
 
-    if (!mo->isUserSpecified) {
-      const ObjectState *os = it->second;
-      uint8_t *address = (uint8_t*) (unsigned long) mo->address;
+  return true;
+}
 
-      if (memcmp(address, os->concreteStore, mo->size)!=0) {
-        if (os->readOnly) {
-          return false;
-        } else {
-          ObjectState *wos = getWriteable(mo, os);
-          memcpy(wos->concreteStore, address, mo->size);
-        }
-      }
-    }
-  }
+void AddressSpace::copyOutConcretes(const std::vector<const MemoryObject*>
+                                      &mos) {
+  for (std::vector<const MemoryObject*>::const_iterator it = mos.begin(),
+         ie = mos.end(); it != ie; ++it)
+    if (const ObjectState *os = findObject(*it))
+      copyOutConcrete(*it, os);
+}
+
+bool AddressSpace::copyInConcretes(const std::vector<const MemoryObject*>
+                                     &mos) {
+  for (std::vector<const MemoryObject*>::const_iterator it = mos.begin(),
+         ie = mos.end(); it != ie; ++it)
+    if (const ObjectState *os = findObject(*it))
+      if (!copyInConcrete(*it, os))
+        return false;
 
   return true;
 }
@@ -38,8 +38,16 @@ namespace klee {
     /// Epoch counter used to control ownership of objects.
     mutable unsigned cowKey;
 
+    /// Identifies the bindings in objects, see getEpoch().
+    uint64_t epoch;
+
+    static uint64_t nextEpoch();
+
     /// Unsupported, use copy constructor
     AddressSpace &operator=(const AddressSpace&); 
+
+    void copyOutConcrete(const MemoryObject *mo, const ObjectState *os) const;
+    bool copyInConcrete(const MemoryObject *mo, const ObjectState *os);
     
   public:
     /// The MemoryObject -> ObjectState map that constitutes the
@@ -52,10 +60,17 @@ namespace klee {
     MemoryMap objects;
     
   public:
-    AddressSpace() : cowKey(1) {}
-    AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) { }
+    AddressSpace() : cowKey(1), epoch(nextEpoch()) {}
+    AddressSpace(const AddressSpace &b)
+      : cowKey(++b.cowKey), epoch(nextEpoch()), objects(b.objects) { }
     ~AddressSpace() {}
 
+    /// Return a number which changes whenever a binding in the address space
+    /// is added, removed or replaced. The number is unique across all
+    /// address spaces and is never reused, so an object and object state
+    /// remembered together with it are still bound while it is unchanged.
+    uint64_t getEpoch() const { return epoch; }
+
     /// Resolve address to an ObjectPair in result.
     /// \return true iff an object was found.
     bool resolveOne(const ref<ConstantExpr> &address, 
@@ -69,12 +84,15 @@ namespace klee {
     /// \param address The address to search for.
     /// \param[out] result An ObjectPair this address can resolve to 
     ///               (when returning true).
+    /// \param[out] value If non-null, set to the value of \a address the
+    ///               search started from, if the solver gave one.
     /// \return true iff an object was found at \a address.
     bool resolveOne(ExecutionState &state, 
                     TimingSolver *solver,
                     ref<Expr> address,
                     ObjectPair &result,
-                    bool &success);
+                    bool &success,
+                    ref<ConstantExpr> *value = 0);
 
     /// Resolve address to a list of ObjectPairs it can point to. If
     /// maxResolutions is non-zero then no more than that many pairs
@@ -125,6 +143,14 @@ namespace klee {
     /// \retval true The copy succeeded. 
     /// \retval false The copy failed because a read-only object was modified.
     bool copyInConcretes();
+
+    /// Copy the concrete values of the ObjectStates of \a mos out, as
+    /// copyOutConcretes() does for all of them.
+    void copyOutConcretes(const std::vector<const MemoryObject*> &mos);
+
+    /// Copy the concrete values of the ObjectStates of \a mos back in, as
+    /// copyInConcretes() does for all of them.
+    bool copyInConcretes(const std::vector<const MemoryObject*> &mos);
   };
 } // End klee namespace
 
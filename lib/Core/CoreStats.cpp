@@ -31,3 +31,6 @@ Statistic stats::querySuccTime("QuerySuccTime", "QStime");
 Statistic stats::queryFailTime("QueryFailTime", "QFtime");
 Statistic stats::succQueries("SuccQueries", "SQueries");
 Statistic stats::failQueries("FailQueries", "FQueries");
+Statistic stats::knownBitsQueries("KnownBitsQueries", "KBQueries");
+Statistic stats::nativeCalls("NativeCalls", "NCalls");
+Statistic stats::resolutionCacheHits("ResolutionCacheHits", "RCHits");
@@ -31,6 +31,17 @@ namespace stats {
   extern Statistic succQueries;
   extern Statistic failQueries;
 
+  /// The number of queries decided from the known bits and intervals of
+  /// the constraints, without reaching the solver.
+  extern Statistic knownBitsQueries;
+
+  /// The number of calls run natively, see Executor::callNatively().
+  extern Statistic nativeCalls;
+
+  /// The number of memory accesses resolved through the object their
+  /// instruction last accessed, see KInstruction::resolution.
+  extern Statistic resolutionCacheHits;
+
   /// The number of process forks.
   extern Statistic forks;
 
@@ -29,6 +29,7 @@
 #include <sstream>
 #include <cassert>
 #include <map>
+#include <new>
 #include <set>
 #include <stdarg.h>
 
@@ -38,6 +39,24 @@ using namespace klee;
 namespace { 
   cl::opt<bool>
   DebugLogStateMerge("debug-log-state-merge");
+
+  /// Allocate \a n registers, with their reference count in front of them.
+  Cell *allocateLocals(unsigned n, unsigned *&refCount) {
+    void *p = ::operator new(sizeof(Cell) * (n + 1));
+    refCount = new (p) unsigned(1);
+    Cell *locals = static_cast<Cell*>(p) + 1;
+    for (unsigned i = 0; i != n; ++i)
+      new (&locals[i]) Cell();
+    return locals;
+  }
+
+  void releaseLocals(Cell *locals, unsigned *refCount, unsigned n) {
+    if (--*refCount)
+      return;
+    for (unsigned i = 0; i != n; ++i)
+      locals[i].~Cell();
+    ::operator delete(refCount);
+  }
 }
 
 /***/
@@ -45,7 +64,7 @@ namespace {
 StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
   : caller(_caller), kf(_kf), callPathNode(0), 
     minDistToUncoveredOnReturn(0), varargs(0) {
-  locals = new Cell[kf->numRegisters];
+  locals = allocateLocals(kf->numRegisters, localsRefCount);
 }
 
 StackFrame::StackFrame(const StackFrame &s) 
@@ -53,15 +72,40 @@ StackFrame::StackFrame(const StackFrame &s)
     kf(s.kf),
     callPathNode(s.callPathNode),
     allocas(s.allocas),
+    locals(s.locals),
+    localsRefCount(s.localsRefCount),
     minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
     varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
-  for (unsigned i=0; i<s.kf->numRegisters; i++)
-    locals[i] = s.locals[i];
+  // The registers are copied on the first write to them.
+  ++*localsRefCount;
 }
 
 StackFrame::~StackFrame() { 
-  delete[] locals; 
+  releaseLocals(locals, localsRefCount, kf->numRegisters);
+}
+
+StackFrame &StackFrame::operator=(const StackFrame &s) {
+  ++*s.localsRefCount;
+  releaseLocals(locals, localsRefCount, kf->numRegisters);
+  caller = s.caller;
+  kf = s.kf;
+  callPathNode = s.callPathNode;
+  allocas = s.allocas;
+  locals = s.locals;
+  localsRefCount = s.localsRefCount;
+  minDistToUncoveredOnReturn = s.minDistToUncoveredOnReturn;
+  varargs = s.varargs;
+  return *this;
+}
+
+void StackFrame::unshareLocals() {
+  unsigned *refCount;
+  Cell *copy = allocateLocals(kf->numRegisters, refCount);
+  for (unsigned i = 0; i != kf->numRegisters; ++i)
+    copy[i] = locals[i];
+  releaseLocals(locals, localsRefCount, kf->numRegisters);
+  locals = copy;
+  localsRefCount = refCount;
 }
 
 /***/
@@ -81,19 +125,12 @@ ExecutionState::ExecutionState(KFunction *kf) :
   pushFrame(0, kf);
 }
 
+ExecutionState::ExecutionState() : ptreeNode(0) {}
+
 ExecutionState::ExecutionState(const std::vector<ref<Expr> > &assumptions)
     : constraints(assumptions), queryCost(0.), ptreeNode(0) {}
 
 ExecutionState::~ExecutionState() {
-  for (unsigned int i=0; i<symbolics.size(); i++)
-  {
-    const MemoryObject *mo = symbolics[i].first;
-    assert(mo->refCount > 0);
-    mo->refCount--;
-    if (mo->refCount == 0)
-      delete mo;
-  }
-
   while (!stack.empty()) popFrame();
 }
 
@@ -122,8 +159,6 @@ ExecutionState::ExecutionState(const ExecutionState& state):
     symbolics(state.symbolics),
     arrayNames(state.arrayNames)
 {
-  for (unsigned int i=0; i<symbolics.size(); i++)
-    symbolics[i].first->refCount++;
 }
 
 ExecutionState *ExecutionState::branch() {
@@ -131,7 +166,7 @@ ExecutionState *ExecutionState::branch() {
 
   ExecutionState *falseState = new ExecutionState(*this);
   falseState->coveredNew = false;
-  falseState->coveredLines.clear();
+  falseState->coveredLines = covered_lines_ty();
 
   weight *= .5;
   falseState->weight -= weight;
@@ -152,24 +187,32 @@ void ExecutionState::popFrame() {
 }
 
 void ExecutionState::addSymbolic(const MemoryObject *mo, const Array *array) { 
-  mo->refCount++;
-  symbolics.push_back(std::make_pair(mo, array));
+  symbolics.push_back(std::make_pair(ref<const MemoryObject>(mo), array));
+}
+
+void ExecutionState::addCoveredLine(const std::string *file, unsigned line) {
+  const covered_lines_ty::value_type *lines = coveredLines.lookup(file);
+  ImmutableSet<unsigned> fileLines;
+  if (lines)
+    fileLines = lines->second;
+  coveredLines = coveredLines.replace(std::make_pair(file,
+                                                     fileLines.insert(line)));
 }
 ///
 
 std::string ExecutionState::getFnAlias(std::string fn) {
-  std::map < std::string, std::string >::iterator it = fnAliases.find(fn);
-  if (it != fnAliases.end())
-    return it->second;
+  const std::pair<std::string, std::string> *alias = fnAliases.lookup(fn);
+  if (alias)
+    return alias->second;
   else return "";
 }
 
 void ExecutionState::addFnAlias(std::string old_fn, std::string new_fn) {
-  fnAliases[old_fn] = new_fn;
+  fnAliases = fnAliases.replace(std::make_pair(old_fn, new_fn));
 }
 
 void ExecutionState::removeFnAlias(std::string fn) {
-  fnAliases.erase(fn);
+  fnAliases = fnAliases.remove(fn);
 }
 
 /**/
@@ -196,8 +239,12 @@ bool ExecutionState::merge(const ExecutionState &b) {
 
   // XXX is it even possible for these to differ? does it matter? probably
   // implies difference in object states?
-  if (symbolics!=b.symbolics)
+  if (symbolics.size() != b.symbolics.size())
     return false;
+  for (unsigned i = 0; i != symbolics.size(); ++i)
+    if (symbolics[i].first.get() != b.symbolics[i].first.get() ||
+        symbolics[i].second != b.symbolics[i].second)
+      return false;
 
   {
     std::vector<StackFrame>::const_iterator itA = stack.begin();
@@ -311,13 +358,13 @@ bool ExecutionState::merge(const ExecutionState &b) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
-      if (av.isNull() || bv.isNull()) {
+      Cell &ac = af.getWriteableLocals()[i];
+      const Cell &bc = bf.getLocals()[i];
+      if (ac.isNull() || bc.isNull()) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
       } else {
-        av = SelectExpr::create(inA, av, bv);
+        ac.setValue(SelectExpr::create(inA, ac.getValue(), bc.getValue()));
       }
     }
   }
@@ -370,7 +417,8 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
 
       out << ai->getName().str();
       // XXX should go through function
-      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value;
+      ref<Expr> value =
+        sf.getLocals()[sf.kf->getArgRegister(index++)].getValue();
       if (value.get() && isa<ConstantExpr>(value))
         out << "=" << value;
     }
@@ -18,10 +18,13 @@
 #include "Searcher.h"
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
+#include "StateSwapper.h"
 #include "StatsTracker.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
 #include "ExecutorTimerInfo.h"
+#include "ExprJIT.h"
+#include "FunctionJIT.h"
 #include "VarAnalysis.h"
 #include "DependencyGraph.h"
 
@@ -32,6 +35,7 @@
 #include "klee/CommandLine.h"
 #include "klee/Common.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/ExprBatchEvaluator.h"
 #include "klee/util/ExprPPrinter.h"
 #include "klee/util/ExprSMTLIBPrinter.h"
 #include "klee/util/ExprVisitor.h"
@@ -46,6 +50,7 @@
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/Internal/Support/FloatEvaluation.h"
+#include "klee/Internal/Support/IntEvaluation.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/System/MemoryUsage.h"
 #include "klee/SolverStats.h"
@@ -110,6 +115,7 @@
 
 #include <cassert>
 #include <algorithm>
+#include <functional>
 #include <iomanip>
 #include <iosfwd>
 #include <fstream>
@@ -243,6 +249,21 @@ namespace {
 		       cl::init(true),
 		       cl::desc("Simplify equality expressions before querying the solver (default=on)."));
 
+  cl::opt<bool>
+  KnownBitsDecisions("known-bits-decisions",
+                     cl::init(true),
+                     cl::desc("Decide branch conditions from the known bits and ranges implied by the constraints before querying the solver (default=on)."));
+
+  cl::opt<bool>
+  UseExprJIT("use-expr-jit",
+             cl::init(false),
+             cl::desc("Compile the expressions evaluated most under seeds to native code (default=off)."));
+
+  cl::opt<unsigned>
+  ExprJITThreshold("expr-jit-threshold",
+                   cl::init(8),
+                   cl::desc("Number of evaluations of an expression under seeds before it is compiled with -use-expr-jit (default=8)."));
+
   cl::opt<unsigned>
   MaxSymArraySize("max-sym-array-size",
                   cl::init(0));
@@ -384,6 +405,21 @@ namespace {
   MaxMemoryInhibit("max-memory-inhibit",
             cl::desc("Inhibit forking at memory cap (vs. random terminate) (default=on)"),
             cl::init(true));
+
+  cl::opt<bool>
+  SwapStates("swap-states",
+             cl::desc("Swap idle states to disk at memory cap before inhibiting forking or terminating states (default=off)"),
+             cl::init(false));
+
+  cl::opt<bool>
+  LazyGlobals("lazy-globals",
+              cl::desc("Create the objects of globals with initializers on their first access in a state (default=off)"),
+              cl::init(false));
+
+  cl::opt<bool>
+  NativeCalls("native-calls",
+              cl::desc("Run calls with concrete arguments natively when all memory is concrete (default=off)"),
+              cl::init(false));
 }
 
 
@@ -412,7 +448,9 @@ const char *Executor::TerminateReasonNames[] = {
 
 Executor::Executor(const InterpreterOptions &opts, InterpreterHandler *ih)
     : Interpreter(opts), kmodule(0), interpreterHandler(ih), searcher(0),
-      externalDispatcher(new ExternalDispatcher()), statsTracker(0),
+      externalDispatcher(new ExternalDispatcher()), exprJIT(0),
+      functionJIT(0),
+      stateSwapper(0), statsTracker(0),
       pathWriter(0), symPathWriter(0), specialFunctionHandler(0),
       processTree(0), replayKTest(0), replayPath(0), usingSeeds(0),
       atMemoryLimit(false), inhibitForking(false), haltExecution(false),
@@ -439,9 +477,19 @@ Executor::Executor(const InterpreterOptions &opts, InterpreterHandler *ih)
       interpreterHandler->getOutputFilename(ALL_QUERIES_PC_FILE_NAME),
       interpreterHandler->getOutputFilename(SOLVER_QUERIES_PC_FILE_NAME));
 
-  this->solver = new TimingSolver(solver, EqualitySubstitution);
+  this->solver = new TimingSolver(solver, EqualitySubstitution,
+                                  KnownBitsDecisions);
   memory = new MemoryManager(&arrayCache);
 
+  if (UseExprJIT)
+    exprJIT = new ExprJIT(externalDispatcher->getExecutionEngine(),
+                          ExprJITThreshold);
+
+  if (SwapStates)
+    stateSwapper =
+      new StateSwapper(interpreterHandler->getOutputFilename("states.swap"),
+                       arrayCache);
+
   if (optionIsSet(DebugPrintInstructions, FILE_ALL) ||
       optionIsSet(DebugPrintInstructions, FILE_COMPACT) ||
       optionIsSet(DebugPrintInstructions, FILE_SRC)) {
@@ -529,7 +577,9 @@ const Module *Executor::setModule(llvm::Module *module,
 }
 
 Executor::~Executor() {
+  delete stateSwapper;
   delete memory;
+  delete exprJIT;
   delete externalDispatcher;
   if (processTree)
     delete processTree;
@@ -744,10 +794,14 @@ void Executor::initializeGlobals(ExecutionState &state) {
       MemoryObject *mo = memory->allocate(size, false, true, &*i);
       if (!mo)
         llvm::report_fatal_error("out of memory");
-      ObjectState *os = bindObjectInState(state, mo, false);
       globalObjects.insert(std::make_pair(i, mo));
       globalAddresses.insert(std::make_pair(i, mo->getBaseExpr()));
 
+      if (LazyGlobals && i->hasInitializer()) {
+        lazyGlobals.insert(std::make_pair(mo->address, &*i));
+        continue;
+      }
+      ObjectState *os = bindObjectInState(state, mo, false);
       if (!i->hasInitializer())
           os->initializeToRandom();
     }
@@ -765,7 +819,7 @@ void Executor::initializeGlobals(ExecutionState &state) {
   for (Module::const_global_iterator i = m->global_begin(),
          e = m->global_end();
        i != e; ++i) {
-    if (i->hasInitializer()) {
+    if (i->hasInitializer() && !LazyGlobals) {
       MemoryObject *mo = globalObjects.find(i)->second;
       const ObjectState *os = state.addressSpace.findObject(mo);
       assert(os);
@@ -777,6 +831,59 @@ void Executor::initializeGlobals(ExecutionState &state) {
   }
 }
 
+bool Executor::bindLazyGlobal(ExecutionState &state, uint64_t address) {
+  std::map<uint64_t, const GlobalVariable*>::iterator it =
+    lazyGlobals.upper_bound(address);
+  if (it == lazyGlobals.begin())
+    return false;
+  --it;
+  const GlobalVariable *gv = it->second;
+  const MemoryObject *mo = globalObjects.find(gv)->second;
+  if (!((mo->size == 0 && address == mo->address) ||
+        address - mo->address < mo->size))
+    return false;
+  if (state.addressSpace.findObject(mo))
+    return false;
+
+  ObjectHolder &initial = lazyGlobalStates[mo];
+  if (!(ObjectState*) initial) {
+    ObjectState *os = new ObjectState(mo);
+    initial = os;
+    initializeGlobalObject(state, os, gv->getInitializer(), 0);
+  }
+  // The copy shares the pages of the initial object state until written.
+  state.addressSpace.bindObject(mo, new ObjectState(*initial));
+  return true;
+}
+
+void Executor::bindLazyGlobals(ExecutionState &state) {
+  for (std::map<uint64_t, const GlobalVariable*>::iterator
+         it = lazyGlobals.begin(), ie = lazyGlobals.end(); it != ie; ++it)
+    bindLazyGlobal(state, it->first);
+}
+
+void Executor::evaluateSeeds(const std::vector<SeedInfo> &seeds, ref<Expr> e,
+                             std::vector< ref<ConstantExpr> > &values) {
+  std::vector<const Assignment*> assignments;
+  for (std::vector<SeedInfo>::const_iterator siit = seeds.begin(),
+         siie = seeds.end(); siit != siie; ++siit)
+    assignments.push_back(&siit->assignment);
+
+  std::vector<uint64_t> batch;
+  std::vector<unsigned char> known;
+  bool compiled = exprJIT && exprJIT->evaluate(e, assignments, batch, known);
+  // The compiled code gives up on the whole expression where part of it is
+  // undefined, the batch evaluation only where the result depends on it.
+  if (!compiled ||
+      std::find(known.begin(), known.end(), 0) != known.end())
+    ExprBatchEvaluator(e).evaluate(assignments, batch, known);
+
+  values.assign(seeds.size(), 0);
+  for (unsigned i = 0, n = seeds.size(); i != n; ++i)
+    if (known[i])
+      values[i] = ConstantExpr::create(batch[i], e->getWidth());
+}
+
 void Executor::branch(ExecutionState &state, 
                       const std::vector< ref<Expr> > &conditions,
                       std::vector<ExecutionState*> &result) {
@@ -821,6 +928,10 @@ void Executor::branch(ExecutionState &state,
     std::vector<SeedInfo> seeds = it->second;
     seedMap.erase(it);
 
+    std::vector< std::vector< ref<ConstantExpr> > > values(N);
+    for (unsigned i=0; i<N; ++i)
+      evaluateSeeds(seeds, conditions[i], values[i]);
+
     // Assume each seed only satisfies one condition (necessarily true
     // when conditions are mutually exclusive and their conjunction is
     // a tautology).
@@ -828,12 +939,14 @@ void Executor::branch(ExecutionState &state,
            siie = seeds.end(); siit != siie; ++siit) {
       unsigned i;
       for (i=0; i<N; ++i) {
-        ref<ConstantExpr> res;
-        bool success = 
-          solver->getValue(state, siit->assignment.evaluate(conditions[i]), 
-                           res);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
+        ref<ConstantExpr> res = values[i][siit - seeds.begin()];
+        if (res.isNull()) {
+          bool success = 
+            solver->getValue(state, siit->assignment.evaluate(conditions[i]), 
+                             res);
+          assert(success && "FIXME: Unhandled solver failure");
+          (void) success;
+        }
         if (res->isTrue())
           break;
       }
@@ -967,14 +1080,18 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       (current.forkDisabled || OnlyReplaySeeds) && 
       res == Solver::Unknown) {
     bool trueSeed=false, falseSeed=false;
+    std::vector< ref<ConstantExpr> > values;
+    evaluateSeeds(it->second, condition, values);
     // Is seed extension still ok here?
     for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
            siie = it->second.end(); siit != siie; ++siit) {
-      ref<ConstantExpr> res;
-      bool success = 
-        solver->getValue(current, siit->assignment.evaluate(condition), res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
+      ref<ConstantExpr> res = values[siit - it->second.begin()];
+      if (res.isNull()) {
+        bool success = 
+          solver->getValue(current, siit->assignment.evaluate(condition), res);
+        assert(success && "FIXME: Unhandled solver failure");
+        (void) success;
+      }
       if (res->isTrue()) {
         trueSeed = true;
       } else {
@@ -1036,13 +1153,18 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       it->second.clear();
       std::vector<SeedInfo> &trueSeeds = seedMap[trueState];
       std::vector<SeedInfo> &falseSeeds = seedMap[falseState];
+      std::vector< ref<ConstantExpr> > values;
+      evaluateSeeds(seeds, condition, values);
       for (std::vector<SeedInfo>::iterator siit = seeds.begin(), 
              siie = seeds.end(); siit != siie; ++siit) {
-        ref<ConstantExpr> res;
-        bool success = 
-          solver->getValue(current, siit->assignment.evaluate(condition), res);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
+        ref<ConstantExpr> res = values[siit - seeds.begin()];
+        if (res.isNull()) {
+          bool success = 
+            solver->getValue(current, siit->assignment.evaluate(condition),
+                             res);
+          assert(success && "FIXME: Unhandled solver failure");
+          (void) success;
+        }
         if (res->isTrue()) {
           trueSeeds.push_back(*siit);
         } else {
@@ -1111,13 +1233,20 @@ void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
     seedMap.find(&state);
   if (it != seedMap.end()) {
     bool warn = false;
+    std::vector< ref<ConstantExpr> > values;
+    evaluateSeeds(it->second, condition, values);
     for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
            siie = it->second.end(); siit != siie; ++siit) {
+      ref<ConstantExpr> value = values[siit - it->second.begin()];
       bool res;
-      bool success = 
-        solver->mustBeFalse(state, siit->assignment.evaluate(condition), res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
+      if (!value.isNull()) {
+        res = value->isFalse();
+      } else {
+        bool success = 
+          solver->mustBeFalse(state, siit->assignment.evaluate(condition), res);
+        assert(success && "FIXME: Unhandled solver failure");
+        (void) success;
+      }
       if (res) {
         siit->patchSeed(state, condition, solver);
         warn = true;
@@ -1209,18 +1338,18 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
   } else {
     unsigned index = vnumber;
     StackFrame &sf = state.stack.back();
-    return sf.locals[index];
+    return sf.getLocals()[index];
   }
 }
 
 void Executor::bindLocal(KInstruction *target, ExecutionState &state, 
                          ref<Expr> value) {
-  getDestCell(state, target).value = value;
+  getDestCell(state, target).setValue(value);
 }
 
 void Executor::bindArgument(KFunction *kf, unsigned index, 
                             ExecutionState &state, ref<Expr> value) {
-  getArgumentCell(state, kf, index).value = value;
+  getArgumentCell(state, kf, index).setValue(value);
 }
 
 ref<Expr> Executor::toUnique(const ExecutionState &state, 
@@ -1288,13 +1417,17 @@ void Executor::executeGetValue(ExecutionState &state,
     bindLocal(target, state, value);
   } else {
     std::set< ref<Expr> > values;
+    std::vector< ref<ConstantExpr> > seedValues;
+    evaluateSeeds(it->second, e, seedValues);
     for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
            siie = it->second.end(); siit != siie; ++siit) {
-      ref<ConstantExpr> value;
-      bool success = 
-        solver->getValue(state, siit->assignment.evaluate(e), value);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
+      ref<ConstantExpr> value = seedValues[siit - it->second.begin()];
+      if (value.isNull()) {
+        bool success = 
+          solver->getValue(state, siit->assignment.evaluate(e), value);
+        assert(success && "FIXME: Unhandled solver failure");
+        (void) success;
+      }
       values.insert(value);
     }
     
@@ -1434,6 +1567,9 @@ void Executor::executeCall(ExecutionState &state,
     if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
       transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
   } else {
+    if (functionJIT && callNatively(state, ki, f, arguments))
+      return;
+
     // FIXME: I'm not really happy about this reliance on prevPC but it is ok, I
     // guess. This just done to avoid having to pass KInstIterator everywhere
     // instead of the actual instruction, since we can't make a KInstIterator
@@ -1553,7 +1689,7 @@ void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src,
   KFunction *kf = state.stack.back().kf;
   unsigned entry = kf->basicBlockEntry[dst];
   state.pc = &kf->instructions[entry];
-  if (state.pc->inst->getOpcode() == Instruction::PHI) {
+  if (state.pc->opcode == Instruction::PHI) {
     PHINode *first = static_cast<PHINode*>(state.pc->inst);
     state.incomingBBIndex = first->getBasicBlockIndex(src);
   }
@@ -1627,1079 +1763,1342 @@ static inline const llvm::fltSemantics * fpWidthToSemantics(unsigned width) {
   }
 }
 
+bool Executor::evalImmediateOperands(ExecutionState &state, KInstruction *ki,
+                                     uint64_t &left, uint64_t &right,
+                                     Expr::Width &width) {
+  const Cell &l = eval(ki, 0, state);
+  const Cell &r = eval(ki, 1, state);
+  if (!l.isImmediate() || !r.isImmediate())
+    return false;
+  left = l.getImmediate();
+  right = r.getImmediate();
+  width = l.getWidth();
+  return true;
+}
+
+bool Executor::evalImmediateOperand(ExecutionState &state, KInstruction *ki,
+                                    uint64_t &value, Expr::Width &width) {
+  const Cell &arg = eval(ki, 0, state);
+  if (!arg.isImmediate() || ki->width > 64)
+    return false;
+  value = arg.getImmediate();
+  width = arg.getWidth();
+  return true;
+}
+
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
+  (this->*ki->handler)(state, ki);
+}
+
+void Executor::executeRetInst(ExecutionState &state, KInstruction *ki) {
   Instruction *i = ki->inst;
-  switch (i->getOpcode()) {
-    // Control flow
-  case Instruction::Ret: {
-    ReturnInst *ri = cast<ReturnInst>(i);
-    KInstIterator kcaller = state.stack.back().caller;
-    Instruction *caller = kcaller ? kcaller->inst : 0;
-    bool isVoidReturn = (ri->getNumOperands() == 0);
-    ref<Expr> result = ConstantExpr::alloc(0, Expr::Bool);
-    if (!isVoidReturn) {
-      result = eval(ki, 0, state).value;
-    }
-    if (state.stack.size() <= 1) {
-      assert(!caller && "caller set on initial stack frame");
-      terminateStateOnExit(state);
-    } else {
-      state.popFrame();
+  ReturnInst *ri = cast<ReturnInst>(i);
+  KInstIterator kcaller = state.stack.back().caller;
+  Instruction *caller = kcaller ? kcaller->inst : 0;
+  bool isVoidReturn = (ri->getNumOperands() == 0);
+  ref<Expr> result = ConstantExpr::alloc(0, Expr::Bool);
+  if (!isVoidReturn) {
+    result = eval(ki, 0, state).getValue();
+  }
+  if (state.stack.size() <= 1) {
+    assert(!caller && "caller set on initial stack frame");
+    terminateStateOnExit(state);
+  } else {
+    state.popFrame();
 
-      if (statsTracker)
-        statsTracker->framePopped(state);
+    if (statsTracker)
+      statsTracker->framePopped(state);
 
-      if (InvokeInst *ii = dyn_cast<InvokeInst>(caller)) {
-        transferToBasicBlock(ii->getNormalDest(), caller->getParent(), state);
-      } else {
-        state.pc = kcaller;
-        ++state.pc;
-      }
+    if (InvokeInst *ii = dyn_cast<InvokeInst>(caller)) {
+      transferToBasicBlock(ii->getNormalDest(), caller->getParent(), state);
+    } else {
+      state.pc = kcaller;
+      ++state.pc;
+    }
 
-      if (!isVoidReturn) {
-        LLVM_TYPE_Q Type *t = caller->getType();
-        if (t != Type::getVoidTy(getGlobalContext())) {
-          // may need to do coercion due to bitcasts
-          Expr::Width from = result->getWidth();
-          Expr::Width to = getWidthForLLVMType(t);
-            
-          if (from != to) {
-            CallSite cs = (isa<InvokeInst>(caller) ? CallSite(cast<InvokeInst>(caller)) : 
-                           CallSite(cast<CallInst>(caller)));
+    if (!isVoidReturn) {
+      LLVM_TYPE_Q Type *t = caller->getType();
+      if (t != Type::getVoidTy(getGlobalContext())) {
+        // may need to do coercion due to bitcasts
+        Expr::Width from = result->getWidth();
+        Expr::Width to = getWidthForLLVMType(t);
+          
+        if (from != to) {
+          CallSite cs = (isa<InvokeInst>(caller) ? CallSite(cast<InvokeInst>(caller)) : 
+                         CallSite(cast<CallInst>(caller)));
 
-            // XXX need to check other param attrs ?
+          // XXX need to check other param attrs ?
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-      bool isSExt = cs.paramHasAttr(0, llvm::Attribute::SExt);
+    bool isSExt = cs.paramHasAttr(0, llvm::Attribute::SExt);
 #elif LLVM_VERSION_CODE >= LLVM_VERSION(3, 2)
 	    bool isSExt = cs.paramHasAttr(0, llvm::Attributes::SExt);
 #else
 	    bool isSExt = cs.paramHasAttr(0, llvm::Attribute::SExt);
 #endif
-            if (isSExt) {
-              result = SExtExpr::create(result, to);
-            } else {
-              result = ZExtExpr::create(result, to);
-            }
+          if (isSExt) {
+            result = SExtExpr::create(result, to);
+          } else {
+            result = ZExtExpr::create(result, to);
           }
-
-          bindLocal(kcaller, state, result);
-        }
-      } else {
-        // We check that the return value has no users instead of
-        // checking the type, since C defaults to returning int for
-        // undeclared functions.
-        if (!caller->use_empty()) {
-          terminateStateOnExecError(state, "return void when caller expected a result");
         }
+
+        bindLocal(kcaller, state, result);
       }
-    }      
-    break;
-  }
+    } else {
+      // We check that the return value has no users instead of
+      // checking the type, since C defaults to returning int for
+      // undeclared functions.
+      if (!caller->use_empty()) {
+        terminateStateOnExecError(state, "return void when caller expected a result");
+      }
+    }
+  }      
+}
+
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 1)
-  case Instruction::Unwind: {
-    for (;;) {
-      KInstruction *kcaller = state.stack.back().caller;
-      state.popFrame();
+void Executor::executeUnwindInst(ExecutionState &state, KInstruction *ki) {
+  for (;;) {
+    KInstruction *kcaller = state.stack.back().caller;
+    state.popFrame();
 
-      if (statsTracker)
-        statsTracker->framePopped(state);
+    if (statsTracker)
+      statsTracker->framePopped(state);
 
-      if (state.stack.empty()) {
-        terminateStateOnExecError(state, "unwind from initial stack frame");
+    if (state.stack.empty()) {
+      terminateStateOnExecError(state, "unwind from initial stack frame");
+      break;
+    } else {
+      Instruction *caller = kcaller->inst;
+      if (InvokeInst *ii = dyn_cast<InvokeInst>(caller)) {
+        transferToBasicBlock(ii->getUnwindDest(), caller->getParent(), state);
         break;
-      } else {
-        Instruction *caller = kcaller->inst;
-        if (InvokeInst *ii = dyn_cast<InvokeInst>(caller)) {
-          transferToBasicBlock(ii->getUnwindDest(), caller->getParent(), state);
-          break;
-        }
       }
     }
-    break;
   }
+}
 #endif
-  case Instruction::Br: {
-    BranchInst *bi = cast<BranchInst>(i);
-    if (bi->isUnconditional()) {
-      transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), state);
-    } else {
-      // FIXME: Find a way that we don't have this hidden dependency.
-      assert(bi->getCondition() == bi->getOperand(0) &&
-             "Wrong operand index!");
-      ref<Expr> cond = eval(ki, 0, state).value;
-      Executor::StatePair branches = fork(state, cond, false);
-
-      // NOTE: There is a hidden dependency here, markBranchVisited
-      // requires that we still be in the context of the branch
-      // instruction (it reuses its statistic id). Should be cleaned
-      // up with convenient instruction specific data.
-      if (statsTracker && state.stack.back().kf->trackCoverage)
-        statsTracker->markBranchVisited(branches.first, branches.second);
-
-      if (branches.first)
-        transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), *branches.first);
-      if (branches.second)
-        transferToBasicBlock(bi->getSuccessor(1), bi->getParent(), *branches.second);
-      
-      if (findDynamicInvalid && startChecking) {
-        if (bi->getParent()->getParent()->getName().find("sequent") != std::string::npos) { 
-          //errs() << "Instruction::Br " << *(bi)  << "\n";
-          //errs() << "Function: " << (bi->getParent()->getParent()->getName()) << "\n";
-          //errs() << "Terminator: " << *(bi->getSuccessor(0)->getTerminator()) << "\n";
-          //errs() << "branches.first: " << branches.first << " branches.second: " << branches.second << "\n";
-          if ((bi->getSuccessor(0)->getTerminator()->getOperand(0) == bi->getOperand(1)) && 
-            (!(branches.first))) {
-            executeFlag = true;
-          }
+
+void Executor::executeBrInst(ExecutionState &state, KInstruction *ki) {
+  Instruction *i = ki->inst;
+  BranchInst *bi = cast<BranchInst>(i);
+  if (bi->isUnconditional()) {
+    transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), state);
+  } else {
+    // FIXME: Find a way that we don't have this hidden dependency.
+    assert(bi->getCondition() == bi->getOperand(0) &&
+           "Wrong operand index!");
+    ref<Expr> cond = eval(ki, 0, state).getValue();
+    Executor::StatePair branches = fork(state, cond, false);
+
+    // NOTE: There is a hidden dependency here, markBranchVisited
+    // requires that we still be in the context of the branch
+    // instruction (it reuses its statistic id). Should be cleaned
+    // up with convenient instruction specific data.
+    if (statsTracker && state.stack.back().kf->trackCoverage)
+      statsTracker->markBranchVisited(branches.first, branches.second);
+
+    if (branches.first)
+      transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), *branches.first);
+    if (branches.second)
+      transferToBasicBlock(bi->getSuccessor(1), bi->getParent(), *branches.second);
+    
+    if (findDynamicInvalid && startChecking) {
+      if (bi->getParent()->getParent()->getName().find("sequent") != std::string::npos) { 
+        //errs() << "Instruction::Br " << *(bi)  << "\n";
+        //errs() << "Function: " << (bi->getParent()->getParent()->getName()) << "\n";
+        //errs() << "Terminator: " << *(bi->getSuccessor(0)->getTerminator()) << "\n";
+        //errs() << "branches.first: " << branches.first << " branches.second: " << branches.second << "\n";
+        if ((bi->getSuccessor(0)->getTerminator()->getOperand(0) == bi->getOperand(1)) && 
+          (!(branches.first))) {
+          executeFlag = true;
         }
-      } 
-    }
-    break;
+      }
+    } 
   }
-  case Instruction::Switch: {
-    SwitchInst *si = cast<SwitchInst>(i);
-    ref<Expr> cond = eval(ki, 0, state).value;
-    BasicBlock *bb = si->getParent();
-
-    cond = toUnique(state, cond);
-    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(cond)) {
-      // Somewhat gross to create these all the time, but fine till we
-      // switch to an internal rep.
-      LLVM_TYPE_Q llvm::IntegerType *Ty = 
-        cast<IntegerType>(si->getCondition()->getType());
-      ConstantInt *ci = ConstantInt::get(Ty, CE->getZExtValue());
+}
+
+void Executor::executeSwitchInst(ExecutionState &state, KInstruction *ki) {
+  Instruction *i = ki->inst;
+  SwitchInst *si = cast<SwitchInst>(i);
+  ref<Expr> cond = eval(ki, 0, state).getValue();
+  BasicBlock *bb = si->getParent();
+
+  cond = toUnique(state, cond);
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(cond)) {
+    // Somewhat gross to create these all the time, but fine till we
+    // switch to an internal rep.
+    LLVM_TYPE_Q llvm::IntegerType *Ty = 
+      cast<IntegerType>(si->getCondition()->getType());
+    ConstantInt *ci = ConstantInt::get(Ty, CE->getZExtValue());
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 1)
-      unsigned index = si->findCaseValue(ci).getSuccessorIndex();
+    unsigned index = si->findCaseValue(ci).getSuccessorIndex();
 #else
-      unsigned index = si->findCaseValue(ci);
+    unsigned index = si->findCaseValue(ci);
 #endif
-      transferToBasicBlock(si->getSuccessor(index), si->getParent(), state);
-    } else {
-      // Handle possible different branch targets
+    transferToBasicBlock(si->getSuccessor(index), si->getParent(), state);
+  } else {
+    // Handle possible different branch targets
 
-      // We have the following assumptions:
-      // - each case value is mutual exclusive to all other values including the
-      //   default value
-      // - order of case branches is based on the order of the expressions of
-      //   the scase values, still default is handled last
-      std::vector<BasicBlock *> bbOrder;
-      std::map<BasicBlock *, ref<Expr> > branchTargets;
+    // We have the following assumptions:
+    // - each case value is mutual exclusive to all other values including the
+    //   default value
+    // - order of case branches is based on the order of the expressions of
+    //   the scase values, still default is handled last
+    std::vector<BasicBlock *> bbOrder;
+    std::map<BasicBlock *, ref<Expr> > branchTargets;
 
-      std::map<ref<Expr>, BasicBlock *> expressionOrder;
+    std::map<ref<Expr>, BasicBlock *> expressionOrder;
 
-      // Iterate through all non-default cases and order them by expressions
+    // Iterate through all non-default cases and order them by expressions
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 1)
-      for (SwitchInst::CaseIt i = si->case_begin(), e = si->case_end(); i != e;
-           ++i) {
-        ref<Expr> value = evalConstant(i.getCaseValue());
+    for (SwitchInst::CaseIt i = si->case_begin(), e = si->case_end(); i != e;
+         ++i) {
+      ref<Expr> value = evalConstant(i.getCaseValue());
 #else
-      for (unsigned i = 1, cases = si->getNumCases(); i < cases; ++i) {
-        ref<Expr> value = evalConstant(si->getCaseValue(i));
+    for (unsigned i = 1, cases = si->getNumCases(); i < cases; ++i) {
+      ref<Expr> value = evalConstant(si->getCaseValue(i));
 #endif
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 1)
-        BasicBlock *caseSuccessor = i.getCaseSuccessor();
+      BasicBlock *caseSuccessor = i.getCaseSuccessor();
 #else
-        BasicBlock *caseSuccessor = si->getSuccessor(i);
+      BasicBlock *caseSuccessor = si->getSuccessor(i);
 #endif
-        expressionOrder.insert(std::make_pair(value, caseSuccessor));
-      }
-
-      // Track default branch values
-      ref<Expr> defaultValue = ConstantExpr::alloc(1, Expr::Bool);
+      expressionOrder.insert(std::make_pair(value, caseSuccessor));
+    }
 
-      // iterate through all non-default cases but in order of the expressions
-      for (std::map<ref<Expr>, BasicBlock *>::iterator
-               it = expressionOrder.begin(),
-               itE = expressionOrder.end();
-           it != itE; ++it) {
-        ref<Expr> match = EqExpr::create(cond, it->first);
+    // Track default branch values
+    ref<Expr> defaultValue = ConstantExpr::alloc(1, Expr::Bool);
 
-        // Make sure that the default value does not contain this target's value
-        defaultValue = AndExpr::create(defaultValue, Expr::createIsZero(match));
+    // iterate through all non-default cases but in order of the expressions
+    for (std::map<ref<Expr>, BasicBlock *>::iterator
+             it = expressionOrder.begin(),
+             itE = expressionOrder.end();
+         it != itE; ++it) {
+      ref<Expr> match = EqExpr::create(cond, it->first);
 
-        // Check if control flow could take this case
-        bool result;
-        bool success = solver->mayBeTrue(state, match, result);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        if (result) {
-          BasicBlock *caseSuccessor = it->second;
-
-          // Handle the case that a basic block might be the target of multiple
-          // switch cases.
-          // Currently we generate an expression containing all switch-case
-          // values for the same target basic block. We spare us forking too
-          // many times but we generate more complex condition expressions
-          // TODO Add option to allow to choose between those behaviors
-          std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> res =
-              branchTargets.insert(std::make_pair(
-                  caseSuccessor, ConstantExpr::alloc(0, Expr::Bool)));
-
-          res.first->second = OrExpr::create(match, res.first->second);
-
-          // Only add basic blocks which have not been target of a branch yet
-          if (res.second) {
-            bbOrder.push_back(caseSuccessor);
-          }
-        }
-      }
+      // Make sure that the default value does not contain this target's value
+      defaultValue = AndExpr::create(defaultValue, Expr::createIsZero(match));
 
-      // Check if control could take the default case
-      bool res;
-      bool success = solver->mayBeTrue(state, defaultValue, res);
+      // Check if control flow could take this case
+      bool result;
+      bool success = solver->mayBeTrue(state, match, result);
       assert(success && "FIXME: Unhandled solver failure");
       (void) success;
-      if (res) {
-        std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> ret =
-            branchTargets.insert(
-                std::make_pair(si->getDefaultDest(), defaultValue));
-        if (ret.second) {
-          bbOrder.push_back(si->getDefaultDest());
+      if (result) {
+        BasicBlock *caseSuccessor = it->second;
+
+        // Handle the case that a basic block might be the target of multiple
+        // switch cases.
+        // Currently we generate an expression containing all switch-case
+        // values for the same target basic block. We spare us forking too
+        // many times but we generate more complex condition expressions
+        // TODO Add option to allow to choose between those behaviors
+        std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> res =
+            branchTargets.insert(std::make_pair(
+                caseSuccessor, ConstantExpr::alloc(0, Expr::Bool)));
+
+        res.first->second = OrExpr::create(match, res.first->second);
+
+        // Only add basic blocks which have not been target of a branch yet
+        if (res.second) {
+          bbOrder.push_back(caseSuccessor);
         }
       }
+    }
 
-      // Fork the current state with each state having one of the possible
-      // successors of this switch
-      std::vector< ref<Expr> > conditions;
-      for (std::vector<BasicBlock *>::iterator it = bbOrder.begin(),
-                                               ie = bbOrder.end();
-           it != ie; ++it) {
-        conditions.push_back(branchTargets[*it]);
+    // Check if control could take the default case
+    bool res;
+    bool success = solver->mayBeTrue(state, defaultValue, res);
+    assert(success && "FIXME: Unhandled solver failure");
+    (void) success;
+    if (res) {
+      std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> ret =
+          branchTargets.insert(
+              std::make_pair(si->getDefaultDest(), defaultValue));
+      if (ret.second) {
+        bbOrder.push_back(si->getDefaultDest());
       }
-      std::vector<ExecutionState*> branches;
-      branch(state, conditions, branches);
+    }
 
-      std::vector<ExecutionState*>::iterator bit = branches.begin();
-      for (std::vector<BasicBlock *>::iterator it = bbOrder.begin(),
-                                               ie = bbOrder.end();
-           it != ie; ++it) {
-        ExecutionState *es = *bit;
-        if (es)
-          transferToBasicBlock(*it, bb, *es);
-        ++bit;
-      }
+    // Fork the current state with each state having one of the possible
+    // successors of this switch
+    std::vector< ref<Expr> > conditions;
+    for (std::vector<BasicBlock *>::iterator it = bbOrder.begin(),
+                                             ie = bbOrder.end();
+         it != ie; ++it) {
+      conditions.push_back(branchTargets[*it]);
     }
-    break;
- }
-  case Instruction::Unreachable:
-    // Note that this is not necessarily an internal bug, llvm will
-    // generate unreachable instructions in cases where it knows the
-    // program will crash. So it is effectively a SEGV or internal
-    // error.
-    terminateStateOnExecError(state, "reached \"unreachable\" instruction");
-    break;
+    std::vector<ExecutionState*> branches;
+    branch(state, conditions, branches);
 
-  case Instruction::Invoke:
-  case Instruction::Call: {
-    CallSite cs(i);
+    std::vector<ExecutionState*>::iterator bit = branches.begin();
+    for (std::vector<BasicBlock *>::iterator it = bbOrder.begin(),
+                                             ie = bbOrder.end();
+         it != ie; ++it) {
+      ExecutionState *es = *bit;
+      if (es)
+        transferToBasicBlock(*it, bb, *es);
+      ++bit;
+    }
+  }
+}
 
-    unsigned numArgs = cs.arg_size();
-    Value *fp = cs.getCalledValue();
-    Function *f = getTargetFunction(fp, state);
+void Executor::executeUnreachableInst(ExecutionState &state, KInstruction *ki) {
+  // Note that this is not necessarily an internal bug, llvm will
+  // generate unreachable instructions in cases where it knows the
+  // program will crash. So it is effectively a SEGV or internal
+  // error.
+  terminateStateOnExecError(state, "reached \"unreachable\" instruction");
+}
 
-    // Skip debug intrinsics, we can't evaluate their metadata arguments.
-    if (f && isDebugIntrinsic(f, kmodule))
-      break;
+void Executor::executeCallInst(ExecutionState &state, KInstruction *ki) {
+  Instruction *i = ki->inst;
+  CallSite cs(i);
 
-    if (isa<InlineAsm>(fp)) {
-      terminateStateOnExecError(state, "inline assembly is unsupported");
-      break;
-    }
-    // evaluate arguments
-    std::vector< ref<Expr> > arguments;
-    arguments.reserve(numArgs);
-
-    for (unsigned j=0; j<numArgs; ++j)
-      arguments.push_back(eval(ki, j+1, state).value);
-
-    if (f) {
-      const FunctionType *fType = 
-        dyn_cast<FunctionType>(cast<PointerType>(f->getType())->getElementType());
-      const FunctionType *fpType =
-        dyn_cast<FunctionType>(cast<PointerType>(fp->getType())->getElementType());
-
-      // special case the call with a bitcast case
-      if (fType != fpType) {
-        assert(fType && fpType && "unable to get function type");
-
-        // XXX check result coercion
-
-        // XXX this really needs thought and validation
-        unsigned i=0;
-        for (std::vector< ref<Expr> >::iterator
-               ai = arguments.begin(), ie = arguments.end();
-             ai != ie; ++ai) {
-          Expr::Width to, from = (*ai)->getWidth();
-            
-          if (i<fType->getNumParams()) {
-            to = getWidthForLLVMType(fType->getParamType(i));
-
-            if (from != to) {
-              // XXX need to check other param attrs ?
+  unsigned numArgs = cs.arg_size();
+  Value *fp = cs.getCalledValue();
+  Function *f = getTargetFunction(fp, state);
+
+  // Skip debug intrinsics, we can't evaluate their metadata arguments.
+  if (f && isDebugIntrinsic(f, kmodule))
+    return;
+
+  if (isa<InlineAsm>(fp)) {
+    terminateStateOnExecError(state, "inline assembly is unsupported");
+    return;
+  }
+  // evaluate arguments
+  std::vector< ref<Expr> > arguments;
+  arguments.reserve(numArgs);
+
+  for (unsigned j=0; j<numArgs; ++j)
+    arguments.push_back(eval(ki, j+1, state).getValue());
+
+  if (f) {
+    const FunctionType *fType = 
+      dyn_cast<FunctionType>(cast<PointerType>(f->getType())->getElementType());
+    const FunctionType *fpType =
+      dyn_cast<FunctionType>(cast<PointerType>(fp->getType())->getElementType());
+
+    // special case the call with a bitcast case
+    if (fType != fpType) {
+      assert(fType && fpType && "unable to get function type");
+
+      // XXX check result coercion
+
+      // XXX this really needs thought and validation
+      unsigned i=0;
+      for (std::vector< ref<Expr> >::iterator
+             ai = arguments.begin(), ie = arguments.end();
+           ai != ie; ++ai) {
+        Expr::Width to, from = (*ai)->getWidth();
+          
+        if (i<fType->getNumParams()) {
+          to = getWidthForLLVMType(fType->getParamType(i));
+
+          if (from != to) {
+            // XXX need to check other param attrs ?
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-              bool isSExt = cs.paramHasAttr(i+1, llvm::Attribute::SExt);
+            bool isSExt = cs.paramHasAttr(i+1, llvm::Attribute::SExt);
 #elif LLVM_VERSION_CODE >= LLVM_VERSION(3, 2)
 	      bool isSExt = cs.paramHasAttr(i+1, llvm::Attributes::SExt);
 #else
 	      bool isSExt = cs.paramHasAttr(i+1, llvm::Attribute::SExt);
 #endif
-              if (isSExt) {
-                arguments[i] = SExtExpr::create(arguments[i], to);
-              } else {
-                arguments[i] = ZExtExpr::create(arguments[i], to);
-              }
+            if (isSExt) {
+              arguments[i] = SExtExpr::create(arguments[i], to);
+            } else {
+              arguments[i] = ZExtExpr::create(arguments[i], to);
             }
           }
-            
-          i++;
         }
+          
+        i++;
       }
+    }
 
-      executeCall(state, ki, f, arguments);
-    } else {
-      ref<Expr> v = eval(ki, 0, state).value;
+    executeCall(state, ki, f, arguments);
+  } else {
+    ref<Expr> v = eval(ki, 0, state).getValue();
 
-      ExecutionState *free = &state;
-      bool hasInvalid = false, first = true;
+    ExecutionState *free = &state;
+    bool hasInvalid = false, first = true;
 
-      /* XXX This is wasteful, no need to do a full evaluate since we
-         have already got a value. But in the end the caches should
-         handle it for us, albeit with some overhead. */
-      do {
-        ref<ConstantExpr> value;
-        bool success = solver->getValue(*free, v, value);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        StatePair res = fork(*free, EqExpr::create(v, value), true);
-        if (res.first) {
-          uint64_t addr = value->getZExtValue();
-          if (legalFunctions.count(addr)) {
-            f = (Function*) addr;
-
-            // Don't give warning on unique resolution
-            if (res.second || !first)
-              klee_warning_once((void*) (unsigned long) addr, 
-                                "resolved symbolic function pointer to: %s",
-                                f->getName().data());
-
-            executeCall(*res.first, ki, f, arguments);
-          } else {
-            if (!hasInvalid) {
-              terminateStateOnExecError(state, "invalid function pointer");
-              hasInvalid = true;
-            }
+    /* XXX This is wasteful, no need to do a full evaluate since we
+       have already got a value. But in the end the caches should
+       handle it for us, albeit with some overhead. */
+    do {
+      ref<ConstantExpr> value;
+      bool success = solver->getValue(*free, v, value);
+      assert(success && "FIXME: Unhandled solver failure");
+      (void) success;
+      StatePair res = fork(*free, EqExpr::create(v, value), true);
+      if (res.first) {
+        uint64_t addr = value->getZExtValue();
+        if (legalFunctions.count(addr)) {
+          f = (Function*) addr;
+
+          // Don't give warning on unique resolution
+          if (res.second || !first)
+            klee_warning_once((void*) (unsigned long) addr, 
+                              "resolved symbolic function pointer to: %s",
+                              f->getName().data());
+
+          executeCall(*res.first, ki, f, arguments);
+        } else {
+          if (!hasInvalid) {
+            terminateStateOnExecError(state, "invalid function pointer");
+            hasInvalid = true;
           }
         }
+      }
 
-        first = false;
-        free = res.second;
-      } while (free);
-    }
-    break;
+      first = false;
+      free = res.second;
+    } while (free);
   }
-  case Instruction::PHI: {
+}
+
+void Executor::executePHIInst(ExecutionState &state, KInstruction *ki) {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 0)
-    ref<Expr> result = eval(ki, state.incomingBBIndex, state).value;
+  const Cell &value = eval(ki, state.incomingBBIndex, state);
 #else
-    ref<Expr> result = eval(ki, state.incomingBBIndex * 2, state).value;
+  const Cell &value = eval(ki, state.incomingBBIndex * 2, state);
 #endif
-    bindLocal(ki, state, result);
-    break;
+  if (value.isImmediate()) {
+    getDestCell(state, ki).setImmediate(value.getImmediate(),
+                                        value.getWidth());
+    return;
   }
+  bindLocal(ki, state, value.getValue());
+}
 
-    // Special instructions
-  case Instruction::Select: {
-    ref<Expr> cond = eval(ki, 0, state).value;
-    ref<Expr> tExpr = eval(ki, 1, state).value;
-    ref<Expr> fExpr = eval(ki, 2, state).value;
-    ref<Expr> result = SelectExpr::create(cond, tExpr, fExpr);
-    bindLocal(ki, state, result);
-    break;
+void Executor::executeSelectInst(ExecutionState &state, KInstruction *ki) {
+  const Cell &c = eval(ki, 0, state);
+  if (c.isImmediate()) {
+    // The chosen operand is copied as is, symbolic or not.
+    getDestCell(state, ki) = eval(ki, c.getImmediate() ? 1 : 2, state);
+    return;
   }
 
-  case Instruction::VAArg:
-    terminateStateOnExecError(state, "unexpected VAArg instruction");
-    break;
+  ref<Expr> cond = c.getValue();
+  ref<Expr> tExpr = eval(ki, 1, state).getValue();
+  ref<Expr> fExpr = eval(ki, 2, state).getValue();
+  ref<Expr> result = SelectExpr::create(cond, tExpr, fExpr);
+  bindLocal(ki, state, result);
+}
 
-    // Arithmetic / logical
+void Executor::executeVAArgInst(ExecutionState &state, KInstruction *ki) {
+  terminateStateOnExecError(state, "unexpected VAArg instruction");
+}
 
-  case Instruction::Add: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, AddExpr::create(left, right));
-    break;
+void Executor::executeAddInst(ExecutionState &state, KInstruction *ki) {
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w)) {
+    getDestCell(state, ki).setImmediate(ints::add(l, r, w), w);
+    return;
   }
 
-  case Instruction::Sub: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, SubExpr::create(left, right));
-    break;
-  }
- 
-  case Instruction::Mul: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, MulExpr::create(left, right));
-    break;
-  }
+  ref<Expr> left = eval(ki, 0, state).getValue();
+  ref<Expr> right = eval(ki, 1, state).getValue();
+  bindLocal(ki, state, AddExpr::create(left, right));
+}
 
-  case Instruction::UDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = UDivExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
+void Executor::executeSubInst(ExecutionState &state, KInstruction *ki) {
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w)) {
+    getDestCell(state, ki).setImmediate(ints::sub(l, r, w), w);
+    return;
   }
 
-  case Instruction::SDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = SDivExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
+  ref<Expr> left = eval(ki, 0, state).getValue();
+  ref<Expr> right = eval(ki, 1, state).getValue();
+  bindLocal(ki, state, SubExpr::create(left, right));
+}
 
-  case Instruction::URem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = URemExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
- 
-  case Instruction::SRem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = SRemExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
+void Executor::executeMulInst(ExecutionState &state, KInstruction *ki) {
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w)) {
+    getDestCell(state, ki).setImmediate(ints::mul(l, r, w), w);
+    return;
   }
 
-  case Instruction::And: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = AndExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
-  }
+  ref<Expr> left = eval(ki, 0, state).getValue();
+  ref<Expr> right = eval(ki, 1, state).getValue();
+  bindLocal(ki, state, MulExpr::create(left, right));
+}
 
-  case Instruction::Or: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = OrExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
+void Executor::executeUDivInst(ExecutionState &state, KInstruction *ki) {
+  // Division by zero is left to the general path.
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w) && r) {
+    getDestCell(state, ki).setImmediate(ints::udiv(l, r, w), w);
+    return;
   }
 
-  case Instruction::Xor: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = XorExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
+  ref<Expr> left = eval(ki, 0, state).getValue();
+  ref<Expr> right = eval(ki, 1, state).getValue();
+  ref<Expr> result = UDivExpr::create(left, right);
+  bindLocal(ki, state, result);
+}
+
+void Executor::executeSDivInst(ExecutionState &state, KInstruction *ki) {
+  // Division by zero and the overflowing division are left to the
+  // general path.
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w) && r &&
+      !(w == 64 && l == (1ULL << 63) && r == ~0ULL)) {
+    getDestCell(state, ki).setImmediate(ints::sdiv(l, r, w), w);
+    return;
   }
 
-  case Instruction::Shl: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = ShlExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
+  ref<Expr> left = eval(ki, 0, state).getValue();
+  ref<Expr> right = eval(ki, 1, state).getValue();
+  ref<Expr> result = SDivExpr::create(left, right);
+  bindLocal(ki, state, result);
+}
+
+void Executor::executeURemInst(ExecutionState &state, KInstruction *ki) {
+  // Division by zero is left to the general path.
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w) && r) {
+    getDestCell(state, ki).setImmediate(ints::urem(l, r, w), w);
+    return;
   }
 
-  case Instruction::LShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = LShrExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
+  ref<Expr> left = eval(ki, 0, state).getValue();
+  ref<Expr> right = eval(ki, 1, state).getValue();
+  ref<Expr> result = URemExpr::create(left, right);
+  bindLocal(ki, state, result);
+}
+
+void Executor::executeSRemInst(ExecutionState &state, KInstruction *ki) {
+  // Division by zero and the overflowing division are left to the
+  // general path.
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w) && r &&
+      !(w == 64 && l == (1ULL << 63) && r == ~0ULL)) {
+    getDestCell(state, ki).setImmediate(ints::srem(l, r, w), w);
+    return;
   }
 
-  case Instruction::AShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = AShrExpr::create(left, right);
-    bindLocal(ki, state, result);
-    break;
+  ref<Expr> left = eval(ki, 0, state).getValue();
+  ref<Expr> right = eval(ki, 1, state).getValue();
+  ref<Expr> result = SRemExpr::create(left, right);
+  bindLocal(ki, state, result);
+}
+
+void Executor::executeAndInst(ExecutionState &state, KInstruction *ki) {
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w)) {
+    getDestCell(state, ki).setImmediate(ints::land(l, r, w), w);
+    return;
   }
 
-    // Compare
+  ref<Expr> left = eval(ki, 0, state).getValue();
+  ref<Expr> right = eval(ki, 1, state).getValue();
+  ref<Expr> result = AndExpr::create(left, right);
+  bindLocal(ki, state, result);
+}
 
-  case Instruction::ICmp: {
-    CmpInst *ci = cast<CmpInst>(i);
-    ICmpInst *ii = cast<ICmpInst>(ci);
- 
-    switch(ii->getPredicate()) {
-    case ICmpInst::ICMP_EQ: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = EqExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+void Executor::executeOrInst(ExecutionState &state, KInstruction *ki) {
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w)) {
+    getDestCell(state, ki).setImmediate(ints::lor(l, r, w), w);
+    return;
+  }
 
-    case ICmpInst::ICMP_NE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = NeExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+  ref<Expr> left = eval(ki, 0, state).getValue();
+  ref<Expr> right = eval(ki, 1, state).getValue();
+  ref<Expr> result = OrExpr::create(left, right);
+  bindLocal(ki, state, result);
+}
 
-    case ICmpInst::ICMP_UGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UgtExpr::create(left, right);
-      bindLocal(ki, state,result);
-      break;
-    }
+void Executor::executeXorInst(ExecutionState &state, KInstruction *ki) {
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w)) {
+    getDestCell(state, ki).setImmediate(ints::lxor(l, r, w), w);
+    return;
+  }
 
-    case ICmpInst::ICMP_UGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UgeExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+  ref<Expr> left = eval(ki, 0, state).getValue();
+  ref<Expr> right = eval(ki, 1, state).getValue();
+  ref<Expr> result = XorExpr::create(left, right);
+  bindLocal(ki, state, result);
+}
 
-    case ICmpInst::ICMP_ULT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UltExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+void Executor::executeShlInst(ExecutionState &state, KInstruction *ki) {
+  // Shifts by the width or more are left to the general path.
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w) && r < w) {
+    getDestCell(state, ki).setImmediate(ints::shl(l, r, w), w);
+    return;
+  }
 
-    case ICmpInst::ICMP_ULE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UleExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+  ref<Expr> left = eval(ki, 0, state).getValue();
+  ref<Expr> right = eval(ki, 1, state).getValue();
+  ref<Expr> result = ShlExpr::create(left, right);
+  bindLocal(ki, state, result);
+}
 
-    case ICmpInst::ICMP_SGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SgtExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+void Executor::executeLShrInst(ExecutionState &state, KInstruction *ki) {
+  // Shifts by the width or more are left to the general path.
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w) && r < w) {
+    getDestCell(state, ki).setImmediate(ints::lshr(l, r, w), w);
+    return;
+  }
 
-    case ICmpInst::ICMP_SGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SgeExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+  ref<Expr> left = eval(ki, 0, state).getValue();
+  ref<Expr> right = eval(ki, 1, state).getValue();
+  ref<Expr> result = LShrExpr::create(left, right);
+  bindLocal(ki, state, result);
+}
 
-    case ICmpInst::ICMP_SLT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SltExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+void Executor::executeAShrInst(ExecutionState &state, KInstruction *ki) {
+  // Shifts by the width or more are left to the general path.
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w) && r < w) {
+    getDestCell(state, ki).setImmediate(ints::ashr(l, r, w), w);
+    return;
+  }
 
-    case ICmpInst::ICMP_SLE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SleExpr::create(left, right);
-      bindLocal(ki, state, result);
-      break;
-    }
+  ref<Expr> left = eval(ki, 0, state).getValue();
+  ref<Expr> right = eval(ki, 1, state).getValue();
+  ref<Expr> result = AShrExpr::create(left, right);
+  bindLocal(ki, state, result);
+}
 
+void Executor::executeICmpInst(ExecutionState &state, KInstruction *ki) {
+  uint64_t l, r;
+  Expr::Width w;
+  if (evalImmediateOperands(state, ki, l, r, w)) {
+    uint64_t result;
+    switch (ki->predicate) {
+    case ICmpInst::ICMP_EQ: result = ints::eq(l, r, w); break;
+    case ICmpInst::ICMP_NE: result = ints::ne(l, r, w); break;
+    case ICmpInst::ICMP_UGT: result = ints::ugt(l, r, w); break;
+    case ICmpInst::ICMP_UGE: result = ints::uge(l, r, w); break;
+    case ICmpInst::ICMP_ULT: result = ints::ult(l, r, w); break;
+    case ICmpInst::ICMP_ULE: result = ints::ule(l, r, w); break;
+    case ICmpInst::ICMP_SGT: result = ints::sgt(l, r, w); break;
+    case ICmpInst::ICMP_SGE: result = ints::sge(l, r, w); break;
+    case ICmpInst::ICMP_SLT: result = ints::slt(l, r, w); break;
+    case ICmpInst::ICMP_SLE: result = ints::sle(l, r, w); break;
     default:
       terminateStateOnExecError(state, "invalid ICmp predicate");
+      return;
     }
-    break;
+    getDestCell(state, ki).setImmediate(result, Expr::Bool);
+    return;
   }
- 
-    // Memory instructions...
-  case Instruction::Alloca: {
-    AllocaInst *ai = cast<AllocaInst>(i);
-    unsigned elementSize = 
-      kmodule->targetData->getTypeStoreSize(ai->getAllocatedType());
-    ref<Expr> size = Expr::createPointer(elementSize);
-    if (ai->isArrayAllocation()) {
-      ref<Expr> count = eval(ki, 0, state).value;
-      count = Expr::createZExtToPointerWidth(count);
-      size = MulExpr::create(size, count);
-    }
-    executeAlloc(state, size, true, ki);
+
+  switch(ki->predicate) {
+  case ICmpInst::ICMP_EQ: {
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = EqExpr::create(left, right);
+    bindLocal(ki, state, result);
     break;
   }
 
-  case Instruction::Load: {
-    ref<Expr> base = eval(ki, 0, state).value;
-    executeMemoryOperation(state, false, base, 0, ki);
+  case ICmpInst::ICMP_NE: {
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = NeExpr::create(left, right);
+    bindLocal(ki, state, result);
     break;
   }
-  case Instruction::Store: {
-    ref<Expr> base = eval(ki, 1, state).value;
-    ref<Expr> value = eval(ki, 0, state).value;
-    executeMemoryOperation(state, true, base, value, 0);
-    if (multiCycles) {
-      if (ki->inst->getOperand(1)->getName() == "tmp") {
-        if (haltExecution == false) {
-//          errs() << "Instruction: " << *(ki->inst) << "\n";
-//          errs() << "Value: " << value << "\n";
-//          errs() << ki->operands[0] << "\n";
-          retrieveConstraints(ki, value);
-        }
-      }
-    }
-    if (printMode) {
-      if (ki->inst->getOperand(1)->getName() == "tmp") {
-        if (haltExecution == false) {
-          errs() << "Instruction: " << *(ki->inst) << "\n";
-          errs() << "Value: " << value << "\n";
-        }
-      }
-    }
+
+  case ICmpInst::ICMP_UGT: {
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = UgtExpr::create(left, right);
+    bindLocal(ki, state,result);
     break;
   }
 
-  case Instruction::GetElementPtr: {
-    KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
-    ref<Expr> base = eval(ki, 0, state).value;
-
-    for (std::vector< std::pair<unsigned, uint64_t> >::iterator 
-           it = kgepi->indices.begin(), ie = kgepi->indices.end(); 
-         it != ie; ++it) {
-      uint64_t elementSize = it->second;
-      ref<Expr> index = eval(ki, it->first, state).value;
-      base = AddExpr::create(base,
-                             MulExpr::create(Expr::createSExtToPointerWidth(index),
-                                             Expr::createPointer(elementSize)));
-    }
-    if (kgepi->offset)
-      base = AddExpr::create(base,
-                             Expr::createPointer(kgepi->offset));
-    bindLocal(ki, state, base);
+  case ICmpInst::ICMP_UGE: {
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = UgeExpr::create(left, right);
+    bindLocal(ki, state, result);
     break;
   }
 
-    // Conversion
-  case Instruction::Trunc: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value,
-                                           0,
-                                           getWidthForLLVMType(ci->getType()));
+  case ICmpInst::ICMP_ULT: {
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = UltExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
-  case Instruction::ZExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+
+  case ICmpInst::ICMP_ULE: {
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = UleExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
-  case Instruction::SExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = SExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+
+  case ICmpInst::ICMP_SGT: {
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = SgtExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
-  case Instruction::IntToPtr: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width pType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
-    bindLocal(ki, state, ZExtExpr::create(arg, pType));
+  case ICmpInst::ICMP_SGE: {
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = SgeExpr::create(left, right);
+    bindLocal(ki, state, result);
     break;
-  } 
-  case Instruction::PtrToInt: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width iType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
-    bindLocal(ki, state, ZExtExpr::create(arg, iType));
+  }
+
+  case ICmpInst::ICMP_SLT: {
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = SltExpr::create(left, right);
+    bindLocal(ki, state, result);
     break;
   }
 
-  case Instruction::BitCast: {
-    ref<Expr> result = eval(ki, 0, state).value;
+  case ICmpInst::ICMP_SLE: {
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = SleExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
-    // Floating point instructions
+  default:
+    terminateStateOnExecError(state, "invalid ICmp predicate");
+  }
+}
+
+void Executor::executeAllocaInst(ExecutionState &state, KInstruction *ki) {
+  Instruction *i = ki->inst;
+  AllocaInst *ai = cast<AllocaInst>(i);
+  unsigned elementSize = 
+    kmodule->targetData->getTypeStoreSize(ai->getAllocatedType());
+  ref<Expr> size = Expr::createPointer(elementSize);
+  if (ai->isArrayAllocation()) {
+    ref<Expr> count = eval(ki, 0, state).getValue();
+    count = Expr::createZExtToPointerWidth(count);
+    size = MulExpr::create(size, count);
+  }
+  executeAlloc(state, size, true, ki);
+}
+
+void Executor::executeLoadInst(ExecutionState &state, KInstruction *ki) {
+  ref<Expr> base = eval(ki, 0, state).getValue();
+  executeMemoryOperation(state, false, base, 0, ki);
+}
+
+void Executor::executeStoreInst(ExecutionState &state, KInstruction *ki) {
+  ref<Expr> base = eval(ki, 1, state).getValue();
+  ref<Expr> value = eval(ki, 0, state).getValue();
+  executeMemoryOperation(state, true, base, value, 0);
+  if (multiCycles) {
+    if (ki->inst->getOperand(1)->getName() == "tmp") {
+      if (haltExecution == false) {
+//          errs() << "Instruction: " << *(ki->inst) << "\n";
+//          errs() << "Value: " << value << "\n";
+//          errs() << ki->operands[0] << "\n";
+        retrieveConstraints(ki, value);
+      }
+    }
+  }
+  if (printMode) {
+    if (ki->inst->getOperand(1)->getName() == "tmp") {
+      if (haltExecution == false) {
+        errs() << "Instruction: " << *(ki->inst) << "\n";
+        errs() << "Value: " << value << "\n";
+      }
+    }
+  }
+}
+
+void Executor::executeGetElementPtrInst(ExecutionState &state,
+                                        KInstruction *ki) {
+  KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
+  ref<Expr> base = eval(ki, 0, state).getValue();
+
+  for (std::vector< std::pair<unsigned, uint64_t> >::iterator 
+         it = kgepi->indices.begin(), ie = kgepi->indices.end(); 
+       it != ie; ++it) {
+    uint64_t elementSize = it->second;
+    ref<Expr> index = eval(ki, it->first, state).getValue();
+    base = AddExpr::create(base,
+                           MulExpr::create(Expr::createSExtToPointerWidth(index),
+                                           Expr::createPointer(elementSize)));
+  }
+  if (kgepi->offset)
+    base = AddExpr::create(base,
+                           Expr::createPointer(kgepi->offset));
+  bindLocal(ki, state, base);
+}
+
+void Executor::executeTruncInst(ExecutionState &state, KInstruction *ki) {
+  uint64_t value;
+  Expr::Width w;
+  if (evalImmediateOperand(state, ki, value, w)) {
+    getDestCell(state, ki).setImmediate(ints::trunc(value, ki->width, w),
+                                        ki->width);
+    return;
+  }
+
+  ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).getValue(),
+                                         0,
+                                         ki->width);
+  bindLocal(ki, state, result);
+}
+
+void Executor::executeZExtInst(ExecutionState &state, KInstruction *ki) {
+  uint64_t value;
+  Expr::Width w;
+  if (evalImmediateOperand(state, ki, value, w)) {
+    getDestCell(state, ki).setImmediate(ints::trunc(value, ki->width, w),
+                                        ki->width);
+    return;
+  }
+
+  ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).getValue(),
+                                      ki->width);
+  bindLocal(ki, state, result);
+}
+
+void Executor::executeSExtInst(ExecutionState &state, KInstruction *ki) {
+  uint64_t value;
+  Expr::Width w;
+  if (evalImmediateOperand(state, ki, value, w)) {
+    getDestCell(state, ki).setImmediate(ints::sext(value, ki->width, w),
+                                        ki->width);
+    return;
+  }
+
+  ref<Expr> result = SExtExpr::create(eval(ki, 0, state).getValue(),
+                                      ki->width);
+  bindLocal(ki, state, result);
+}
+
+void Executor::executeIntToPtrInst(ExecutionState &state, KInstruction *ki) {
+  uint64_t value;
+  Expr::Width w;
+  if (evalImmediateOperand(state, ki, value, w)) {
+    getDestCell(state, ki).setImmediate(ints::trunc(value, ki->width, w),
+                                        ki->width);
+    return;
+  }
+
+  Expr::Width pType = ki->width;
+  ref<Expr> arg = eval(ki, 0, state).getValue();
+  bindLocal(ki, state, ZExtExpr::create(arg, pType));
+}
+
+void Executor::executePtrToIntInst(ExecutionState &state, KInstruction *ki) {
+  uint64_t value;
+  Expr::Width w;
+  if (evalImmediateOperand(state, ki, value, w)) {
+    getDestCell(state, ki).setImmediate(ints::trunc(value, ki->width, w),
+                                        ki->width);
+    return;
+  }
+
+  Expr::Width iType = ki->width;
+  ref<Expr> arg = eval(ki, 0, state).getValue();
+  bindLocal(ki, state, ZExtExpr::create(arg, iType));
+}
+
+void Executor::executeBitCastInst(ExecutionState &state, KInstruction *ki) {
+  uint64_t value;
+  Expr::Width w;
+  if (evalImmediateOperand(state, ki, value, w)) {
+    getDestCell(state, ki).setImmediate(ints::trunc(value, ki->width, w),
+                                        ki->width);
+    return;
+  }
+
+  ref<Expr> result = eval(ki, 0, state).getValue();
+  bindLocal(ki, state, result);
+}
 
-  case Instruction::FAdd: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
-    if (!fpWidthToSemantics(left->getWidth()) ||
-        !fpWidthToSemantics(right->getWidth()))
-      return terminateStateOnExecError(state, "Unsupported FAdd operation");
+void Executor::executeFAddInst(ExecutionState &state, KInstruction *ki) {
+  ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
+                                      "floating point");
+  ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
+                                       "floating point");
+  if (!fpWidthToSemantics(left->getWidth()) ||
+      !fpWidthToSemantics(right->getWidth()))
+    return terminateStateOnExecError(state, "Unsupported FAdd operation");
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.add(APFloat(*fpWidthToSemantics(right->getWidth()),right->getAPValue()), APFloat::rmNearestTiesToEven);
+  llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
+  Res.add(APFloat(*fpWidthToSemantics(right->getWidth()),right->getAPValue()), APFloat::rmNearestTiesToEven);
 #else
-    llvm::APFloat Res(left->getAPValue());
-    Res.add(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
+  llvm::APFloat Res(left->getAPValue());
+  Res.add(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
 #endif
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
-    break;
-  }
+  bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+}
 
-  case Instruction::FSub: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
-    if (!fpWidthToSemantics(left->getWidth()) ||
-        !fpWidthToSemantics(right->getWidth()))
-      return terminateStateOnExecError(state, "Unsupported FSub operation");
+void Executor::executeFSubInst(ExecutionState &state, KInstruction *ki) {
+  ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
+                                      "floating point");
+  ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
+                                       "floating point");
+  if (!fpWidthToSemantics(left->getWidth()) ||
+      !fpWidthToSemantics(right->getWidth()))
+    return terminateStateOnExecError(state, "Unsupported FSub operation");
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.subtract(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
+  llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
+  Res.subtract(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
 #else
-    llvm::APFloat Res(left->getAPValue());
-    Res.subtract(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
+  llvm::APFloat Res(left->getAPValue());
+  Res.subtract(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
 #endif
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
-    break;
-  }
- 
-  case Instruction::FMul: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
-    if (!fpWidthToSemantics(left->getWidth()) ||
-        !fpWidthToSemantics(right->getWidth()))
-      return terminateStateOnExecError(state, "Unsupported FMul operation");
+  bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+}
+
+void Executor::executeFMulInst(ExecutionState &state, KInstruction *ki) {
+  ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
+                                      "floating point");
+  ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
+                                       "floating point");
+  if (!fpWidthToSemantics(left->getWidth()) ||
+      !fpWidthToSemantics(right->getWidth()))
+    return terminateStateOnExecError(state, "Unsupported FMul operation");
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.multiply(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
+  llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
+  Res.multiply(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
 #else
-    llvm::APFloat Res(left->getAPValue());
-    Res.multiply(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
+  llvm::APFloat Res(left->getAPValue());
+  Res.multiply(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
 #endif
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
-    break;
-  }
+  bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+}
 
-  case Instruction::FDiv: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
-    if (!fpWidthToSemantics(left->getWidth()) ||
-        !fpWidthToSemantics(right->getWidth()))
-      return terminateStateOnExecError(state, "Unsupported FDiv operation");
+void Executor::executeFDivInst(ExecutionState &state, KInstruction *ki) {
+  ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
+                                      "floating point");
+  ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
+                                       "floating point");
+  if (!fpWidthToSemantics(left->getWidth()) ||
+      !fpWidthToSemantics(right->getWidth()))
+    return terminateStateOnExecError(state, "Unsupported FDiv operation");
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.divide(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
+  llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
+  Res.divide(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
 #else
-    llvm::APFloat Res(left->getAPValue());
-    Res.divide(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
+  llvm::APFloat Res(left->getAPValue());
+  Res.divide(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
 #endif
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
-    break;
-  }
+  bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+}
 
-  case Instruction::FRem: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
-    if (!fpWidthToSemantics(left->getWidth()) ||
-        !fpWidthToSemantics(right->getWidth()))
-      return terminateStateOnExecError(state, "Unsupported FRem operation");
+void Executor::executeFRemInst(ExecutionState &state, KInstruction *ki) {
+  ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
+                                      "floating point");
+  ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
+                                       "floating point");
+  if (!fpWidthToSemantics(left->getWidth()) ||
+      !fpWidthToSemantics(right->getWidth()))
+    return terminateStateOnExecError(state, "Unsupported FRem operation");
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.mod(APFloat(*fpWidthToSemantics(right->getWidth()),right->getAPValue()),
-            APFloat::rmNearestTiesToEven);
+  llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
+  Res.mod(APFloat(*fpWidthToSemantics(right->getWidth()),right->getAPValue()),
+          APFloat::rmNearestTiesToEven);
 #else
-    llvm::APFloat Res(left->getAPValue());
-    Res.mod(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
+  llvm::APFloat Res(left->getAPValue());
+  Res.mod(APFloat(right->getAPValue()), APFloat::rmNearestTiesToEven);
 #endif
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
-    break;
-  }
+  bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+}
 
-  case Instruction::FPTrunc: {
-    FPTruncInst *fi = cast<FPTruncInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
-      return terminateStateOnExecError(state, "Unsupported FPTrunc operation");
+void Executor::executeFPTruncInst(ExecutionState &state, KInstruction *ki) {
+  Expr::Width resultType = ki->width;
+  ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
+                                     "floating point");
+  if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
+    return terminateStateOnExecError(state, "Unsupported FPTrunc operation");
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
+  llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
 #else
-    llvm::APFloat Res(arg->getAPValue());
+  llvm::APFloat Res(arg->getAPValue());
 #endif
-    bool losesInfo = false;
-    Res.convert(*fpWidthToSemantics(resultType),
-                llvm::APFloat::rmNearestTiesToEven,
-                &losesInfo);
-    bindLocal(ki, state, ConstantExpr::alloc(Res));
-    break;
-  }
+  bool losesInfo = false;
+  Res.convert(*fpWidthToSemantics(resultType),
+              llvm::APFloat::rmNearestTiesToEven,
+              &losesInfo);
+  bindLocal(ki, state, ConstantExpr::alloc(Res));
+}
 
-  case Instruction::FPExt: {
-    FPExtInst *fi = cast<FPExtInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
-      return terminateStateOnExecError(state, "Unsupported FPExt operation");
+void Executor::executeFPExtInst(ExecutionState &state, KInstruction *ki) {
+  Expr::Width resultType = ki->width;
+  ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
+                                      "floating point");
+  if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
+    return terminateStateOnExecError(state, "Unsupported FPExt operation");
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
+  llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
 #else
-    llvm::APFloat Res(arg->getAPValue());
+  llvm::APFloat Res(arg->getAPValue());
 #endif
-    bool losesInfo = false;
-    Res.convert(*fpWidthToSemantics(resultType),
-                llvm::APFloat::rmNearestTiesToEven,
-                &losesInfo);
-    bindLocal(ki, state, ConstantExpr::alloc(Res));
-    break;
-  }
+  bool losesInfo = false;
+  Res.convert(*fpWidthToSemantics(resultType),
+              llvm::APFloat::rmNearestTiesToEven,
+              &losesInfo);
+  bindLocal(ki, state, ConstantExpr::alloc(Res));
+}
 
-  case Instruction::FPToUI: {
-    FPToUIInst *fi = cast<FPToUIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
-      return terminateStateOnExecError(state, "Unsupported FPToUI operation");
+void Executor::executeFPToUIInst(ExecutionState &state, KInstruction *ki) {
+  Expr::Width resultType = ki->width;
+  ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
+                                     "floating point");
+  if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
+    return terminateStateOnExecError(state, "Unsupported FPToUI operation");
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
+  llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
 #else
-    llvm::APFloat Arg(arg->getAPValue());
+  llvm::APFloat Arg(arg->getAPValue());
 #endif
-    uint64_t value = 0;
-    bool isExact = true;
-    Arg.convertToInteger(&value, resultType, false,
-                         llvm::APFloat::rmTowardZero, &isExact);
-    bindLocal(ki, state, ConstantExpr::alloc(value, resultType));
-    break;
-  }
+  uint64_t value = 0;
+  bool isExact = true;
+  Arg.convertToInteger(&value, resultType, false,
+                       llvm::APFloat::rmTowardZero, &isExact);
+  bindLocal(ki, state, ConstantExpr::alloc(value, resultType));
+}
 
-  case Instruction::FPToSI: {
-    FPToSIInst *fi = cast<FPToSIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
-      return terminateStateOnExecError(state, "Unsupported FPToSI operation");
+void Executor::executeFPToSIInst(ExecutionState &state, KInstruction *ki) {
+  Expr::Width resultType = ki->width;
+  ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
+                                     "floating point");
+  if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
+    return terminateStateOnExecError(state, "Unsupported FPToSI operation");
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
+  llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
 #else
-    llvm::APFloat Arg(arg->getAPValue());
+  llvm::APFloat Arg(arg->getAPValue());
 
 #endif
-    uint64_t value = 0;
-    bool isExact = true;
-    Arg.convertToInteger(&value, resultType, true,
-                         llvm::APFloat::rmTowardZero, &isExact);
-    bindLocal(ki, state, ConstantExpr::alloc(value, resultType));
-    break;
-  }
+  uint64_t value = 0;
+  bool isExact = true;
+  Arg.convertToInteger(&value, resultType, true,
+                       llvm::APFloat::rmTowardZero, &isExact);
+  bindLocal(ki, state, ConstantExpr::alloc(value, resultType));
+}
 
-  case Instruction::UIToFP: {
-    UIToFPInst *fi = cast<UIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
-    if (!semantics)
-      return terminateStateOnExecError(state, "Unsupported UIToFP operation");
-    llvm::APFloat f(*semantics, 0);
-    f.convertFromAPInt(arg->getAPValue(), false,
-                       llvm::APFloat::rmNearestTiesToEven);
-
-    bindLocal(ki, state, ConstantExpr::alloc(f));
-    break;
-  }
+void Executor::executeUIToFPInst(ExecutionState &state, KInstruction *ki) {
+  Expr::Width resultType = ki->width;
+  ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
+                                     "floating point");
+  const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
+  if (!semantics)
+    return terminateStateOnExecError(state, "Unsupported UIToFP operation");
+  llvm::APFloat f(*semantics, 0);
+  f.convertFromAPInt(arg->getAPValue(), false,
+                     llvm::APFloat::rmNearestTiesToEven);
+
+  bindLocal(ki, state, ConstantExpr::alloc(f));
+}
 
-  case Instruction::SIToFP: {
-    SIToFPInst *fi = cast<SIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
-    if (!semantics)
-      return terminateStateOnExecError(state, "Unsupported SIToFP operation");
-    llvm::APFloat f(*semantics, 0);
-    f.convertFromAPInt(arg->getAPValue(), true,
-                       llvm::APFloat::rmNearestTiesToEven);
-
-    bindLocal(ki, state, ConstantExpr::alloc(f));
-    break;
-  }
+void Executor::executeSIToFPInst(ExecutionState &state, KInstruction *ki) {
+  Expr::Width resultType = ki->width;
+  ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
+                                     "floating point");
+  const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
+  if (!semantics)
+    return terminateStateOnExecError(state, "Unsupported SIToFP operation");
+  llvm::APFloat f(*semantics, 0);
+  f.convertFromAPInt(arg->getAPValue(), true,
+                     llvm::APFloat::rmNearestTiesToEven);
+
+  bindLocal(ki, state, ConstantExpr::alloc(f));
+}
 
-  case Instruction::FCmp: {
-    FCmpInst *fi = cast<FCmpInst>(i);
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
-    if (!fpWidthToSemantics(left->getWidth()) ||
-        !fpWidthToSemantics(right->getWidth()))
-      return terminateStateOnExecError(state, "Unsupported FCmp operation");
+void Executor::executeFCmpInst(ExecutionState &state, KInstruction *ki) {
+  ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
+                                      "floating point");
+  ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
+                                       "floating point");
+  if (!fpWidthToSemantics(left->getWidth()) ||
+      !fpWidthToSemantics(right->getWidth()))
+    return terminateStateOnExecError(state, "Unsupported FCmp operation");
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-    APFloat LHS(*fpWidthToSemantics(left->getWidth()),left->getAPValue());
-    APFloat RHS(*fpWidthToSemantics(right->getWidth()),right->getAPValue());
+  APFloat LHS(*fpWidthToSemantics(left->getWidth()),left->getAPValue());
+  APFloat RHS(*fpWidthToSemantics(right->getWidth()),right->getAPValue());
 #else
-    APFloat LHS(left->getAPValue());
-    APFloat RHS(right->getAPValue());
+  APFloat LHS(left->getAPValue());
+  APFloat RHS(right->getAPValue());
 #endif
-    APFloat::cmpResult CmpRes = LHS.compare(RHS);
-
-    bool Result = false;
-    switch( fi->getPredicate() ) {
-      // Predicates which only care about whether or not the operands are NaNs.
-    case FCmpInst::FCMP_ORD:
-      Result = CmpRes != APFloat::cmpUnordered;
-      break;
-
-    case FCmpInst::FCMP_UNO:
-      Result = CmpRes == APFloat::cmpUnordered;
-      break;
+  APFloat::cmpResult CmpRes = LHS.compare(RHS);
 
-      // Ordered comparisons return false if either operand is NaN.  Unordered
-      // comparisons return true if either operand is NaN.
-    case FCmpInst::FCMP_UEQ:
-      if (CmpRes == APFloat::cmpUnordered) {
-        Result = true;
-        break;
-      }
-    case FCmpInst::FCMP_OEQ:
-      Result = CmpRes == APFloat::cmpEqual;
-      break;
+  bool Result = false;
+  switch( ki->predicate ) {
+    // Predicates which only care about whether or not the operands are NaNs.
+  case FCmpInst::FCMP_ORD:
+    Result = CmpRes != APFloat::cmpUnordered;
+    break;
 
-    case FCmpInst::FCMP_UGT:
-      if (CmpRes == APFloat::cmpUnordered) {
-        Result = true;
-        break;
-      }
-    case FCmpInst::FCMP_OGT:
-      Result = CmpRes == APFloat::cmpGreaterThan;
-      break;
+  case FCmpInst::FCMP_UNO:
+    Result = CmpRes == APFloat::cmpUnordered;
+    break;
 
-    case FCmpInst::FCMP_UGE:
-      if (CmpRes == APFloat::cmpUnordered) {
-        Result = true;
-        break;
-      }
-    case FCmpInst::FCMP_OGE:
-      Result = CmpRes == APFloat::cmpGreaterThan || CmpRes == APFloat::cmpEqual;
+    // Ordered comparisons return false if either operand is NaN.  Unordered
+    // comparisons return true if either operand is NaN.
+  case FCmpInst::FCMP_UEQ:
+    if (CmpRes == APFloat::cmpUnordered) {
+      Result = true;
       break;
+    }
+  case FCmpInst::FCMP_OEQ:
+    Result = CmpRes == APFloat::cmpEqual;
+    break;
 
-    case FCmpInst::FCMP_ULT:
-      if (CmpRes == APFloat::cmpUnordered) {
-        Result = true;
-        break;
-      }
-    case FCmpInst::FCMP_OLT:
-      Result = CmpRes == APFloat::cmpLessThan;
+  case FCmpInst::FCMP_UGT:
+    if (CmpRes == APFloat::cmpUnordered) {
+      Result = true;
       break;
+    }
+  case FCmpInst::FCMP_OGT:
+    Result = CmpRes == APFloat::cmpGreaterThan;
+    break;
 
-    case FCmpInst::FCMP_ULE:
-      if (CmpRes == APFloat::cmpUnordered) {
-        Result = true;
-        break;
-      }
-    case FCmpInst::FCMP_OLE:
-      Result = CmpRes == APFloat::cmpLessThan || CmpRes == APFloat::cmpEqual;
+  case FCmpInst::FCMP_UGE:
+    if (CmpRes == APFloat::cmpUnordered) {
+      Result = true;
       break;
+    }
+  case FCmpInst::FCMP_OGE:
+    Result = CmpRes == APFloat::cmpGreaterThan || CmpRes == APFloat::cmpEqual;
+    break;
 
-    case FCmpInst::FCMP_UNE:
-      Result = CmpRes == APFloat::cmpUnordered || CmpRes != APFloat::cmpEqual;
-      break;
-    case FCmpInst::FCMP_ONE:
-      Result = CmpRes != APFloat::cmpUnordered && CmpRes != APFloat::cmpEqual;
+  case FCmpInst::FCMP_ULT:
+    if (CmpRes == APFloat::cmpUnordered) {
+      Result = true;
       break;
+    }
+  case FCmpInst::FCMP_OLT:
+    Result = CmpRes == APFloat::cmpLessThan;
+    break;
 
-    default:
-      assert(0 && "Invalid FCMP predicate!");
-    case FCmpInst::FCMP_FALSE:
-      Result = false;
-      break;
-    case FCmpInst::FCMP_TRUE:
+  case FCmpInst::FCMP_ULE:
+    if (CmpRes == APFloat::cmpUnordered) {
       Result = true;
       break;
     }
+  case FCmpInst::FCMP_OLE:
+    Result = CmpRes == APFloat::cmpLessThan || CmpRes == APFloat::cmpEqual;
+    break;
+
+  case FCmpInst::FCMP_UNE:
+    Result = CmpRes == APFloat::cmpUnordered || CmpRes != APFloat::cmpEqual;
+    break;
+  case FCmpInst::FCMP_ONE:
+    Result = CmpRes != APFloat::cmpUnordered && CmpRes != APFloat::cmpEqual;
+    break;
 
-    bindLocal(ki, state, ConstantExpr::alloc(Result, Expr::Bool));
+  default:
+    assert(0 && "Invalid FCMP predicate!");
+  case FCmpInst::FCMP_FALSE:
+    Result = false;
+    break;
+  case FCmpInst::FCMP_TRUE:
+    Result = true;
     break;
   }
-  case Instruction::InsertValue: {
-    KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-    ref<Expr> agg = eval(ki, 0, state).value;
-    ref<Expr> val = eval(ki, 1, state).value;
+  bindLocal(ki, state, ConstantExpr::alloc(Result, Expr::Bool));
+}
 
-    ref<Expr> l = NULL, r = NULL;
-    unsigned lOffset = kgepi->offset*8, rOffset = kgepi->offset*8 + val->getWidth();
+void Executor::executeInsertValueInst(ExecutionState &state, KInstruction *ki) {
+  KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-    if (lOffset > 0)
-      l = ExtractExpr::create(agg, 0, lOffset);
-    if (rOffset < agg->getWidth())
-      r = ExtractExpr::create(agg, rOffset, agg->getWidth() - rOffset);
+  ref<Expr> agg = eval(ki, 0, state).getValue();
+  ref<Expr> val = eval(ki, 1, state).getValue();
 
-    ref<Expr> result;
-    if (!l.isNull() && !r.isNull())
-      result = ConcatExpr::create(r, ConcatExpr::create(val, l));
-    else if (!l.isNull())
-      result = ConcatExpr::create(val, l);
-    else if (!r.isNull())
-      result = ConcatExpr::create(r, val);
-    else
-      result = val;
+  ref<Expr> l = NULL, r = NULL;
+  unsigned lOffset = kgepi->offset*8, rOffset = kgepi->offset*8 + val->getWidth();
 
-    bindLocal(ki, state, result);
-    break;
-  }
-  case Instruction::ExtractValue: {
-    KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
+  if (lOffset > 0)
+    l = ExtractExpr::create(agg, 0, lOffset);
+  if (rOffset < agg->getWidth())
+    r = ExtractExpr::create(agg, rOffset, agg->getWidth() - rOffset);
+
+  ref<Expr> result;
+  if (!l.isNull() && !r.isNull())
+    result = ConcatExpr::create(r, ConcatExpr::create(val, l));
+  else if (!l.isNull())
+    result = ConcatExpr::create(val, l);
+  else if (!r.isNull())
+    result = ConcatExpr::create(r, val);
+  else
+    result = val;
 
-    ref<Expr> agg = eval(ki, 0, state).value;
+  bindLocal(ki, state, result);
+}
 
-    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, getWidthForLLVMType(i->getType()));
+void Executor::executeExtractValueInst(ExecutionState &state,
+                                       KInstruction *ki) {
+  KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
+
+  ref<Expr> agg = eval(ki, 0, state).getValue();
+
+  ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, ki->width);
+
+  bindLocal(ki, state, result);
+}
 
-    bindLocal(ki, state, result);
-    break;
-  }
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
-  case Instruction::Fence: {
-    // Ignore for now
-    break;
-  }
+void Executor::executeFenceInst(ExecutionState &state, KInstruction *ki) {
+  // Ignore for now
+}
 #endif
 
-  // Other instructions...
-  // Unhandled
+void Executor::executeVectorInst(ExecutionState &state, KInstruction *ki) {
+  terminateStateOnError(state, "XXX vector instructions unhandled",
+                        Unhandled);
+}
+
+void Executor::executeIllegalInst(ExecutionState &state, KInstruction *ki) {
+  terminateStateOnExecError(state, "illegal instruction");
+}
+
+InstructionHandler Executor::getInstructionHandler(unsigned opcode) {
+  switch (opcode) {
+  case Instruction::Ret:
+    return &Executor::executeRetInst;
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 1)
+  case Instruction::Unwind:
+    return &Executor::executeUnwindInst;
+#endif
+  case Instruction::Br:
+    return &Executor::executeBrInst;
+  case Instruction::Switch:
+    return &Executor::executeSwitchInst;
+  case Instruction::Unreachable:
+    return &Executor::executeUnreachableInst;
+  case Instruction::Invoke:
+  case Instruction::Call:
+    return &Executor::executeCallInst;
+  case Instruction::PHI:
+    return &Executor::executePHIInst;
+  case Instruction::Select:
+    return &Executor::executeSelectInst;
+  case Instruction::VAArg:
+    return &Executor::executeVAArgInst;
+  case Instruction::Add:
+    return &Executor::executeAddInst;
+  case Instruction::Sub:
+    return &Executor::executeSubInst;
+  case Instruction::Mul:
+    return &Executor::executeMulInst;
+  case Instruction::UDiv:
+    return &Executor::executeUDivInst;
+  case Instruction::SDiv:
+    return &Executor::executeSDivInst;
+  case Instruction::URem:
+    return &Executor::executeURemInst;
+  case Instruction::SRem:
+    return &Executor::executeSRemInst;
+  case Instruction::And:
+    return &Executor::executeAndInst;
+  case Instruction::Or:
+    return &Executor::executeOrInst;
+  case Instruction::Xor:
+    return &Executor::executeXorInst;
+  case Instruction::Shl:
+    return &Executor::executeShlInst;
+  case Instruction::LShr:
+    return &Executor::executeLShrInst;
+  case Instruction::AShr:
+    return &Executor::executeAShrInst;
+  case Instruction::ICmp:
+    return &Executor::executeICmpInst;
+  case Instruction::Alloca:
+    return &Executor::executeAllocaInst;
+  case Instruction::Load:
+    return &Executor::executeLoadInst;
+  case Instruction::Store:
+    return &Executor::executeStoreInst;
+  case Instruction::GetElementPtr:
+    return &Executor::executeGetElementPtrInst;
+  case Instruction::Trunc:
+    return &Executor::executeTruncInst;
+  case Instruction::ZExt:
+    return &Executor::executeZExtInst;
+  case Instruction::SExt:
+    return &Executor::executeSExtInst;
+  case Instruction::IntToPtr:
+    return &Executor::executeIntToPtrInst;
+  case Instruction::PtrToInt:
+    return &Executor::executePtrToIntInst;
+  case Instruction::BitCast:
+    return &Executor::executeBitCastInst;
+  case Instruction::FAdd:
+    return &Executor::executeFAddInst;
+  case Instruction::FSub:
+    return &Executor::executeFSubInst;
+  case Instruction::FMul:
+    return &Executor::executeFMulInst;
+  case Instruction::FDiv:
+    return &Executor::executeFDivInst;
+  case Instruction::FRem:
+    return &Executor::executeFRemInst;
+  case Instruction::FPTrunc:
+    return &Executor::executeFPTruncInst;
+  case Instruction::FPExt:
+    return &Executor::executeFPExtInst;
+  case Instruction::FPToUI:
+    return &Executor::executeFPToUIInst;
+  case Instruction::FPToSI:
+    return &Executor::executeFPToSIInst;
+  case Instruction::UIToFP:
+    return &Executor::executeUIToFPInst;
+  case Instruction::SIToFP:
+    return &Executor::executeSIToFPInst;
+  case Instruction::FCmp:
+    return &Executor::executeFCmpInst;
+  case Instruction::InsertValue:
+    return &Executor::executeInsertValueInst;
+  case Instruction::ExtractValue:
+    return &Executor::executeExtractValueInst;
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+  case Instruction::Fence:
+    return &Executor::executeFenceInst;
+#endif
   case Instruction::ExtractElement:
   case Instruction::InsertElement:
   case Instruction::ShuffleVector:
-    terminateStateOnError(state, "XXX vector instructions unhandled",
-                          Unhandled);
-    break;
- 
+    return &Executor::executeVectorInst;
   default:
-    terminateStateOnExecError(state, "illegal instruction");
-    break;
+    return &Executor::executeIllegalInst;
   }
 }
 
+
 void Executor::updateStates(ExecutionState *current) {
   if (searcher) {
     searcher->update(current, addedStates, removedStates);
@@ -2719,6 +3118,8 @@ void Executor::updateStates(ExecutionState *current) {
       seedMap.find(es);
     if (it3 != seedMap.end())
       seedMap.erase(it3);
+    if (stateSwapper)
+      stateSwapper->discard(*es);
     processTree->remove(es->ptreeNode);
     delete es;
   }
@@ -2761,6 +3162,13 @@ void Executor::computeOffsets(KGEPInstruction *kgepi, TypeIt ib, TypeIt ie) {
 void Executor::bindInstructionConstants(KInstruction *KI) {
   KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(KI);
 
+  KI->opcode = KI->inst->getOpcode();
+  KI->handler = getInstructionHandler(KI->opcode);
+  if (CmpInst *ci = dyn_cast<CmpInst>(KI->inst))
+    KI->predicate = ci->getPredicate();
+  LLVM_TYPE_Q Type *type = KI->inst->getType();
+  KI->width = type->isSized() ? getWidthForLLVMType(type) : 0;
+
   if (GetElementPtrInst *gepi = dyn_cast<GetElementPtrInst>(KI->inst)) {
     computeOffsets(kgepi, gep_type_begin(gepi), gep_type_end(gepi));
   } else if (InsertValueInst *ivi = dyn_cast<InsertValueInst>(KI->inst)) {
@@ -2783,11 +3191,41 @@ void Executor::bindModuleConstants() {
   kmodule->constantTable = new Cell[kmodule->constants.size()];
   for (unsigned i=0; i<kmodule->constants.size(); ++i) {
     Cell &c = kmodule->constantTable[i];
-    c.value = evalConstant(kmodule->constants[i]);
+    c.setValue(evalConstant(kmodule->constants[i]));
+  }
+}
+
+void Executor::swapInState(ExecutionState &state) {
+  if (stateSwapper && stateSwapper->isSwappedOut(state))
+    stateSwapper->swapIn(state);
+}
+
+unsigned Executor::swapOutStates(ExecutionState *current, unsigned count) {
+  std::vector<std::pair<unsigned, ExecutionState*> > candidates;
+  for (std::set<ExecutionState*>::iterator it = states.begin(),
+         ie = states.end(); it != ie; ++it) {
+    ExecutionState *es = *it;
+    if (es == current || stateSwapper->isSwappedOut(*es) ||
+        std::find(removedStates.begin(), removedStates.end(), es) !=
+          removedStates.end())
+      continue;
+    candidates.push_back(std::make_pair(es->instsSinceCovNew, es));
+  }
+  count = std::min(count, (unsigned) candidates.size());
+  std::partial_sort(candidates.begin(), candidates.begin() + count,
+                    candidates.end(),
+                    std::greater<std::pair<unsigned, ExecutionState*> >());
+
+  unsigned swapped = 0;
+  for (unsigned i = 0; i != count; ++i) {
+    if (!stateSwapper->swapOut(*candidates[i].second))
+      break;
+    ++swapped;
   }
+  return swapped;
 }
 
-void Executor::checkMemoryUsage() {
+void Executor::checkMemoryUsage(ExecutionState *current) {
   if (!MaxMemory)
     return;
   if ((stats::instructions & 0xFFFF) == 0) {
@@ -2797,13 +3235,33 @@ void Executor::checkMemoryUsage() {
     unsigned mbs = (util::GetTotalMallocUsage() >> 20) +
                    (memory->getUsedDeterministicSize() >> 20);
 
+    if (mbs > MaxMemory && stateSwapper) {
+      // Swap out enough resident states to get some way below the cap,
+      // assuming that they all take the same memory, then measure again.
+      unsigned target = MaxMemory - MaxMemory / 10;
+      unsigned numResident = states.size() - stateSwapper->getNumSwappedOut();
+      unsigned toSwap =
+        std::max(1U, numResident - numResident * target / mbs);
+      unsigned swapped = swapOutStates(current, toSwap);
+      if (swapped) {
+        klee_message("swapped out %d states (over memory cap)", swapped);
+        mbs = (util::GetTotalMallocUsage() >> 20) +
+              (memory->getUsedDeterministicSize() >> 20);
+      }
+    }
+
     if (mbs > MaxMemory) {
       if (mbs > MaxMemory + 100) {
         // just guess at how many to kill
         unsigned numStates = states.size();
         unsigned toKill = std::max(1U, numStates - numStates * MaxMemory / mbs);
         klee_warning("killing %d states (over memory cap)", toKill);
-        std::vector<ExecutionState *> arr(states.begin(), states.end());
+        // Swapped out states would have to be swapped in to terminate them.
+        std::vector<ExecutionState *> arr;
+        for (std::set<ExecutionState*>::iterator it = states.begin(),
+               ie = states.end(); it != ie; ++it)
+          if (!stateSwapper || !stateSwapper->isSwappedOut(**it))
+            arr.push_back(*it);
         for (unsigned i = 0, N = arr.size(); N && i < toKill; ++i, --N) {
           unsigned idx = rand() % N;
           // Make two pulls to try and not hit a state that
@@ -2826,12 +3284,18 @@ void Executor::doDumpStates() {
   if (!DumpStatesOnHalt || states.empty())
     return;
   klee_message("halting execution, dumping remaining states");
-  for (std::set<ExecutionState *>::iterator it = states.begin(),
-                                            ie = states.end();
+  std::vector<ExecutionState *> remaining(states.begin(), states.end());
+  for (std::vector<ExecutionState *>::iterator it = remaining.begin(),
+                                               ie = remaining.end();
       it != ie; ++it) {
     ExecutionState &state = **it;
+    bool swappedOut = stateSwapper && stateSwapper->isSwappedOut(state);
+    swapInState(state);
     stepInstruction(state); // keep stats rolling
     terminateStateEarly(state, "Execution halting.");
+    // Free swapped in states right away, so they do not pile up in memory.
+    if (swappedOut)
+      updateStates(0);
   }
   updateStates(0);
 }
@@ -2894,6 +3358,7 @@ void Executor::run(ExecutionState &initialState) {
       lastState = it->first;
       unsigned numSeeds = it->second.size();
       ExecutionState &state = *lastState;
+      swapInState(state);
       KInstruction *ki = state.pc;
       stepInstruction(state);
 
@@ -2947,6 +3412,7 @@ void Executor::run(ExecutionState &initialState) {
 
   while (!states.empty() && !haltExecution) {
     ExecutionState &state = searcher->selectState();
+    swapInState(state);
     KInstruction *ki = state.pc;
 
 //    if (haltExecution == true) {
@@ -3011,7 +3477,7 @@ void Executor::run(ExecutionState &initialState) {
     stepInstruction(state);
     executeInstruction(state, ki);
     processTimers(&state, MaxInstructionTime);
-    checkMemoryUsage();
+    checkMemoryUsage(&state);
     updateStates(&state);
   }
 
@@ -3279,6 +3745,7 @@ void Executor::callExternalFunction(ExecutionState &state,
     }
   }
 
+  bindLazyGlobals(state);
   state.addressSpace.copyOutConcretes();
 
   if (!SuppressExternalWarnings) {
@@ -3320,6 +3787,85 @@ void Executor::callExternalFunction(ExecutionState &state,
   }
 }
 
+bool Executor::callNatively(ExecutionState &state, KInstruction *ki,
+                            Function *f,
+                            std::vector< ref<Expr> > &arguments) {
+  // the dispatcher passes the arguments of the call site, which must then
+  // be those of f
+  CallInst *ci = dyn_cast<CallInst>(ki->inst);
+  if (!ci || ci->getCalledFunction() != f || arguments.size() != f->arg_size())
+    return false;
+  for (unsigned i = 0, e = arguments.size(); i != e; ++i)
+    if (!isa<ConstantExpr>(arguments[i]))
+      return false;
+
+  void *code = functionJIT->getPointerToFunction(f);
+  if (!code)
+    return false;
+
+  // the callee only accesses the globals it refers to and the objects its
+  // pointer arguments point into, so only those must be concrete
+  std::vector<const MemoryObject*> objects(functionJIT->getReferencedObjects(f));
+  Function::arg_iterator ai = f->arg_begin();
+  for (unsigned i = 0, e = arguments.size(); i != e; ++i, ++ai) {
+    if (!ai->getType()->isPointerTy())
+      continue;
+    ref<ConstantExpr> address = cast<ConstantExpr>(arguments[i]);
+    if (address->isZero())
+      continue;
+    bindLazyGlobal(state, address->getZExtValue());
+    ObjectPair op;
+    if (!state.addressSpace.resolveOne(address, op))
+      return false;
+    objects.push_back(op.first);
+  }
+  std::sort(objects.begin(), objects.end());
+  objects.erase(std::unique(objects.begin(), objects.end()), objects.end());
+
+  for (std::vector<const MemoryObject*>::iterator it = objects.begin(),
+         ie = objects.end(); it != ie; ++it) {
+    const MemoryObject *mo = *it;
+    if (mo->isUserSpecified)
+      return false;
+    bindLazyGlobal(state, mo->address);
+    const ObjectState *os = state.addressSpace.findObject(mo);
+    if (!os || !os->isConcrete())
+      return false;
+  }
+
+  // see callExternalFunction()
+  uint64_t *args = (uint64_t*) alloca(2*sizeof(*args) * (arguments.size() + 1));
+  memset(args, 0, 2 * sizeof(*args) * (arguments.size() + 1));
+  unsigned wordIndex = 2;
+  for (unsigned i = 0, e = arguments.size(); i != e; ++i) {
+    ConstantExpr *ce = cast<ConstantExpr>(arguments[i]);
+    ce->toMemory(&args[wordIndex]);
+    wordIndex += (ce->getWidth()+63)/64;
+  }
+
+  state.addressSpace.copyOutConcretes(objects);
+
+  // On a trap, such as a failed check or an invalid access, the objects
+  // are left unchanged and the call is interpreted to report the error.
+  if (!externalDispatcher->executeNativeCall(f, ki->inst, args, code))
+    return false;
+
+  ++stats::nativeCalls;
+  if (!state.addressSpace.copyInConcretes(objects)) {
+    terminateStateOnError(state, "native call modified read-only object",
+                          External);
+    return true;
+  }
+
+  LLVM_TYPE_Q Type *resultType = ki->inst->getType();
+  if (resultType != Type::getVoidTy(getGlobalContext())) {
+    ref<Expr> e = ConstantExpr::fromMemory((void*) args,
+                                           getWidthForLLVMType(resultType));
+    bindLocal(ki, state, e);
+  }
+  return true;
+}
+
 /***/
 
 ref<Expr> Executor::replaceReadWithSymbolic(ExecutionState &state, 
@@ -3508,6 +4054,11 @@ void Executor::resolveExact(ExecutionState &state,
                             ref<Expr> p,
                             ExactResolutionList &results, 
                             const std::string &name) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(p))
+    bindLazyGlobal(state, CE->getZExtValue());
+  else
+    bindLazyGlobals(state);
+
   // XXX we may want to be capping this?
   ResolutionList rl;
   state.addressSpace.resolve(state, solver, p, rl);
@@ -3538,8 +4089,7 @@ void Executor::executeMemoryOperation(ExecutionState &state,
                                       ref<Expr> address,
                                       ref<Expr> value /* undef if read */,
                                       KInstruction *target /* undef if write */) {
-  Expr::Width type = (isWrite ? value->getWidth() : 
-                     getWidthForLLVMType(target->inst->getType()));
+  Expr::Width type = (isWrite ? value->getWidth() : target->width);
   unsigned bytes = Expr::getMinBytesForWidth(type);
 
   if (SimplifySymIndices) {
@@ -3549,62 +4099,104 @@ void Executor::executeMemoryOperation(ExecutionState &state,
       value = state.constraints.simplifyExpr(value);
   }
 
-  // fast path: single in-bounds resolution
+  // fastest path: a constant address inside the object this instruction
+  // accessed last, while the bindings of the address space are unchanged
+  KInstruction *ki = state.prevPC;
+  ResolutionCache &cache = ki->resolution;
+  ConstantExpr *constantAddress = dyn_cast<ConstantExpr>(address);
   ObjectPair op;
-  bool success;
-  solver->setTimeout(coreSolverTimeout);
-  if (!state.addressSpace.resolveOne(state, solver, address, op, success)) {
-    address = toConstant(state, address, "resolveOne failure");
-    success = state.addressSpace.resolveOne(cast<ConstantExpr>(address), op);
+  ref<Expr> offset;
+  bool inBounds = false;
+  if (constantAddress && cache.epoch == state.addressSpace.getEpoch()) {
+    uint64_t cachedOffset = constantAddress->getZExtValue() - cache.base;
+    if (cachedOffset < cache.size && bytes <= cache.size - cachedOffset) {
+      op = ObjectPair(cache.mo, cache.os);
+      offset = ConstantExpr::alloc(cachedOffset, address->getWidth());
+      inBounds = true;
+      ++stats::resolutionCacheHits;
+    }
   }
-  solver->setTimeout(0);
 
-  if (success) {
-    const MemoryObject *mo = op.first;
-
-    if (MaxSymArraySize && mo->size>=MaxSymArraySize) {
-      address = toConstant(state, address, "max-sym-array-size");
-    }
-    
-    ref<Expr> offset = mo->getOffsetExpr(address);
+  // fast path: single in-bounds resolution
+  if (!inBounds) {
+    // Bind the lazy global at a constant address before resolving it.
+    if (constantAddress && !lazyGlobals.empty())
+      bindLazyGlobal(state, constantAddress->getZExtValue());
 
-    bool inBounds;
+    bool success;
+    ref<ConstantExpr> example;
     solver->setTimeout(coreSolverTimeout);
-    bool success = solver->mustBeTrue(state, 
-                                      mo->getBoundsCheckOffset(offset, bytes),
-                                      inBounds);
+    if (!state.addressSpace.resolveOne(state, solver, address, op, success,
+                                       &example)) {
+      address = toConstant(state, address, "resolveOne failure");
+      if (!lazyGlobals.empty())
+        bindLazyGlobal(state, cast<ConstantExpr>(address)->getZExtValue());
+      success = state.addressSpace.resolveOne(cast<ConstantExpr>(address), op);
+    } else if (!constantAddress && !lazyGlobals.empty() &&
+               !example.isNull() &&
+               bindLazyGlobal(state, example->getZExtValue())) {
+      // The example the search started from is in a lazy global the state
+      // had not accessed yet, which is where the address is resolved to.
+      success = state.addressSpace.resolveOne(example, op);
+    }
     solver->setTimeout(0);
-    if (!success) {
-      state.pc = state.prevPC;
-      terminateStateEarly(state, "Query timed out (bounds check).");
-      return;
+
+    if (success) {
+      const MemoryObject *mo = op.first;
+
+      if (MaxSymArraySize && mo->size>=MaxSymArraySize) {
+        address = toConstant(state, address, "max-sym-array-size");
+      }
+      
+      offset = mo->getOffsetExpr(address);
+
+      solver->setTimeout(coreSolverTimeout);
+      bool success =
+        solver->mustBeTrue(state, mo->getBoundsCheckOffset(offset, bytes),
+                           inBounds);
+      solver->setTimeout(0);
+      if (!success) {
+        state.pc = state.prevPC;
+        terminateStateEarly(state, "Query timed out (bounds check).");
+        return;
+      }
     }
+  }
 
-    if (inBounds) {
-      const ObjectState *os = op.second;
-      if (isWrite) {
-        if (os->readOnly) {
-          terminateStateOnError(state, "memory error: object read only",
-                                ReadOnly);
-        } else {
-          ObjectState *wos = state.addressSpace.getWriteable(mo, os);
-          wos->write(offset, value);
-        }          
-      } else {
-        ref<Expr> result = os->read(offset, type);
-        
-        if (interpreterOpts.MakeConcreteSymbolic)
-          result = replaceReadWithSymbolic(state, result);
-        
-        bindLocal(target, state, result);
+  if (inBounds) {
+    const MemoryObject *mo = op.first;
+    const ObjectState *os = op.second;
+    if (isWrite) {
+      if (os->readOnly) {
+        terminateStateOnError(state, "memory error: object read only",
+                              ReadOnly);
+        return;
       }
+      ObjectState *wos = state.addressSpace.getWriteable(mo, os);
+      wos->write(offset, value);
+      os = wos;
+    } else {
+      ref<Expr> result = os->read(offset, type);
+      
+      if (interpreterOpts.MakeConcreteSymbolic)
+        result = replaceReadWithSymbolic(state, result);
+      
+      bindLocal(target, state, result);
+    }
 
-      return;
+    if (isa<ConstantExpr>(address)) {
+      cache.epoch = state.addressSpace.getEpoch();
+      cache.base = mo->address;
+      cache.size = mo->size;
+      cache.mo = mo;
+      cache.os = os;
     }
-  } 
+    return;
+  }
 
   // we are on an error path (no resolution, multiple resolution, one
   // resolution with out of bounds)
+  bindLazyGlobals(state);
   
   ResolutionList rl;  
   solver->setTimeout(coreSolverTimeout);
@@ -3664,9 +4256,10 @@ void Executor::executeMakeSymbolic(ExecutionState &state,
     // or if that fails try adding a unique identifier.
     unsigned id = 0;
     std::string uniqueName = name;
-    while (!state.arrayNames.insert(uniqueName).second) {
+    while (state.arrayNames.count(uniqueName)) {
       uniqueName = name + "_" + llvm::utostr(++id);
     }
+    state.arrayNames = state.arrayNames.insert(uniqueName);
     const Array *array = arrayCache.CreateArray(uniqueName, mo->size);
     bindObjectInState(state, mo, false, array);
     state.addSymbolic(mo, array);
@@ -3819,12 +4412,24 @@ void Executor::runFunctionAsMain(Function *f,
   initializeGlobals(*state);
   enablePrune();
 
+  if (NativeCalls)
+    functionJIT = new FunctionJIT(externalDispatcher->getExecutionEngine(),
+                                  kmodule->module, globalObjects);
+
   processTree = new PTree(state);
   state->ptreeNode = processTree->root;
   run(*state);
   delete processTree;
   processTree = 0;
 
+  // the compiled code refers to the memory objects of the globals
+  delete functionJIT;
+  functionJIT = 0;
+
+  // the initial states of lazy globals refer to their memory objects
+  lazyGlobals.clear();
+  lazyGlobalStates.clear();
+
   // hack to clear memory objects
   delete memory;
   memory = new MemoryManager(NULL);
@@ -3899,7 +4504,7 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
   // an example) While this process can be very expensive, it can
   // also make understanding individual test cases much easier.
   for (unsigned i = 0; i != state.symbolics.size(); ++i) {
-    const MemoryObject *mo = state.symbolics[i].first;
+    const MemoryObject *mo = state.symbolics[i].first.get();
     std::vector< ref<Expr> >::const_iterator pi = 
       mo->cexPreferences.begin(), pie = mo->cexPreferences.end();
     for (; pi != pie; ++pi) {
@@ -3974,7 +4579,15 @@ bool Executor::checkSame(int value, int ind) {
 
 void Executor::getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) {
-  res = state.coveredLines;
+  res.clear();
+  for (ExecutionState::covered_lines_ty::iterator
+         it = state.coveredLines.begin(), ie = state.coveredLines.end();
+       it != ie; ++it) {
+    std::set<unsigned> &lines = res[it->first];
+    for (ImmutableSet<unsigned>::iterator lit = it->second.begin(),
+           lie = it->second.end(); lit != lie; ++lit)
+      lines.insert(*lit);
+  }
 }
 
 void Executor::doImpliedValueConcretization(ExecutionState &state,
@@ -24,6 +24,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include "VarAnalysis.h"
 #include "DependencyGraph.h"
+#include "ObjectHolder.h"
 
 #include "expr/Lexer.h"
 #include "expr/Parser.h"
@@ -59,6 +60,8 @@ namespace klee {
   class Array;
   struct Cell;
   class ExecutionState;
+  class ExprJIT;
+  class FunctionJIT;
   class ExternalDispatcher;
   class Expr;
   class InstructionInfoTable;
@@ -73,6 +76,7 @@ namespace klee {
   class Searcher;
   class SeedInfo;
   class SpecialFunctionHandler;
+  class StateSwapper;
   struct StackFrame;
   class StatsTracker;
   class TimingSolver;
@@ -163,6 +167,12 @@ private:
   Searcher *searcher;
 
   ExternalDispatcher *externalDispatcher;
+  /// Compiles the expressions evaluated most under seeds, or null.
+  ExprJIT *exprJIT;
+  /// Compiles the functions called with concrete state, or null.
+  FunctionJIT *functionJIT;
+  /// Swaps idle states to disk at the memory cap, or null.
+  StateSwapper *stateSwapper;
   TimingSolver *solver;
   MemoryManager *memory;
   std::set<ExecutionState*> states;
@@ -218,6 +228,14 @@ private:
   /// Map of globals to their representative memory object.
   std::map<const llvm::GlobalValue*, MemoryObject*> globalObjects;
 
+  /// The globals with initializers whose object states are created on their
+  /// first access in a state, by address. \see bindLazyGlobal()
+  std::map<uint64_t, const llvm::GlobalVariable*> lazyGlobals;
+
+  /// The initialized object states of the lazy globals accessed so far,
+  /// which are copied into the states accessing them.
+  std::map<const MemoryObject*, ObjectHolder> lazyGlobalStates;
+
   /// Map of globals to their bound address. This also includes
   /// globals that have no representative object (i.e. functions).
   std::map<const llvm::GlobalValue*, ref<ConstantExpr> > globalAddresses;
@@ -273,8 +291,87 @@ private:
   llvm::Function* getTargetFunction(llvm::Value *calledVal,
                                     ExecutionState &state);
   
+  /// executeInstruction - Execute \a ki through the handler of its opcode,
+  /// which bindInstructionConstants() stored in it.
   void executeInstruction(ExecutionState &state, KInstruction *ki);
 
+  /// Return the member function interpreting instructions with \a opcode.
+  static InstructionHandler getInstructionHandler(unsigned opcode);
+
+  /// The handlers of the instructions, one per opcode, except that invoke
+  /// shares the one of call and vector instructions share one reporting
+  /// them unhandled. Handlers of integer operations, comparisons, casts,
+  /// selects and phis first compute the result on immediates when their
+  /// operands are concrete.
+  void executeRetInst(ExecutionState &state, KInstruction *ki);
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 1)
+  void executeUnwindInst(ExecutionState &state, KInstruction *ki);
+#endif
+  void executeBrInst(ExecutionState &state, KInstruction *ki);
+  void executeSwitchInst(ExecutionState &state, KInstruction *ki);
+  void executeUnreachableInst(ExecutionState &state, KInstruction *ki);
+  void executeCallInst(ExecutionState &state, KInstruction *ki);
+  void executePHIInst(ExecutionState &state, KInstruction *ki);
+  void executeSelectInst(ExecutionState &state, KInstruction *ki);
+  void executeVAArgInst(ExecutionState &state, KInstruction *ki);
+  void executeAddInst(ExecutionState &state, KInstruction *ki);
+  void executeSubInst(ExecutionState &state, KInstruction *ki);
+  void executeMulInst(ExecutionState &state, KInstruction *ki);
+  void executeUDivInst(ExecutionState &state, KInstruction *ki);
+  void executeSDivInst(ExecutionState &state, KInstruction *ki);
+  void executeURemInst(ExecutionState &state, KInstruction *ki);
+  void executeSRemInst(ExecutionState &state, KInstruction *ki);
+  void executeAndInst(ExecutionState &state, KInstruction *ki);
+  void executeOrInst(ExecutionState &state, KInstruction *ki);
+  void executeXorInst(ExecutionState &state, KInstruction *ki);
+  void executeShlInst(ExecutionState &state, KInstruction *ki);
+  void executeLShrInst(ExecutionState &state, KInstruction *ki);
+  void executeAShrInst(ExecutionState &state, KInstruction *ki);
+  void executeICmpInst(ExecutionState &state, KInstruction *ki);
+  void executeAllocaInst(ExecutionState &state, KInstruction *ki);
+  void executeLoadInst(ExecutionState &state, KInstruction *ki);
+  void executeStoreInst(ExecutionState &state, KInstruction *ki);
+  void executeGetElementPtrInst(ExecutionState &state, KInstruction *ki);
+  void executeTruncInst(ExecutionState &state, KInstruction *ki);
+  void executeZExtInst(ExecutionState &state, KInstruction *ki);
+  void executeSExtInst(ExecutionState &state, KInstruction *ki);
+  void executeIntToPtrInst(ExecutionState &state, KInstruction *ki);
+  void executePtrToIntInst(ExecutionState &state, KInstruction *ki);
+  void executeBitCastInst(ExecutionState &state, KInstruction *ki);
+  void executeFAddInst(ExecutionState &state, KInstruction *ki);
+  void executeFSubInst(ExecutionState &state, KInstruction *ki);
+  void executeFMulInst(ExecutionState &state, KInstruction *ki);
+  void executeFDivInst(ExecutionState &state, KInstruction *ki);
+  void executeFRemInst(ExecutionState &state, KInstruction *ki);
+  void executeFPTruncInst(ExecutionState &state, KInstruction *ki);
+  void executeFPExtInst(ExecutionState &state, KInstruction *ki);
+  void executeFPToUIInst(ExecutionState &state, KInstruction *ki);
+  void executeFPToSIInst(ExecutionState &state, KInstruction *ki);
+  void executeUIToFPInst(ExecutionState &state, KInstruction *ki);
+  void executeSIToFPInst(ExecutionState &state, KInstruction *ki);
+  void executeFCmpInst(ExecutionState &state, KInstruction *ki);
+  void executeInsertValueInst(ExecutionState &state, KInstruction *ki);
+  void executeExtractValueInst(ExecutionState &state, KInstruction *ki);
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+  void executeFenceInst(ExecutionState &state, KInstruction *ki);
+#endif
+  void executeVectorInst(ExecutionState &state, KInstruction *ki);
+  void executeIllegalInst(ExecutionState &state, KInstruction *ki);
+
+  /// Evaluate the two operands of the binary operation or comparison \a ki
+  /// to their immediates, of the returned \a width, so that its handler can
+  /// compute it without building expressions. Returns false if an operand
+  /// is symbolic.
+  bool evalImmediateOperands(ExecutionState &state, KInstruction *ki,
+                             uint64_t &left, uint64_t &right,
+                             Expr::Width &width);
+
+  /// Evaluate the operand of the integer cast \a ki to its immediate, of
+  /// the returned \a width. Returns false if it is symbolic or the result
+  /// does not fit an immediate.
+  bool evalImmediateOperand(ExecutionState &state, KInstruction *ki,
+                            uint64_t &value, Expr::Width &width);
+
   void printFileLine(ExecutionState &state, KInstruction *ki,
                      llvm::raw_ostream &file);
 
@@ -290,6 +387,15 @@ private:
 			      unsigned offset);
   void initializeGlobals(ExecutionState &state);
 
+  /// Bind the object state of the lazy global at \a address in \a state,
+  /// if it has not been accessed in the state yet.
+  ///
+  /// \return true if an object state was bound.
+  bool bindLazyGlobal(ExecutionState &state, uint64_t address);
+  /// Bind the object states of all lazy globals not yet accessed in
+  /// \a state, before the address space is searched or copied as a whole.
+  void bindLazyGlobals(ExecutionState &state);
+
   void stepInstruction(ExecutionState &state);
   void updateStates(ExecutionState *current);
   void transferToBasicBlock(llvm::BasicBlock *dst, 
@@ -301,6 +407,14 @@ private:
                             llvm::Function *function,
                             std::vector< ref<Expr> > &arguments);
 
+  /// Run a call to the defined function \a f natively, if \a f can be
+  /// compiled and its arguments and the objects it may access, see
+  /// FunctionJIT, are concrete.
+  ///
+  /// \return false if the call is to be interpreted instead.
+  bool callNatively(ExecutionState &state, KInstruction *ki,
+                    llvm::Function *f, std::vector< ref<Expr> > &arguments);
+
   ObjectState *bindObjectInState(ExecutionState &state, const MemoryObject *mo,
                                  bool isLocal, const Array *array = 0);
 
@@ -374,6 +488,13 @@ private:
               const std::vector< ref<Expr> > &conditions,
               std::vector<ExecutionState*> &result);
 
+  /// Evaluate \a e under all of \a seeds at once, with native code once \a e
+  /// is hot. The value under a seed is left null where the evaluation cannot
+  /// tell it, typically because it depends on bytes the seed does not bind;
+  /// the caller then asks the solver as before.
+  void evaluateSeeds(const std::vector<SeedInfo> &seeds, ref<Expr> e,
+                     std::vector< ref<ConstantExpr> > &values);
+
   // Fork current and return states in which condition holds / does
   // not hold, respectively. One of the states is necessarily the
   // current state, and one of the states may be null.
@@ -395,12 +516,13 @@ private:
   Cell& getArgumentCell(ExecutionState &state,
                         KFunction *kf,
                         unsigned index) {
-    return state.stack.back().locals[kf->getArgRegister(index)];
+    unsigned reg = kf->getArgRegister(index);
+    return state.stack.back().getWriteableLocals()[reg];
   }
 
   Cell& getDestCell(ExecutionState &state,
                     KInstruction *target) {
-    return state.stack.back().locals[target->dest];
+    return state.stack.back().getWriteableLocals()[target->dest];
   }
 
   void bindLocal(KInstruction *target, 
@@ -489,7 +611,17 @@ private:
   void initTimers();
   void processTimers(ExecutionState *current,
                      double maxInstTime);
-  void checkMemoryUsage();
+  void checkMemoryUsage(ExecutionState *current);
+
+  /// Reload the contents of \a state if it was swapped out at the memory
+  /// cap. This must be done before a state is executed or its contents
+  /// are used.
+  void swapInState(ExecutionState &state);
+
+  /// Swap out about \a count states, other than \a current, starting with
+  /// those which went longest without covering new code. Returns the number
+  /// of states swapped out.
+  unsigned swapOutStates(ExecutionState *current, unsigned count);
   void printDebugInstructions(ExecutionState &state);
   void doDumpStates();
 
@@ -292,7 +292,8 @@ bool Executor::pathConstraintSatisfied(ExecutionState &state) {
       ie = Decls.end(); it != ie; ++it) {
     Decl *D = *it;
     if (QueryCommand *QC = dyn_cast<QueryCommand>(D)) {
-      for (ConstraintManager::const_iterator it = QC->Constraints.begin(); 
+      for (std::vector< ref<Expr> >::const_iterator
+             it = QC->Constraints.begin(); 
           it != QC->Constraints.end(); ++it) {
         ref<Expr> e = *it;
         outs() << "Constraint: " << e << "\n";
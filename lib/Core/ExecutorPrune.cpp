@@ -176,6 +176,10 @@ bool Executor::isDuplicate(snapshot sn) {
       continue;
     }
 
+    // Both states must have the same objects: with lazy globals a global
+    // one of them has not accessed yet is missing from its snapshot.
+    if (sit->memObjs.size() != sn.memObjs.size())
+      continue;
     for (std::map<const llvm::Value*, ref<Expr> >::iterator it = sn.memObjs.begin(); 
         it != sn.memObjs.end(); it++) {
       if (sit->memObjs.find(it->first) == sit->memObjs.end()) {
@@ -0,0 +1,405 @@
+//===-- ExprJIT.cpp -------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ExprJIT.h"
+
+#include "klee/Config/Version.h"
+#include "klee/util/Assignment.h"
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#else
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 2)
+#include "llvm/IRBuilder.h"
+#else
+#include "llvm/Support/IRBuilder.h"
+#endif
+#endif
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+  /// The number of distinct expressions whose uses are counted; beyond it
+  /// only the expressions already seen can be compiled.
+  const unsigned MaxEntries = 1 << 16;
+
+  /// ExprCompiler - Emits the straight-line code computing an expression
+  /// into the entry block of a compiled function.
+  class ExprCompiler {
+    IRBuilder<> &builder;
+    std::vector<const Array*> &arrays;
+    std::map<const Array*, std::vector<unsigned char> > &constantBytes;
+    Value *bytesArg, *sizesArg, *allowFreeValuesArg;
+    /// Whether all subexpressions computed so far are defined.
+    Value *defined;
+    DenseMap<const Expr*, Value*> values;
+    /// The bytes and number of bytes loaded for each array read.
+    DenseMap<const Array*, std::pair<Value*, Value*> > bindings;
+    bool supported;
+
+    LLVMContext &getContext() { return builder.getContext(); }
+    LLVM_TYPE_Q IntegerType *getType(Expr::Width w) {
+      return IntegerType::get(getContext(), w);
+    }
+    Constant *getConstant(Expr::Width w, uint64_t value) {
+      return ConstantInt::get(getType(w), value);
+    }
+
+    /// Mark the result unknown wherever \a condition does not hold.
+    void require(Value *condition) {
+      defined = builder.CreateAnd(defined, condition);
+    }
+
+    /// Mark the result unknown where a read of an unbound byte is free,
+    /// unless \a condition holds.
+    void requireBound(Value *condition) {
+      require(builder.CreateOr(condition,
+                               builder.CreateICmpEQ(allowFreeValuesArg,
+                                                    getConstant(8, 0))));
+    }
+
+    Value *compileKind(const ref<Expr> &e);
+    Value *compileRead(const ReadExpr *re);
+    Value *compileBinding(const Array *root, Value *index, Value *covered);
+
+  public:
+    ExprCompiler(IRBuilder<> &_builder, Value *_bytesArg, Value *_sizesArg,
+                 Value *_allowFreeValuesArg,
+                 std::vector<const Array*> &_arrays,
+                 std::map<const Array*,
+                          std::vector<unsigned char> > &_constantBytes)
+      : builder(_builder), arrays(_arrays), constantBytes(_constantBytes),
+        bytesArg(_bytesArg), sizesArg(_sizesArg),
+        allowFreeValuesArg(_allowFreeValuesArg),
+        defined(ConstantInt::getTrue(_builder.getContext())),
+        supported(true) {}
+
+    bool isSupported() const { return supported; }
+    Value *getDefined() const { return defined; }
+
+    Value *compile(const ref<Expr> &e);
+  };
+}
+
+Value *ExprCompiler::compile(const ref<Expr> &e) {
+  DenseMap<const Expr*, Value*>::iterator it = values.find(e.get());
+  if (it != values.end())
+    return it->second;
+
+  if (e->getWidth() > 64)
+    supported = false;
+  if (!supported)
+    return 0;
+
+  Value *v = compileKind(e);
+  if (!supported)
+    return 0;
+  values.insert(std::make_pair(e.get(), v));
+  return v;
+}
+
+Value *ExprCompiler::compileBinding(const Array *root, Value *index,
+                                   Value *covered) {
+  DenseMap<const Array*, std::pair<Value*, Value*> >::iterator it =
+    bindings.find(root);
+  if (it == bindings.end()) {
+    Value *k = getConstant(32, arrays.size());
+    arrays.push_back(root);
+    Value *bytes = builder.CreateLoad(builder.CreateGEP(bytesArg, k));
+    Value *size = builder.CreateLoad(builder.CreateGEP(sizesArg, k));
+    it = bindings.insert(std::make_pair(root,
+                                        std::make_pair(bytes, size))).first;
+  }
+
+  // The caller always passes at least one byte, so the load is safe even
+  // when the index is out of the bound bytes.
+  Value *inRange = builder.CreateICmpULT(index, it->second.second);
+  Value *safeIndex = builder.CreateSelect(inRange, index, getConstant(64, 0));
+  Value *byte = builder.CreateLoad(builder.CreateGEP(it->second.first,
+                                                     safeIndex));
+  requireBound(builder.CreateOr(covered, inRange));
+  return builder.CreateSelect(inRange, byte, getConstant(8, 0));
+}
+
+Value *ExprCompiler::compileRead(const ReadExpr *re) {
+  const Array *root = re->updates.root;
+  // Bindings are bytes.
+  if (root->range != Expr::Int8) {
+    supported = false;
+    return 0;
+  }
+
+  Value *index = compile(re->index);
+  if (!supported)
+    return 0;
+  index = builder.CreateZExt(index, getType(64));
+  // Assignment::evaluate() takes the index as an unsigned.
+  require(builder.CreateICmpULE(index, getConstant(64, 0xFFFFFFFFULL)));
+
+  // Match the updates newest first, as ExprEvaluator::evalRead() does; the
+  // root is read only where none of them writes the index.
+  std::vector<std::pair<Value*, Value*> > writes;
+  Value *matched = ConstantInt::getFalse(getContext());
+  for (const UpdateNode *un = re->updates.head; un; un = un->next) {
+    Value *updateIndex = compile(un->index);
+    Value *updateValue = compile(un->value);
+    if (!supported)
+      return 0;
+    updateIndex = builder.CreateZExt(updateIndex, getType(64));
+    Value *match = builder.CreateICmpEQ(index, updateIndex);
+    writes.push_back(std::make_pair(match, updateValue));
+    matched = builder.CreateOr(matched, match);
+  }
+
+  Value *result;
+  if (root->isConstantArray()) {
+    std::vector<unsigned char> &contents = constantBytes[root];
+    if (contents.empty())
+      for (unsigned i = 0; i != root->size; ++i)
+        contents.push_back(root->constantValues[i]->getZExtValue(8));
+    Value *base =
+      builder.CreateIntToPtr(getConstant(64, (uintptr_t) &contents[0]),
+                             PointerType::getUnqual(getType(8)));
+    Value *inRange =
+      builder.CreateICmpULT(index, getConstant(64, root->size));
+    Value *safeIndex =
+      builder.CreateSelect(inRange, index, getConstant(64, 0));
+    Value *byte = builder.CreateLoad(builder.CreateGEP(base, safeIndex));
+    // Assignments never bind constant arrays, so a read beyond the
+    // constant values reads an unbound byte.
+    requireBound(builder.CreateOr(matched, inRange));
+    result = builder.CreateSelect(inRange, byte, getConstant(8, 0));
+  } else {
+    result = compileBinding(root, index, matched);
+  }
+
+  // Apply the updates oldest first, so that the newest write wins.
+  for (std::vector<std::pair<Value*, Value*> >::reverse_iterator
+         it = writes.rbegin(), ie = writes.rend(); it != ie; ++it)
+    result = builder.CreateSelect(it->first, it->second, result);
+  return result;
+}
+
+Value *ExprCompiler::compileKind(const ref<Expr> &e) {
+  Expr::Width w = e->getWidth();
+
+  switch (e->getKind()) {
+  case Expr::Constant:
+    return getConstant(w, cast<klee::ConstantExpr>(e)->getZExtValue());
+
+  case Expr::NotOptimized:
+    return compile(e->getKid(0));
+
+  case Expr::Read:
+    return compileRead(cast<ReadExpr>(e));
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    Value *v = compile(ee->expr);
+    if (!supported)
+      return 0;
+    if (ee->offset)
+      v = builder.CreateLShr(v, getConstant(ee->expr->getWidth(),
+                                            ee->offset));
+    return builder.CreateTrunc(v, getType(w));
+  }
+
+  default:
+    break;
+  }
+
+  Value *ops[3] = { 0, 0, 0 };
+  for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+    ops[i] = compile(e->getKid(i));
+  if (!supported)
+    return 0;
+  Value *a = ops[0], *b = ops[1];
+
+  switch (e->getKind()) {
+  case Expr::Select:
+    return builder.CreateSelect(a, b, ops[2]);
+
+  case Expr::Concat: {
+    Expr::Width rightWidth = e->getKid(1)->getWidth();
+    Value *left = builder.CreateZExt(a, getType(w));
+    return builder.CreateOr(builder.CreateShl(left,
+                                              getConstant(w, rightWidth)),
+                            builder.CreateZExt(b, getType(w)));
+  }
+
+  case Expr::ZExt: return builder.CreateZExt(a, getType(w));
+  case Expr::SExt: return builder.CreateSExt(a, getType(w));
+  case Expr::Not: return builder.CreateNot(a);
+
+  case Expr::Add: return builder.CreateAdd(a, b);
+  case Expr::Sub: return builder.CreateSub(a, b);
+  case Expr::Mul: return builder.CreateMul(a, b);
+  case Expr::And: return builder.CreateAnd(a, b);
+  case Expr::Or: return builder.CreateOr(a, b);
+  case Expr::Xor: return builder.CreateXor(a, b);
+
+  // Division by zero and signed overflow are undefined in LLVM, so the
+  // divisor is replaced by one where the result is unknown anyway.
+  case Expr::UDiv:
+  case Expr::URem:
+  case Expr::SDiv:
+  case Expr::SRem: {
+    Value *d = builder.CreateICmpNE(b, getConstant(w, 0));
+    if (e->getKind() == Expr::SDiv || e->getKind() == Expr::SRem) {
+      Value *minValue = getConstant(w, 1ULL << (w - 1));
+      Value *minusOne = Constant::getAllOnesValue(getType(w));
+      Value *overflow = builder.CreateAnd(builder.CreateICmpEQ(a, minValue),
+                                          builder.CreateICmpEQ(b, minusOne));
+      d = builder.CreateAnd(d, builder.CreateNot(overflow));
+    }
+    require(d);
+    b = builder.CreateSelect(d, b, getConstant(w, 1));
+    switch (e->getKind()) {
+    case Expr::UDiv: return builder.CreateUDiv(a, b);
+    case Expr::URem: return builder.CreateURem(a, b);
+    case Expr::SDiv: return builder.CreateSDiv(a, b);
+    default: return builder.CreateSRem(a, b);
+    }
+  }
+
+  // Shifting by the width or more is undefined in LLVM, as above.
+  case Expr::Shl:
+  case Expr::LShr:
+  case Expr::AShr: {
+    Value *d = builder.CreateICmpULT(b, getConstant(w, w));
+    require(d);
+    b = builder.CreateSelect(d, b, getConstant(w, 0));
+    switch (e->getKind()) {
+    case Expr::Shl: return builder.CreateShl(a, b);
+    case Expr::LShr: return builder.CreateLShr(a, b);
+    default: return builder.CreateAShr(a, b);
+    }
+  }
+
+  case Expr::Eq: return builder.CreateICmpEQ(a, b);
+  case Expr::Ne: return builder.CreateICmpNE(a, b);
+  case Expr::Ult: return builder.CreateICmpULT(a, b);
+  case Expr::Ule: return builder.CreateICmpULE(a, b);
+  case Expr::Ugt: return builder.CreateICmpUGT(a, b);
+  case Expr::Uge: return builder.CreateICmpUGE(a, b);
+  case Expr::Slt: return builder.CreateICmpSLT(a, b);
+  case Expr::Sle: return builder.CreateICmpSLE(a, b);
+  case Expr::Sgt: return builder.CreateICmpSGT(a, b);
+  case Expr::Sge: return builder.CreateICmpSGE(a, b);
+
+  default:
+    supported = false;
+    return 0;
+  }
+}
+
+/***/
+
+ExprJIT::ExprJIT(ExecutionEngine *_executionEngine, unsigned _threshold)
+  : executionEngine(_executionEngine),
+    module(new Module("ExprJIT", getGlobalContext())),
+    threshold(_threshold) {
+  executionEngine->addModule(module);
+}
+
+bool ExprJIT::compile(const ref<Expr> &e, Entry &entry) {
+  LLVMContext &ctx = module->getContext();
+  LLVM_TYPE_Q Type *i8 = Type::getInt8Ty(ctx);
+  LLVM_TYPE_Q Type *i64 = Type::getInt64Ty(ctx);
+  std::vector<LLVM_TYPE_Q Type*> params;
+  params.push_back(PointerType::getUnqual(PointerType::getUnqual(i8)));
+  params.push_back(PointerType::getUnqual(i64));
+  params.push_back(i8);
+  params.push_back(PointerType::getUnqual(i8));
+  Function *f = Function::Create(FunctionType::get(i64, params, false),
+                                 GlobalVariable::ExternalLinkage, "", module);
+
+  Function::arg_iterator ai = f->arg_begin();
+  Value *bytesArg = ai++, *sizesArg = ai++, *allowFreeValuesArg = ai++;
+  Value *knownArg = ai;
+
+  IRBuilder<> builder(BasicBlock::Create(ctx, "entry", f));
+  ExprCompiler compiler(builder, bytesArg, sizesArg, allowFreeValuesArg,
+                        entry.arrays, constantBytes);
+  Value *result = compiler.compile(e);
+  if (!compiler.isSupported()) {
+    f->eraseFromParent();
+    entry.arrays.clear();
+    return false;
+  }
+
+  builder.CreateStore(builder.CreateZExt(compiler.getDefined(), i8),
+                      knownArg);
+  builder.CreateRet(builder.CreateZExt(result, i64));
+
+  entry.function =
+    (CompiledExpr) (uintptr_t) executionEngine->getPointerToFunction(f);
+  return entry.function != 0;
+}
+
+bool ExprJIT::evaluate(const ref<Expr> &e,
+                       const std::vector<const Assignment*> &assignments,
+                       std::vector<uint64_t> &values,
+                       std::vector<unsigned char> &known) {
+  ExprHashMap<Entry>::iterator it = entries.find(e);
+  if (it == entries.end()) {
+    if (entries.size() >= MaxEntries)
+      return false;
+    it = entries.insert(std::make_pair(e, Entry())).first;
+  }
+
+  Entry &entry = it->second;
+  if (!entry.function) {
+    if (entry.unsupported || ++entry.uses < threshold)
+      return false;
+    if (!compile(e, entry)) {
+      entry.unsupported = true;
+      return false;
+    }
+  }
+
+  // Unbound arrays are passed as no bytes; the function still loads one
+  // before checking the size.
+  static const unsigned char unbound = 0;
+  unsigned n = assignments.size(), numArrays = entry.arrays.size();
+  std::vector<const unsigned char*> bytes(numArrays + 1, &unbound);
+  std::vector<uint64_t> sizes(numArrays + 1, 0);
+  values.assign(n, 0);
+  known.assign(n, 0);
+  for (unsigned i = 0; i != n; ++i) {
+    const Assignment *a = assignments[i];
+    for (unsigned j = 0; j != numArrays; ++j) {
+      Assignment::bindings_ty::const_iterator bit =
+        a->bindings.find(entry.arrays[j]);
+      if (bit != a->bindings.end() && !bit->second.empty()) {
+        bytes[j] = &bit->second[0];
+        sizes[j] = bit->second.size();
+      } else {
+        bytes[j] = &unbound;
+        sizes[j] = 0;
+      }
+    }
+    values[i] = entry.function(&bytes[0], &sizes[0], a->allowFreeValues,
+                               &known[i]);
+  }
+  return true;
+}
@@ -0,0 +1,87 @@
+//===-- ExprJIT.h -----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRJIT_H
+#define KLEE_EXPRJIT_H
+
+#include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
+
+#include <map>
+#include <vector>
+
+namespace llvm {
+  class ExecutionEngine;
+  class Module;
+}
+
+namespace klee {
+  class Assignment;
+
+  /// ExprJIT - Evaluates hot expressions under assignments with native code.
+  ///
+  /// Each expression is counted as it is evaluated, and once it has been
+  /// evaluated \a threshold times it is compiled through the execution engine
+  /// into a function reading the bytes an assignment binds for each array.
+  /// Expressions are keyed by structure, so the count and the function are
+  /// shared by equal expressions built separately.
+  ///
+  /// Only expressions whose subexpressions are all at most 64 bits wide and
+  /// which read bytes are compiled. The compiled function reports the value
+  /// as unknown if any subexpression is undefined under the assignment, as
+  /// described for ExprBatchEvaluator, even in an arm of a select that is
+  /// not taken; callers evaluate those assignments in another way.
+  class ExprJIT {
+    /// The signature of a compiled expression: the bytes and number of bytes
+    /// bound for each array the expression reads, whether unbound bytes are
+    /// free, and where to store whether the returned value is known.
+    typedef uint64_t (*CompiledExpr)(const unsigned char *const *bytes,
+                                     const uint64_t *sizes,
+                                     unsigned char allowFreeValues,
+                                     unsigned char *known);
+
+    struct Entry {
+      /// The number of times the expression was evaluated.
+      unsigned uses;
+      /// The compiled function, or null if it is not compiled (yet).
+      CompiledExpr function;
+      /// Whether the expression cannot be compiled.
+      bool unsupported;
+      /// The arrays the function reads, in argument order.
+      std::vector<const Array*> arrays;
+
+      Entry() : uses(0), function(0), unsupported(false) {}
+    };
+
+    llvm::ExecutionEngine *executionEngine;
+    llvm::Module *module;
+    unsigned threshold;
+    ExprHashMap<Entry> entries;
+    /// The contents of the constant arrays read by compiled functions, which
+    /// refer to them by address.
+    std::map<const Array*, std::vector<unsigned char> > constantBytes;
+
+    bool compile(const ref<Expr> &e, Entry &entry);
+
+  public:
+    /// Compile into a module added to \a executionEngine, which owns it.
+    ExprJIT(llvm::ExecutionEngine *executionEngine, unsigned threshold);
+
+    /// evaluate - Compute the value of \a e under each of \a assignments, if
+    /// \a e has been compiled; otherwise count the use and return false.
+    /// \a known[i] is set if the value under the i-th assignment is known,
+    /// and \a values[i] to that value.
+    bool evaluate(const ref<Expr> &e,
+                  const std::vector<const Assignment*> &assignments,
+                  std::vector<uint64_t> &values,
+                  std::vector<unsigned char> &known);
+  };
+}
+
+#endif /* KLEE_EXPRJIT_H */
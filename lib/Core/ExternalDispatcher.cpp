@@ -137,7 +137,7 @@ bool ExternalDispatcher::executeCall(Function *f, Instruction *i, uint64_t *args
     }
 #endif
 
-    dispatcher = createDispatcher(f,i);
+    dispatcher = createDispatcher(f,i,0);
 
     dispatchers.insert(std::make_pair(i, dispatcher));
 
@@ -155,11 +155,28 @@ bool ExternalDispatcher::executeCall(Function *f, Instruction *i, uint64_t *args
   return runProtectedCall(dispatcher, args);
 }
 
+bool ExternalDispatcher::executeNativeCall(Function *f, Instruction *i,
+                                           uint64_t *args, void *address) {
+  dispatchers_ty::iterator it = nativeDispatchers.find(i);
+  Function *dispatcher;
+
+  if (it == nativeDispatchers.end()) {
+    dispatcher = createDispatcher(f, i, address);
+    nativeDispatchers.insert(std::make_pair(i, dispatcher));
+    executionEngine->recompileAndRelinkFunction(dispatcher);
+  } else {
+    dispatcher = it->second;
+  }
+
+  return runProtectedCall(dispatcher, args);
+}
+
 // FIXME: This is not reentrant.
 static uint64_t *gTheArgsP;
 
 bool ExternalDispatcher::runProtectedCall(Function *f, uint64_t *args) {
-  struct sigaction segvAction, segvActionOld;
+  struct sigaction segvAction, segvActionOld, busActionOld, fpeActionOld,
+    illActionOld;
   bool res;
   
   if (!f)
@@ -170,9 +187,15 @@ bool ExternalDispatcher::runProtectedCall(Function *f, uint64_t *args) {
 
   segvAction.sa_handler = 0;
   memset(&segvAction.sa_mask, 0, sizeof(segvAction.sa_mask));
-  segvAction.sa_flags = SA_SIGINFO;
+  // The handler does not return, so the signal must not stay blocked for
+  // the next call.
+  segvAction.sa_flags = SA_SIGINFO | SA_NODEFER;
   segvAction.sa_sigaction = ::sigsegv_handler;
   sigaction(SIGSEGV, &segvAction, &segvActionOld);
+  // Natively run code of the program may also trap on its own bugs.
+  sigaction(SIGBUS, &segvAction, &busActionOld);
+  sigaction(SIGFPE, &segvAction, &fpeActionOld);
+  sigaction(SIGILL, &segvAction, &illActionOld);
 
   if (setjmp(escapeCallJmpBuf)) {
     res = false;
@@ -181,6 +204,9 @@ bool ExternalDispatcher::runProtectedCall(Function *f, uint64_t *args) {
     res = true;
   }
 
+  sigaction(SIGILL, &illActionOld, 0);
+  sigaction(SIGFPE, &fpeActionOld, 0);
+  sigaction(SIGBUS, &busActionOld, 0);
   sigaction(SIGSEGV, &segvActionOld, 0);
   return res;
 }
@@ -191,8 +217,10 @@ bool ExternalDispatcher::runProtectedCall(Function *f, uint64_t *args) {
 // the special cases that the JIT knows how to directly call. If this is not
 // done, then the jit will end up generating a nullary stub just to call our
 // stub, for every single function call.
-Function *ExternalDispatcher::createDispatcher(Function *target, Instruction *inst) {
-  if (!resolveSymbol(target->getName()))
+Function *ExternalDispatcher::createDispatcher(Function *target,
+                                              Instruction *inst,
+                                              void *address) {
+  if (!address && !resolveSymbol(target->getName()))
     return 0;
 
   CallSite cs;
@@ -250,9 +278,18 @@ Function *ExternalDispatcher::createDispatcher(Function *target, Instruction *in
     idx += ((!!argSize ? argSize : 64) + 63)/64;
   }
 
-  Constant *dispatchTarget =
-    dispatchModule->getOrInsertFunction(target->getName(), FTy,
-                                        target->getAttributes());
+  Constant *dispatchTarget;
+  if (address) {
+    Function *decl = Function::Create(FTy, GlobalVariable::ExternalLinkage,
+                                      "", dispatchModule);
+    decl->setAttributes(target->getAttributes());
+    executionEngine->addGlobalMapping(decl, address);
+    dispatchTarget = decl;
+  } else {
+    dispatchTarget =
+      dispatchModule->getOrInsertFunction(target->getName(), FTy,
+                                          target->getAttributes());
+  }
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 0)
   Instruction *result = CallInst::Create(dispatchTarget,
                                          llvm::ArrayRef<Value *>(args, args+i),
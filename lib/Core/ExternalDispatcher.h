@@ -27,11 +27,14 @@ namespace klee {
   private:
     typedef std::map<const llvm::Instruction*,llvm::Function*> dispatchers_ty;
     dispatchers_ty dispatchers;
+    /// The dispatchers of calls to code at a given address.
+    dispatchers_ty nativeDispatchers;
     llvm::Module *dispatchModule;
     llvm::ExecutionEngine *executionEngine;
     std::map<std::string, void*> preboundFunctions;
     
-    llvm::Function *createDispatcher(llvm::Function *f, llvm::Instruction *i);
+    llvm::Function *createDispatcher(llvm::Function *f, llvm::Instruction *i,
+                                     void *address);
     bool runProtectedCall(llvm::Function *f, uint64_t *args);
     
   public:
@@ -43,7 +46,15 @@ namespace klee {
      * into args[0].
      */
     bool executeCall(llvm::Function *function, llvm::Instruction *i, uint64_t *args);
+
+    /* Like executeCall, but call the code at address, which has the type of
+     * the given function, instead of the external symbol of its name.
+     */
+    bool executeNativeCall(llvm::Function *function, llvm::Instruction *i,
+                           uint64_t *args, void *address);
     void *resolveSymbol(const std::string &name);
+
+    llvm::ExecutionEngine *getExecutionEngine() { return executionEngine; }
   };  
 }
 
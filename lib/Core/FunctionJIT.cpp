@@ -0,0 +1,295 @@
+//===-- FunctionJIT.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "FunctionJIT.h"
+#include "Memory.h"
+
+#include "klee/Config/Version.h"
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalAlias.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#else
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/GlobalAlias.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/Instructions.h"
+#include "llvm/Intrinsics.h"
+#include "llvm/Module.h"
+#include "llvm/Operator.h"
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 2)
+#include "llvm/IRBuilder.h"
+#else
+#include "llvm/Support/IRBuilder.h"
+#endif
+#endif
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include <cassert>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+  bool isDivZeroCheck(const Function *f) {
+    return f->getName() == "klee_div_zero_check";
+  }
+
+  bool isOvershiftCheck(const Function *f) {
+    return f->getName() == "klee_overshift_check";
+  }
+
+  /// Replace the body of a division or overshift check by one that traps
+  /// when the check fails.
+  void defineTrappingCheck(Function *f) {
+    LLVMContext &ctx = f->getContext();
+    f->deleteBody();
+    BasicBlock *entry = BasicBlock::Create(ctx, "entry", f);
+    BasicBlock *fail = BasicBlock::Create(ctx, "fail", f);
+    BasicBlock *ok = BasicBlock::Create(ctx, "ok", f);
+
+    IRBuilder<> builder(entry);
+    Function::arg_iterator ai = f->arg_begin();
+    Value *failed;
+    if (isDivZeroCheck(f)) {
+      Value *z = ai;
+      failed = builder.CreateICmpEQ(z, Constant::getNullValue(z->getType()));
+    } else {
+      Value *bitWidth = ai++;
+      Value *shift = ai;
+      failed = builder.CreateICmpUGE(shift, bitWidth);
+    }
+    builder.CreateCondBr(failed, fail, ok);
+
+    builder.SetInsertPoint(fail);
+    builder.CreateCall(Intrinsic::getDeclaration(f->getParent(),
+                                                 Intrinsic::trap));
+    builder.CreateUnreachable();
+
+    builder.SetInsertPoint(ok);
+    builder.CreateRetVoid();
+  }
+
+  bool containsPointer(LLVM_TYPE_Q Type *t) {
+    if (t->isPointerTy())
+      return true;
+    if (LLVM_TYPE_Q SequentialType *st = dyn_cast<SequentialType>(t))
+      return containsPointer(st->getElementType());
+    if (LLVM_TYPE_Q StructType *st = dyn_cast<StructType>(t))
+      for (unsigned i = 0, e = st->getNumElements(); i != e; ++i)
+        if (containsPointer(st->getElementType(i)))
+          return true;
+    return false;
+  }
+
+  /// Whether \a v points into a stack slot of the function, which is on
+  /// the native stack.
+  bool isStackSlot(const Value *v) {
+    return isa<AllocaInst>(v->stripPointerCasts());
+  }
+
+  /// Whether the memory \a v points to may hold pointers, judged by the
+  /// type of the object it is derived from rather than by the type it is
+  /// accessed as.
+  bool mayHoldPointers(const Value *v) {
+    for (;;) {
+      v = v->stripPointerCasts();
+      if (const GEPOperator *gep = dyn_cast<GEPOperator>(v))
+        v = gep->getPointerOperand();
+      else
+        break;
+    }
+    return containsPointer(cast<PointerType>(v->getType())->getElementType());
+  }
+}
+
+/***/
+
+FunctionJIT::FunctionJIT(ExecutionEngine *_executionEngine,
+                         const Module *_module,
+                         const std::map<const GlobalValue*, MemoryObject*>
+                           &_globalObjects)
+  : executionEngine(_executionEngine), module(_module),
+    globalObjects(_globalObjects), clone(0) {
+}
+
+bool FunctionJIT::isNativeConstant(const Constant *c,
+                                   std::set<const MemoryObject*> &objects)
+  const {
+  if (isa<Function>(c) || isa<GlobalAlias>(c))
+    return false;
+  if (isa<GlobalVariable>(c)) {
+    std::map<const GlobalValue*, MemoryObject*>::const_iterator it =
+      globalObjects.find(cast<GlobalValue>(c));
+    if (it == globalObjects.end())
+      return false;
+    objects.insert(it->second);
+    return true;
+  }
+  for (User::const_op_iterator it = c->op_begin(), ie = c->op_end();
+       it != ie; ++it)
+    if (!isNativeConstant(cast<Constant>(*it), objects))
+      return false;
+  return true;
+}
+
+bool FunctionJIT::isSupported(const Function *f) {
+  std::map<const Function*, bool>::iterator it = supported.find(f);
+  if (it != supported.end())
+    return it->second;
+
+  // A call back into a function being checked finds it unsupported, which
+  // keeps recursive functions interpreted.
+  supported[f] = false;
+  std::set<const MemoryObject*> objects;
+  bool result = checkFunction(f, objects);
+  supported[f] = result;
+  if (result)
+    referencedObjects[f].assign(objects.begin(), objects.end());
+  return result;
+}
+
+bool FunctionJIT::checkFunction(const Function *f,
+                                std::set<const MemoryObject*> &objects) {
+  if (f->isDeclaration() || f->isVarArg())
+    return false;
+  if (isDivZeroCheck(f) || isOvershiftCheck(f))
+    return true;
+
+  for (Function::const_iterator bb = f->begin(), be = f->end(); bb != be;
+       ++bb) {
+    for (BasicBlock::const_iterator i = bb->begin(), ie = bb->end(); i != ie;
+         ++i) {
+      if (isa<InvokeInst>(i) || isa<UnreachableInst>(i) ||
+          isa<VAArgInst>(i) || isa<IndirectBrInst>(i) ||
+          isa<IntToPtrInst>(i))
+        return false;
+
+      // Pointers may only be kept in stack slots, so that the objects the
+      // code accesses are those it refers to and those its pointer
+      // arguments point into. Memory that may hold pointers is otherwise
+      // not accessed at all, whatever the type it is accessed as, and
+      // stack slots for pointers are only stored pointers, so that no
+      // pointer is read or made from its bytes.
+      if (const LoadInst *li = dyn_cast<LoadInst>(i)) {
+        const Value *p = li->getPointerOperand();
+        if (!isStackSlot(p) &&
+            (containsPointer(li->getType()) || mayHoldPointers(p)))
+          return false;
+      }
+      if (const StoreInst *si = dyn_cast<StoreInst>(i)) {
+        const Value *p = si->getPointerOperand();
+        if (p->getName() == "tmp")
+          return false;
+        bool storesPointer = containsPointer(si->getValueOperand()->getType());
+        if (isStackSlot(p) ? mayHoldPointers(p) && !storesPointer
+                           : storesPointer)
+          return false;
+      }
+
+      if (const CallInst *ci = dyn_cast<CallInst>(i)) {
+        const Function *callee = ci->getCalledFunction();
+        if (!callee)
+          return false;
+        if (callee->isDeclaration()) {
+          switch (callee->getIntrinsicID()) {
+          case Intrinsic::dbg_declare:
+          case Intrinsic::dbg_value:
+          case Intrinsic::lifetime_start:
+          case Intrinsic::lifetime_end:
+          case Intrinsic::memset:
+            break;
+          case Intrinsic::memcpy:
+          case Intrinsic::memmove:
+            if (mayHoldPointers(ci->getArgOperand(0)) ||
+                mayHoldPointers(ci->getArgOperand(1)))
+              return false;
+            break;
+          default:
+            return false;
+          }
+        } else if (!isSupported(callee)) {
+          return false;
+        } else {
+          const std::vector<const MemoryObject*> &calleeObjects =
+            referencedObjects[callee];
+          objects.insert(calleeObjects.begin(), calleeObjects.end());
+        }
+        for (unsigned j = 0, e = ci->getNumArgOperands(); j != e; ++j)
+          if (const Constant *c = dyn_cast<Constant>(ci->getArgOperand(j)))
+            if (!isNativeConstant(c, objects))
+              return false;
+        continue;
+      }
+
+      for (unsigned j = 0, e = i->getNumOperands(); j != e; ++j)
+        if (const Constant *c = dyn_cast<Constant>(i->getOperand(j)))
+          if (!isNativeConstant(c, objects))
+            return false;
+    }
+  }
+  return true;
+}
+
+void FunctionJIT::cloneModule() {
+  ValueToValueMapTy map;
+  clone = CloneModule(module, map);
+
+  for (Module::const_global_iterator it = module->global_begin(),
+         ie = module->global_end(); it != ie; ++it) {
+    std::map<const GlobalValue*, MemoryObject*>::const_iterator mo =
+      globalObjects.find(it);
+    if (mo != globalObjects.end())
+      executionEngine->addGlobalMapping(cast<GlobalValue>(map[it]),
+                                        (void*) (uintptr_t)
+                                          mo->second->address);
+  }
+
+  for (Module::const_iterator it = module->begin(), ie = module->end();
+       it != ie; ++it) {
+    Function *f = cast<Function>(map[it]);
+    clones[it] = f;
+    if (!f->isDeclaration() && (isDivZeroCheck(f) || isOvershiftCheck(f)))
+      defineTrappingCheck(f);
+  }
+
+  executionEngine->addModule(clone);
+}
+
+const std::vector<const MemoryObject*> &
+FunctionJIT::getReferencedObjects(const Function *f) {
+  assert(isSupported(f) && "function cannot be compiled");
+  return referencedObjects[f];
+}
+
+void *FunctionJIT::getPointerToFunction(const Function *f) {
+  std::map<const Function*, void*>::iterator it = code.find(f);
+  if (it != code.end())
+    return it->second;
+
+  void *result = 0;
+  if (isSupported(f)) {
+    if (!clone)
+      cloneModule();
+    result = executionEngine->getPointerToFunction(clones[f]);
+  }
+  code[f] = result;
+  return result;
+}
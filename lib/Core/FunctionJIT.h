@@ -0,0 +1,94 @@
+//===-- FunctionJIT.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FUNCTIONJIT_H
+#define KLEE_FUNCTIONJIT_H
+
+#include <map>
+#include <set>
+#include <vector>
+
+namespace llvm {
+  class Constant;
+  class ExecutionEngine;
+  class Function;
+  class GlobalValue;
+  class Module;
+}
+
+namespace klee {
+  class MemoryObject;
+
+  /// FunctionJIT - Compiles functions of the program to native code that
+  /// runs on the memory of the objects the executor allocated.
+  ///
+  /// On first use the module is cloned into the execution engine, with
+  /// each global of the clone mapped to the address of the memory object of
+  /// the original, so that the native code reads and writes the same bytes
+  /// as AddressSpace::copyOutConcretes() and copyInConcretes() do.
+  ///
+  /// Only functions whose behaviour natively matches their interpretation
+  /// are compiled: they may call only other such functions, directly, and
+  /// memory intrinsics, and may not take the address of a function, whose
+  /// native address differs from the one the executor uses. Functions
+  /// calling special or external functions, invoking, reaching unreachable
+  /// code, using varargs or recursing are rejected, as are stores to
+  /// "tmp", which the executor observes in multi-cycle mode. The division
+  /// and overshift checks trap instead of reporting the error, so that the
+  /// caller can interpret the call to report it.
+  ///
+  /// Compiled functions may also not load or store pointers other than in
+  /// their stack slots, nor make pointers from integers or from the bytes
+  /// of memory that may hold pointers, so that they only access the
+  /// globals they and their callees refer to and the objects their pointer
+  /// arguments point into. Callers are responsible for calling only with
+  /// concrete arguments and those objects concrete.
+  class FunctionJIT {
+    llvm::ExecutionEngine *executionEngine;
+    const llvm::Module *module;
+    const std::map<const llvm::GlobalValue*, MemoryObject*> &globalObjects;
+    /// The clone of module added to the execution engine, or null.
+    llvm::Module *clone;
+    std::map<const llvm::Function*, llvm::Function*> clones;
+    /// Whether each function checked so far can be compiled.
+    std::map<const llvm::Function*, bool> supported;
+    /// The native code of each function asked for, or null.
+    std::map<const llvm::Function*, void*> code;
+    /// The objects of the globals each function that can be compiled and
+    /// its callees refer to.
+    std::map<const llvm::Function*,
+             std::vector<const MemoryObject*> > referencedObjects;
+
+    bool isSupported(const llvm::Function *f);
+    bool checkFunction(const llvm::Function *f,
+                       std::set<const MemoryObject*> &objects);
+    bool isNativeConstant(const llvm::Constant *c,
+                          std::set<const MemoryObject*> &objects) const;
+    void cloneModule();
+
+  public:
+    /// Compile functions of \a module, whose globals are allocated at the
+    /// addresses of \a globalObjects, into \a executionEngine.
+    FunctionJIT(llvm::ExecutionEngine *executionEngine,
+                const llvm::Module *module,
+                const std::map<const llvm::GlobalValue*, MemoryObject*>
+                  &globalObjects);
+
+    /// Return the native code of \a f, compiling it on first use, or null
+    /// if it cannot be compiled.
+    void *getPointerToFunction(const llvm::Function *f);
+
+    /// Return the objects of the globals \a f, which can be compiled, may
+    /// access.
+    const std::vector<const MemoryObject*> &
+    getReferencedObjects(const llvm::Function *f);
+  };
+}
+
+#endif /* KLEE_FUNCTIONJIT_H */
@@ -12,9 +12,10 @@
 #include "Context.h"
 #include "klee/Expr.h"
 #include "klee/Solver.h"
-#include "klee/util/BitArray.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/util/ArrayCache.h"
+#include "klee/util/ExprSerializer.h"
+#include "klee/util/SlabAllocator.h"
 
 #include "ObjectHolder.h"
 #include "MemoryManager.h"
@@ -32,7 +33,10 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <new>
 #include <sstream>
 
 using namespace llvm;
@@ -42,6 +46,230 @@ namespace {
   cl::opt<bool>
   UseConstantArrays("use-constant-arrays",
                     cl::init(true));
+
+  cl::opt<bool>
+  CompactUpdates("compact-updates",
+                 cl::desc("Periodically drop overwritten updates of objects and fold their oldest concrete updates into a new constant array (default=on)"),
+                 cl::init(true));
+
+  /// The number of updates added since the last compaction which triggers
+  /// the next one, on top of the number of updates it left.
+  const unsigned MinUpdatesToCompact = 32;
+
+  /// The number of bytes of an object state in a page, a power of two.
+  const unsigned PageSize = 256;
+
+  /// Read the \a n byte value at \a bytes in the target byte order.
+  inline uint64_t readConcrete(const uint8_t *bytes, unsigned n) {
+    uint64_t value = 0;
+    if (Context::get().isLittleEndian()) {
+      for (unsigned i = n; i != 0; --i)
+        value = (value << 8) | bytes[i - 1];
+    } else {
+      for (unsigned i = 0; i != n; ++i)
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+  }
+
+  /// Write the \a n byte \a value to \a bytes in the target byte order.
+  inline void writeConcrete(uint8_t *bytes, unsigned n, uint64_t value) {
+    for (unsigned i = 0; i != n; ++i) {
+      unsigned idx = Context::get().isLittleEndian() ? i : (n - i - 1);
+      bytes[idx] = (uint8_t) (value >> (8 * i));
+    }
+  }
+}
+
+namespace klee {
+  /// ObjectPage - Up to PageSize bytes of the contents of an object state:
+  /// the concrete bytes, which of them are concrete and which are not
+  /// flushed to the updates, the known symbolic values and the known
+  /// symbolic words they were written as. The bytes and
+  /// the masks are allocated right after the page; the pages of fully
+  /// concrete object states have no masks.
+  class ObjectPage {
+    friend class ObjectState;
+    unsigned refCount;
+
+  public:
+    const unsigned size;
+    const bool masked;
+
+  private:
+    ref<Expr> *knownSymbolics;
+    /// The symbolic values of up to 64 bits written at an offset, as long
+    /// as none of their bytes were overwritten, so that reading them back
+    /// at their width does not reassemble their bytes.
+    ref<Expr> *knownWords;
+
+    static unsigned paddedSize(unsigned size) { return (size + 3) & ~3u; }
+    static unsigned maskWords(unsigned size) { return (size + 31) / 32; }
+    static size_t allocationSize(unsigned size, bool masked) {
+      return sizeof(ObjectPage) + paddedSize(size) +
+             (masked ? 2 * maskWords(size) * sizeof(uint32_t) : 0);
+    }
+
+    uint32_t *concreteMask() {
+      assert(masked && "page of a concrete object state has no masks");
+      return reinterpret_cast<uint32_t*>(concreteStore() + paddedSize(size));
+    }
+    const uint32_t *concreteMask() const {
+      assert(masked && "page of a concrete object state has no masks");
+      return reinterpret_cast<const uint32_t*>(concreteStore() +
+                                               paddedSize(size));
+    }
+    // XXX cleanup name of flushMask (its backwards or something)
+    uint32_t *flushMask() { return concreteMask() + maskWords(size); }
+    const uint32_t *flushMask() const {
+      return concreteMask() + maskWords(size);
+    }
+
+    static bool get(const uint32_t *bits, unsigned idx) {
+      return (bits[idx / 32] >> (idx & 0x1F)) & 1;
+    }
+    static void set(uint32_t *bits, unsigned idx) {
+      bits[idx / 32] |= 1 << (idx & 0x1F);
+    }
+    static void unset(uint32_t *bits, unsigned idx) {
+      bits[idx / 32] &= ~(1 << (idx & 0x1F));
+    }
+
+    ObjectPage(unsigned _size, bool _masked)
+      : refCount(0), size(_size), masked(_masked), knownSymbolics(0),
+        knownWords(0) {}
+
+    static ObjectPage *allocate(unsigned size, bool masked) {
+      assert(allocationSize(PageSize, true) <= SlabAllocator::MaxSize &&
+             "full pages do not fit a size class of the memory allocator");
+      return new (getMemoryAllocator().allocate(allocationSize(size, masked)))
+        ObjectPage(size, masked);
+    }
+
+    // DO NOT IMPLEMENT
+    ObjectPage(const ObjectPage &p);
+    ObjectPage &operator=(const ObjectPage &p);
+
+  public:
+    /// Create a page of \a size concrete, unflushed zero bytes, with masks
+    /// if \a masked. Pages come from the size classes of the memory
+    /// allocator.
+    static ObjectPage *create(unsigned size, bool masked) {
+      ObjectPage *p = allocate(size, masked);
+      memset(p->concreteStore(), 0, size);
+      if (masked)
+        memset(p->concreteMask(), 0xFF,
+               2 * maskWords(size) * sizeof(uint32_t));
+      return p;
+    }
+
+    ObjectPage *clone() const {
+      ObjectPage *p = allocate(size, masked);
+      memcpy(p->concreteStore(), concreteStore(),
+             allocationSize(size, masked) - sizeof(ObjectPage));
+      if (knownSymbolics) {
+        p->knownSymbolics = new ref<Expr>[size];
+        for (unsigned i = 0; i != size; ++i)
+          p->knownSymbolics[i] = knownSymbolics[i];
+      }
+      if (knownWords) {
+        p->knownWords = new ref<Expr>[size];
+        for (unsigned i = 0; i != size; ++i)
+          p->knownWords[i] = knownWords[i];
+      }
+      return p;
+    }
+
+    /// Copy the bytes of the page to a new page with masks, marking them
+    /// all concrete and unflushed, or to one without masks, dropping the
+    /// known symbolic values.
+    ObjectPage *cloneBytes(bool masked) const {
+      ObjectPage *p = allocate(size, masked);
+      memcpy(p->concreteStore(), concreteStore(), size);
+      if (masked)
+        memset(p->concreteMask(), 0xFF,
+               2 * maskWords(size) * sizeof(uint32_t));
+      return p;
+    }
+
+    void destroy() {
+      delete[] knownSymbolics;
+      delete[] knownWords;
+      size_t bytes = allocationSize(size, masked);
+      this->~ObjectPage();
+      getMemoryAllocator().deallocate(this, bytes);
+    }
+
+    uint8_t *concreteStore() { return reinterpret_cast<uint8_t*>(this + 1); }
+    const uint8_t *concreteStore() const {
+      return reinterpret_cast<const uint8_t*>(this + 1);
+    }
+
+    bool isByteConcrete(unsigned offset) const {
+      return get(concreteMask(), offset);
+    }
+    bool isConcrete() const {
+      const uint32_t *mask = concreteMask();
+      unsigned full = size / 32;
+      for (unsigned i = 0; i != full; ++i)
+        if (mask[i] != ~0u)
+          return false;
+      unsigned rest = size % 32;
+      return !rest || (~mask[full] & ((1u << rest) - 1)) == 0;
+    }
+    bool isByteFlushed(unsigned offset) const {
+      return !get(flushMask(), offset);
+    }
+    bool isByteKnownSymbolic(unsigned offset) const {
+      return knownSymbolics && knownSymbolics[offset].get();
+    }
+    const ref<Expr> &getKnownSymbolic(unsigned offset) const {
+      return knownSymbolics[offset];
+    }
+
+    void markByteConcrete(unsigned offset) { set(concreteMask(), offset); }
+    void markByteSymbolic(unsigned offset) { unset(concreteMask(), offset); }
+    void markByteFlushed(unsigned offset) { unset(flushMask(), offset); }
+    void markByteUnflushed(unsigned offset) { set(flushMask(), offset); }
+
+    const ref<Expr> *getKnownWord(unsigned offset) const {
+      return knownWords && knownWords[offset].get() ? &knownWords[offset] : 0;
+    }
+
+    /// Set the known symbolic word at \a offset, after its bytes are set.
+    void setKnownWord(unsigned offset, const ref<Expr> &value) {
+      assert(value->getWidth() <= Expr::Int64 && "invalid known word");
+      if (!knownWords)
+        knownWords = new ref<Expr>[size];
+      knownWords[offset] = value;
+    }
+
+    void clearKnownWords() {
+      delete[] knownWords;
+      knownWords = 0;
+    }
+
+    void setKnownSymbolic(unsigned offset, Expr *value /* can be null */) {
+      // Forget the words overlapping the byte.
+      if (knownWords)
+        for (unsigned i = offset < 7 ? 0 : offset - 7; i <= offset; ++i)
+          knownWords[i] = 0;
+      if (knownSymbolics) {
+        knownSymbolics[offset] = value;
+      } else if (value) {
+        knownSymbolics = new ref<Expr>[size];
+        knownSymbolics[offset] = value;
+      }
+    }
+
+    /// Mark all bytes symbolic and flushed.
+    void makeSymbolic() {
+      memset(concreteMask(), 0, 2 * maskWords(size) * sizeof(uint32_t));
+      delete[] knownSymbolics;
+      knownSymbolics = 0;
+      clearKnownWords();
+    }
+  };
 }
 
 /***/
@@ -74,6 +302,14 @@ MemoryObject::~MemoryObject() {
     parent->markFreed(this);
 }
 
+void *MemoryObject::operator new(size_t size) {
+  return getMemoryAllocator().allocate(size);
+}
+
+void MemoryObject::operator delete(void *p, size_t size) {
+  getMemoryAllocator().deallocate(p, size);
+}
+
 void MemoryObject::getAllocInfo(std::string &result) const {
   llvm::raw_string_ostream info(result);
 
@@ -102,11 +338,10 @@ ObjectState::ObjectState(const MemoryObject *mo)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
-    concreteMask(0),
-    flushMask(0),
-    knownSymbolics(0),
+    pages((mo->size + PageSize - 1) / PageSize),
     updates(0, 0),
+    compactedUpdates(0),
+    concrete(true),
     size(mo->size),
     readOnly(false) {
   mo->refCount++;
@@ -116,7 +351,11 @@ ObjectState::ObjectState(const MemoryObject *mo)
         getArrayCache()->CreateArray("tmp_arr" + llvm::utostr(++id), size);
     updates = UpdateList(array, 0);
   }
-  memset(concreteStore, 0, size);
+  for (unsigned i = 0, e = pages.size(); i != e; ++i) {
+    pages[i] = ObjectPage::create(std::min(PageSize, size - i * PageSize),
+                                  /*masked=*/false);
+    ++pages[i]->refCount;
+  }
 }
 
 
@@ -124,47 +363,109 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
-    concreteMask(0),
-    flushMask(0),
-    knownSymbolics(0),
+    pages((mo->size + PageSize - 1) / PageSize),
     updates(array, 0),
+    compactedUpdates(0),
+    concrete(false),
     size(mo->size),
     readOnly(false) {
   mo->refCount++;
+  for (unsigned i = 0, e = pages.size(); i != e; ++i) {
+    pages[i] = ObjectPage::create(std::min(PageSize, size - i * PageSize),
+                                  /*masked=*/true);
+    ++pages[i]->refCount;
+  }
   makeSymbolic();
-  memset(concreteStore, 0, size);
 }
 
 ObjectState::ObjectState(const ObjectState &os) 
   : copyOnWriteOwner(0),
     refCount(0),
     object(os.object),
-    concreteStore(new uint8_t[os.size]),
-    concreteMask(os.concreteMask ? new BitArray(*os.concreteMask, os.size) : 0),
-    flushMask(os.flushMask ? new BitArray(*os.flushMask, os.size) : 0),
-    knownSymbolics(0),
+    pages(os.pages),
     updates(os.updates),
+    compactedUpdates(os.compactedUpdates),
+    concrete(os.concrete),
     size(os.size),
     readOnly(false) {
   assert(!os.readOnly && "no need to copy read only object?");
   if (object)
     object->refCount++;
 
-  if (os.knownSymbolics) {
-    knownSymbolics = new ref<Expr>[size];
-    for (unsigned i=0; i<size; i++)
-      knownSymbolics[i] = os.knownSymbolics[i];
+  // The pages are copied on the first write to them.
+  for (unsigned i = 0, e = pages.size(); i != e; ++i)
+    ++pages[i]->refCount;
+}
+
+ObjectState::ObjectState(const MemoryObject *mo, ExprDeserializer &d)
+  : copyOnWriteOwner(0),
+    refCount(0),
+    object(mo),
+    pages((mo->size + PageSize - 1) / PageSize),
+    updates(0, 0),
+    compactedUpdates(0),
+    concrete(false),
+    size(mo->size),
+    readOnly(false) {
+  mo->refCount++;
+  readOnly = d.readU8();
+  concrete = d.readU8();
+  compactedUpdates = d.readU32();
+  updates = d.readUpdateList();
+  for (unsigned i = 0, e = pages.size(); i != e; ++i) {
+    ObjectPage *page =
+      ObjectPage::create(std::min(PageSize, size - i * PageSize), !concrete);
+    pages[i] = page;
+    ++page->refCount;
+    uint8_t *bytes = page->concreteStore();
+    for (unsigned j = 0; j != page->size; ++j)
+      bytes[j] = d.readU8();
+    if (concrete)
+      continue;
+    uint32_t *masks = page->concreteMask();
+    for (unsigned j = 0, n = 2 * ObjectPage::maskWords(page->size); j != n;
+         ++j)
+      masks[j] = d.readU32();
+    for (unsigned j = 0, n = d.readU32(); j != n; ++j) {
+      unsigned offset = d.readU32();
+      page->setKnownSymbolic(offset, d.readExpr().get());
+    }
   }
+}
 
-  memcpy(concreteStore, os.concreteStore, size*sizeof(*concreteStore));
+void ObjectState::serialize(ExprSerializer &s) const {
+  s.writeU8(readOnly);
+  s.writeU8(concrete);
+  s.writeU32(compactedUpdates);
+  s.write(updates);
+  for (unsigned i = 0, e = pages.size(); i != e; ++i) {
+    const ObjectPage *page = pages[i];
+    const uint8_t *bytes = page->concreteStore();
+    for (unsigned j = 0; j != page->size; ++j)
+      s.writeU8(bytes[j]);
+    if (concrete)
+      continue;
+    const uint32_t *masks = page->concreteMask();
+    for (unsigned j = 0, n = 2 * ObjectPage::maskWords(page->size); j != n;
+         ++j)
+      s.writeU32(masks[j]);
+    unsigned numKnown = 0;
+    for (unsigned j = 0; j != page->size; ++j)
+      numKnown += page->isByteKnownSymbolic(j);
+    s.writeU32(numKnown);
+    for (unsigned j = 0; numKnown && j != page->size; ++j) {
+      if (page->isByteKnownSymbolic(j)) {
+        s.writeU32(j);
+        s.write(page->getKnownSymbolic(j));
+      }
+    }
+  }
 }
 
 ObjectState::~ObjectState() {
-  if (concreteMask) delete concreteMask;
-  if (flushMask) delete flushMask;
-  if (knownSymbolics) delete[] knownSymbolics;
-  delete[] concreteStore;
+  for (unsigned i = 0, e = pages.size(); i != e; ++i)
+    if (--pages[i]->refCount == 0)
+      pages[i]->destroy();
 
   if (object)
   {
@@ -177,6 +478,37 @@ ObjectState::~ObjectState() {
   }
 }
 
+void *ObjectState::operator new(size_t size) {
+  return getMemoryAllocator().allocate(size);
+}
+
+void ObjectState::operator delete(void *p, size_t size) {
+  getMemoryAllocator().deallocate(p, size);
+}
+
+ObjectPage *ObjectState::getWriteablePage(unsigned offset) const {
+  ObjectPage *&page = pages[offset / PageSize];
+  if (page->refCount > 1) {
+    --page->refCount;
+    page = page->clone();
+    ++page->refCount;
+  }
+  return page;
+}
+
+void ObjectState::addMasks() const {
+  if (!concrete)
+    return;
+  for (unsigned i = 0, e = pages.size(); i != e; ++i) {
+    ObjectPage *page = pages[i]->cloneBytes(/*masked=*/true);
+    if (--pages[i]->refCount == 0)
+      pages[i]->destroy();
+    pages[i] = page;
+    ++page->refCount;
+  }
+  concrete = false;
+}
+
 ArrayCache *ObjectState::getArrayCache() const {
   assert(object && "object was NULL");
   return object->parent->getArrayCache();
@@ -221,54 +553,148 @@ const UpdateList &ObjectState::getUpdates() const {
       Contents[Index->getZExtValue()] = Value;
     }
 
-    static unsigned id = 0;
-    const Array *array = getArrayCache()->CreateArray(
-        "const_arr" + llvm::utostr(++id), size, &Contents[0],
-        &Contents[0] + Contents.size());
-    updates = UpdateList(array, 0);
+    updates = UpdateList(createConstantArray(Contents), 0);
 
     // Apply the remaining (non-constant) writes.
     for (; Begin != End; ++Begin)
       updates.extend(Writes[Begin].first, Writes[Begin].second);
   }
 
+  if (CompactUpdates &&
+      updates.getSize() >= 2 * compactedUpdates + MinUpdatesToCompact)
+    compactUpdates();
+
   return updates;
 }
 
+const Array *ObjectState::createConstantArray(
+    const std::vector< ref<ConstantExpr> > &contents) const {
+  static unsigned id = 0;
+  return getArrayCache()->CreateArray("const_arr" + llvm::utostr(++id), size,
+                                      &contents[0],
+                                      &contents[0] + contents.size());
+}
+
+void ObjectState::compactUpdates() const {
+  // Collect the live updates, newest first. An update at a constant offset
+  // is dead once a newer update at the same offset exists, whatever the
+  // updates in between.
+  std::vector<const UpdateNode*> live;
+  std::vector<bool> overwritten(size);
+  for (const UpdateNode *un = updates.head; un; un = un->next) {
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(un->index)) {
+      uint64_t offset = CE->getZExtValue();
+      if (offset < size) {
+        if (overwritten[offset])
+          continue;
+        overwritten[offset] = true;
+      }
+    }
+    live.push_back(un);
+  }
+
+  // Fold the oldest concrete updates into a new constant array, if there
+  // are enough of them to pay for the copy of the contents.
+  const Array *root = updates.root;
+  unsigned end = live.size();
+  if (root->isConstantArray()) {
+    unsigned begin = end;
+    for (; begin != 0; --begin) {
+      ConstantExpr *Index = dyn_cast<ConstantExpr>(live[begin - 1]->index);
+      if (!Index || Index->getZExtValue() >= size ||
+          !isa<ConstantExpr>(live[begin - 1]->value))
+        break;
+    }
+    if (begin != end && 4 * (end - begin) >= size) {
+      std::vector< ref<ConstantExpr> > Contents(root->constantValues);
+      for (unsigned i = end; i != begin; --i)
+        Contents[cast<ConstantExpr>(live[i - 1]->index)->getZExtValue()] =
+          cast<ConstantExpr>(live[i - 1]->value);
+      root = createConstantArray(Contents);
+      end = begin;
+    }
+  }
+
+  if (root != updates.root || end != updates.getSize()) {
+    UpdateList compacted(root, 0);
+    for (unsigned i = end; i != 0; --i)
+      compacted.extend(live[i - 1]->index, live[i - 1]->value);
+    updates = compacted;
+  }
+  compactedUpdates = updates.getSize();
+}
+
 void ObjectState::makeConcrete() {
-  if (concreteMask) delete concreteMask;
-  if (flushMask) delete flushMask;
-  if (knownSymbolics) delete[] knownSymbolics;
-  concreteMask = 0;
-  flushMask = 0;
-  knownSymbolics = 0;
+  // All bytes become concrete and unflushed, so the updates will be
+  // overwritten by the next flush and the masks can go.
+  if (concrete)
+    return;
+  for (unsigned i = 0, e = pages.size(); i != e; ++i) {
+    ObjectPage *page = pages[i]->cloneBytes(/*masked=*/false);
+    if (--pages[i]->refCount == 0)
+      pages[i]->destroy();
+    pages[i] = page;
+    ++page->refCount;
+  }
+  concrete = true;
 }
 
 void ObjectState::makeSymbolic() {
   assert(!updates.head &&
          "XXX makeSymbolic of objects with symbolic values is unsupported");
 
-  // XXX simplify this, can just delete various arrays I guess
-  for (unsigned i=0; i<size; i++) {
-    markByteSymbolic(i);
-    setKnownSymbolic(i, 0);
-    markByteFlushed(i);
-  }
+  addMasks();
+
+  for (unsigned i = 0, e = pages.size(); i != e; ++i)
+    getWriteablePage(i * PageSize)->makeSymbolic();
 }
 
 void ObjectState::initializeToZero() {
   makeConcrete();
-  memset(concreteStore, 0, size);
+  for (unsigned i = 0, e = pages.size(); i != e; ++i)
+    memset(getWriteablePage(i * PageSize)->concreteStore(), 0,
+           pages[i]->size);
 }
 
 void ObjectState::initializeToRandom() {  
   makeConcrete();
-  for (unsigned i=0; i<size; i++) {
+  for (unsigned i = 0, e = pages.size(); i != e; ++i) {
     // randomly selected by 256 sided die
-    concreteStore[i] = 0xAB;
+    memset(getWriteablePage(i * PageSize)->concreteStore(), 0xAB,
+           pages[i]->size);
   }
 }
 
+void ObjectState::copyConcretesOut(uint8_t *address) const {
+  for (unsigned i = 0, e = pages.size(); i != e; ++i)
+    memcpy(address + i * PageSize, pages[i]->concreteStore(), pages[i]->size);
+}
+
+bool ObjectState::isConcrete() const {
+  if (concrete)
+    return true;
+  for (unsigned i = 0, e = pages.size(); i != e; ++i)
+    if (!pages[i]->isConcrete())
+      return false;
+  return true;
+}
+
+bool ObjectState::concretesDiffer(const uint8_t *address) const {
+  for (unsigned i = 0, e = pages.size(); i != e; ++i)
+    if (memcmp(address + i * PageSize, pages[i]->concreteStore(),
+               pages[i]->size) != 0)
+      return true;
+  return false;
+}
+
+void ObjectState::copyConcretesIn(const uint8_t *address) {
+  for (unsigned i = 0, e = pages.size(); i != e; ++i)
+    if (memcmp(address + i * PageSize, pages[i]->concreteStore(),
+               pages[i]->size) != 0)
+      memcpy(getWriteablePage(i * PageSize)->concreteStore(),
+             address + i * PageSize, pages[i]->size);
+}
+
 /*
 Cache Invariants
 --
@@ -286,42 +712,52 @@ void ObjectState::fastRangeCheckOffset(ref<Expr> offset,
 
 void ObjectState::flushRangeForRead(unsigned rangeBase, 
                                     unsigned rangeSize) const {
-  if (!flushMask) flushMask = new BitArray(size, true);
- 
   for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
     if (!isByteFlushed(offset)) {
-      if (isByteConcrete(offset)) {
+      const ObjectPage *page = pages[offset / PageSize];
+      unsigned pageOffset = offset % PageSize;
+      if (page->isByteConcrete(pageOffset)) {
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(concreteStore[offset], Expr::Int8));
+                       ConstantExpr::create(page->concreteStore()[pageOffset],
+                                            Expr::Int8));
       } else {
-        assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
+        assert(page->isByteKnownSymbolic(pageOffset) &&
+               "invalid bit set in flushMask");
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
+                       page->getKnownSymbolic(pageOffset));
       }
 
-      flushMask->unset(offset);
+      getWriteablePage(offset)->markByteFlushed(pageOffset);
     }
   } 
 }
 
 void ObjectState::flushRangeForWrite(unsigned rangeBase, 
                                      unsigned rangeSize) {
-  if (!flushMask) flushMask = new BitArray(size, true);
+  // The bytes are about to be overwritten at a symbolic offset.
+  for (unsigned i = rangeBase / PageSize,
+         e = (rangeBase + rangeSize + PageSize - 1) / PageSize; i < e; ++i)
+    if (pages[i]->knownWords)
+      getWriteablePage(i * PageSize)->clearKnownWords();
 
   for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
     if (!isByteFlushed(offset)) {
-      if (isByteConcrete(offset)) {
+      const ObjectPage *page = pages[offset / PageSize];
+      unsigned pageOffset = offset % PageSize;
+      if (page->isByteConcrete(pageOffset)) {
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(concreteStore[offset], Expr::Int8));
+                       ConstantExpr::create(page->concreteStore()[pageOffset],
+                                            Expr::Int8));
         markByteSymbolic(offset);
       } else {
-        assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
+        assert(page->isByteKnownSymbolic(pageOffset) &&
+               "invalid bit set in flushMask");
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
+                       page->getKnownSymbolic(pageOffset));
         setKnownSymbolic(offset, 0);
       }
 
-      flushMask->unset(offset);
+      markByteFlushed(offset);
     } else {
       // flushed bytes that are written over still need
       // to be marked out
@@ -335,62 +771,61 @@ void ObjectState::flushRangeForWrite(unsigned rangeBase,
 }
 
 bool ObjectState::isByteConcrete(unsigned offset) const {
-  return !concreteMask || concreteMask->get(offset);
+  if (concrete)
+    return true;
+  return pages[offset / PageSize]->isByteConcrete(offset % PageSize);
 }
 
 bool ObjectState::isByteFlushed(unsigned offset) const {
-  return flushMask && !flushMask->get(offset);
+  if (concrete)
+    return false;
+  return pages[offset / PageSize]->isByteFlushed(offset % PageSize);
 }
 
 bool ObjectState::isByteKnownSymbolic(unsigned offset) const {
-  return knownSymbolics && knownSymbolics[offset].get();
+  if (concrete)
+    return false;
+  return pages[offset / PageSize]->isByteKnownSymbolic(offset % PageSize);
 }
 
 void ObjectState::markByteConcrete(unsigned offset) {
-  if (concreteMask)
-    concreteMask->set(offset);
+  if (!isByteConcrete(offset))
+    getWriteablePage(offset)->markByteConcrete(offset % PageSize);
 }
 
 void ObjectState::markByteSymbolic(unsigned offset) {
-  if (!concreteMask)
-    concreteMask = new BitArray(size, true);
-  concreteMask->unset(offset);
+  if (isByteConcrete(offset))
+    getWriteablePage(offset)->markByteSymbolic(offset % PageSize);
 }
 
 void ObjectState::markByteUnflushed(unsigned offset) {
-  if (flushMask)
-    flushMask->set(offset);
+  if (isByteFlushed(offset))
+    getWriteablePage(offset)->markByteUnflushed(offset % PageSize);
 }
 
 void ObjectState::markByteFlushed(unsigned offset) {
-  if (!flushMask) {
-    flushMask = new BitArray(size, false);
-  } else {
-    flushMask->unset(offset);
-  }
+  if (!isByteFlushed(offset))
+    getWriteablePage(offset)->markByteFlushed(offset % PageSize);
 }
 
 void ObjectState::setKnownSymbolic(unsigned offset, 
                                    Expr *value /* can be null */) {
-  if (knownSymbolics) {
-    knownSymbolics[offset] = value;
-  } else {
-    if (value) {
-      knownSymbolics = new ref<Expr>[size];
-      knownSymbolics[offset] = value;
-    }
-  }
+  if (value || isByteKnownSymbolic(offset))
+    getWriteablePage(offset)->setKnownSymbolic(offset % PageSize, value);
 }
 
 /***/
 
 ref<Expr> ObjectState::read8(unsigned offset) const {
-  if (isByteConcrete(offset)) {
-    return ConstantExpr::create(concreteStore[offset], Expr::Int8);
-  } else if (isByteKnownSymbolic(offset)) {
-    return knownSymbolics[offset];
+  const ObjectPage *page = pages[offset / PageSize];
+  unsigned pageOffset = offset % PageSize;
+  if (concrete || page->isByteConcrete(pageOffset)) {
+    return ConstantExpr::create(page->concreteStore()[pageOffset], Expr::Int8);
+  } else if (page->isByteKnownSymbolic(pageOffset)) {
+    return page->getKnownSymbolic(pageOffset);
   } else {
-    assert(isByteFlushed(offset) && "unflushed byte without cache value");
+    assert(page->isByteFlushed(pageOffset) &&
+           "unflushed byte without cache value");
     
     return ReadExpr::create(getUpdates(), 
                             ConstantExpr::create(offset, Expr::Int32));
@@ -399,6 +834,7 @@ ref<Expr> ObjectState::read8(unsigned offset) const {
 
 ref<Expr> ObjectState::read8(ref<Expr> offset) const {
   assert(!isa<ConstantExpr>(offset) && "constant offset passed to symbolic read8");
+  addMasks();
   unsigned base, size;
   fastRangeCheckOffset(offset, &base, &size);
   flushRangeForRead(base, size);
@@ -416,11 +852,15 @@ ref<Expr> ObjectState::read8(ref<Expr> offset) const {
 
 void ObjectState::write8(unsigned offset, uint8_t value) {
   //assert(read_only == false && "writing to read-only object!");
-  concreteStore[offset] = value;
-  setKnownSymbolic(offset, 0);
+  ObjectPage *page = getWriteablePage(offset);
+  unsigned pageOffset = offset % PageSize;
+  page->concreteStore()[pageOffset] = value;
+  if (concrete)
+    return;
+  page->setKnownSymbolic(pageOffset, 0);
 
-  markByteConcrete(offset);
-  markByteUnflushed(offset);
+  page->markByteConcrete(pageOffset);
+  page->markByteUnflushed(pageOffset);
 }
 
 void ObjectState::write8(unsigned offset, ref<Expr> value) {
@@ -428,15 +868,19 @@ void ObjectState::write8(unsigned offset, ref<Expr> value) {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
     write8(offset, (uint8_t) CE->getZExtValue(8));
   } else {
-    setKnownSymbolic(offset, value.get());
+    addMasks();
+    ObjectPage *page = getWriteablePage(offset);
+    unsigned pageOffset = offset % PageSize;
+    page->setKnownSymbolic(pageOffset, value.get());
       
-    markByteSymbolic(offset);
-    markByteUnflushed(offset);
+    page->markByteSymbolic(pageOffset);
+    page->markByteUnflushed(pageOffset);
   }
 }
 
 void ObjectState::write8(ref<Expr> offset, ref<Expr> value) {
   assert(!isa<ConstantExpr>(offset) && "constant offset passed to symbolic write8");
+  addMasks();
   unsigned base, size;
   fastRangeCheckOffset(offset, &base, &size);
   flushRangeForWrite(base, size);
@@ -486,9 +930,25 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
-  // Otherwise, follow the slow general case.
   unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid width for read size!");
+
+  // Read words of concrete objects directly from the page.
+  unsigned pageOffset = offset % PageSize;
+  if (concrete && width <= Expr::Int64 && pageOffset + NumBytes <= PageSize)
+    return ConstantExpr::create(
+        readConcrete(pages[offset / PageSize]->concreteStore() + pageOffset,
+                     NumBytes),
+        width);
+
+  // Return symbolic words read back at their width intact.
+  if (!concrete && NumBytes > 1 && pageOffset + NumBytes <= PageSize)
+    if (const ref<Expr> *word =
+          pages[offset / PageSize]->getKnownWord(pageOffset))
+      if ((*word)->getWidth() == width)
+        return *word;
+
+  // Otherwise, follow the slow general case.
   ref<Expr> Res(0);
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
@@ -557,10 +1017,20 @@ void ObjectState::write(unsigned offset, ref<Expr> value) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
     write8(offset + idx, ExtractExpr::create(value, 8 * i, Expr::Int8));
   }
-} 
+
+  // Remember the word, to return it intact when it is read back.
+  if (!concrete && NumBytes > 1 && w <= Expr::Int64 &&
+      offset % PageSize + NumBytes <= PageSize)
+    getWriteablePage(offset)->setKnownWord(offset % PageSize, value);
+}
 
 void ObjectState::write16(unsigned offset, uint16_t value) {
   unsigned NumBytes = 2;
+  if (concrete && offset % PageSize + NumBytes <= PageSize) {
+    writeConcrete(getWriteablePage(offset)->concreteStore() +
+                  offset % PageSize, NumBytes, value);
+    return;
+  }
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
     write8(offset + idx, (uint8_t) (value >> (8 * i)));
@@ -569,6 +1039,11 @@ void ObjectState::write16(unsigned offset, uint16_t value) {
 
 void ObjectState::write32(unsigned offset, uint32_t value) {
   unsigned NumBytes = 4;
+  if (concrete && offset % PageSize + NumBytes <= PageSize) {
+    writeConcrete(getWriteablePage(offset)->concreteStore() +
+                  offset % PageSize, NumBytes, value);
+    return;
+  }
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
     write8(offset + idx, (uint8_t) (value >> (8 * i)));
@@ -577,6 +1052,11 @@ void ObjectState::write32(unsigned offset, uint32_t value) {
 
 void ObjectState::write64(unsigned offset, uint64_t value) {
   unsigned NumBytes = 8;
+  if (concrete && offset % PageSize + NumBytes <= PageSize) {
+    writeConcrete(getWriteablePage(offset)->concreteStore() +
+                  offset % PageSize, NumBytes, value);
+    return;
+  }
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
     write8(offset + idx, (uint8_t) (value >> (8 * i)));
@@ -24,15 +24,18 @@ namespace llvm {
 
 namespace klee {
 
-class BitArray;
 class MemoryManager;
+class ObjectPage;
 class Solver;
 class ArrayCache;
+class ExprDeserializer;
+class ExprSerializer;
 
 class MemoryObject {
   friend class STPBuilder;
   friend class ObjectState;
   friend class ExecutionState;
+  template<class T> friend class ref;
 
 private:
   static int counter;
@@ -104,6 +107,10 @@ public:
 
   ~MemoryObject();
 
+  /// Memory objects are allocated from slabs, see getMemoryAllocator().
+  static void *operator new(size_t size);
+  static void operator delete(void *p, size_t size);
+
   /// Get an identifying string for this allocation.
   void getAllocInfo(std::string &result) const;
 
@@ -152,22 +159,28 @@ private:
   unsigned copyOnWriteOwner; // exclusively for AddressSpace
 
   friend class ObjectHolder;
+  friend class StateSwapper;
   unsigned refCount;
 
   const MemoryObject *object;
 
-  uint8_t *concreteStore;
-  // XXX cleanup name of flushMask (its backwards or something)
-  BitArray *concreteMask;
-
+  /// The concrete bytes, their concrete and flush masks and the known
+  /// symbolic values, in pages shared with the copies of this object state
+  /// and copied on the first write.
   // mutable because may need flushed during read of const
-  mutable BitArray *flushMask;
-
-  ref<Expr> *knownSymbolics;
+  mutable std::vector<ObjectPage*> pages;
 
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  /// The number of updates left by the last compaction of the updates.
+  mutable unsigned compactedUpdates;
+
+  /// Whether all bytes are concrete and unflushed, in which case the pages
+  /// have no masks and the updates are stale. Cleared on the first symbolic
+  /// write or read or write at a symbolic offset.
+  mutable bool concrete;
+
 public:
   unsigned size;
 
@@ -184,8 +197,17 @@ public:
   ObjectState(const MemoryObject *mo, const Array *array);
 
   ObjectState(const ObjectState &os);
+
+  /// Create a new object state for the given memory object with the
+  /// contents written by serialize().
+  ObjectState(const MemoryObject *mo, ExprDeserializer &d);
+
   ~ObjectState();
 
+  /// Object states are allocated from slabs, see getMemoryAllocator().
+  static void *operator new(size_t size);
+  static void operator delete(void *p, size_t size);
+
   const MemoryObject *getObject() const { return object; }
 
   void setReadOnly(bool ro) { readOnly = ro; }
@@ -208,8 +230,31 @@ public:
   void write32(unsigned offset, uint32_t value);
   void write64(unsigned offset, uint64_t value);
 
+  /// Whether no byte is symbolic, so that the concrete bytes are the
+  /// complete contents.
+  bool isConcrete() const;
+
+  /// Copy the concrete bytes to \a address, see
+  /// AddressSpace::copyOutConcretes().
+  void copyConcretesOut(uint8_t *address) const;
+  /// Whether the concrete bytes differ from those at \a address.
+  bool concretesDiffer(const uint8_t *address) const;
+  /// Overwrite the concrete bytes with those at \a address, copying only the
+  /// pages that differ.
+  void copyConcretesIn(const uint8_t *address);
+
+  /// Append the contents, except for the memory object, to \a s.
+  void serialize(ExprSerializer &s) const;
+
 private:
+  ObjectPage *getWriteablePage(unsigned offset) const;
+  /// Move a concrete object state to the general representation.
+  void addMasks() const;
+
   const UpdateList &getUpdates() const;
+  const Array *createConstantArray(
+    const std::vector< ref<ConstantExpr> > &contents) const;
+  void compactUpdates() const;
 
   void makeConcrete();
 
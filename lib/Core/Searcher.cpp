@@ -349,6 +349,8 @@ entry:
       statesAtMerge.insert(std::make_pair(mp, &es));
     } else {
       ExecutionState *mergeWith = it->second;
+      executor.swapInState(*mergeWith);
+      executor.swapInState(es);
       if (mergeWith->merge(es)) {
         // hack, because we are terminating the state we need to let
         // the baseSearcher know about it again
@@ -442,11 +444,13 @@ ExecutionState &MergingSearcher::selectState() {
     while (!toMerge.empty()) {
       ExecutionState *base = *toMerge.begin();
       toMerge.erase(toMerge.begin());
+      executor.swapInState(*base);
       
       std::set<ExecutionState*> toErase;
       for (std::set<ExecutionState*>::iterator it = toMerge.begin(),
              ie = toMerge.end(); it != ie; ++it) {
         ExecutionState *mergeWith = *it;
+        executor.swapInState(*mergeWith);
         
         if (base->merge(*mergeWith)) {
           toErase.insert(mergeWith);
@@ -0,0 +1,268 @@
+//===-- StateSwapper.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "StateSwapper.h"
+
+#include "AddressSpace.h"
+#include "Memory.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Internal/Module/Cell.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/util/ExprSerializer.h"
+
+#include <cassert>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+  enum CellTag {
+    CellNull,
+    CellImmediate,
+    CellExpr
+  };
+
+  void writeCell(ExprSerializer &s, const Cell &c) {
+    if (c.isNull()) {
+      s.writeU8(CellNull);
+    } else if (c.isImmediate()) {
+      s.writeU8(CellImmediate);
+      s.writeU32(c.getWidth());
+      s.writeU64(c.getImmediate());
+    } else {
+      s.writeU8(CellExpr);
+      s.write(c.getValue());
+    }
+  }
+
+  void readCell(ExprDeserializer &d, Cell &c) {
+    switch (d.readU8()) {
+    case CellNull:
+      c = Cell();
+      break;
+    case CellImmediate: {
+      Expr::Width w = d.readU32();
+      c.setImmediate(d.readU64(), w);
+      break;
+    }
+    case CellExpr:
+      c.setValue(d.readExpr());
+      break;
+    default:
+      assert(0 && "invalid register in swapped out state");
+    }
+  }
+
+  bool writeAll(int fd, const unsigned char *data, size_t size,
+                uint64_t offset) {
+    while (size) {
+      ssize_t n = pwrite(fd, data, size, offset);
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+      data += n;
+      size -= n;
+      offset += n;
+    }
+    return true;
+  }
+
+  bool readAll(int fd, unsigned char *data, size_t size, uint64_t offset) {
+    while (size) {
+      ssize_t n = pread(fd, data, size, offset);
+      if (n <= 0) {
+        if (n < 0 && errno == EINTR)
+          continue;
+        return false;
+      }
+      data += n;
+      size -= n;
+      offset += n;
+    }
+    return true;
+  }
+}
+
+/***/
+
+StateSwapper::StateSwapper(const std::string &_path, ArrayCache &_arrayCache)
+  : path(_path), arrayCache(_arrayCache), fileSize(0) {
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    klee_warning("unable to open state swap file %s: %s", path.c_str(),
+                 strerror(errno));
+}
+
+StateSwapper::~StateSwapper() {
+  if (fd >= 0) {
+    close(fd);
+    unlink(path.c_str());
+  }
+}
+
+uint64_t StateSwapper::allocate(uint64_t size) {
+  for (std::map<uint64_t, uint64_t>::iterator it = freeExtents.begin(),
+         ie = freeExtents.end(); it != ie; ++it) {
+    if (it->second < size)
+      continue;
+    uint64_t offset = it->first, rest = it->second - size;
+    freeExtents.erase(it);
+    if (rest)
+      freeExtents[offset + size] = rest;
+    return offset;
+  }
+
+  uint64_t offset = fileSize;
+  fileSize += size;
+  return offset;
+}
+
+void StateSwapper::release(uint64_t offset, uint64_t size) {
+  std::map<uint64_t, uint64_t>::iterator next =
+    freeExtents.lower_bound(offset);
+  if (next != freeExtents.end() && offset + size == next->first) {
+    size += next->second;
+    freeExtents.erase(next++);
+  }
+  if (next != freeExtents.begin()) {
+    std::map<uint64_t, uint64_t>::iterator prev = next;
+    --prev;
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      size += prev->second;
+      freeExtents.erase(prev);
+    }
+  }
+
+  // Give free space at the end back to the file system.
+  if (offset + size == fileSize && ftruncate(fd, offset) == 0) {
+    fileSize = offset;
+    return;
+  }
+  freeExtents[offset] = size;
+}
+
+bool StateSwapper::swapOut(ExecutionState &state) {
+  assert(!isSwappedOut(state) && "state is already swapped out");
+  if (fd < 0)
+    return false;
+
+  std::vector<unsigned char> data;
+  ExprSerializer s(data, /*anonymousArrays=*/false, /*arraysByAddress=*/true);
+
+  s.writeU32(state.constraints.size());
+  for (ConstraintManager::const_iterator it = state.constraints.begin(),
+         ie = state.constraints.end(); it != ie; ++it)
+    s.write(*it);
+
+  for (ExecutionState::stack_ty::const_iterator it = state.stack.begin(),
+         ie = state.stack.end(); it != ie; ++it) {
+    // Registers shared with other frames would not be freed.
+    bool shared = it->sharesLocals();
+    s.writeU8(!shared);
+    if (shared)
+      continue;
+    const Cell *locals = it->getLocals();
+    for (unsigned i = 0, e = it->kf->numRegisters; i != e; ++i)
+      writeCell(s, locals[i]);
+  }
+
+  // Likewise, only the object states no other address space refers to are
+  // written out.
+  std::vector<ObjectPair> objects;
+  for (MemoryMap::iterator it = state.addressSpace.objects.begin(),
+         ie = state.addressSpace.objects.end(); it != ie; ++it) {
+    const ObjectState *os = it->second;
+    if (os->refCount == 1)
+      objects.push_back(ObjectPair(it->first, os));
+  }
+  s.writeU32(objects.size());
+  for (unsigned i = 0, e = objects.size(); i != e; ++i) {
+    s.writeU64(reinterpret_cast<uintptr_t>(objects[i].first));
+    objects[i].second->serialize(s);
+  }
+
+  uint64_t offset = allocate(data.size());
+  if (!writeAll(fd, &data[0], data.size(), offset)) {
+    klee_warning("unable to write state swap file %s: %s", path.c_str(),
+                 strerror(errno));
+    release(offset, data.size());
+    return false;
+  }
+
+  Record &record = swapped[&state];
+  record.offset = offset;
+  record.size = data.size();
+
+  state.constraints = ConstraintManager();
+  for (ExecutionState::stack_ty::iterator it = state.stack.begin(),
+         ie = state.stack.end(); it != ie; ++it) {
+    if (it->sharesLocals())
+      continue;
+    Cell *locals = it->getWriteableLocals();
+    for (unsigned i = 0, e = it->kf->numRegisters; i != e; ++i)
+      locals[i] = Cell();
+  }
+  for (unsigned i = 0, e = objects.size(); i != e; ++i) {
+    record.objects.push_back(objects[i].first);
+    state.addressSpace.unbindObject(objects[i].first);
+  }
+  return true;
+}
+
+void StateSwapper::swapIn(ExecutionState &state) {
+  std::map<const ExecutionState*, Record>::iterator it = swapped.find(&state);
+  assert(it != swapped.end() && "state is not swapped out");
+  Record &record = it->second;
+
+  std::vector<unsigned char> data(record.size);
+  if (!readAll(fd, &data[0], data.size(), record.offset))
+    klee_error("unable to read state swap file %s: %s", path.c_str(),
+               strerror(errno));
+  ExprDeserializer d(&data[0], &data[0] + data.size(), arrayCache);
+
+  std::vector< ref<Expr> > constraints(d.readU32());
+  for (unsigned i = 0, e = constraints.size(); i != e; ++i)
+    constraints[i] = d.readExpr();
+  state.constraints = ConstraintManager(constraints);
+
+  for (ExecutionState::stack_ty::iterator sf = state.stack.begin(),
+         se = state.stack.end(); sf != se; ++sf) {
+    if (!d.readU8())
+      continue;
+    Cell *locals = sf->getWriteableLocals();
+    for (unsigned i = 0, e = sf->kf->numRegisters; i != e; ++i)
+      readCell(d, locals[i]);
+  }
+
+  for (unsigned i = 0, e = d.readU32(); i != e; ++i) {
+    uintptr_t address = d.readU64();
+    const MemoryObject *mo = reinterpret_cast<const MemoryObject*>(address);
+    state.addressSpace.bindObject(mo, new ObjectState(mo, d));
+  }
+  assert(d.atEnd() && "swapped out state not fully read");
+
+  release(record.offset, record.size);
+  swapped.erase(it);
+}
+
+void StateSwapper::discard(const ExecutionState &state) {
+  std::map<const ExecutionState*, Record>::iterator it = swapped.find(&state);
+  if (it == swapped.end())
+    return;
+  release(it->second.offset, it->second.size);
+  swapped.erase(it);
+}
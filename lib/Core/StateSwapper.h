@@ -0,0 +1,95 @@
+//===-- StateSwapper.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATESWAPPER_H
+#define KLEE_STATESWAPPER_H
+
+#include "klee/util/Ref.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace klee {
+  class ArrayCache;
+  class ExecutionState;
+  class MemoryObject;
+
+  /// StateSwapper - Moves the contents of idle states to a spill file, to
+  /// bound memory usage without terminating states.
+  ///
+  /// A swapped out state stays in the searcher as a stub, which keeps its
+  /// control flow, statistics and path information, so searchers can still
+  /// weigh it. Its constraints, the registers its frames do not share with
+  /// other frames, and the object states its address space alone refers to
+  /// are written to the file and dropped; object states shared with other
+  /// states are kept, since dropping them would not free them. The state
+  /// must be swapped back in before it is executed or its contents are
+  /// otherwise accessed.
+  ///
+  /// The space of states swapped back in or discarded is reused for later
+  /// states, first fit, and free space at the end of the file is truncated
+  /// away, so the file stays about as large as the states it holds.
+  ///
+  /// Expressions are written with ExprSerializer, sharing nodes within a
+  /// state and referring to arrays by address, so that swapping a state back
+  /// in yields the same arrays and, through hash consing, shares the nodes
+  /// with the expressions still in memory.
+  class StateSwapper {
+    struct Record {
+      /// The position and size of the state in the file.
+      uint64_t offset, size;
+      /// The memory objects whose object states were dropped, kept alive
+      /// until they are bound again.
+      std::vector<ref<const MemoryObject> > objects;
+    };
+
+    std::string path;
+    int fd;
+    ArrayCache &arrayCache;
+    std::map<const ExecutionState*, Record> swapped;
+    /// The end of the file.
+    uint64_t fileSize;
+    /// The size of each free extent before the end of the file, by offset.
+    /// Adjacent extents are merged.
+    std::map<uint64_t, uint64_t> freeExtents;
+
+    /// Return the offset of \a size bytes of free space in the file.
+    uint64_t allocate(uint64_t size);
+    /// Mark the \a size bytes at \a offset as free.
+    void release(uint64_t offset, uint64_t size);
+
+  public:
+    /// Swap states out to the file at \a path, which is created, and
+    /// removed again on destruction.
+    StateSwapper(const std::string &path, ArrayCache &arrayCache);
+    ~StateSwapper();
+
+    bool isSwappedOut(const ExecutionState &state) const {
+      return swapped.count(&state);
+    }
+
+    unsigned getNumSwappedOut() const { return swapped.size(); }
+
+    /// Write the contents of \a state to the file and drop them.
+    ///
+    /// \return false if the file cannot be written, in which case \a state
+    /// is unchanged.
+    bool swapOut(ExecutionState &state);
+
+    /// Restore the contents of a swapped out \a state.
+    void swapIn(ExecutionState &state);
+
+    /// Forget about \a state, which is about to be deleted, if it is
+    /// swapped out.
+    void discard(const ExecutionState &state);
+  };
+}
+
+#endif /* KLEE_STATESWAPPER_H */
@@ -20,6 +20,7 @@
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/SolverStats.h"
+#include "klee/util/SlabAllocator.h"
 
 #include "CallPathManager.h"
 #include "CoreStats.h"
@@ -324,7 +325,7 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
         //
         // FIXME: This trick no longer works, we should fix this in the line
         // number propogation.
-          es.coveredLines[&ii.file].insert(ii.line);
+          es.addCoveredLine(&ii.file, ii.line);
 	es.coveredNew = true;
         es.instsSinceCovNew = 1;
 	++stats::coveredInstructions;
@@ -429,6 +430,8 @@ void StatsTracker::writeStatsHeader() {
              << "'QueryCacheHits',"
              << "'QueryCacheMisses',"
              << "'QueryCounterexamples',"
+             << "'MemoryPoolObjects',"
+             << "'MemoryPoolBytes',"
 #ifdef DEBUG
 	     << "'ArrayHashTime',"
 #endif
@@ -468,6 +471,8 @@ void StatsTracker::writeStatsLine() {
              << "," << stats::queryCacheHits
              << "," << stats::queryCacheMisses
              << "," << stats::queryCounterexamples
+             << "," << getMemoryAllocator().getNumLive()
+             << "," << getMemoryAllocator().getSlabBytes()
 #ifdef DEBUG
              << "," << stats::arrayHashTime / 1000000.
 #endif
@@ -24,6 +24,23 @@ using namespace llvm;
 
 /***/
 
+bool TimingSolver::decideByKnownBits(const ExecutionState &state,
+                                     ref<Expr> expr, bool &result) {
+  if (!useKnownBits)
+    return false;
+
+  KnownBits value = state.constraints.getKnownBits().evaluate(expr);
+  if (value.isTrue()) {
+    result = true;
+  } else if (value.isFalse()) {
+    result = false;
+  } else {
+    return false;
+  }
+  ++stats::knownBitsQueries;
+  return true;
+}
+
 bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
                             Solver::Validity &result) {
 //  outs() << "Evaluate\n";
@@ -34,6 +51,12 @@ bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
     return true;
   }
 
+  bool value;
+  if (decideByKnownBits(state, expr, value)) {
+    result = value ? Solver::True : Solver::False;
+    return true;
+  }
+
   sys::TimeValue now = util::getWallTimeVal();
 
   if (simplifyExprs)
@@ -68,6 +91,9 @@ bool TimingSolver::mustBeTrue(const ExecutionState& state, ref<Expr> expr,
     return true;
   }
 
+  if (decideByKnownBits(state, expr, result))
+    return true;
+
   sys::TimeValue now = util::getWallTimeVal();
 
   if (simplifyExprs)
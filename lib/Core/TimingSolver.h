@@ -25,6 +25,13 @@ namespace klee {
   public:
     Solver *solver;
     bool simplifyExprs;
+    bool useKnownBits;
+
+  private:
+    /// decideByKnownBits - Try to decide the boolean \a expr from the known
+    /// bits of the constraints of \a state alone.
+    bool decideByKnownBits(const ExecutionState &state, ref<Expr> expr,
+                           bool &result);
 
   public:
     /// TimingSolver - Construct a new timing solver.
@@ -32,8 +39,13 @@ namespace klee {
     /// \param _simplifyExprs - Whether expressions should be
     /// simplified (via the constraint manager interface) prior to
     /// querying.
-    TimingSolver(Solver *_solver, bool _simplifyExprs = true) 
-      : solver(_solver), simplifyExprs(_simplifyExprs) {}
+    ///
+    /// \param _useKnownBits - Whether boolean queries should first be
+    /// decided from the known bits and ranges implied by the constraints.
+    TimingSolver(Solver *_solver, bool _simplifyExprs = true,
+                 bool _useKnownBits = true)
+      : solver(_solver), simplifyExprs(_simplifyExprs),
+        useKnownBits(_useKnownBits) {}
     ~TimingSolver() {
       delete solver;
     }
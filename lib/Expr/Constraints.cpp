@@ -10,6 +10,7 @@
 #include "klee/Constraints.h"
 
 #include "klee/util/ExprPPrinter.h"
+#include "klee/util/ExprUtil.h"
 #include "klee/util/ExprVisitor.h"
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
 #include "llvm/IR/Function.h"
@@ -19,6 +20,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "klee/Internal/Module/KModule.h"
 
+#include <algorithm>
 #include <map>
 
 using namespace klee;
@@ -75,14 +77,163 @@ public:
   }
 };
 
+unsigned ConstraintPartition::find(unsigned node) const {
+  while (parent[node] != node) {
+    parent[node] = parent[parent[node]];
+    node = parent[node];
+  }
+  return node;
+}
+
+void ConstraintPartition::unite(unsigned a, unsigned b) {
+  a = find(a);
+  b = find(b);
+  if (a != b)
+    parent[std::max(a, b)] = std::min(a, b);
+}
+
+unsigned ConstraintPartition::getByteNode(const Array *array, unsigned index) {
+  ArrayNodes &nodes = arrays[array];
+  std::map<unsigned, unsigned>::iterator it = nodes.bytes.find(index);
+  if (it != nodes.bytes.end())
+    return it->second;
+
+  unsigned node = parent.size();
+  parent.push_back(node);
+  nodes.bytes.insert(std::make_pair(index, node));
+  if (nodes.whole != NoClass)
+    unite(nodes.whole, node);
+  return node;
+}
+
+unsigned ConstraintPartition::getWholeNode(const Array *array) {
+  ArrayNodes &nodes = arrays[array];
+  if (nodes.whole == NoClass) {
+    nodes.whole = parent.size();
+    parent.push_back(nodes.whole);
+    for (std::map<unsigned, unsigned>::iterator it = nodes.bytes.begin(),
+           ie = nodes.bytes.end(); it != ie; ++it)
+      unite(nodes.whole, it->second);
+  }
+  return nodes.whole;
+}
+
+void ConstraintPartition::addConstraint(const ref<Expr> &e) {
+  std::vector< ref<ReadExpr> > reads;
+  findReads(e, /* visitUpdates= */ true, reads);
+
+  unsigned node = NoClass;
+  for (unsigned i = 0; i != reads.size(); ++i) {
+    ReadExpr *re = reads[i].get();
+    const Array *array = re->updates.root;
+
+    // Reads of a constant array don't alias.
+    if (array->isConstantArray() && !re->updates.head)
+      continue;
+
+    unsigned n;
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
+      n = getByteNode(array, (unsigned) CE->getZExtValue(32));
+    } else {
+      n = getWholeNode(array);
+    }
+    if (node == NoClass) {
+      node = n;
+    } else {
+      unite(node, n);
+    }
+  }
+  constraintNodes.push_back(node);
+}
+
+void ConstraintPartition::getClasses(const ref<Expr> &e,
+                                     std::set<unsigned> &classes) const {
+  std::vector< ref<ReadExpr> > reads;
+  findReads(e, /* visitUpdates= */ true, reads);
+
+  for (unsigned i = 0; i != reads.size(); ++i) {
+    ReadExpr *re = reads[i].get();
+    const Array *array = re->updates.root;
+
+    if (array->isConstantArray() && !re->updates.head)
+      continue;
+
+    std::map<const Array*, ArrayNodes>::const_iterator it = arrays.find(array);
+    if (it == arrays.end())
+      continue;
+    const ArrayNodes &nodes = it->second;
+
+    if (nodes.whole != NoClass) {
+      classes.insert(find(nodes.whole));
+    } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
+      std::map<unsigned, unsigned>::const_iterator it2 =
+        nodes.bytes.find((unsigned) CE->getZExtValue(32));
+      if (it2 != nodes.bytes.end())
+        classes.insert(find(it2->second));
+    } else {
+      // A symbolic index may alias any byte of the array.
+      for (std::map<unsigned, unsigned>::const_iterator
+             it2 = nodes.bytes.begin(), ie2 = nodes.bytes.end();
+           it2 != ie2; ++it2)
+        classes.insert(find(it2->second));
+    }
+  }
+}
+
+const ConstraintPartition &ConstraintManager::getPartition() const {
+  if (partition.isNull()) {
+    partition = new ConstraintPartition();
+    for (constraints_ty::const_iterator it = constraints.begin(),
+           ie = constraints.end(); it != ie; ++it)
+      partition->addConstraint(*it);
+  }
+  assert(partition->size() == constraints.size() && "stale partition");
+  return *partition;
+}
+
+const ConstraintKnownBits &ConstraintManager::getKnownBits() const {
+  if (knownBits.isNull()) {
+    knownBits = new ConstraintKnownBits();
+    for (constraints_ty::const_iterator it = constraints.begin(),
+           ie = constraints.end(); it != ie; ++it)
+      knownBits->addConstraint(*it);
+  }
+  assert(knownBits->size() == constraints.size() && "stale known bits");
+  return *knownBits;
+}
+
+void ConstraintManager::appendConstraint(ref<Expr> e) {
+  constraints.push_back(e);
+  if (!partition.isNull()) {
+    // The partition may be shared with the constraint set this one was
+    // copied from.
+    if (partition->refCount > 1)
+      partition = new ConstraintPartition(*partition);
+    partition->addConstraint(e);
+  }
+  if (!knownBits.isNull()) {
+    if (knownBits->refCount > 1)
+      knownBits = new ConstraintKnownBits(*knownBits);
+    knownBits->addConstraint(e);
+  }
+}
+
 bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
   ConstraintManager::constraints_ty old;
   bool changed = false;
 
+  // The rewritten constraints may read fewer bytes, so rather than keeping
+  // the classes they were merged into, the partition is rebuilt on demand.
+  // So are the known bits, which may have been learned from the old forms.
+  ref<ConstraintPartition> oldPartition = partition;
+  ref<ConstraintKnownBits> oldKnownBits = knownBits;
+  partition = 0;
+  knownBits = 0;
+
   constraints.swap(old);
-  for (ConstraintManager::constraints_ty::iterator 
+  for (ConstraintManager::constraints_ty::const_iterator 
          it = old.begin(), ie = old.end(); it != ie; ++it) {
-    ref<Expr> &ce = *it;
+    const ref<Expr> &ce = *it;
     ref<Expr> e = visitor.visit(ce);
 
     if (e!=ce) {
@@ -93,6 +244,11 @@ bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
     }
   }
 
+  if (!changed) {
+    partition = oldPartition;
+    knownBits = oldKnownBits;
+  }
+
   return changed;
 }
 
@@ -155,12 +311,12 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
 	rewriteConstraints(visitor);
       }
     }
-    constraints.push_back(e);
+    appendConstraint(e);
     break;
   }
     
   default:
-    constraints.push_back(e);
+    appendConstraint(e);
     break;
   }
 }
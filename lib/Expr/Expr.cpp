@@ -20,22 +20,120 @@
 #include "klee/Internal/Support/IntEvaluation.h"
 
 #include "klee/util/ExprPPrinter.h"
+#include "klee/util/ExprRewriter.h"
+#include "klee/util/SlabAllocator.h"
 
+#include <ciso646>
+#ifdef _LIBCPP_VERSION
+#include <unordered_map>
+#define unordered_multimap std::unordered_multimap
+#else
+#include <tr1/unordered_map>
+#define unordered_multimap std::tr1::unordered_multimap
+#endif
 #include <sstream>
 
 using namespace klee;
 using namespace llvm;
 
+bool Expr::hashConsing = false;
+bool Expr::rewriting = false;
+
 namespace {
   cl::opt<bool>
   ConstArrayOpt("const-array-opt",
 	 cl::init(false),
 	 cl::desc("Enable various optimizations involving all-constant arrays."));
+
+  cl::opt<bool, true>
+  HashConsExprs("hash-cons-exprs",
+                cl::location(Expr::hashConsing),
+                cl::desc("Share the nodes of structurally identical "
+                         "expressions (default=off)"));
+
+  cl::opt<bool, true>
+  RewriteExprs("rewrite-exprs",
+               cl::location(Expr::rewriting),
+               cl::desc("Simplify expressions with the built-in rewrite "
+                        "rules as they are built (default=off)"));
+
+  /// The hash-consed expressions, by hash. The table does not own them;
+  /// they remove themselves from it when they are destroyed.
+  typedef unordered_multimap<unsigned, Expr*> HashConsTable;
+  HashConsTable *hashConsTable = 0;
 }
 
 /***/
 
 unsigned Expr::count = 0;
+uint64_t Expr::numLive[Expr::LastKind + 1];
+uint64_t Expr::numPeak[Expr::LastKind + 1];
+
+Expr::~Expr() {
+  Expr::count--;
+
+  if (hashConsTable) {
+    // Only the base part is left at this point, so look the expression up
+    // by pointer rather than by contents.
+    std::pair<HashConsTable::iterator, HashConsTable::iterator> range =
+      hashConsTable->equal_range(hashValue);
+    for (HashConsTable::iterator it = range.first; it != range.second; ++it) {
+      if (it->second == this) {
+        hashConsTable->erase(it);
+        break;
+      }
+    }
+  }
+}
+
+void *Expr::operator new(size_t size) {
+  return getExprAllocator().allocate(size);
+}
+
+void Expr::operator delete(void *p, size_t size) {
+  getExprAllocator().deallocate(p, size);
+}
+
+void Expr::printKindStats(llvm::raw_ostream &os, const char *prefix) {
+  for (unsigned k = 0; k != LastKind + 1; ++k) {
+    if (!numPeak[k])
+      continue;
+    os << prefix << "Expr objects of kind ";
+    printKind(os, (Kind) k);
+    os << ": live = " << numLive[k] << ", peak = " << numPeak[k] << "\n";
+  }
+}
+
+// Kids of hash-consed expressions are hash-consed themselves, so comparing
+// them by pointer is enough to find an identical expression.
+static bool isShallowEqual(const Expr &a, const Expr &b) {
+  if (a.getKind() != b.getKind() || a.compareContents(b))
+    return false;
+  for (unsigned i = 0, e = a.getNumKids(); i != e; ++i)
+    if (a.getKid(i).get() != b.getKid(i).get())
+      return false;
+  return true;
+}
+
+Expr *Expr::lookupOrInsert(Expr *e) {
+  if (!hashConsTable)
+    hashConsTable = new HashConsTable();
+
+  std::pair<HashConsTable::iterator, HashConsTable::iterator> range =
+    hashConsTable->equal_range(e->hash());
+  for (HashConsTable::iterator it = range.first; it != range.second; ++it)
+    if (isShallowEqual(*it->second, *e))
+      return it->second;
+
+  hashConsTable->insert(std::make_pair(e->hash(), e));
+  return e;
+}
+
+ref<Expr> Expr::applyRewriteRules(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return e;
+  return ExprRewriter::getDefault().rewrite(e);
+}
 
 ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
   UpdateList ul(array, 0);
@@ -358,8 +456,16 @@ void ConstantExpr::toString(std::string &Res, unsigned radix) const {
   Res = value.toString(radix, false);
 }
 
+// The operations below work on the single word of constants of up to 64
+// bits directly and only use the APInt operations for wider constants,
+// where the invalid bits of the word are always zero.
+
 ref<ConstantExpr> ConstantExpr::Concat(const ref<ConstantExpr> &RHS) {
   Expr::Width W = getWidth() + RHS->getWidth();
+  if (W <= 64)
+    return ConstantExpr::alloc((getZExtValue() << RHS->getWidth()) |
+                               RHS->getZExtValue(), W);
+
   APInt Tmp(value);
   Tmp=Tmp.zext(W);
   Tmp <<= RHS->getWidth();
@@ -369,114 +475,201 @@ ref<ConstantExpr> ConstantExpr::Concat(const ref<ConstantExpr> &RHS) {
 }
 
 ref<ConstantExpr> ConstantExpr::Extract(unsigned Offset, Width W) {
+  if (getWidth() <= 64 && Offset + W <= getWidth())
+    return ConstantExpr::alloc(ints::trunc(getZExtValue() >> Offset, W,
+                                           getWidth()), W);
   return ConstantExpr::alloc(APInt(value.ashr(Offset)).zextOrTrunc(W));
 }
 
 ref<ConstantExpr> ConstantExpr::ZExt(Width W) {
+  if (getWidth() <= 64 && W <= 64)
+    return ConstantExpr::alloc(ints::trunc(getZExtValue(), W, getWidth()), W);
   return ConstantExpr::alloc(APInt(value).zextOrTrunc(W));
 }
 
 ref<ConstantExpr> ConstantExpr::SExt(Width W) {
+  if (getWidth() <= 64 && W <= 64)
+    return ConstantExpr::alloc(ints::sext(getZExtValue(), W, getWidth()), W);
   return ConstantExpr::alloc(APInt(value).sextOrTrunc(W));
 }
 
 ref<ConstantExpr> ConstantExpr::Add(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(ints::add(getZExtValue(), RHS->getZExtValue(),
+                                         getWidth()), getWidth());
   return ConstantExpr::alloc(value + RHS->value);
 }
 
 ref<ConstantExpr> ConstantExpr::Neg() {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(ints::sub(0, getZExtValue(), getWidth()),
+                               getWidth());
   return ConstantExpr::alloc(-value);
 }
 
 ref<ConstantExpr> ConstantExpr::Sub(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(ints::sub(getZExtValue(), RHS->getZExtValue(),
+                                         getWidth()), getWidth());
   return ConstantExpr::alloc(value - RHS->value);
 }
 
 ref<ConstantExpr> ConstantExpr::Mul(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(ints::mul(getZExtValue(), RHS->getZExtValue(),
+                                         getWidth()), getWidth());
   return ConstantExpr::alloc(value * RHS->value);
 }
 
+// Division by zero, and the signed division of the smallest 64-bit value by
+// -1, are left to APInt, which asserts on the former.
+
 ref<ConstantExpr> ConstantExpr::UDiv(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64 && !RHS->isZero())
+    return ConstantExpr::alloc(ints::udiv(getZExtValue(), RHS->getZExtValue(),
+                                          getWidth()), getWidth());
   return ConstantExpr::alloc(value.udiv(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::SDiv(const ref<ConstantExpr> &RHS) {
+  if (getWidth() < 64 && !RHS->isZero())
+    return ConstantExpr::alloc(ints::sdiv(getZExtValue(), RHS->getZExtValue(),
+                                          getWidth()), getWidth());
   return ConstantExpr::alloc(value.sdiv(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::URem(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64 && !RHS->isZero())
+    return ConstantExpr::alloc(ints::urem(getZExtValue(), RHS->getZExtValue(),
+                                          getWidth()), getWidth());
   return ConstantExpr::alloc(value.urem(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::SRem(const ref<ConstantExpr> &RHS) {
+  if (getWidth() < 64 && !RHS->isZero())
+    return ConstantExpr::alloc(ints::srem(getZExtValue(), RHS->getZExtValue(),
+                                          getWidth()), getWidth());
   return ConstantExpr::alloc(value.srem(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::And(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(getZExtValue() & RHS->getZExtValue(),
+                               getWidth());
   return ConstantExpr::alloc(value & RHS->value);
 }
 
 ref<ConstantExpr> ConstantExpr::Or(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(getZExtValue() | RHS->getZExtValue(),
+                               getWidth());
   return ConstantExpr::alloc(value | RHS->value);
 }
 
 ref<ConstantExpr> ConstantExpr::Xor(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(getZExtValue() ^ RHS->getZExtValue(),
+                               getWidth());
   return ConstantExpr::alloc(value ^ RHS->value);
 }
 
+// Shifts by the width or more are left to APInt, which defines them.
+
 ref<ConstantExpr> ConstantExpr::Shl(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64 && RHS->getLimitedValue(64) < getWidth())
+    return ConstantExpr::alloc(ints::shl(getZExtValue(), RHS->getZExtValue(),
+                                         getWidth()), getWidth());
   return ConstantExpr::alloc(value.shl(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::LShr(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64 && RHS->getLimitedValue(64) < getWidth())
+    return ConstantExpr::alloc(ints::lshr(getZExtValue(), RHS->getZExtValue(),
+                                          getWidth()), getWidth());
   return ConstantExpr::alloc(value.lshr(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::AShr(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64 && RHS->getLimitedValue(64) < getWidth())
+    return ConstantExpr::alloc(ints::ashr(getZExtValue(), RHS->getZExtValue(),
+                                          getWidth()), getWidth());
   return ConstantExpr::alloc(value.ashr(RHS->value));
 }
 
 ref<ConstantExpr> ConstantExpr::Not() {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(ints::trunc(~getZExtValue(), getWidth(),
+                                           getWidth()), getWidth());
   return ConstantExpr::alloc(~value);
 }
 
 ref<ConstantExpr> ConstantExpr::Eq(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(getZExtValue() == RHS->getZExtValue(),
+                               Expr::Bool);
   return ConstantExpr::alloc(value == RHS->value, Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Ne(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(getZExtValue() != RHS->getZExtValue(),
+                               Expr::Bool);
   return ConstantExpr::alloc(value != RHS->value, Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Ult(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(getZExtValue() < RHS->getZExtValue(),
+                               Expr::Bool);
   return ConstantExpr::alloc(value.ult(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Ule(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(getZExtValue() <= RHS->getZExtValue(),
+                               Expr::Bool);
   return ConstantExpr::alloc(value.ule(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Ugt(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(getZExtValue() > RHS->getZExtValue(),
+                               Expr::Bool);
   return ConstantExpr::alloc(value.ugt(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Uge(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(getZExtValue() >= RHS->getZExtValue(),
+                               Expr::Bool);
   return ConstantExpr::alloc(value.uge(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Slt(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(ints::slt(getZExtValue(), RHS->getZExtValue(),
+                                         getWidth()), Expr::Bool);
   return ConstantExpr::alloc(value.slt(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Sle(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(ints::sle(getZExtValue(), RHS->getZExtValue(),
+                                         getWidth()), Expr::Bool);
   return ConstantExpr::alloc(value.sle(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Sgt(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(ints::sgt(getZExtValue(), RHS->getZExtValue(),
+                                         getWidth()), Expr::Bool);
   return ConstantExpr::alloc(value.sgt(RHS->value), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Sge(const ref<ConstantExpr> &RHS) {
+  if (getWidth() <= 64)
+    return ConstantExpr::alloc(ints::sge(getZExtValue(), RHS->getZExtValue(),
+                                         getWidth()), Expr::Bool);
   return ConstantExpr::alloc(value.sge(RHS->value), Expr::Bool);
 }
 
@@ -529,6 +722,11 @@ ref<Expr> ReadExpr::create(const UpdateList &ul, ref<Expr> index) {
   // a smart UpdateList so it is not worth rescanning.
 
   const UpdateNode *un = ul.head;
+  if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(index))
+    if (CE->getWidth() <= 64)
+      if (const UpdateNode *w = ul.findConstantUpdate(CE->getZExtValue(), un))
+        return w->value;
+
   for (; un; un=un->next) {
     ref<Expr> cond = EqExpr::create(index, un->index);
     
@@ -540,7 +738,7 @@ ref<Expr> ReadExpr::create(const UpdateList &ul, ref<Expr> index) {
     }
   }
 
-  return ReadExpr::alloc(ul, index);
+  return rewrite(ReadExpr::alloc(ul, index));
 }
 
 int ReadExpr::compareContents(const Expr &b) const { 
@@ -573,7 +771,7 @@ ref<Expr> SelectExpr::create(ref<Expr> c, ref<Expr> t, ref<Expr> f) {
     }
   }
   
-  return SelectExpr::alloc(c, t, f);
+  return rewrite(SelectExpr::alloc(c, t, f));
 }
 
 /***/
@@ -581,9 +779,8 @@ ref<Expr> SelectExpr::create(ref<Expr> c, ref<Expr> t, ref<Expr> f) {
 ref<Expr> ConcatExpr::create(const ref<Expr> &l, const ref<Expr> &r) {
   Expr::Width w = l->getWidth() + r->getWidth();
   
-  // Fold concatenation of constants.
-  //
-  // FIXME: concat 0 x -> zext x ?
+  // Fold concatenation of constants. Concatenations with zero become
+  // ZExts through the concat-of-zero rewrite rule.
   if (ConstantExpr *lCE = dyn_cast<ConstantExpr>(l))
     if (ConstantExpr *rCE = dyn_cast<ConstantExpr>(r))
       return lCE->Concat(rCE);
@@ -598,7 +795,7 @@ ref<Expr> ConcatExpr::create(const ref<Expr> &l, const ref<Expr> &r) {
     }
   }
 
-  return ConcatExpr::alloc(l, r);
+  return rewrite(ConcatExpr::alloc(l, r));
 }
 
 /// Shortcut to concat N kids.  The chain returned is unbalanced to the right
@@ -655,7 +852,7 @@ ref<Expr> ExtractExpr::create(ref<Expr> expr, unsigned off, Width w) {
     }
   }
   
-  return ExtractExpr::alloc(expr, off, w);
+  return rewrite(ExtractExpr::alloc(expr, off, w));
 }
 
 /***/
@@ -664,7 +861,7 @@ ref<Expr> NotExpr::create(const ref<Expr> &e) {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e))
     return CE->Not();
   
-  return NotExpr::alloc(e);
+  return rewrite(NotExpr::alloc(e));
 }
 
 
@@ -679,7 +876,7 @@ ref<Expr> ZExtExpr::create(const ref<Expr> &e, Width w) {
   } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
     return CE->ZExt(w);
   } else {
-    return ZExtExpr::alloc(e, w);
+    return rewrite(ZExtExpr::alloc(e, w));
   }
 }
 
@@ -692,7 +889,7 @@ ref<Expr> SExtExpr::create(const ref<Expr> &e, Width w) {
   } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
     return CE->SExt(w);
   } else {    
-    return SExtExpr::alloc(e, w);
+    return rewrite(SExtExpr::alloc(e, w));
   }
 }
 
@@ -941,11 +1138,11 @@ ref<Expr>  _e_op ::create(const ref<Expr> &l, const ref<Expr> &r) { \
   if (ConstantExpr *cl = dyn_cast<ConstantExpr>(l)) {                   \
     if (ConstantExpr *cr = dyn_cast<ConstantExpr>(r))                   \
       return cl->_op(cr);                                               \
-    return _e_op ## _createPartialR(cl, r.get());                       \
+    return rewrite(_e_op ## _createPartialR(cl, r.get()));              \
   } else if (ConstantExpr *cr = dyn_cast<ConstantExpr>(r)) {            \
-    return _e_op ## _createPartial(l.get(), cr);                        \
+    return rewrite(_e_op ## _createPartial(l.get(), cr));               \
   }                                                                     \
-  return _e_op ## _create(l.get(), r.get());                            \
+  return rewrite(_e_op ## _create(l.get(), r.get()));                   \
 }
 
 #define BCREATE(_e_op, _op) \
@@ -954,7 +1151,7 @@ ref<Expr>  _e_op ::create(const ref<Expr> &l, const ref<Expr> &r) { \
   if (ConstantExpr *cl = dyn_cast<ConstantExpr>(l))                 \
     if (ConstantExpr *cr = dyn_cast<ConstantExpr>(r))               \
       return cl->_op(cr);                                           \
-  return _e_op ## _create(l, r);                                    \
+  return rewrite(_e_op ## _create(l, r));                           \
 }
 
 BCREATE_R(AddExpr, Add, AddExpr_createPartial, AddExpr_createPartialR)
@@ -977,7 +1174,7 @@ ref<Expr>  _e_op ::create(const ref<Expr> &l, const ref<Expr> &r) { \
   if (ConstantExpr *cl = dyn_cast<ConstantExpr>(l))                     \
     if (ConstantExpr *cr = dyn_cast<ConstantExpr>(r))                   \
       return cl->_op(cr);                                               \
-  return _e_op ## _create(l, r);                                        \
+  return rewrite(_e_op ## _create(l, r));                               \
 }
 
 #define CMPCREATE_T(_e_op, _op, _reflexive_e_op, partialL, partialR) \
@@ -986,11 +1183,11 @@ ref<Expr>  _e_op ::create(const ref<Expr> &l, const ref<Expr> &r) {    \
   if (ConstantExpr *cl = dyn_cast<ConstantExpr>(l)) {                  \
     if (ConstantExpr *cr = dyn_cast<ConstantExpr>(r))                  \
       return cl->_op(cr);                                              \
-    return partialR(cl, r.get());                                      \
+    return rewrite(partialR(cl, r.get()));                             \
   } else if (ConstantExpr *cr = dyn_cast<ConstantExpr>(r)) {           \
-    return partialL(l.get(), cr);                                      \
+    return rewrite(partialL(l.get(), cr));                             \
   } else {                                                             \
-    return _e_op ## _create(l.get(), r.get());                         \
+    return rewrite(_e_op ## _create(l.get(), r.get()));                \
   }                                                                    \
 }
   
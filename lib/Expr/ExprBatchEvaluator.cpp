@@ -0,0 +1,303 @@
+//===-- ExprBatchEvaluator.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ExprBatchEvaluator.h"
+
+#include "klee/Internal/Support/IntEvaluation.h"
+#include "klee/util/Assignment.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+ExprBatchEvaluator::ExprBatchEvaluator(const ref<Expr> &e) : supported(true) {
+  llvm::DenseMap<const Expr*, unsigned> compiled;
+  compile(e, compiled);
+  if (!supported) {
+    instructions.clear();
+    reads.clear();
+    arrays.clear();
+  }
+}
+
+unsigned
+ExprBatchEvaluator::compile(const ref<Expr> &e,
+                            llvm::DenseMap<const Expr*, unsigned> &compiled) {
+  llvm::DenseMap<const Expr*, unsigned>::iterator it = compiled.find(e.get());
+  if (it != compiled.end())
+    return it->second;
+
+  if (e->getWidth() > 64)
+    supported = false;
+  if (!supported)
+    return 0;
+
+  Instruction insn;
+  insn.kind = e->getKind();
+  insn.width = e->getWidth();
+  insn.operandWidth = 0;
+  insn.ops[0] = insn.ops[1] = insn.ops[2] = 0;
+  insn.imm = 0;
+
+  switch (e->getKind()) {
+  case Expr::Constant:
+    insn.imm = cast<ConstantExpr>(e)->getZExtValue();
+    break;
+
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    Read read;
+    read.root = re->updates.root;
+    read.array = std::find(arrays.begin(), arrays.end(), read.root) -
+                 arrays.begin();
+    if (read.array == arrays.size())
+      arrays.push_back(read.root);
+    for (const UpdateNode *un = re->updates.head; un; un = un->next) {
+      unsigned index = compile(un->index, compiled);
+      read.updates.push_back(std::make_pair(index,
+                                            compile(un->value, compiled)));
+    }
+    insn.ops[0] = compile(re->index, compiled);
+    insn.imm = reads.size();
+    reads.push_back(read);
+    break;
+  }
+
+  case Expr::Extract:
+    insn.ops[0] = compile(cast<ExtractExpr>(e)->expr, compiled);
+    insn.imm = cast<ExtractExpr>(e)->offset;
+    break;
+
+  default:
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+      insn.ops[i] = compile(e->getKid(i), compiled);
+    // Concat needs the width of its right operand, the other kinds that of
+    // their (first) operand.
+    insn.operandWidth =
+      e->getKid(e->getKind() == Expr::Concat ? 1 : 0)->getWidth();
+    break;
+  }
+
+  if (!supported)
+    return 0;
+  instructions.push_back(insn);
+  compiled.insert(std::make_pair(e.get(), instructions.size() - 1));
+  return instructions.size() - 1;
+}
+
+void ExprBatchEvaluator::evaluate(
+    const std::vector<const Assignment*> &assignments,
+    std::vector<uint64_t> &values, std::vector<unsigned char> &known) const {
+  unsigned n = assignments.size();
+  values.assign(n, 0);
+  known.assign(n, 0);
+  if (!supported)
+    return;
+
+  for (unsigned begin = 0; begin < n; begin += BlockSize)
+    evaluateBlock(&assignments[begin], std::min(BlockSize, n - begin),
+                  &values[begin], &known[begin]);
+}
+
+// The lanes of an instruction are evaluated in simple loops over \a n
+// contiguous values, which the compiler can vectorize.
+#define LANES for (unsigned l = 0; l != n; ++l)
+
+#define BINARY_OP(kind, fn)                                                    \
+  case Expr::kind:                                                             \
+    LANES {                                                                    \
+      r[l] = ints::fn(a[l], b[l], w);                                          \
+      k[l] = ka[l] & kb[l];                                                    \
+    }                                                                          \
+    break;
+
+#define COMPARE_OP(kind, fn)                                                   \
+  case Expr::kind:                                                             \
+    LANES {                                                                    \
+      r[l] = ints::fn(a[l], b[l], ow);                                         \
+      k[l] = ka[l] & kb[l];                                                    \
+    }                                                                          \
+    break;
+
+// The value is unknown where the operation is not defined, see the class
+// comment.
+#define PARTIAL_OP(kind, fn, defined)                                          \
+  case Expr::kind:                                                             \
+    LANES {                                                                    \
+      bool d = (defined);                                                      \
+      r[l] = d ? ints::fn(a[l], b[l], w) : 0;                                  \
+      k[l] = d & ka[l] & kb[l];                                                \
+    }                                                                          \
+    break;
+
+void ExprBatchEvaluator::evaluateBlock(const Assignment *const *assignments,
+                                       unsigned n, uint64_t *values,
+                                       unsigned char *known) const {
+  const unsigned B = BlockSize;
+  std::vector<uint64_t> regs(instructions.size() * B);
+  std::vector<unsigned char> oks(instructions.size() * B);
+
+  // The bytes each assignment binds for each array read.
+  std::vector<const std::vector<unsigned char>*> bindings(arrays.size() * B);
+  for (unsigned i = 0, e = arrays.size(); i != e; ++i) {
+    for (unsigned l = 0; l != n; ++l) {
+      Assignment::bindings_ty::const_iterator it =
+        assignments[l]->bindings.find(arrays[i]);
+      if (it != assignments[l]->bindings.end())
+        bindings[i * B + l] = &it->second;
+    }
+  }
+
+  const uint64_t signBit = 1ULL << 63;
+  for (unsigned i = 0, e = instructions.size(); i != e; ++i) {
+    const Instruction &insn = instructions[i];
+    uint64_t *r = &regs[i * B];
+    unsigned char *k = &oks[i * B];
+    const uint64_t *a = &regs[insn.ops[0] * B], *b = &regs[insn.ops[1] * B],
+      *c = &regs[insn.ops[2] * B];
+    const unsigned char *ka = &oks[insn.ops[0] * B],
+      *kb = &oks[insn.ops[1] * B], *kc = &oks[insn.ops[2] * B];
+    Expr::Width w = insn.width, ow = insn.operandWidth;
+    uint64_t mask = bits64::maxValueOfNBits(w);
+
+    switch (insn.kind) {
+    case Expr::Constant:
+      LANES {
+        r[l] = insn.imm;
+        k[l] = 1;
+      }
+      break;
+
+    case Expr::NotOptimized:
+    case Expr::ZExt:
+      LANES {
+        r[l] = a[l];
+        k[l] = ka[l];
+      }
+      break;
+
+    case Expr::Read: {
+      const Read &read = reads[insn.imm];
+      const Array *root = read.root;
+      for (unsigned l = 0; l != n; ++l) {
+        r[l] = 0;
+        k[l] = 0;
+        // Assignment::evaluate() takes the index as an unsigned.
+        if (!ka[l] || a[l] > 0xFFFFFFFFULL)
+          continue;
+        uint64_t index = a[l];
+
+        std::vector<std::pair<unsigned, unsigned> >::const_iterator
+          it = read.updates.begin(), ie = read.updates.end();
+        for (; it != ie; ++it)
+          if (!oks[it->first * B + l] || regs[it->first * B + l] == index)
+            break;
+        if (it != ie) {
+          // Either the update index is unknown, or the update is read.
+          if (oks[it->first * B + l]) {
+            r[l] = regs[it->second * B + l];
+            k[l] = oks[it->second * B + l];
+          }
+          continue;
+        }
+
+        if (root->isConstantArray() && index < root->size) {
+          r[l] = root->constantValues[index]->getZExtValue();
+          k[l] = 1;
+          continue;
+        }
+        const std::vector<unsigned char> *bytes =
+          bindings[read.array * B + l];
+        if (bytes && index < bytes->size()) {
+          r[l] = (*bytes)[index];
+          k[l] = 1;
+        } else {
+          k[l] = !assignments[l]->allowFreeValues;
+        }
+      }
+      break;
+    }
+
+    case Expr::Select:
+      LANES {
+        r[l] = a[l] ? b[l] : c[l];
+        k[l] = ka[l] & (a[l] ? kb[l] : kc[l]);
+      }
+      break;
+
+    case Expr::Concat:
+      LANES {
+        r[l] = (a[l] << ow) | b[l];
+        k[l] = ka[l] & kb[l];
+      }
+      break;
+
+    case Expr::Extract:
+      LANES {
+        r[l] = (a[l] >> insn.imm) & mask;
+        k[l] = ka[l];
+      }
+      break;
+
+    case Expr::SExt:
+      LANES {
+        r[l] = ints::sext(a[l], w, ow);
+        k[l] = ka[l];
+      }
+      break;
+
+    case Expr::Not:
+      LANES {
+        r[l] = ~a[l] & mask;
+        k[l] = ka[l];
+      }
+      break;
+
+    BINARY_OP(Add, add)
+    BINARY_OP(Sub, sub)
+    BINARY_OP(Mul, mul)
+    PARTIAL_OP(UDiv, udiv, b[l] != 0)
+    PARTIAL_OP(URem, urem, b[l] != 0)
+    PARTIAL_OP(SDiv, sdiv,
+               b[l] != 0 && !(w == 64 && a[l] == signBit && b[l] == mask))
+    PARTIAL_OP(SRem, srem,
+               b[l] != 0 && !(w == 64 && a[l] == signBit && b[l] == mask))
+    BINARY_OP(And, land)
+    BINARY_OP(Or, lor)
+    BINARY_OP(Xor, lxor)
+    PARTIAL_OP(Shl, shl, b[l] < w)
+    PARTIAL_OP(LShr, lshr, b[l] < w)
+    PARTIAL_OP(AShr, ashr, b[l] < w)
+
+    COMPARE_OP(Eq, eq)
+    COMPARE_OP(Ne, ne)
+    COMPARE_OP(Ult, ult)
+    COMPARE_OP(Ule, ule)
+    COMPARE_OP(Ugt, ugt)
+    COMPARE_OP(Uge, uge)
+    COMPARE_OP(Slt, slt)
+    COMPARE_OP(Sle, sle)
+    COMPARE_OP(Sgt, sgt)
+    COMPARE_OP(Sge, sge)
+
+    default:
+      assert(0 && "invalid expression kind");
+    }
+  }
+
+  if (!instructions.empty()) {
+    std::copy(regs.end() - B, regs.end() - B + n, values);
+    std::copy(oks.end() - B, oks.end() - B + n, known);
+  }
+}
+
+#undef LANES
+#undef BINARY_OP
+#undef COMPARE_OP
+#undef PARTIAL_OP
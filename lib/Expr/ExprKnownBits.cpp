@@ -0,0 +1,586 @@
+//===-- ExprKnownBits.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ExprKnownBits.h"
+
+#include "klee/util/Bits.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+/***/
+
+KnownBits KnownBits::top(Expr::Width w) {
+  KnownBits res;
+  if (w > 64)
+    return res;
+  res.width = w;
+  res.max = res.mask();
+  return res;
+}
+
+KnownBits KnownBits::constant(uint64_t value, Expr::Width w) {
+  KnownBits res;
+  assert(w && w <= 64 && "invalid width");
+  res.width = w;
+  res.ones = res.min = res.max = value;
+  res.zeros = ~value & res.mask();
+  return res;
+}
+
+bool KnownBits::meet(const KnownBits &b) {
+  if (!width || b.width != width)
+    return true;
+
+  KnownBits res = *this;
+  res.zeros |= b.zeros;
+  res.ones |= b.ones;
+  res.min = std::max(min, b.min);
+  res.max = std::min(max, b.max);
+  if (!res.normalize())
+    return false;
+  *this = res;
+  return true;
+}
+
+bool KnownBits::normalize() {
+  if (!width)
+    return true;
+
+  uint64_t m = mask();
+  for (;;) {
+    if (zeros & ones)
+      return false;
+
+    uint64_t oldMin = min, oldMax = max;
+    min = std::max(min, ones);
+    max = std::min(max, m & ~zeros);
+    if (min > max)
+      return false;
+
+    // All the values of the interval share the bits above the highest bit
+    // in which its bounds differ.
+    uint64_t diff = min ^ max;
+    diff |= diff >> 1;
+    diff |= diff >> 2;
+    diff |= diff >> 4;
+    diff |= diff >> 8;
+    diff |= diff >> 16;
+    diff |= diff >> 32;
+    uint64_t prefix = m & ~diff;
+    ones |= min & prefix;
+    zeros |= ~min & prefix;
+
+    if (min == oldMin && max == oldMax)
+      return !(zeros & ones);
+  }
+}
+
+/***/
+
+static KnownBits fromBits(Expr::Width w, uint64_t zeros, uint64_t ones) {
+  KnownBits res = KnownBits::top(w);
+  res.zeros = zeros & res.mask();
+  res.ones = ones & res.mask();
+  if (!res.normalize())
+    return KnownBits::top(w);
+  return res;
+}
+
+static KnownBits fromRange(Expr::Width w, uint64_t min, uint64_t max) {
+  KnownBits res = KnownBits::top(w);
+  res.min = min;
+  res.max = max;
+  if (!res.normalize())
+    return KnownBits::top(w);
+  return res;
+}
+
+static KnownBits fromBool(bool value) {
+  return KnownBits::constant(value, 1);
+}
+
+static KnownBits join(const KnownBits &a, const KnownBits &b) {
+  if (!a.width || a.width != b.width)
+    return KnownBits::top(a.width);
+  KnownBits res = a;
+  res.zeros &= b.zeros;
+  res.ones &= b.ones;
+  res.min = std::min(a.min, b.min);
+  res.max = std::max(a.max, b.max);
+  return res;
+}
+
+/// Return 0 if all the values of \a a are non-negative, 1 if all are
+/// negative, and -1 otherwise.
+static int getSignClass(const KnownBits &a) {
+  uint64_t half = 1ULL << (a.width - 1);
+  if (a.max < half)
+    return 0;
+  if (a.min >= half)
+    return 1;
+  return -1;
+}
+
+static KnownBits evalUlt(const KnownBits &a, const KnownBits &b) {
+  if (a.max < b.min)
+    return fromBool(true);
+  if (a.min >= b.max)
+    return fromBool(false);
+  return KnownBits::top(1);
+}
+
+static KnownBits evalUle(const KnownBits &a, const KnownBits &b) {
+  if (a.max <= b.min)
+    return fromBool(true);
+  if (a.min > b.max)
+    return fromBool(false);
+  return KnownBits::top(1);
+}
+
+static KnownBits evalSigned(const KnownBits &a, const KnownBits &b,
+                            bool orEqual) {
+  int ca = getSignClass(a), cb = getSignClass(b);
+  if (ca < 0 || cb < 0)
+    return KnownBits::top(1);
+  // Within one sign class, the signed and unsigned orders agree.
+  if (ca == cb)
+    return orEqual ? evalUle(a, b) : evalUlt(a, b);
+  return fromBool(ca == 1);
+}
+
+static KnownBits evalEq(const KnownBits &a, const KnownBits &b) {
+  if (a.isConstant() && b.isConstant() && a.min == b.min)
+    return fromBool(true);
+  if ((a.ones & b.zeros) || (a.zeros & b.ones) ||
+      a.max < b.min || b.max < a.min)
+    return fromBool(false);
+  return KnownBits::top(1);
+}
+
+static KnownBits evalNot(const KnownBits &a) {
+  if (!a.width)
+    return a;
+  uint64_t m = a.mask();
+  KnownBits res = a;
+  res.zeros = a.ones;
+  res.ones = a.zeros;
+  res.min = m - a.max;
+  res.max = m - a.min;
+  return res;
+}
+
+/// Match \a e against (And x mask), with a constant mask of up to 64 bits.
+static bool getMaskedOperand(const ref<Expr> &e, uint64_t &mask,
+                             ref<Expr> &operand) {
+  if (e->getKind() != Expr::And || e->getWidth() > 64)
+    return false;
+  for (unsigned i = 0; i != 2; ++i) {
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(i))) {
+      mask = CE->getZExtValue();
+      operand = e->getKid(1 - i);
+      return true;
+    }
+  }
+  return false;
+}
+
+/***/
+
+void ConstraintKnownBits::addConstraint(const ref<Expr> &e) {
+  learnTrue(e);
+  cache.clear();
+  ++numConstraints;
+}
+
+void ConstraintKnownBits::learn(const ref<Expr> &e, const KnownBits &value) {
+  if (!value.width || isa<ConstantExpr>(e) || e->getWidth() != value.width)
+    return;
+
+  std::pair<ExprHashMap<KnownBits>::iterator, bool> res =
+    facts.insert(std::make_pair(e, value));
+  KnownBits &fact = res.first->second;
+  if (!res.second && !fact.meet(value))
+    return;
+
+  // Push the fact down to the parts of the value.
+  switch (e->getKind()) {
+  case Expr::Concat: {
+    const ref<Expr> &hi = e->getKid(0), &lo = e->getKid(1);
+    Expr::Width lw = lo->getWidth();
+    learn(lo, fromBits(lw, fact.zeros, fact.ones));
+    KnownBits h = fromBits(hi->getWidth(), fact.zeros >> lw, fact.ones >> lw);
+    h.meet(fromRange(hi->getWidth(), fact.min >> lw, fact.max >> lw));
+    learn(hi, h);
+    break;
+  }
+  case Expr::ZExt: {
+    // The value is the operand itself.
+    const ref<Expr> &kid = e->getKid(0);
+    KnownBits k = fromBits(kid->getWidth(), fact.zeros, fact.ones);
+    if (fact.min <= k.max) {
+      k.meet(fromRange(kid->getWidth(), fact.min, std::min(fact.max, k.max)));
+      learn(kid, k);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void ConstraintKnownBits::learnMin(const ref<Expr> &e, uint64_t min) {
+  Expr::Width w = e->getWidth();
+  if (w > 64 || min > bits64::maxValueOfNBits(w))
+    return;
+  learn(e, fromRange(w, min, bits64::maxValueOfNBits(w)));
+}
+
+void ConstraintKnownBits::learnMax(const ref<Expr> &e, uint64_t max) {
+  Expr::Width w = e->getWidth();
+  if (w > 64)
+    return;
+  learn(e, fromRange(w, 0, std::min(max, bits64::maxValueOfNBits(w))));
+}
+
+void ConstraintKnownBits::learnTrue(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return;
+  learn(e, fromBool(true));
+
+  switch (e->getKind()) {
+  case Expr::Not:
+    learnFalse(e->getKid(0));
+    break;
+
+  case Expr::And:
+    learnTrue(e->getKid(0));
+    learnTrue(e->getKid(1));
+    break;
+
+  case Expr::Eq: {
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(0));
+    const ref<Expr> &r = e->getKid(1);
+    if (!CE || CE->getWidth() > 64)
+      break;
+    uint64_t value = CE->getZExtValue();
+    Expr::Width w = CE->getWidth();
+    if (w == Expr::Bool) {
+      if (value)
+        learnTrue(r);
+      else
+        learnFalse(r);
+      break;
+    }
+    learn(r, KnownBits::constant(value, w));
+    // (And x mask) == value fixes the bits of x under the mask.
+    uint64_t mask;
+    ref<Expr> operand;
+    if (getMaskedOperand(r, mask, operand) && !(value & ~mask))
+      learn(operand, fromBits(w, ~value & mask, value));
+    break;
+  }
+
+  case Expr::Ult:
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(1))) {
+      if (CE->getWidth() <= 64 && !CE->isZero())
+        learnMax(e->getKid(0), CE->getZExtValue() - 1);
+    } else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(0))) {
+      if (CE->getWidth() <= 64 && !CE->isAllOnes())
+        learnMin(e->getKid(1), CE->getZExtValue() + 1);
+    }
+    break;
+
+  case Expr::Ule:
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(1))) {
+      if (CE->getWidth() <= 64)
+        learnMax(e->getKid(0), CE->getZExtValue());
+    } else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(0))) {
+      if (CE->getWidth() <= 64)
+        learnMin(e->getKid(1), CE->getZExtValue());
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+void ConstraintKnownBits::learnFalse(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return;
+  learn(e, fromBool(false));
+
+  switch (e->getKind()) {
+  case Expr::Not:
+    learnTrue(e->getKid(0));
+    break;
+
+  case Expr::Or:
+    learnFalse(e->getKid(0));
+    learnFalse(e->getKid(1));
+    break;
+
+  case Expr::Eq: {
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(0));
+    const ref<Expr> &r = e->getKid(1);
+    if (!CE || CE->getWidth() > 64)
+      break;
+    uint64_t value = CE->getZExtValue();
+    Expr::Width w = CE->getWidth();
+    if (w == Expr::Bool) {
+      if (value)
+        learnFalse(r);
+      else
+        learnTrue(r);
+      break;
+    }
+    // Only a bound of the interval can be excluded.
+    if (value == 0)
+      learnMin(r, 1);
+    else if (value == bits64::maxValueOfNBits(w))
+      learnMax(r, value - 1);
+    // (And x bit) != value fixes the tested bit of x.
+    uint64_t bit;
+    ref<Expr> operand;
+    if (getMaskedOperand(r, bit, operand) && bits64::isPowerOfTwo(bit)) {
+      if (value == 0)
+        learn(operand, fromBits(w, 0, bit));
+      else if (value == bit)
+        learn(operand, fromBits(w, bit, 0));
+    }
+    break;
+  }
+
+  case Expr::Ult:
+    // !(a < b) is b <= a.
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(1))) {
+      if (CE->getWidth() <= 64)
+        learnMin(e->getKid(0), CE->getZExtValue());
+    } else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(0))) {
+      if (CE->getWidth() <= 64)
+        learnMax(e->getKid(1), CE->getZExtValue());
+    }
+    break;
+
+  case Expr::Ule:
+    // !(a <= b) is b < a.
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(1))) {
+      if (CE->getWidth() <= 64 && !CE->isAllOnes())
+        learnMin(e->getKid(0), CE->getZExtValue() + 1);
+    } else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(0))) {
+      if (CE->getWidth() <= 64 && !CE->isZero())
+        learnMax(e->getKid(1), CE->getZExtValue() - 1);
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+/***/
+
+KnownBits ConstraintKnownBits::evaluate(const ref<Expr> &e) const {
+  if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
+    if (CE->getWidth() > 64)
+      return KnownBits();
+    return KnownBits::constant(CE->getZExtValue(), CE->getWidth());
+  }
+
+  ExprHashMap<KnownBits>::iterator it = cache.find(e);
+  if (it != cache.end())
+    return it->second;
+
+  KnownBits res = compute(e);
+  ExprHashMap<KnownBits>::const_iterator fact = facts.find(e);
+  if (fact != facts.end())
+    res.meet(fact->second);
+
+  cache.insert(std::make_pair(e, res));
+  return res;
+}
+
+KnownBits ConstraintKnownBits::compute(const ref<Expr> &e) const {
+  Expr::Width w = e->getWidth();
+  KnownBits top = KnownBits::top(w);
+
+  switch (e->getKind()) {
+  case Expr::NotOptimized:
+    return evaluate(e->getKid(0));
+
+  case Expr::Select: {
+    KnownBits cond = evaluate(e->getKid(0));
+    if (cond.isTrue())
+      return evaluate(e->getKid(1));
+    if (cond.isFalse())
+      return evaluate(e->getKid(2));
+    return join(evaluate(e->getKid(1)), evaluate(e->getKid(2)));
+  }
+
+  case Expr::Not:
+    return evalNot(evaluate(e->getKid(0)));
+
+  case Expr::ZExt:
+  case Expr::SExt: {
+    KnownBits a = evaluate(e->getKid(0));
+    if (!a.width || !top.width)
+      return top;
+    uint64_t high = top.mask() & ~a.mask();
+    bool negative;
+    if (e->getKind() == Expr::ZExt || getSignClass(a) == 0) {
+      negative = false;
+    } else if (getSignClass(a) == 1) {
+      negative = true;
+    } else {
+      // Only the low bits are known.
+      return fromBits(w, a.zeros, a.ones);
+    }
+    KnownBits res = a;
+    res.width = w;
+    if (negative) {
+      res.ones |= high;
+      res.min |= high;
+      res.max |= high;
+    } else {
+      res.zeros |= high;
+    }
+    return res;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    KnownBits a = evaluate(ee->expr);
+    if (!a.width || !top.width)
+      return top;
+    unsigned offset = ee->offset;
+    KnownBits res = fromBits(w, a.zeros >> offset, a.ones >> offset);
+    // Without truncation, the interval shifts along.
+    if (offset + w == a.width)
+      res.meet(fromRange(w, a.min >> offset, a.max >> offset));
+    return res;
+  }
+
+  case Expr::Concat: {
+    KnownBits hi = evaluate(e->getKid(0)), lo = evaluate(e->getKid(1));
+    if (!hi.width || !lo.width || !top.width)
+      return top;
+    unsigned lw = lo.width;
+    KnownBits res = top;
+    res.zeros = (hi.zeros << lw) | lo.zeros;
+    res.ones = (hi.ones << lw) | lo.ones;
+    res.min = (hi.min << lw) | lo.min;
+    res.max = (hi.max << lw) | lo.max;
+    if (!res.normalize())
+      return top;
+    return res;
+  }
+
+  default:
+    break;
+  }
+
+  if (e->getNumKids() != 2)
+    return top;
+
+  KnownBits a = evaluate(e->getKid(0)), b = evaluate(e->getKid(1));
+  if (!a.width || !b.width)
+    return top;
+
+  switch (e->getKind()) {
+  case Expr::Add:
+    if (a.max <= a.mask() - b.max)
+      return fromRange(w, a.min + b.min, a.max + b.max);
+    return top;
+
+  case Expr::Sub:
+    if (a.min >= b.max)
+      return fromRange(w, a.min - b.max, a.max - b.min);
+    return top;
+
+  case Expr::Mul:
+    if (!a.max || !b.max)
+      return KnownBits::constant(0, w);
+    if (a.max <= a.mask() / b.max)
+      return fromRange(w, a.min * b.min, a.max * b.max);
+    return top;
+
+  case Expr::UDiv:
+    if (b.min)
+      return fromRange(w, a.min / b.max, a.max / b.min);
+    return top;
+
+  case Expr::URem:
+    if (!b.min)
+      return top;
+    if (a.max < b.min)
+      return a;
+    return fromRange(w, 0, std::min(a.max, b.max - 1));
+
+  case Expr::And: {
+    KnownBits res = fromBits(w, a.zeros | b.zeros, a.ones & b.ones);
+    res.meet(fromRange(w, 0, std::min(a.max, b.max)));
+    return res;
+  }
+
+  case Expr::Or: {
+    KnownBits res = fromBits(w, a.zeros & b.zeros, a.ones | b.ones);
+    res.meet(fromRange(w, std::max(a.min, b.min), res.mask()));
+    return res;
+  }
+
+  case Expr::Xor:
+    return fromBits(w, (a.zeros & b.zeros) | (a.ones & b.ones),
+                    (a.zeros & b.ones) | (a.ones & b.zeros));
+
+  case Expr::Shl:
+  case Expr::LShr: {
+    if (!b.isConstant() || b.min >= w)
+      return top;
+    unsigned shift = b.min;
+    uint64_t m = top.mask();
+    if (e->getKind() == Expr::Shl) {
+      KnownBits res = fromBits(w, (a.zeros << shift) | ((1ULL << shift) - 1),
+                               a.ones << shift);
+      if (a.max <= (m >> shift))
+        res.meet(fromRange(w, a.min << shift, a.max << shift));
+      return res;
+    }
+    KnownBits res = fromBits(w, (a.zeros >> shift) | (m & ~(m >> shift)),
+                             a.ones >> shift);
+    res.meet(fromRange(w, a.min >> shift, a.max >> shift));
+    return res;
+  }
+
+  case Expr::Eq:
+    return evalEq(a, b);
+  case Expr::Ne:
+    return evalNot(evalEq(a, b));
+  case Expr::Ult:
+    return evalUlt(a, b);
+  case Expr::Ule:
+    return evalUle(a, b);
+  case Expr::Ugt:
+    return evalUlt(b, a);
+  case Expr::Uge:
+    return evalUle(b, a);
+  case Expr::Slt:
+    return evalSigned(a, b, false);
+  case Expr::Sle:
+    return evalSigned(a, b, true);
+  case Expr::Sgt:
+    return evalSigned(b, a, false);
+  case Expr::Sge:
+    return evalSigned(b, a, true);
+
+  default:
+    return top;
+  }
+}
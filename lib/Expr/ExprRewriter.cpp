@@ -0,0 +1,246 @@
+//===-- ExprRewriter.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ExprRewriter.h"
+
+#include "klee/util/Bits.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+using namespace klee;
+
+void ExprRewriter::addRule(const ExprRewriteRule &rule) {
+  rulesByKind[rule.kind].push_back(rules.size());
+  rules.push_back(rule);
+  hits.push_back(0);
+}
+
+bool ExprRewriter::matches(const ExprRewriteRule &rule,
+                           const ref<Expr> &e) const {
+  Expr::Width w = e->getWidth();
+  if (w < rule.minWidth || w > rule.maxWidth)
+    return false;
+  for (unsigned i = 0; i != 2; ++i) {
+    if (rule.kidKinds[i] == Expr::InvalidKind)
+      continue;
+    if (i >= e->getNumKids() || e->getKid(i)->getKind() != rule.kidKinds[i])
+      return false;
+  }
+  return true;
+}
+
+ref<Expr> ExprRewriter::rewrite(ref<Expr> e) {
+  for (unsigned step = 0; step != MaxSteps; ++step) {
+    const std::vector<unsigned> &candidates = rulesByKind[e->getKind()];
+    ref<Expr> res;
+    for (std::vector<unsigned>::const_iterator it = candidates.begin(),
+           ie = candidates.end(); it != ie; ++it) {
+      const ExprRewriteRule &rule = rules[*it];
+      if (!matches(rule, e))
+        continue;
+      res = rule.apply(e);
+      if (!res.isNull()) {
+        ++hits[*it];
+        break;
+      }
+    }
+    if (res.isNull())
+      break;
+    e = res;
+  }
+  return e;
+}
+
+void ExprRewriter::printStats(llvm::raw_ostream &os,
+                              const char *prefix) const {
+  for (unsigned i = 0, e = rules.size(); i != e; ++i)
+    if (hits[i])
+      os << prefix << "rewrite rule " << rules[i].name << ": "
+         << hits[i] << " hits\n";
+}
+
+/***/
+
+// Extract(Extract(x, o1), o2) = Extract(x, o1 + o2)
+static ref<Expr> extractOfExtract(const ref<Expr> &e) {
+  const ExtractExpr *ee = cast<ExtractExpr>(e);
+  const ExtractExpr *kid = cast<ExtractExpr>(ee->expr);
+  return ExtractExpr::create(kid->expr, kid->offset + ee->offset,
+                             ee->getWidth());
+}
+
+// Extract(ZExt(x)) takes bits of x, zeros, or both.
+static ref<Expr> extractOfZExt(const ref<Expr> &e) {
+  const ExtractExpr *ee = cast<ExtractExpr>(e);
+  const ref<Expr> &src = cast<ZExtExpr>(ee->expr)->src;
+  unsigned off = ee->offset, w = ee->getWidth(), sw = src->getWidth();
+  if (off + w <= sw)
+    return ExtractExpr::create(src, off, w);
+  if (off >= sw)
+    return ConstantExpr::create(0, w);
+  return ZExtExpr::create(ExtractExpr::create(src, off, sw - off), w);
+}
+
+// Extract(SExt(x)) takes bits of x, copies of its sign bit, or both.
+static ref<Expr> extractOfSExt(const ref<Expr> &e) {
+  const ExtractExpr *ee = cast<ExtractExpr>(e);
+  const ref<Expr> &src = cast<SExtExpr>(ee->expr)->src;
+  unsigned off = ee->offset, w = ee->getWidth(), sw = src->getWidth();
+  if (off + w <= sw)
+    return ExtractExpr::create(src, off, w);
+  if (off >= sw - 1)
+    return SExtExpr::create(ExtractExpr::create(src, sw - 1, 1), w);
+  return SExtExpr::create(ExtractExpr::create(src, off, sw - off), w);
+}
+
+// ZExt(ZExt(x)) = ZExt(x), and so is SExt(ZExt(x)), as the sign bit of a
+// widening ZExt is zero.
+static ref<Expr> extOfZExt(const ref<Expr> &e) {
+  const CastExpr *ce = cast<CastExpr>(e);
+  return ZExtExpr::create(cast<ZExtExpr>(ce->src)->src, ce->getWidth());
+}
+
+// SExt(SExt(x)) = SExt(x)
+static ref<Expr> sextOfSExt(const ref<Expr> &e) {
+  const SExtExpr *se = cast<SExtExpr>(e);
+  return SExtExpr::create(cast<SExtExpr>(se->src)->src, se->getWidth());
+}
+
+// Concat(0, x) = ZExt(x)
+static ref<Expr> concatOfZero(const ref<Expr> &e) {
+  if (!cast<ConstantExpr>(e->getKid(0))->isZero())
+    return 0;
+  return ZExtExpr::create(e->getKid(1), e->getWidth());
+}
+
+// And(LShr(x, c), 2^k - 1) selects k bits of x from bit c on.
+static ref<Expr> andMaskOfLShr(const ref<Expr> &e) {
+  const ref<Expr> &shift = e->getKid(0);
+  const ConstantExpr *amount = dyn_cast<ConstantExpr>(shift->getKid(1));
+  uint64_t mask = cast<ConstantExpr>(e->getKid(1))->getZExtValue();
+  unsigned w = e->getWidth();
+  if (!amount || amount->getZExtValue() >= w ||
+      !bits64::isPowerOfTwo(mask + 1))
+    return 0;
+  unsigned c = amount->getZExtValue();
+  unsigned k = bits64::indexOfSingleBit(mask + 1);
+  // A mask covering all the bits shifted in is redundant.
+  if (c + k >= w)
+    return shift;
+  return ZExtExpr::create(ExtractExpr::create(shift->getKid(0), c, k), w);
+}
+
+// And(Shl(x, c), m) only keeps the bits of m from bit c on.
+static ref<Expr> andMaskOfShl(const ref<Expr> &e) {
+  const ref<Expr> &shift = e->getKid(0);
+  const ConstantExpr *amount = dyn_cast<ConstantExpr>(shift->getKid(1));
+  ref<ConstantExpr> mask = cast<ConstantExpr>(e->getKid(1));
+  unsigned w = e->getWidth();
+  if (!amount || amount->getZExtValue() >= w)
+    return 0;
+  uint64_t high =
+    bits64::maxValueOfNBits(w) & ~bits64::maxValueOfNBits(
+      amount->getZExtValue());
+  uint64_t m = mask->getZExtValue();
+  if (!(m & high))
+    return ConstantExpr::create(0, w);
+  if ((m & high) == high)
+    return shift;
+  if (m & ~high)
+    return AndExpr::create(shift, ConstantExpr::create(m & high, w));
+  return 0;
+}
+
+// ZExt(x) == ZExt(y) iff x == y, for x and y of the same width.
+static ref<Expr> eqOfZExts(const ref<Expr> &e) {
+  const ref<Expr> &l = cast<ZExtExpr>(e->getKid(0))->src;
+  const ref<Expr> &r = cast<ZExtExpr>(e->getKid(1))->src;
+  if (l->getWidth() != r->getWidth())
+    return 0;
+  return EqExpr::create(l, r);
+}
+
+// Compare the operand of a ZExt with a constant at the operand's width,
+// deciding the comparison if the constant is out of its range.
+static ref<Expr> compareZExtWithConstant(Expr::Kind k, bool constantOnLeft,
+                                         const ref<Expr> &src,
+                                         const ref<ConstantExpr> &c) {
+  unsigned sw = src->getWidth();
+  if (c->getAPValue().isIntN(sw)) {
+    ref<Expr> t = c->Extract(0, sw);
+    if (constantOnLeft)
+      return k == Expr::Ult ? UltExpr::create(t, src)
+                            : UleExpr::create(t, src);
+    return k == Expr::Ult ? UltExpr::create(src, t) : UleExpr::create(src, t);
+  }
+  // The constant is larger than any value of the operand.
+  return ConstantExpr::create(!constantOnLeft, Expr::Bool);
+}
+
+static ref<Expr> compareOfZExtConstant(const ref<Expr> &e) {
+  return compareZExtWithConstant(e->getKind(), false,
+                                 cast<ZExtExpr>(e->getKid(0))->src,
+                                 cast<ConstantExpr>(e->getKid(1)));
+}
+
+static ref<Expr> compareOfConstantZExt(const ref<Expr> &e) {
+  return compareZExtWithConstant(e->getKind(), true,
+                                 cast<ZExtExpr>(e->getKid(1))->src,
+                                 cast<ConstantExpr>(e->getKid(0)));
+}
+
+#define ANY Expr::InvalidKind
+#define ALL_WIDTHS 1, ~0U
+
+static const ExprRewriteRule builtinRules[] = {
+  { "extract-of-extract", Expr::Extract, { Expr::Extract, ANY },
+    ALL_WIDTHS, extractOfExtract },
+  { "extract-of-zext", Expr::Extract, { Expr::ZExt, ANY },
+    ALL_WIDTHS, extractOfZExt },
+  { "extract-of-sext", Expr::Extract, { Expr::SExt, ANY },
+    ALL_WIDTHS, extractOfSExt },
+  { "zext-of-zext", Expr::ZExt, { Expr::ZExt, ANY },
+    ALL_WIDTHS, extOfZExt },
+  { "sext-of-zext", Expr::SExt, { Expr::ZExt, ANY },
+    ALL_WIDTHS, extOfZExt },
+  { "sext-of-sext", Expr::SExt, { Expr::SExt, ANY },
+    ALL_WIDTHS, sextOfSExt },
+  { "concat-of-zero", Expr::Concat, { Expr::Constant, ANY },
+    ALL_WIDTHS, concatOfZero },
+  { "and-mask-of-lshr", Expr::And, { Expr::LShr, Expr::Constant },
+    2, 64, andMaskOfLShr },
+  { "and-mask-of-shl", Expr::And, { Expr::Shl, Expr::Constant },
+    2, 64, andMaskOfShl },
+  { "eq-of-zexts", Expr::Eq, { Expr::ZExt, Expr::ZExt },
+    ALL_WIDTHS, eqOfZExts },
+  { "ult-of-zext-constant", Expr::Ult, { Expr::ZExt, Expr::Constant },
+    ALL_WIDTHS, compareOfZExtConstant },
+  { "ult-of-constant-zext", Expr::Ult, { Expr::Constant, Expr::ZExt },
+    ALL_WIDTHS, compareOfConstantZExt },
+  { "ule-of-zext-constant", Expr::Ule, { Expr::ZExt, Expr::Constant },
+    ALL_WIDTHS, compareOfZExtConstant },
+  { "ule-of-constant-zext", Expr::Ule, { Expr::Constant, Expr::ZExt },
+    ALL_WIDTHS, compareOfConstantZExt },
+};
+
+#undef ANY
+#undef ALL_WIDTHS
+
+// Like the expression allocators, the default rewriter is never destroyed,
+// as expressions may be built during the destruction of static objects.
+ExprRewriter &ExprRewriter::getDefault() {
+  static ExprRewriter *rewriter = 0;
+  if (!rewriter) {
+    rewriter = new ExprRewriter();
+    for (unsigned i = 0, e = sizeof(builtinRules) / sizeof(builtinRules[0]);
+         i != e; ++i)
+      rewriter->addRule(builtinRules[i]);
+  }
+  return *rewriter;
+}
@@ -0,0 +1,397 @@
+//===-- ExprSerializer.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ExprSerializer.h"
+#include "klee/util/ArrayCache.h"
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include <cassert>
+#include <cstring>
+
+using namespace klee;
+
+namespace {
+  enum RecordTag {
+    TagArray = 1,
+    TagUpdate,
+    TagExpr,
+    TagExprRef,
+    TagArrayRef,
+    TagArrayAddress,
+    TagUpdateListRef
+  };
+
+  const unsigned NoUpdate = ~0U;
+  const unsigned NoArray = ~0U;
+}
+
+/***/
+
+void ExprSerializer::writeU32(uint32_t v) {
+  unsigned char buf[sizeof(v)];
+  memcpy(buf, &v, sizeof(v));
+  out.insert(out.end(), buf, buf + sizeof(v));
+}
+
+void ExprSerializer::writeU64(uint64_t v) {
+  unsigned char buf[sizeof(v)];
+  memcpy(buf, &v, sizeof(v));
+  out.insert(out.end(), buf, buf + sizeof(v));
+}
+
+void ExprSerializer::writeString(const std::string &s) {
+  writeU32(s.size());
+  out.insert(out.end(), s.begin(), s.end());
+}
+
+static void writeAPInt(ExprSerializer &s, const llvm::APInt &v) {
+  const uint64_t *words = v.getRawData();
+  for (unsigned i = 0, e = v.getNumWords(); i != e; ++i)
+    s.writeU64(words[i]);
+}
+
+unsigned ExprSerializer::defineArray(const Array *array) {
+  llvm::DenseMap<const Array*, unsigned>::iterator it = arrayIDs.find(array);
+  if (it != arrayIDs.end())
+    return it->second;
+
+  if (arraysByAddress) {
+    writeU8(TagArrayAddress);
+    writeU64(reinterpret_cast<uintptr_t>(array));
+    unsigned id = arrayIDs.size();
+    arrayIDs[array] = id;
+    return id;
+  }
+
+  writeU8(TagArray);
+  writeString(anonymousArrays ? std::string() : array->name);
+  writeU32(array->size);
+  writeU32(array->domain);
+  writeU32(array->range);
+  writeU32(array->constantValues.size());
+  for (unsigned i = 0, e = array->constantValues.size(); i != e; ++i)
+    writeAPInt(*this, array->constantValues[i]->getAPValue());
+
+  unsigned id = arrayIDs.size();
+  arrayIDs[array] = id;
+  return id;
+}
+
+unsigned ExprSerializer::defineUpdates(const UpdateNode *head) {
+  if (!head)
+    return NoUpdate;
+
+  // Update lists can be very long, so walk them iteratively, oldest node
+  // first, stopping at the first node that was already written.
+  std::vector<const UpdateNode*> pending;
+  for (const UpdateNode *un = head; un && !updateIDs.count(un); un = un->next)
+    pending.push_back(un);
+
+  for (std::vector<const UpdateNode*>::reverse_iterator it = pending.rbegin(),
+         ie = pending.rend(); it != ie; ++it) {
+    const UpdateNode *un = *it;
+    unsigned next = un->next ? updateIDs[un->next] : NoUpdate;
+    unsigned index = defineExpr(un->index);
+    unsigned value = defineExpr(un->value);
+
+    writeU8(TagUpdate);
+    writeU32(next);
+    writeU32(index);
+    writeU32(value);
+
+    unsigned id = updateIDs.size();
+    updateIDs[un] = id;
+  }
+
+  return updateIDs[head];
+}
+
+unsigned ExprSerializer::defineExpr(const ref<Expr> &e) {
+  llvm::DenseMap<const Expr*, unsigned>::iterator it = exprIDs.find(e.get());
+  if (it != exprIDs.end())
+    return it->second;
+
+  Expr::Kind k = e->getKind();
+  unsigned kids[3];
+  unsigned root = 0, head = NoUpdate;
+
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    root = defineArray(re->updates.root);
+    head = defineUpdates(re->updates.head);
+    kids[0] = defineExpr(re->index);
+  } else {
+    assert(e->getNumKids() <= 3 && "unexpected number of kids");
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+      kids[i] = defineExpr(e->getKid(i));
+  }
+
+  writeU8(TagExpr);
+  writeU8(k);
+  switch (k) {
+  case Expr::Constant: {
+    const ConstantExpr *ce = cast<ConstantExpr>(e);
+    writeU32(ce->getWidth());
+    writeAPInt(*this, ce->getAPValue());
+    break;
+  }
+  case Expr::Read:
+    writeU32(root);
+    writeU32(head);
+    writeU32(kids[0]);
+    break;
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    writeU32(kids[0]);
+    writeU32(ee->offset);
+    writeU32(ee->width);
+    break;
+  }
+  case Expr::ZExt:
+  case Expr::SExt:
+    writeU32(kids[0]);
+    writeU32(e->getWidth());
+    break;
+  default:
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+      writeU32(kids[i]);
+    break;
+  }
+
+  unsigned id = exprIDs.size();
+  exprIDs[e.get()] = id;
+  return id;
+}
+
+void ExprSerializer::write(const ref<Expr> &e) {
+  unsigned id = defineExpr(e);
+  writeU8(TagExprRef);
+  writeU32(id);
+}
+
+void ExprSerializer::write(const Array *array) {
+  unsigned id = defineArray(array);
+  writeU8(TagArrayRef);
+  writeU32(id);
+}
+
+void ExprSerializer::write(const UpdateList &updates) {
+  unsigned root = updates.root ? defineArray(updates.root) : NoArray;
+  unsigned head = defineUpdates(updates.head);
+  writeU8(TagUpdateListRef);
+  writeU32(root);
+  writeU32(head);
+}
+
+/***/
+
+uint8_t ExprDeserializer::readU8() {
+  assert(pos + 1 <= end && "truncated expression stream");
+  return *pos++;
+}
+
+uint32_t ExprDeserializer::readU32() {
+  uint32_t v;
+  assert(pos + sizeof(v) <= end && "truncated expression stream");
+  memcpy(&v, pos, sizeof(v));
+  pos += sizeof(v);
+  return v;
+}
+
+uint64_t ExprDeserializer::readU64() {
+  uint64_t v;
+  assert(pos + sizeof(v) <= end && "truncated expression stream");
+  memcpy(&v, pos, sizeof(v));
+  pos += sizeof(v);
+  return v;
+}
+
+std::string ExprDeserializer::readString() {
+  uint32_t len = readU32();
+  assert(pos + len <= end && "truncated expression stream");
+  std::string s((const char*) pos, len);
+  pos += len;
+  return s;
+}
+
+static llvm::APInt readAPInt(ExprDeserializer &d, Expr::Width w) {
+  llvm::SmallVector<uint64_t, 2> words;
+  for (unsigned i = 0, e = (w + 63) / 64; i != e; ++i)
+    words.push_back(d.readU64());
+  return llvm::APInt(w, llvm::ArrayRef<uint64_t>(words));
+}
+
+#define BINARY_EXPR_CASE(_kind)                                         \
+  case Expr::_kind: {                                                   \
+    ref<Expr> l = exprs[readU32()];                                     \
+    ref<Expr> r = exprs[readU32()];                                     \
+    exprs.push_back(_kind ## Expr::alloc(l, r));                        \
+    break;                                                              \
+  }
+
+void ExprDeserializer::readDefinition(uint8_t tag) {
+  switch (tag) {
+  case TagArray: {
+    std::string name = readString();
+    uint32_t size = readU32();
+    Expr::Width domain = readU32();
+    Expr::Width range = readU32();
+    std::vector<ref<ConstantExpr> > values(readU32());
+    for (unsigned i = 0, e = values.size(); i != e; ++i)
+      values[i] = ConstantExpr::alloc(readAPInt(*this, range));
+    const Array *array;
+    if (values.empty())
+      array = arrayCache.CreateArray(name, size, 0, 0, domain, range);
+    else
+      array = arrayCache.CreateArray(name, size, &values[0],
+                                     &values[0] + values.size(),
+                                     domain, range);
+    arrays.push_back(array);
+    break;
+  }
+
+  case TagArrayAddress:
+    arrays.push_back(reinterpret_cast<const Array*>(
+                       static_cast<uintptr_t>(readU64())));
+    break;
+
+  case TagUpdate: {
+    uint32_t next = readU32();
+    ref<Expr> index = exprs[readU32()];
+    ref<Expr> value = exprs[readU32()];
+    UpdateList ul(0, next == NoUpdate ? 0 : updates[next].head);
+    ul.extend(index, value);
+    updates.push_back(ul);
+    break;
+  }
+
+  case TagExpr: {
+    Expr::Kind k = (Expr::Kind) readU8();
+    switch (k) {
+    case Expr::Constant: {
+      Expr::Width w = readU32();
+      exprs.push_back(ConstantExpr::alloc(readAPInt(*this, w)));
+      break;
+    }
+    case Expr::NotOptimized:
+      exprs.push_back(NotOptimizedExpr::alloc(exprs[readU32()]));
+      break;
+    case Expr::Read: {
+      const Array *root = arrays[readU32()];
+      uint32_t head = readU32();
+      ref<Expr> index = exprs[readU32()];
+      UpdateList ul(root, head == NoUpdate ? 0 : updates[head].head);
+      exprs.push_back(ReadExpr::alloc(ul, index));
+      break;
+    }
+    case Expr::Select: {
+      ref<Expr> c = exprs[readU32()];
+      ref<Expr> t = exprs[readU32()];
+      ref<Expr> f = exprs[readU32()];
+      exprs.push_back(SelectExpr::alloc(c, t, f));
+      break;
+    }
+    case Expr::Concat: {
+      ref<Expr> l = exprs[readU32()];
+      ref<Expr> r = exprs[readU32()];
+      exprs.push_back(ConcatExpr::alloc(l, r));
+      break;
+    }
+    case Expr::Extract: {
+      ref<Expr> kid = exprs[readU32()];
+      unsigned offset = readU32();
+      Expr::Width w = readU32();
+      exprs.push_back(ExtractExpr::alloc(kid, offset, w));
+      break;
+    }
+    case Expr::ZExt: {
+      ref<Expr> kid = exprs[readU32()];
+      exprs.push_back(ZExtExpr::alloc(kid, readU32()));
+      break;
+    }
+    case Expr::SExt: {
+      ref<Expr> kid = exprs[readU32()];
+      exprs.push_back(SExtExpr::alloc(kid, readU32()));
+      break;
+    }
+    case Expr::Not:
+      exprs.push_back(NotExpr::alloc(exprs[readU32()]));
+      break;
+
+    BINARY_EXPR_CASE(Add)
+    BINARY_EXPR_CASE(Sub)
+    BINARY_EXPR_CASE(Mul)
+    BINARY_EXPR_CASE(UDiv)
+    BINARY_EXPR_CASE(SDiv)
+    BINARY_EXPR_CASE(URem)
+    BINARY_EXPR_CASE(SRem)
+    BINARY_EXPR_CASE(And)
+    BINARY_EXPR_CASE(Or)
+    BINARY_EXPR_CASE(Xor)
+    BINARY_EXPR_CASE(Shl)
+    BINARY_EXPR_CASE(LShr)
+    BINARY_EXPR_CASE(AShr)
+    BINARY_EXPR_CASE(Eq)
+    BINARY_EXPR_CASE(Ne)
+    BINARY_EXPR_CASE(Ult)
+    BINARY_EXPR_CASE(Ule)
+    BINARY_EXPR_CASE(Ugt)
+    BINARY_EXPR_CASE(Uge)
+    BINARY_EXPR_CASE(Slt)
+    BINARY_EXPR_CASE(Sle)
+    BINARY_EXPR_CASE(Sgt)
+    BINARY_EXPR_CASE(Sge)
+
+    default:
+      assert(0 && "invalid expression kind in stream");
+    }
+    break;
+  }
+
+  default:
+    assert(0 && "invalid record in expression stream");
+  }
+}
+
+#undef BINARY_EXPR_CASE
+
+ref<Expr> ExprDeserializer::readExpr() {
+  for (;;) {
+    uint8_t tag = readU8();
+    if (tag == TagExprRef)
+      return exprs[readU32()];
+    assert(tag != TagArrayRef && "expected an expression reference");
+    readDefinition(tag);
+  }
+}
+
+const Array *ExprDeserializer::readArray() {
+  for (;;) {
+    uint8_t tag = readU8();
+    if (tag == TagArrayRef)
+      return arrays[readU32()];
+    assert(tag != TagExprRef && "expected an array reference");
+    readDefinition(tag);
+  }
+}
+
+UpdateList ExprDeserializer::readUpdateList() {
+  for (;;) {
+    uint8_t tag = readU8();
+    if (tag == TagUpdateListRef) {
+      uint32_t root = readU32();
+      uint32_t head = readU32();
+      return UpdateList(root == NoArray ? 0 : arrays[root],
+                        head == NoUpdate ? 0 : updates[head].head);
+    }
+    assert(tag != TagExprRef && tag != TagArrayRef &&
+           "expected an update list reference");
+    readDefinition(tag);
+  }
+}
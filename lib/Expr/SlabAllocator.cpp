@@ -0,0 +1,104 @@
+//===-- SlabAllocator.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/SlabAllocator.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <new>
+
+using namespace klee;
+
+SlabAllocator::SlabAllocator(const char *_name)
+  : name(_name), slabBegin(0), slabEnd(0) {
+  for (unsigned i = 0; i != NumClasses; ++i)
+    freeLists[i] = 0;
+  for (unsigned i = 0; i != NumClasses + 1; ++i)
+    live[i] = peak[i] = 0;
+}
+
+SlabAllocator::~SlabAllocator() {
+  for (std::vector<void*>::iterator it = slabs.begin(), ie = slabs.end();
+       it != ie; ++it)
+    ::operator delete(*it);
+}
+
+void *SlabAllocator::allocateSlow(unsigned sizeClass) {
+  // Whatever is left of the current slab is too small for this class; hand
+  // it out to the free lists of the smaller classes which still fit.
+  while (slabEnd != slabBegin) {
+    size_t rest = slabEnd - slabBegin;
+    size_t blockSize = rest < MaxSize ? rest : MaxSize;
+    unsigned c = getSizeClass(blockSize);
+    FreeBlock *b = reinterpret_cast<FreeBlock*>(slabBegin);
+    b->next = freeLists[c];
+    freeLists[c] = b;
+    slabBegin += blockSize;
+  }
+
+  slabBegin = static_cast<char*>(::operator new(SlabSize));
+  slabEnd = slabBegin + SlabSize;
+  slabs.push_back(slabBegin);
+
+  void *p = slabBegin;
+  slabBegin += (sizeClass + 1) * Granularity;
+  return p;
+}
+
+void *SlabAllocator::allocateLarge(size_t size) {
+  if (++live[NumClasses] > peak[NumClasses])
+    peak[NumClasses] = live[NumClasses];
+  return ::operator new(size);
+}
+
+void SlabAllocator::deallocateLarge(void *p) {
+  --live[NumClasses];
+  ::operator delete(p);
+}
+
+void SlabAllocator::printStats(llvm::raw_ostream &os,
+                               const char *prefix) const {
+  for (unsigned i = 0; i != NumClasses + 1; ++i) {
+    if (!peak[i])
+      continue;
+    os << prefix << name << " objects of ";
+    if (i == NumClasses) {
+      os << "more than " << MaxSize;
+    } else {
+      os << (i + 1) * Granularity;
+    }
+    os << " bytes: live = " << live[i] << ", peak = " << peak[i] << "\n";
+  }
+  os << prefix << name << " slabs = " << slabs.size() << " ("
+     << (slabs.size() * SlabSize) / 1024 << " KB)\n";
+}
+
+uint64_t SlabAllocator::getNumLive() const {
+  uint64_t n = 0;
+  for (unsigned i = 0; i != NumClasses; ++i)
+    n += live[i];
+  return n;
+}
+
+// The allocators are never destroyed, as expressions held by globals may
+// outlive any static object.
+SlabAllocator &klee::getExprAllocator() {
+  static SlabAllocator *allocator = new SlabAllocator("Expr");
+  return *allocator;
+}
+
+SlabAllocator &klee::getUpdateNodeAllocator() {
+  static SlabAllocator *allocator = new SlabAllocator("UpdateNode");
+  return *allocator;
+}
+
+SlabAllocator &klee::getMemoryAllocator() {
+  static SlabAllocator *allocator = new SlabAllocator("Memory");
+  return *allocator;
+}
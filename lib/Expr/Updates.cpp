@@ -8,11 +8,35 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/Expr.h"
+#include "klee/util/SlabAllocator.h"
 
 #include <cassert>
+#include <ciso646>
+#ifdef _LIBCPP_VERSION
+#include <unordered_map>
+#define unordered_map std::unordered_map
+#else
+#include <tr1/unordered_map>
+#define unordered_map std::tr1::unordered_map
+#endif
 
 using namespace klee;
 
+namespace klee {
+  /// UpdateNodeIndex - The newest update at each constant index among the
+  /// updates newer than \a rest, the newest update at a symbolic index.
+  class UpdateNodeIndex {
+  public:
+    unordered_map<uint64_t, const UpdateNode*> newest;
+    const UpdateNode *rest;
+
+    UpdateNodeIndex(const UpdateNode *_rest) : rest(_rest) {}
+  };
+}
+
+/// Update lists up to this size are searched without an index.
+static const unsigned MinIndexedUpdates = 16;
+
 ///
 
 UpdateNode::UpdateNode(const UpdateNode *_next, 
@@ -21,7 +45,8 @@ UpdateNode::UpdateNode(const UpdateNode *_next,
   : refCount(0),    
     next(_next),
     index(_index),
-    value(_value) {
+    value(_value),
+    lookup(0) {
   // FIXME: What we need to check here instead is that _value is of the same width 
   // as the range of the array that the update node is part of.
   /*
@@ -36,6 +61,14 @@ UpdateNode::UpdateNode(const UpdateNode *_next,
   else size = 1;
 }
 
+void *UpdateNode::operator new(size_t size) {
+  return getUpdateNodeAllocator().allocate(size);
+}
+
+void UpdateNode::operator delete(void *p, size_t size) {
+  getUpdateNodeAllocator().deallocate(p, size);
+}
+
 extern "C" void vc_DeleteExpr(void*);
 
 // This is deliberately empty to avoid recursively deleting UpdateNodes
@@ -44,6 +77,7 @@ extern "C" void vc_DeleteExpr(void*);
 // non-recursively.
 UpdateNode::~UpdateNode() {
     assert(refCount == 0 && "Deleted UpdateNode when a reference is still held");
+    delete lookup;
 }
 
 int UpdateNode::compare(const UpdateNode &b) const {
@@ -156,6 +190,47 @@ void UpdateList::extend(const ref<Expr> &index, const ref<Expr> &value) {
   ++head->refCount;
 }
 
+const UpdateNode *UpdateList::findConstantUpdate(uint64_t index,
+                                                 const UpdateNode *&rest) const {
+  if (!head || head->getSize() <= MinIndexedUpdates) {
+    for (rest = head; rest; rest = rest->next) {
+      const ConstantExpr *CE = dyn_cast<ConstantExpr>(rest->index);
+      if (!CE)
+        break;
+      if (CE->getZExtValue() == index)
+        return rest;
+    }
+    return 0;
+  }
+
+  if (!head->lookup) {
+    // Take over the index of the newest indexed update older than the head,
+    // which is less likely to be searched again, and add the updates
+    // since.
+    std::vector<const UpdateNode*> newer;
+    const UpdateNode *un = head;
+    UpdateNodeIndex *lookup = 0;
+    for (; un && isa<ConstantExpr>(un->index); un = un->next) {
+      if (un->lookup) {
+        std::swap(lookup, un->lookup);
+        break;
+      }
+      newer.push_back(un);
+    }
+    if (!lookup)
+      lookup = new UpdateNodeIndex(un);
+    for (std::vector<const UpdateNode*>::reverse_iterator it = newer.rbegin(),
+           ie = newer.rend(); it != ie; ++it)
+      lookup->newest[cast<ConstantExpr>((*it)->index)->getZExtValue()] = *it;
+    head->lookup = lookup;
+  }
+
+  rest = head->lookup->rest;
+  unordered_map<uint64_t, const UpdateNode*>::const_iterator it =
+    head->lookup->newest.find(index);
+  return it == head->lookup->newest.end() ? 0 : it->second;
+}
+
 int UpdateList::compare(const UpdateList &b) const {
   if (root->name != b.root->name)
     return root->name < b.root->name ? -1 : 1;
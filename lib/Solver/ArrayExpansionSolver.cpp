@@ -0,0 +1,331 @@
+//===-- ArrayExpansionSolver.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A solver layer which removes the reads from small arrays from queries, so
+// that the core solver gets bit-vector problems instead of problems in the
+// theory of arrays.
+//
+// A read at a symbolic index, or through updates, becomes a chain of selects
+// over the updates, newest first, and then over the elements of the array,
+// which are reads at constant indices, i.e. plain variables. The value of a
+// read beyond the end of the array is a fresh variable; Ackermann
+// constraints make such variables equal whenever their indices are, as the
+// array would. Counterexamples are still in terms of the original arrays.
+//
+// An array is only expanded if all of its reads can be: it must be small,
+// must not be read at a constant index beyond its end, and must not be read
+// at too many symbolic indices.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/util/ArrayCache.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+
+#include <map>
+#include <sstream>
+
+using namespace klee;
+
+namespace {
+  /// The maximum number of distinct symbolic index reads of an expanded
+  /// array, which bounds the number of Ackermann constraints.
+  const unsigned MaxSymbolicReads = 32;
+
+  /// QueryExpander - Expand the reads of the small arrays of a single query.
+  class QueryExpander {
+    ArrayCache &arrayCache;
+    unsigned maxSize;
+
+    /// Whether each array read by the query is expanded.
+    llvm::DenseMap<const Array*, bool> expanded;
+    /// The symbolic indices each array is read at.
+    llvm::DenseMap<const Array*, llvm::DenseSet<const Expr*> > symbolicReads;
+    llvm::DenseSet<const Expr*> visited;
+    llvm::DenseSet<const UpdateNode*> visitedUpdates;
+
+    llvm::DenseMap<const Expr*, ref<Expr> > exprs;
+    /// The expanded reads of each array at each symbolic index, and the
+    /// fresh variables standing for the value beyond its end.
+    std::map<std::pair<const Array*, ref<Expr> >, ref<Expr> > elementReads;
+    std::map<const Array*, std::vector<std::pair<ref<Expr>, ref<Expr> > > >
+      outOfBoundReads;
+    unsigned numFresh;
+
+    void collect(const ref<Expr> &e);
+    void collect(const UpdateNode *head);
+    ref<Expr> getElement(const Array *array, unsigned index);
+    ref<Expr> expandRead(const Array *array, const ref<Expr> &index);
+
+  public:
+    QueryExpander(ArrayCache &_arrayCache, unsigned _maxSize,
+                  const Query &query);
+
+    ref<Expr> visit(const ref<Expr> &e);
+    /// visit - Return the expanded constraints of the query, followed by
+    /// the Ackermann constraints of the fresh variables.
+    std::vector< ref<Expr> > visit(const ConstraintManager &constraints,
+                                   const ref<Expr> &expr,
+                                   ref<Expr> &expandedExpr);
+  };
+}
+
+QueryExpander::QueryExpander(ArrayCache &_arrayCache, unsigned _maxSize,
+                             const Query &query)
+  : arrayCache(_arrayCache), maxSize(_maxSize), numFresh(0) {
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+         ie = query.constraints.end(); it != ie; ++it)
+    collect(*it);
+  collect(query.expr);
+
+  for (llvm::DenseMap<const Array*, bool>::iterator it = expanded.begin(),
+         ie = expanded.end(); it != ie; ++it)
+    if (symbolicReads[it->first].size() > MaxSymbolicReads)
+      it->second = false;
+  visited.clear();
+  visitedUpdates.clear();
+  symbolicReads.clear();
+}
+
+void QueryExpander::collect(const UpdateNode *head) {
+  for (const UpdateNode *un = head; un; un = un->next) {
+    if (!visitedUpdates.insert(un).second)
+      break;
+    collect(un->index);
+    collect(un->value);
+  }
+}
+
+void QueryExpander::collect(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e) || !visited.insert(e.get()).second)
+    return;
+
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    const Array *root = re->updates.root;
+    std::pair<llvm::DenseMap<const Array*, bool>::iterator, bool> res =
+      expanded.insert(std::make_pair(root, true));
+    if (res.second && (root->size > maxSize || root->getDomain() > 64))
+      res.first->second = false;
+
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
+      // The value beyond the end would have to agree with the fresh
+      // variables of the symbolic reads.
+      if (CE->getZExtValue() >= root->size)
+        res.first->second = false;
+    } else {
+      symbolicReads[root].insert(re->index.get());
+    }
+    collect(re->updates.head);
+  }
+
+  for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+    collect(e->getKid(i));
+}
+
+ref<Expr> QueryExpander::getElement(const Array *array, unsigned index) {
+  if (array->isConstantArray())
+    return array->constantValues[index];
+  return ReadExpr::create(UpdateList(array, 0),
+                          ConstantExpr::create(index, array->getDomain()));
+}
+
+ref<Expr> QueryExpander::expandRead(const Array *array,
+                                    const ref<Expr> &index) {
+  if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(index))
+    if (CE->getZExtValue() < array->size)
+      return getElement(array, CE->getZExtValue());
+
+  ref<Expr> &res = elementReads[std::make_pair(array, index)];
+  if (!res.isNull())
+    return res;
+
+  // The k-th fresh variable of every query is the same array, so the
+  // arrays are only created once.
+  std::ostringstream name;
+  name << "ackermann" << numFresh++ << "_" << array->getRange();
+  const Array *fresh = arrayCache.CreateArray(name.str(), 1, 0, 0,
+                                              Expr::Int32, array->getRange());
+  ref<Expr> outOfBound =
+    ReadExpr::create(UpdateList(fresh, 0), ConstantExpr::create(0, 32));
+  outOfBoundReads[array].push_back(std::make_pair(index, outOfBound));
+
+  res = outOfBound;
+  for (unsigned i = array->size; i != 0; --i) {
+    ref<Expr> cond = EqExpr::create(
+      index, ConstantExpr::create(i - 1, array->getDomain()));
+    res = SelectExpr::create(cond, getElement(array, i - 1), res);
+  }
+  return res;
+}
+
+ref<Expr> QueryExpander::visit(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return e;
+
+  llvm::DenseMap<const Expr*, ref<Expr> >::iterator it = exprs.find(e.get());
+  if (it != exprs.end())
+    return it->second;
+
+  ref<Expr> res;
+  const ReadExpr *re = dyn_cast<ReadExpr>(e);
+  if (re && expanded.lookup(re->updates.root) &&
+      (re->updates.head || !isa<ConstantExpr>(re->index))) {
+    ref<Expr> index = visit(re->index);
+    res = expandRead(re->updates.root, index);
+
+    // Apply the updates, oldest first.
+    std::vector<const UpdateNode*> updates;
+    for (const UpdateNode *un = re->updates.head; un; un = un->next)
+      updates.push_back(un);
+    for (std::vector<const UpdateNode*>::reverse_iterator
+           it = updates.rbegin(), ie = updates.rend(); it != ie; ++it)
+      res = SelectExpr::create(EqExpr::create(index, visit((*it)->index)),
+                               visit((*it)->value), res);
+  } else if (re) {
+    // Reads of arrays which are not expanded keep their updates, which may
+    // still read expanded arrays.
+    std::vector<const UpdateNode*> updates;
+    bool changed = false;
+    for (const UpdateNode *un = re->updates.head; un; un = un->next) {
+      updates.push_back(un);
+      changed |= visit(un->index) != un->index ||
+                 visit(un->value) != un->value;
+    }
+    ref<Expr> index = visit(re->index);
+    if (changed) {
+      UpdateList ul(re->updates.root, 0);
+      for (std::vector<const UpdateNode*>::reverse_iterator
+             it = updates.rbegin(), ie = updates.rend(); it != ie; ++it)
+        ul.extend(visit((*it)->index), visit((*it)->value));
+      res = ReadExpr::create(ul, index);
+    } else if (index != re->index) {
+      res = ReadExpr::create(re->updates, index);
+    } else {
+      res = e;
+    }
+  } else {
+    ref<Expr> kids[8];
+    unsigned n = e->getNumKids();
+    assert(n <= 8 && "unexpected number of kids");
+    bool changed = false;
+    for (unsigned i = 0; i != n; ++i) {
+      kids[i] = visit(e->getKid(i));
+      changed |= kids[i] != e->getKid(i);
+    }
+    res = changed ? e->rebuild(kids) : e;
+  }
+
+  exprs.insert(std::make_pair(e.get(), res));
+  return res;
+}
+
+std::vector< ref<Expr> >
+QueryExpander::visit(const ConstraintManager &constraints,
+                     const ref<Expr> &expr, ref<Expr> &expandedExpr) {
+  std::vector< ref<Expr> > res;
+  for (ConstraintManager::const_iterator it = constraints.begin(),
+         ie = constraints.end(); it != ie; ++it)
+    res.push_back(visit(*it));
+  expandedExpr = visit(expr);
+
+  for (std::map<const Array*, std::vector<std::pair<ref<Expr>, ref<Expr> > > >
+         ::iterator it = outOfBoundReads.begin(), ie = outOfBoundReads.end();
+       it != ie; ++it) {
+    const std::vector<std::pair<ref<Expr>, ref<Expr> > > &reads = it->second;
+    for (unsigned i = 0, e = reads.size(); i != e; ++i)
+      for (unsigned j = i + 1; j != e; ++j)
+        res.push_back(Expr::createImplies(
+                        EqExpr::create(reads[i].first, reads[j].first),
+                        EqExpr::create(reads[i].second, reads[j].second)));
+  }
+  return res;
+}
+
+/***/
+
+class ArrayExpansionSolver : public SolverImpl {
+private:
+  Solver *solver;
+  unsigned maxSize;
+  /// Owns the fresh variables, which are shared by all queries.
+  ArrayCache arrayCache;
+
+public:
+  ArrayExpansionSolver(Solver *s, unsigned _maxSize)
+    : solver(s), maxSize(_maxSize) {}
+  ~ArrayExpansionSolver() { delete solver; }
+
+  bool computeValidity(const Query&, Solver::Validity &result);
+  bool computeTruth(const Query&, bool &isValid);
+  bool computeValue(const Query&, ref<Expr> &result);
+  bool computeInitialValues(const Query& query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query&);
+  void setCoreSolverTimeout(double timeout);
+};
+
+bool ArrayExpansionSolver::computeValidity(const Query& query,
+                                           Solver::Validity &result) {
+  QueryExpander x(arrayCache, maxSize, query);
+  ref<Expr> expr;
+  ConstraintManager constraints(x.visit(query.constraints, query.expr, expr));
+  return solver->impl->computeValidity(Query(constraints, expr), result);
+}
+
+bool ArrayExpansionSolver::computeTruth(const Query& query, bool &isValid) {
+  QueryExpander x(arrayCache, maxSize, query);
+  ref<Expr> expr;
+  ConstraintManager constraints(x.visit(query.constraints, query.expr, expr));
+  return solver->impl->computeTruth(Query(constraints, expr), isValid);
+}
+
+bool ArrayExpansionSolver::computeValue(const Query& query,
+                                        ref<Expr> &result) {
+  QueryExpander x(arrayCache, maxSize, query);
+  ref<Expr> expr;
+  ConstraintManager constraints(x.visit(query.constraints, query.expr, expr));
+  return solver->impl->computeValue(Query(constraints, expr), result);
+}
+
+bool ArrayExpansionSolver::computeInitialValues(
+    const Query& query, const std::vector<const Array*> &objects,
+    std::vector< std::vector<unsigned char> > &values, bool &hasSolution) {
+  QueryExpander x(arrayCache, maxSize, query);
+  ref<Expr> expr;
+  ConstraintManager constraints(x.visit(query.constraints, query.expr, expr));
+  return solver->impl->computeInitialValues(Query(constraints, expr), objects,
+                                            values, hasSolution);
+}
+
+SolverImpl::SolverRunStatus ArrayExpansionSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *ArrayExpansionSolver::getConstraintLog(const Query& query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void ArrayExpansionSolver::setCoreSolverTimeout(double timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+///
+
+Solver *klee::createArrayExpansionSolver(Solver *s, unsigned maxSize) {
+  return new Solver(new ArrayExpansionSolver(s, maxSize));
+}
@@ -0,0 +1,66 @@
+//===-- AssertionStack.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_ASSERTIONSTACK_H
+#define KLEE_ASSERTIONSTACK_H
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+
+#include <vector>
+
+namespace klee {
+
+/// AssertionStack - Book-keeping for an incremental solver context which
+/// keeps the constraints of earlier queries asserted, each one in its own
+/// push/pop scope.
+///
+/// States created by a fork start with the constraints of their parent, and
+/// consecutive queries of one state only ever append to them, so the
+/// constraints of a query usually share a long prefix with what is already
+/// asserted. Only the scopes past that prefix have to be popped, and only the
+/// remaining constraints of the query have to be asserted.
+class AssertionStack {
+  std::vector<ref<Expr> > asserted;
+
+public:
+  /// lastUse - Tick of the last query which used this context, for picking a
+  /// context to evict.
+  uint64_t lastUse;
+
+  AssertionStack() : lastUse(0) {}
+
+  unsigned size() const { return asserted.size(); }
+
+  /// commonPrefix - Return the number of leading constraints of \a
+  /// constraints which are already asserted.
+  unsigned commonPrefix(const ConstraintManager &constraints) const {
+    unsigned n = 0;
+    for (ConstraintManager::const_iterator it = constraints.begin(),
+           ie = constraints.end(); it != ie && n != asserted.size(); ++it, ++n) {
+      const ref<Expr> &e = asserted[n];
+      // Constraints of related states are normally shared, but fall back
+      // to a structural comparison for queries which were rebuilt.
+      if (e.get() != it->get() &&
+          (e->hash() != (*it)->hash() || e != *it))
+        break;
+    }
+    return n;
+  }
+
+  /// truncate - Forget all but the first \a n assertions. The caller is
+  /// responsible for popping the corresponding scopes.
+  void truncate(unsigned n) { asserted.resize(n); }
+
+  void push(const ref<Expr> &e) { asserted.push_back(e); }
+};
+
+}
+
+#endif /* KLEE_ASSERTIONSTACK_H */
@@ -0,0 +1,336 @@
+//===-- CanonicalizingSolver.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A solver layer which rewrites queries into a canonical form before passing
+// them on, so that the caches below it see the same query for queries which
+// only differ in the identity of their symbolic arrays or in the order of the
+// operands of commutative operations.
+//
+// Symbolic arrays are renamed by first occurrence to arrays owned by this
+// solver, which are reused by every query, and the operands of commutative
+// operations are ordered by a hash of their structure which does not depend
+// on array identities. Constant arrays are left alone. Counterexamples are
+// returned per requested object, so they map back to the original arrays by
+// position.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/ExprUtil.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+
+#include <sstream>
+
+using namespace klee;
+
+namespace {
+  /// QueryCanonicalizer - Rewrite the expressions of a single query.
+  class QueryCanonicalizer {
+    ArrayCache &arrayCache;
+
+    llvm::DenseMap<const Array*, const Array*> arrays;
+    llvm::DenseMap<const Expr*, ref<Expr> > exprs;
+    llvm::DenseMap<const UpdateNode*, const UpdateNode*> updates;
+    /// Keeps the rewritten update nodes alive.
+    std::vector<UpdateList> updateLists;
+
+    llvm::DenseMap<const Expr*, uint64_t> exprShapes;
+    llvm::DenseMap<const UpdateNode*, uint64_t> updateShapes;
+    /// A summary of the expressions of the query each symbolic array occurs
+    /// in, part of the shape of its reads.
+    llvm::DenseMap<const Array*, uint64_t> signatures;
+
+    uint64_t shape(const ref<Expr> &e);
+    uint64_t shape(const UpdateNode *head);
+    const UpdateNode *visitUpdates(const UpdateNode *head);
+
+  public:
+    QueryCanonicalizer(ArrayCache &_arrayCache, const Query &query);
+
+    const Array *visit(const Array *array);
+    ref<Expr> visit(const ref<Expr> &e);
+    std::vector< ref<Expr> > visit(const ConstraintManager &constraints);
+  };
+}
+
+static uint64_t mix(uint64_t h, uint64_t v) {
+  return h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+}
+
+static bool isCommutative(Expr::Kind k) {
+  switch (k) {
+  case Expr::Add:
+  case Expr::Mul:
+  case Expr::And:
+  case Expr::Or:
+  case Expr::Xor:
+  case Expr::Eq:
+  case Expr::Ne:
+    return true;
+  default:
+    return false;
+  }
+}
+
+QueryCanonicalizer::QueryCanonicalizer(ArrayCache &_arrayCache,
+                                       const Query &query)
+  : arrayCache(_arrayCache) {
+  // Arrays used in the same way by an expression, such as the operands of
+  // (Add (Read a) (Read b)), have the same shape there. Tell them apart by
+  // their other uses, so that the order in which they are renamed does not
+  // depend on how the operands happened to be ordered.
+  std::vector< ref<Expr> > roots(query.constraints.begin(),
+                                 query.constraints.end());
+  roots.push_back(query.expr);
+  for (unsigned i = 0, e = roots.size(); i != e; ++i) {
+    uint64_t h = mix(shape(roots[i]), i + 1 == e);
+    std::vector<const Array*> objects;
+    findSymbolicObjects(roots[i], objects);
+    for (unsigned j = 0, je = objects.size(); j != je; ++j)
+      signatures[objects[j]] += h;
+  }
+  exprShapes.clear();
+  updateShapes.clear();
+}
+
+const Array *QueryCanonicalizer::visit(const Array *array) {
+  if (array->isConstantArray())
+    return array;
+
+  const Array *&canonical = arrays[array];
+  if (!canonical) {
+    // The array cache uniques symbolic arrays by name and size, so the n-th
+    // array of every query maps to the same object.
+    std::ostringstream name;
+    name << "canon" << arrays.size() - 1;
+    if (array->getDomain() != Expr::Int32 || array->getRange() != Expr::Int8)
+      name << "_" << array->getDomain() << "_" << array->getRange();
+    canonical = arrayCache.CreateArray(name.str(), array->size, 0, 0,
+                                       array->getDomain(), array->getRange());
+  }
+  return canonical;
+}
+
+/// shape - A structural hash of \a head and the nodes following it which
+/// does not depend on the identity of symbolic arrays.
+uint64_t QueryCanonicalizer::shape(const UpdateNode *head) {
+  if (!head)
+    return 0;
+
+  // Walk long update lists iteratively, oldest node first.
+  std::vector<const UpdateNode*> pending;
+  for (const UpdateNode *un = head; un && !updateShapes.count(un);
+       un = un->next)
+    pending.push_back(un);
+  for (std::vector<const UpdateNode*>::reverse_iterator it = pending.rbegin(),
+         ie = pending.rend(); it != ie; ++it) {
+    const UpdateNode *n = *it;
+    uint64_t h = n->next ? updateShapes[n->next] : 0;
+    h = mix(mix(h, shape(n->index)), shape(n->value));
+    updateShapes[n] = h;
+  }
+  return updateShapes[head];
+}
+
+uint64_t QueryCanonicalizer::shape(const ref<Expr> &e) {
+  llvm::DenseMap<const Expr*, uint64_t>::iterator it = exprShapes.find(e.get());
+  if (it != exprShapes.end())
+    return it->second;
+
+  uint64_t h = mix(e->getKind(), e->getWidth());
+  if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+    h = mix(h, llvm::hash_value(ce->getAPValue()));
+  } else if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    const Array *root = re->updates.root;
+    h = mix(h, root->size);
+    if (root->isConstantArray())
+      h = mix(h, root->hash());
+    else
+      h = mix(h, signatures.lookup(root));
+    h = mix(h, shape(re->updates.head));
+    h = mix(h, shape(re->index));
+  } else if (isCommutative(e->getKind())) {
+    uint64_t a = shape(e->getKid(0)), b = shape(e->getKid(1));
+    h = mix(mix(h, std::min(a, b)), std::max(a, b));
+  } else {
+    if (const ExtractExpr *ee = dyn_cast<ExtractExpr>(e))
+      h = mix(h, ee->offset);
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+      h = mix(h, shape(e->getKid(i)));
+  }
+
+  exprShapes[e.get()] = h;
+  return h;
+}
+
+const UpdateNode *QueryCanonicalizer::visitUpdates(const UpdateNode *head) {
+  if (!head)
+    return 0;
+
+  std::vector<const UpdateNode*> pending;
+  for (const UpdateNode *un = head; un && !updates.count(un); un = un->next)
+    pending.push_back(un);
+  for (std::vector<const UpdateNode*>::reverse_iterator it = pending.rbegin(),
+         ie = pending.rend(); it != ie; ++it) {
+    const UpdateNode *un = *it;
+    ref<Expr> index = visit(un->index);
+    ref<Expr> value = visit(un->value);
+    UpdateList ul(0, un->next ? updates[un->next] : 0);
+    ul.extend(index, value);
+    updateLists.push_back(ul);
+    updates[un] = ul.head;
+  }
+  return updates[head];
+}
+
+ref<Expr> QueryCanonicalizer::visit(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return e;
+
+  llvm::DenseMap<const Expr*, ref<Expr> >::iterator it = exprs.find(e.get());
+  if (it != exprs.end())
+    return it->second;
+
+  ref<Expr> res;
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    const Array *root = visit(re->updates.root);
+    const UpdateNode *head = visitUpdates(re->updates.head);
+    ref<Expr> index = visit(re->index);
+    res = ReadExpr::alloc(UpdateList(root, head), index);
+  } else {
+    ref<Expr> kids[8];
+    unsigned n = e->getNumKids();
+    assert(n <= 8 && "unexpected number of kids");
+
+    // Visit the operands of commutative operations in the order of their
+    // shapes, which fixes the order in which their arrays are renamed. Once
+    // the arrays are renamed, operands with the same shape can be ordered by
+    // their structure. Constant operands sort first, which keeps them on the
+    // left where the expression builders expect them.
+    bool commutative = isCommutative(e->getKind()) &&
+      !isa<ConstantExpr>(e->getKid(0));
+    bool swap = commutative && shape(e->getKid(1)) < shape(e->getKid(0));
+
+    bool changed = swap;
+    for (unsigned i = 0; i != n; ++i) {
+      unsigned k = swap ? n - 1 - i : i;
+      kids[i] = visit(e->getKid(k));
+      changed |= kids[i].get() != e->getKid(k).get();
+    }
+    if (commutative && shape(kids[0]) == shape(kids[1]) &&
+        kids[1].compare(kids[0]) < 0) {
+      std::swap(kids[0], kids[1]);
+      changed = true;
+    }
+    res = changed ? e->rebuild(kids) : e;
+  }
+
+  exprs.insert(std::make_pair(e.get(), res));
+  return res;
+}
+
+std::vector< ref<Expr> >
+QueryCanonicalizer::visit(const ConstraintManager &constraints) {
+  std::vector< ref<Expr> > res;
+  for (ConstraintManager::const_iterator it = constraints.begin(),
+         ie = constraints.end(); it != ie; ++it)
+    res.push_back(visit(*it));
+  return res;
+}
+
+/***/
+
+class CanonicalizingSolver : public SolverImpl {
+private:
+  Solver *solver;
+  /// Owns the canonical arrays, which are shared by all queries.
+  ArrayCache arrayCache;
+
+public:
+  CanonicalizingSolver(Solver *s) : solver(s) {}
+  ~CanonicalizingSolver() { delete solver; }
+
+  bool computeValidity(const Query&, Solver::Validity &result);
+  bool computeTruth(const Query&, bool &isValid);
+  bool computeValue(const Query&, ref<Expr> &result);
+  bool computeInitialValues(const Query& query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query&);
+  void setCoreSolverTimeout(double timeout);
+};
+
+bool CanonicalizingSolver::computeValidity(const Query& query,
+                                           Solver::Validity &result) {
+  QueryCanonicalizer c(arrayCache, query);
+  ConstraintManager constraints(c.visit(query.constraints));
+  return solver->impl->computeValidity(Query(constraints, c.visit(query.expr)),
+                                       result);
+}
+
+bool CanonicalizingSolver::computeTruth(const Query& query, bool &isValid) {
+  QueryCanonicalizer c(arrayCache, query);
+  ConstraintManager constraints(c.visit(query.constraints));
+  return solver->impl->computeTruth(Query(constraints, c.visit(query.expr)),
+                                    isValid);
+}
+
+bool CanonicalizingSolver::computeValue(const Query& query,
+                                        ref<Expr> &result) {
+  QueryCanonicalizer c(arrayCache, query);
+  ConstraintManager constraints(c.visit(query.constraints));
+  return solver->impl->computeValue(Query(constraints, c.visit(query.expr)),
+                                    result);
+}
+
+bool CanonicalizingSolver::computeInitialValues(
+    const Query& query, const std::vector<const Array*> &objects,
+    std::vector< std::vector<unsigned char> > &values, bool &hasSolution) {
+  QueryCanonicalizer c(arrayCache, query);
+  ConstraintManager constraints(c.visit(query.constraints));
+  ref<Expr> expr = c.visit(query.expr);
+
+  // Objects which do not occur in the query still get arrays of their own.
+  // The values come back in the order of the objects, which is all the
+  // mapping back to the original arrays needs.
+  std::vector<const Array*> canonicalObjects;
+  for (unsigned i = 0, e = objects.size(); i != e; ++i)
+    canonicalObjects.push_back(c.visit(objects[i]));
+
+  return solver->impl->computeInitialValues(Query(constraints, expr),
+                                            canonicalObjects, values,
+                                            hasSolution);
+}
+
+SolverImpl::SolverRunStatus CanonicalizingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *CanonicalizingSolver::getConstraintLog(const Query& query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void CanonicalizingSolver::setCoreSolverTimeout(double timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+///
+
+Solver *klee::createCanonicalizingSolver(Solver *s) {
+  return new Solver(new CanonicalizingSolver(s));
+}
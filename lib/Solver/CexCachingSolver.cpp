@@ -14,6 +14,8 @@
 #include "klee/SolverImpl.h"
 #include "klee/TimerStatIncrementer.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/ExprBatchEvaluator.h"
+#include "klee/util/ExprHashMap.h"
 #include "klee/util/ExprUtil.h"
 #include "klee/util/ExprVisitor.h"
 #include "klee/Internal/ADT/MapOfSets.h"
@@ -44,6 +46,14 @@ namespace {
   cl::opt<bool>
   CexCacheExperimental("cex-cache-exp", cl::init(false));
 
+  /// The number of cached counterexamples from which the scan of
+  /// -cex-cache-try-all evaluates constraints under all of them at once;
+  /// below it, each one is tried in turn.
+  const unsigned MinBatchAssignments = 8;
+
+  /// The number of constraints whose batch evaluators are kept; beyond it
+  /// they are dropped and compiled again on their next use.
+  const unsigned MaxEvaluators = 4096;
 }
 
 ///
@@ -65,6 +75,12 @@ class CexCachingSolver : public SolverImpl {
   MapOfSets<ref<Expr>, Assignment*> cache;
   // memo table
   assignmentsTable_ty assignmentsTable;
+  /// The batch evaluators of the constraints scanned so far, since the same
+  /// constraints recur in the queries along a path.
+  ExprHashMap<ExprBatchEvaluator*> evaluators;
+
+  const ExprBatchEvaluator &getEvaluator(const ref<Expr> &e);
+  void clearEvaluators();
 
   bool searchForAssignment(KeyType &key, 
                            Assignment *&result);
@@ -146,12 +162,46 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
     }
 
     // Otherwise, iterate through the set of current assignments to see if one
-    // of them satisfies the query.
-    for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
-           ie = assignmentsTable.end(); it != ie; ++it) {
-      Assignment *a = *it;
-      if (a->satisfies(key.begin(), key.end())) {
-        result = a;
+    // of them satisfies the query. Compiling the constraints only pays off
+    // for enough assignments; then each constraint is evaluated under all of
+    // them at once.
+    if (assignmentsTable.size() < MinBatchAssignments) {
+      for (assignmentsTable_ty::iterator it = assignmentsTable.begin(),
+             ie = assignmentsTable.end(); it != ie; ++it) {
+        Assignment *a = *it;
+        if (a->satisfies(key.begin(), key.end())) {
+          result = a;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    std::vector<Assignment*> assignments(assignmentsTable.begin(),
+                                         assignmentsTable.end());
+    std::vector<const Assignment*> candidates(assignments.begin(),
+                                              assignments.end());
+    std::vector<unsigned char> satisfied(candidates.size(), 1);
+    std::vector<uint64_t> values;
+    std::vector<unsigned char> known;
+    unsigned numSatisfied = candidates.size();
+    for (KeyType::iterator it = key.begin(), ie = key.end();
+         it != ie && numSatisfied; ++it) {
+      getEvaluator(*it).evaluate(candidates, values, known);
+      for (unsigned i = 0, e = candidates.size(); i != e; ++i) {
+        if (!satisfied[i])
+          continue;
+        if (known[i])
+          satisfied[i] = values[i] != 0;
+        else
+          satisfied[i] = assignments[i]->evaluate(*it)->isTrue();
+        if (!satisfied[i])
+          --numSatisfied;
+      }
+    }
+    for (unsigned i = 0, e = candidates.size(); i != e; ++i) {
+      if (satisfied[i]) {
+        result = assignments[i];
         return true;
       }
     }
@@ -182,6 +232,25 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
   return false;
 }
 
+const ExprBatchEvaluator &CexCachingSolver::getEvaluator(const ref<Expr> &e) {
+  ExprHashMap<ExprBatchEvaluator*>::iterator it = evaluators.find(e);
+  if (it != evaluators.end())
+    return *it->second;
+
+  if (evaluators.size() >= MaxEvaluators)
+    clearEvaluators();
+  ExprBatchEvaluator *evaluator = new ExprBatchEvaluator(e);
+  evaluators.insert(std::make_pair(e, evaluator));
+  return *evaluator;
+}
+
+void CexCachingSolver::clearEvaluators() {
+  for (ExprHashMap<ExprBatchEvaluator*>::iterator it = evaluators.begin(),
+         ie = evaluators.end(); it != ie; ++it)
+    delete it->second;
+  evaluators.clear();
+}
+
 /// lookupAssignment - Lookup a cached result for the given \arg query.
 ///
 /// \param query - The query to lookup.
@@ -259,6 +328,7 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
 
 CexCachingSolver::~CexCachingSolver() {
   cache.clear();
+  clearEvaluators();
   delete solver;
   for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
          ie = assignmentsTable.end(); it != ie; ++it)
@@ -66,7 +66,10 @@ Solver *createCoreSolver(CoreSolverType cst) {
   case STP_SOLVER:
 #ifdef ENABLE_STP
     llvm::errs() << "Using STP solver backend\n";
-    return new STPSolver(UseForkedCoreSolver, CoreSolverOptimizeDivides);
+    if (UseSolverWorkerPool)
+      return createWorkerPoolSolver(cst);
+    return new STPSolver(UseForkedCoreSolver, CoreSolverOptimizeDivides,
+                         UseIncrementalSolver);
 #else
     llvm::errs() << "Not compiled with STP support\n";
     return NULL;
@@ -84,7 +87,9 @@ Solver *createCoreSolver(CoreSolverType cst) {
   case Z3_SOLVER:
 #ifdef ENABLE_Z3
     llvm::errs() << "Using Z3 solver backend\n";
-    return new Z3Solver();
+    if (UseSolverWorkerPool)
+      return createWorkerPoolSolver(cst);
+    return new Z3Solver(UseIncrementalSolver);
 #else
     llvm::errs() << "Not compiled with Z3 support\n";
     return NULL;
@@ -56,14 +56,6 @@ public:
     return modified;
   }
 
-  bool intersects(const DenseSet &b) {
-    for (typename set_ty::iterator it = s.begin(), ie = s.end(); 
-         it != ie; ++it)
-      if (b.s.count(*it))
-        return true;
-    return false;
-  }
-
   std::set<unsigned>::iterator begin(){
     return s.begin();
   }
@@ -182,32 +174,6 @@ public:
     os << "}";
   }
 
-  // more efficient when this is the smaller set
-  bool intersects(const IndependentElementSet &b) {
-    // If there are any symbolic arrays in our query that b accesses
-    for (std::set<const Array*>::iterator it = wholeObjects.begin(), 
-           ie = wholeObjects.end(); it != ie; ++it) {
-      const Array *array = *it;
-      if (b.wholeObjects.count(array) || 
-          b.elements.find(array) != b.elements.end())
-        return true;
-    }
-    for (elements_ty::iterator it = elements.begin(), ie = elements.end();
-         it != ie; ++it) {
-      const Array *array = it->first;
-      // if the array we access is symbolic in b
-      if (b.wholeObjects.count(array))
-        return true;
-      elements_ty::const_iterator it2 = b.elements.find(array);
-      // if any of the elements we access are also accessed by b
-      if (it2 != b.elements.end()) {
-        if (it->second.intersects(it2->second))
-          return true;
-      }
-    }
-    return false;
-  }
-
   // returns true iff set is changed by addition
   bool add(const IndependentElementSet &b) {
     for(unsigned i = 0; i < b.exprs.size(); i ++){
@@ -263,6 +229,10 @@ inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
 static std::list<IndependentElementSet>*
 getAllIndependentConstraintsSets(const Query &query) {
   std::list<IndependentElementSet> *factors = new std::list<IndependentElementSet>();
+  const ConstraintPartition &partition = query.constraints.getPartition();
+  // The factor of each class of the partition seen so far.
+  std::map<unsigned, IndependentElementSet*> classFactors;
+
   ConstantExpr *CE = dyn_cast<ConstantExpr>(query.expr);
   if (CE) {
     assert(CE && CE->isFalse() && "the expr should always be false and "
@@ -270,85 +240,51 @@ getAllIndependentConstraintsSets(const Query &query) {
   } else {
     ref<Expr> neg = Expr::createIsZero(query.expr);
     factors->push_back(IndependentElementSet(neg));
+    std::set<unsigned> classes;
+    partition.getClasses(query.expr, classes);
+    for (std::set<unsigned>::iterator it = classes.begin(), ie = classes.end();
+         it != ie; ++it)
+      classFactors[*it] = &factors->back();
   }
 
+  unsigned i = 0;
   for (ConstraintManager::const_iterator it = query.constraints.begin(),
                                          ie = query.constraints.end();
-       it != ie; ++it) {
-    // iterate through all the previously separated constraints.  Until we
-    // actually return, factors is treated as a queue of expressions to be
-    // evaluated.  If the queue property isn't maintained, then the exprs
-    // could be returned in an order different from how they came it, negatively
-    // affecting later stages.
-    factors->push_back(IndependentElementSet(*it));
-  }
-
-  bool doneLoop = false;
-  do {
-    doneLoop = true;
-    std::list<IndependentElementSet> *done =
-        new std::list<IndependentElementSet>;
-    while (factors->size() > 0) {
-      IndependentElementSet current = factors->front();
-      factors->pop_front();
-      // This list represents the set of factors that are separate from current.
-      // Those that are not inserted into this list (queue) intersect with
-      // current.
-      std::list<IndependentElementSet> *keep =
-          new std::list<IndependentElementSet>;
-      while (factors->size() > 0) {
-        IndependentElementSet compare = factors->front();
-        factors->pop_front();
-        if (current.intersects(compare)) {
-          if (current.add(compare)) {
-            // Means that we have added (z=y)added to (x=y)
-            // Now need to see if there are any (z=?)'s
-            doneLoop = false;
-          }
-        } else {
-          keep->push_back(compare);
-        }
+       it != ie; ++it, ++i) {
+    // Keep the constraints of a factor in the order they came in, so later
+    // stages see them in the same order.
+    unsigned c = partition.getClass(i);
+    if (c != ConstraintPartition::NoClass) {
+      std::map<unsigned, IndependentElementSet*>::iterator f =
+        classFactors.find(c);
+      if (f != classFactors.end()) {
+        f->second->add(IndependentElementSet(*it));
+        continue;
       }
-      done->push_back(current);
-      delete factors;
-      factors = keep;
     }
-    delete factors;
-    factors = done;
-  } while (!doneLoop);
+    factors->push_back(IndependentElementSet(*it));
+    if (c != ConstraintPartition::NoClass)
+      classFactors[c] = &factors->back();
+  }
 
   return factors;
 }
 
-static 
-IndependentElementSet getIndependentConstraints(const Query& query,
-                                                std::vector< ref<Expr> > &result) {
-  IndependentElementSet eltsClosure(query.expr);
-  std::vector< std::pair<ref<Expr>, IndependentElementSet> > worklist;
-
-  for (ConstraintManager::const_iterator it = query.constraints.begin(), 
-         ie = query.constraints.end(); it != ie; ++it)
-    worklist.push_back(std::make_pair(*it, IndependentElementSet(*it)));
-
-  // XXX This should be more efficient (in terms of low level copy stuff).
-  bool done = false;
-  do {
-    done = true;
-    std::vector< std::pair<ref<Expr>, IndependentElementSet> > newWorklist;
-    for (std::vector< std::pair<ref<Expr>, IndependentElementSet> >::iterator
-           it = worklist.begin(), ie = worklist.end(); it != ie; ++it) {
-      if (it->second.intersects(eltsClosure)) {
-        if (eltsClosure.add(it->second))
-          done = false;
-        result.push_back(it->first);
-        // Means that we have added (z=y)added to (x=y)
-        // Now need to see if there are any (z=?)'s
-      } else {
-        newWorklist.push_back(*it);
-      }
+static void getIndependentConstraints(const Query& query,
+                                      std::vector< ref<Expr> > &result) {
+  const ConstraintPartition &partition = query.constraints.getPartition();
+  std::set<unsigned> classes;
+  partition.getClasses(query.expr, classes);
+
+  if (!classes.empty()) {
+    unsigned i = 0;
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+           ie = query.constraints.end(); it != ie; ++it, ++i) {
+      unsigned c = partition.getClass(i);
+      if (c != ConstraintPartition::NoClass && classes.count(c))
+        result.push_back(*it);
     }
-    worklist.swap(newWorklist);
-  } while (!done);
+  }
 
   KLEE_DEBUG(
     std::set< ref<Expr> > reqset(result.begin(), result.end());
@@ -362,11 +298,7 @@ IndependentElementSet getIndependentConstraints(const Query& query,
       errs() << " " << (reqset.count(*it) ? "(required)" : "(independent)") << "\n";
       errs() << "\telts: " << IndependentElementSet(*it) << "\n";
     }
-    errs() << "elts closure: " << eltsClosure << "\n";
  );
-
-
-  return eltsClosure;
 }
 
 
@@ -414,8 +346,7 @@ public:
 bool IndependentSolver::computeValidity(const Query& query,
                                         Solver::Validity &result) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure =
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, required);
   ConstraintManager tmp(required);
   return solver->impl->computeValidity(Query(tmp, query.expr), 
                                        result);
@@ -423,8 +354,7 @@ bool IndependentSolver::computeValidity(const Query& query,
 
 bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, required);
   ConstraintManager tmp(required);
   return solver->impl->computeTruth(Query(tmp, query.expr), 
                                     isValid);
@@ -432,8 +362,7 @@ bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
 
 bool IndependentSolver::computeValue(const Query& query, ref<Expr> &result) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, required);
   ConstraintManager tmp(required);
   return solver->impl->computeValue(Query(tmp, query.expr), result);
 }
@@ -0,0 +1,494 @@
+//===-- PersistentCachingSolver.cpp ---------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A query result cache which lives in a memory mapped file, so that results
+// survive the process and are shared between KLEE runs (including concurrent
+// ones) on the same machine.
+//
+// Queries are keyed by a hash of their serialized form with array names
+// omitted, so queries which only differ in the names of their arrays share
+// an entry. The file holds an open addressing hash table followed by a
+// payload area. All accesses take an exclusive flock() on the file. When the
+// table or the payload area fills up, only the most recently used entries are
+// kept and the payload area is compacted.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/util/ExprSerializer.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace klee;
+
+namespace {
+  llvm::cl::opt<unsigned>
+  PersistentQueryCacheSize("persistent-query-cache-size",
+                           llvm::cl::init(256),
+                           llvm::cl::value_desc("MB"),
+                           llvm::cl::desc("Size of the file created for "
+                                          "--persistent-query-cache. The "
+                                          "least recently used entries are "
+                                          "evicted when it is full "
+                                          "(default=256)"));
+}
+
+namespace {
+  const uint32_t StoreMagic = 0x4b514331; // "KQC1"
+  const uint32_t StoreVersion = 1;
+
+  struct StoreHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fileSize;
+    uint64_t numBuckets;
+    uint64_t numEntries;
+    uint64_t dataBegin;
+    uint64_t dataTop;
+    uint64_t clock;
+    /// Set while the store is being modified, so that a process finding it
+    /// set after taking the lock knows that a writer died half way.
+    uint64_t writing;
+  };
+
+  struct StoreBucket {
+    uint64_t key[2];
+    uint64_t lastUse;
+    /// Offset of the payload in the file, 0 for an empty bucket.
+    uint64_t offset;
+    uint64_t length;
+  };
+
+  struct QueryKey {
+    uint64_t hash[2];
+  };
+
+  /// QueryResultStore - The memory mapped hash table backing the cache.
+  class QueryResultStore {
+    std::string path;
+    int fd;
+    unsigned char *base;
+    size_t mappedSize;
+
+    StoreHeader *header() const { return (StoreHeader*) base; }
+    StoreBucket *buckets() const {
+      return (StoreBucket*) (base + sizeof(StoreHeader));
+    }
+
+    QueryResultStore(const std::string &_path, int _fd, unsigned char *_base,
+                     size_t _mappedSize)
+      : path(_path), fd(_fd), base(_base), mappedSize(_mappedSize) {}
+
+    void lock();
+    void unlock();
+    void reset();
+    StoreBucket *findBucket(const QueryKey &key);
+    void evict();
+
+  public:
+    ~QueryResultStore();
+
+    /// open - Map the store at \a path, creating a store of \a size bytes if
+    /// the file does not exist yet. Returns null on failure.
+    static QueryResultStore *open(const std::string &path, uint64_t size);
+
+    bool lookup(const QueryKey &key, std::vector<unsigned char> &payload);
+    void insert(const QueryKey &key, const std::vector<unsigned char> &payload);
+  };
+}
+
+/// Initialize an empty table in a mapping of \a size bytes.
+static void initializeStore(unsigned char *base, uint64_t size) {
+  memset(base, 0, sizeof(StoreHeader));
+  StoreHeader *h = (StoreHeader*) base;
+  h->magic = StoreMagic;
+  h->version = StoreVersion;
+  h->fileSize = size;
+  // Spend about a quarter of the file on buckets, most payloads are small.
+  h->numBuckets = 1;
+  while (h->numBuckets * 2 * sizeof(StoreBucket) * 4 <= size)
+    h->numBuckets *= 2;
+  h->dataBegin = sizeof(StoreHeader) + h->numBuckets * sizeof(StoreBucket);
+  h->dataTop = h->dataBegin;
+  memset(base + sizeof(StoreHeader), 0, h->numBuckets * sizeof(StoreBucket));
+}
+
+static bool isValidStore(const unsigned char *base, uint64_t size) {
+  const StoreHeader *h = (const StoreHeader*) base;
+  return h->magic == StoreMagic && h->version == StoreVersion &&
+    h->fileSize == size && h->numBuckets &&
+    !(h->numBuckets & (h->numBuckets - 1)) &&
+    h->dataBegin == sizeof(StoreHeader) + h->numBuckets * sizeof(StoreBucket) &&
+    h->dataTop >= h->dataBegin && h->dataTop <= size;
+}
+
+QueryResultStore *QueryResultStore::open(const std::string &path,
+                                         uint64_t size) {
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    klee_warning("unable to open persistent query cache %s: %s",
+                 path.c_str(), strerror(errno));
+    return 0;
+  }
+
+  // Whoever gets the lock first creates the store.
+  while (flock(fd, LOCK_EX) < 0 && errno == EINTR)
+    ;
+  struct stat st;
+  if (fstat(fd, &st) < 0 ||
+      (st.st_size == 0 && ftruncate(fd, size) < 0) ||
+      fstat(fd, &st) < 0 || (uint64_t) st.st_size < sizeof(StoreHeader)) {
+    klee_warning("unable to size persistent query cache %s", path.c_str());
+    flock(fd, LOCK_UN);
+    close(fd);
+    return 0;
+  }
+
+  void *base = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    klee_warning("unable to map persistent query cache %s: %s",
+                 path.c_str(), strerror(errno));
+    flock(fd, LOCK_UN);
+    close(fd);
+    return 0;
+  }
+
+  QueryResultStore *store =
+    new QueryResultStore(path, fd, (unsigned char*) base, st.st_size);
+  if (!isValidStore(store->base, st.st_size)) {
+    if (store->header()->magic)
+      klee_warning("persistent query cache %s is invalid, clearing it",
+                   path.c_str());
+    initializeStore(store->base, st.st_size);
+  }
+  store->unlock();
+  return store;
+}
+
+QueryResultStore::~QueryResultStore() {
+  munmap(base, mappedSize);
+  close(fd);
+}
+
+void QueryResultStore::lock() {
+  while (flock(fd, LOCK_EX) < 0 && errno == EINTR)
+    ;
+  if (header()->writing) {
+    klee_warning("persistent query cache %s was left inconsistent, "
+                 "clearing it", path.c_str());
+    reset();
+  }
+}
+
+void QueryResultStore::unlock() {
+  flock(fd, LOCK_UN);
+}
+
+void QueryResultStore::reset() {
+  initializeStore(base, mappedSize);
+}
+
+StoreBucket *QueryResultStore::findBucket(const QueryKey &key) {
+  uint64_t mask = header()->numBuckets - 1;
+  for (uint64_t i = key.hash[0] & mask;; i = (i + 1) & mask) {
+    StoreBucket *b = &buckets()[i];
+    if (!b->offset ||
+        (b->key[0] == key.hash[0] && b->key[1] == key.hash[1]))
+      return b;
+  }
+}
+
+static bool moreRecentlyUsed(const StoreBucket &a, const StoreBucket &b) {
+  return a.lastUse > b.lastUse;
+}
+
+/// evict - Keep the most recently used entries, up to a quarter of the
+/// buckets and half of the payload area, and move their payloads to the start
+/// of the payload area.
+void QueryResultStore::evict() {
+  StoreHeader *h = header();
+  std::vector<StoreBucket> entries;
+  for (uint64_t i = 0; i != h->numBuckets; ++i)
+    if (buckets()[i].offset)
+      entries.push_back(buckets()[i]);
+  std::sort(entries.begin(), entries.end(), moreRecentlyUsed);
+
+  uint64_t dataSize = h->fileSize - h->dataBegin;
+  std::vector<unsigned char> data;
+  unsigned kept = 0;
+  for (; kept != entries.size() && kept < h->numBuckets / 4; ++kept) {
+    StoreBucket &b = entries[kept];
+    if (data.size() + b.length > dataSize / 2)
+      break;
+    data.insert(data.end(), base + b.offset, base + b.offset + b.length);
+    b.offset = h->dataBegin + data.size() - b.length;
+  }
+
+  memset(buckets(), 0, h->numBuckets * sizeof(StoreBucket));
+  memcpy(base + h->dataBegin, data.data(), data.size());
+  h->dataTop = h->dataBegin + data.size();
+  h->numEntries = kept;
+  for (unsigned i = 0; i != kept; ++i) {
+    QueryKey key = { { entries[i].key[0], entries[i].key[1] } };
+    *findBucket(key) = entries[i];
+  }
+}
+
+bool QueryResultStore::lookup(const QueryKey &key,
+                              std::vector<unsigned char> &payload) {
+  lock();
+  StoreBucket *b = findBucket(key);
+  bool found = b->offset != 0;
+  if (found) {
+    payload.assign(base + b->offset, base + b->offset + b->length);
+    b->lastUse = ++header()->clock;
+  }
+  unlock();
+  return found;
+}
+
+void QueryResultStore::insert(const QueryKey &key,
+                              const std::vector<unsigned char> &payload) {
+  lock();
+  StoreHeader *h = header();
+  // Entries larger than what survives an eviction are not worth storing.
+  if (payload.empty() ||
+      payload.size() > (h->fileSize - h->dataBegin) / 4 ||
+      findBucket(key)->offset) {
+    unlock();
+    return;
+  }
+
+  h->writing = 1;
+  if ((h->numEntries + 1) * 4 > h->numBuckets * 3 ||
+      h->dataTop + payload.size() > h->fileSize)
+    evict();
+
+  memcpy(base + h->dataTop, payload.data(), payload.size());
+  StoreBucket *b = findBucket(key);
+  b->key[0] = key.hash[0];
+  b->key[1] = key.hash[1];
+  b->lastUse = ++h->clock;
+  b->length = payload.size();
+  b->offset = h->dataTop;
+  h->dataTop += payload.size();
+  ++h->numEntries;
+  h->writing = 0;
+  unlock();
+}
+
+/***/
+
+class PersistentCachingSolver : public SolverImpl {
+private:
+  enum QueryKind {
+    TruthQuery = 1,
+    ValueQuery,
+    InitialValuesQuery
+  };
+
+  Solver *solver;
+  QueryResultStore *store;
+  /// The status of the last query answered from the cache, or
+  /// SOLVER_RUN_STATUS_FAILURE if the last query was forwarded.
+  SolverRunStatus hitStatus;
+
+  QueryKey getKey(QueryKind kind, const Query &query,
+                  const std::vector<const Array*> *objects = 0);
+  bool lookup(const QueryKey &key, std::vector<unsigned char> &payload);
+
+public:
+  PersistentCachingSolver(Solver *s, QueryResultStore *_store)
+    : solver(s), store(_store), hitStatus(SOLVER_RUN_STATUS_FAILURE) {}
+  ~PersistentCachingSolver() { delete store; delete solver; }
+
+  bool computeTruth(const Query&, bool &isValid);
+  bool computeValue(const Query&, ref<Expr> &result);
+  bool computeInitialValues(const Query& query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query&);
+  void setCoreSolverTimeout(double timeout);
+};
+
+QueryKey PersistentCachingSolver::getKey(
+    QueryKind kind, const Query &query,
+    const std::vector<const Array*> *objects) {
+  std::vector<unsigned char> data;
+  ExprSerializer s(data, /*anonymousArrays=*/true);
+  s.writeU8(kind);
+  s.writeU32(query.constraints.size());
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+         ie = query.constraints.end(); it != ie; ++it)
+    s.write(*it);
+  s.write(query.expr);
+  if (objects) {
+    s.writeU32(objects->size());
+    for (unsigned i = 0, e = objects->size(); i != e; ++i)
+      s.write((*objects)[i]);
+  }
+
+  // Two independent 64-bit hashes (FNV-1a and a multiplicative mix), which
+  // makes collisions negligible for any realistic number of entries.
+  QueryKey key;
+  uint64_t h0 = 14695981039346656037ULL;
+  uint64_t h1 = data.size() * 0x9e3779b97f4a7c15ULL;
+  for (std::vector<unsigned char>::iterator it = data.begin(),
+         ie = data.end(); it != ie; ++it) {
+    h0 = (h0 ^ *it) * 1099511628211ULL;
+    h1 = (h1 + *it + 1) * 0xff51afd7ed558ccdULL;
+    h1 ^= h1 >> 29;
+  }
+  key.hash[0] = h0;
+  key.hash[1] = h1;
+  return key;
+}
+
+bool PersistentCachingSolver::lookup(const QueryKey &key,
+                                     std::vector<unsigned char> &payload) {
+  hitStatus = SOLVER_RUN_STATUS_FAILURE;
+  if (store->lookup(key, payload)) {
+    ++stats::queryPersistentCacheHits;
+    return true;
+  }
+  ++stats::queryPersistentCacheMisses;
+  return false;
+}
+
+bool PersistentCachingSolver::computeTruth(const Query& query,
+                                           bool &isValid) {
+  QueryKey key = getKey(TruthQuery, query);
+  std::vector<unsigned char> payload;
+  if (lookup(key, payload) && payload.size() == 1) {
+    isValid = payload[0];
+    hitStatus = isValid ? SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE
+                        : SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+    return true;
+  }
+
+  if (!solver->impl->computeTruth(query, isValid))
+    return false;
+  store->insert(key, std::vector<unsigned char>(1, isValid));
+  return true;
+}
+
+bool PersistentCachingSolver::computeValue(const Query& query,
+                                           ref<Expr> &result) {
+  QueryKey key = getKey(ValueQuery, query);
+  std::vector<unsigned char> payload;
+  // The payload is the width followed by the words of the value.
+  Expr::Width width;
+  if (lookup(key, payload) && payload.size() >= sizeof(width)) {
+    memcpy(&width, &payload[0], sizeof(width));
+    unsigned numWords = (width + 63) / 64;
+    if (width &&
+        payload.size() == sizeof(width) + numWords * sizeof(uint64_t)) {
+      std::vector<uint64_t> words(numWords);
+      memcpy(&words[0], &payload[sizeof(width)], numWords * sizeof(uint64_t));
+      result = ConstantExpr::alloc(llvm::APInt(width, words));
+      hitStatus = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+      return true;
+    }
+  }
+
+  if (!solver->impl->computeValue(query, result))
+    return false;
+  if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(result)) {
+    const llvm::APInt &v = ce->getAPValue();
+    width = v.getBitWidth();
+    const unsigned char *words = (const unsigned char*) v.getRawData();
+    payload.assign((const unsigned char*) &width,
+                   (const unsigned char*) &width + sizeof(width));
+    payload.insert(payload.end(), words,
+                   words + v.getNumWords() * sizeof(uint64_t));
+    store->insert(key, payload);
+  }
+  return true;
+}
+
+bool PersistentCachingSolver::computeInitialValues(
+    const Query& query, const std::vector<const Array*> &objects,
+    std::vector< std::vector<unsigned char> > &values, bool &hasSolution) {
+  QueryKey key = getKey(InitialValuesQuery, query, &objects);
+  std::vector<unsigned char> payload;
+  if (lookup(key, payload) && !payload.empty()) {
+    // Values are stored one array after the other, in the order of the
+    // objects. The objects are part of the key, so the sizes match.
+    size_t expected = 1;
+    if (payload[0])
+      for (unsigned i = 0, e = objects.size(); i != e; ++i)
+        expected += objects[i]->size;
+    if (payload.size() == expected) {
+      hasSolution = payload[0];
+      values.clear();
+      if (hasSolution) {
+        const unsigned char *pos = &payload[1];
+        for (unsigned i = 0, e = objects.size(); i != e; ++i) {
+          values.push_back(std::vector<unsigned char>(pos,
+                                                      pos + objects[i]->size));
+          pos += objects[i]->size;
+        }
+      }
+      hitStatus = hasSolution ? SOLVER_RUN_STATUS_SUCCESS_SOLVABLE
+                              : SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+      return true;
+    }
+  }
+
+  if (!solver->impl->computeInitialValues(query, objects, values,
+                                          hasSolution))
+    return false;
+  payload.assign(1, hasSolution);
+  if (hasSolution)
+    for (unsigned i = 0, e = values.size(); i != e; ++i)
+      payload.insert(payload.end(), values[i].begin(), values[i].end());
+  store->insert(key, payload);
+  return true;
+}
+
+SolverImpl::SolverRunStatus PersistentCachingSolver::getOperationStatusCode() {
+  if (hitStatus != SOLVER_RUN_STATUS_FAILURE)
+    return hitStatus;
+  return solver->impl->getOperationStatusCode();
+}
+
+char *PersistentCachingSolver::getConstraintLog(const Query& query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void PersistentCachingSolver::setCoreSolverTimeout(double timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+///
+
+Solver *klee::createPersistentCachingSolver(Solver *s, std::string path) {
+  QueryResultStore *store =
+    QueryResultStore::open(path, (uint64_t) PersistentQueryCacheSize << 20);
+  if (!store)
+    return s;
+  return new Solver(new PersistentCachingSolver(s, store));
+}
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 #include "klee/Config/config.h"
 #ifdef ENABLE_STP
+#include "AssertionStack.h"
 #include "STPBuilder.h"
 #include "klee/Solver.h"
 #include "klee/SolverImpl.h"
@@ -66,9 +67,16 @@ private:
   double timeout;
   bool useForkedSTP;
   SolverRunStatus runStatusCode;
+  bool incremental;
+  /// The constraints asserted in vc by earlier queries, when running
+  /// incrementally.
+  AssertionStack assertions;
+
+  void popAssertions(unsigned n);
 
 public:
-  STPSolverImpl(bool _useForkedSTP, bool _optimizeDivides = true);
+  STPSolverImpl(bool _useForkedSTP, bool _optimizeDivides = true,
+                bool _incremental = false);
   ~STPSolverImpl();
 
   char *getConstraintLog(const Query &);
@@ -83,10 +91,12 @@ public:
   SolverRunStatus getOperationStatusCode();
 };
 
-STPSolverImpl::STPSolverImpl(bool _useForkedSTP, bool _optimizeDivides)
+STPSolverImpl::STPSolverImpl(bool _useForkedSTP, bool _optimizeDivides,
+                             bool _incremental)
     : vc(vc_createValidityChecker()),
       builder(new STPBuilder(vc, _optimizeDivides)), timeout(0.0),
-      useForkedSTP(_useForkedSTP), runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+      useForkedSTP(_useForkedSTP), runStatusCode(SOLVER_RUN_STATUS_FAILURE),
+      incremental(_incremental) {
   assert(vc && "unable to create validity checker");
   assert(builder && "unable to create STPBuilder");
 
@@ -128,10 +138,20 @@ STPSolverImpl::~STPSolverImpl() {
 
 /***/
 
+/// popAssertions - Pop the scopes of all but the first \a n incrementally
+/// asserted constraints.
+void STPSolverImpl::popAssertions(unsigned n) {
+  for (unsigned i = assertions.size(); i > n; --i)
+    vc_pop(vc);
+  assertions.truncate(n);
+}
+
 char *STPSolverImpl::getConstraintLog(const Query &query) {
+  // The log has to contain exactly the constraints of this query.
+  popAssertions(0);
   vc_push(vc);
-  for (std::vector<ref<Expr> >::const_iterator it = query.constraints.begin(),
-                                               ie = query.constraints.end();
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                         ie = query.constraints.end();
        it != ie; ++it)
     vc_assertFormula(vc, builder->construct(*it));
   assert(query.expr == ConstantExpr::alloc(0, Expr::Bool) &&
@@ -327,12 +347,30 @@ bool STPSolverImpl::computeInitialValues(
 
   TimerStatIncrementer t(stats::queryTime);
 
-  vc_push(vc);
+  if (incremental) {
+    // Keep the scopes of the constraints shared with the previous query and
+    // only assert the new ones, each in a scope of its own.
+    unsigned prefix = assertions.commonPrefix(query.constraints);
+    popAssertions(prefix);
+    stats::queryAssertionsReused += prefix;
 
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
-       it != ie; ++it)
-    vc_assertFormula(vc, builder->construct(*it));
+    for (ConstraintManager::const_iterator
+             it = query.constraints.begin() + prefix,
+             ie = query.constraints.end();
+         it != ie; ++it) {
+      vc_push(vc);
+      vc_assertFormula(vc, builder->construct(*it));
+      assertions.push(*it);
+      ++stats::queryAssertionsPushed;
+    }
+  } else {
+    vc_push(vc);
+
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                           ie = query.constraints.end();
+         it != ie; ++it)
+      vc_assertFormula(vc, builder->construct(*it));
+  }
 
   ++stats::queries;
   ++stats::queryCounterexamples;
@@ -365,7 +403,8 @@ bool STPSolverImpl::computeInitialValues(
       ++stats::queriesValid;
   }
 
-  vc_pop(vc);
+  if (!incremental)
+    vc_pop(vc);
 
   return success;
 }
@@ -374,8 +413,8 @@ SolverImpl::SolverRunStatus STPSolverImpl::getOperationStatusCode() {
   return runStatusCode;
 }
 
-STPSolver::STPSolver(bool useForkedSTP, bool optimizeDivides)
-    : Solver(new STPSolverImpl(useForkedSTP, optimizeDivides)) {}
+STPSolver::STPSolver(bool useForkedSTP, bool optimizeDivides, bool incremental)
+    : Solver(new STPSolverImpl(useForkedSTP, optimizeDivides, incremental)) {}
 
 char *STPSolver::getConstraintLog(const Query &query) {
   return impl->getConstraintLog(query);
@@ -13,12 +13,17 @@ using namespace klee;
 
 Statistic stats::cexCacheTime("CexCacheTime", "CCtime");
 Statistic stats::queries("Queries", "Q");
+Statistic stats::queryAssertionsPushed("QueryAssertionsPushed", "QApushed");
+Statistic stats::queryAssertionsReused("QueryAssertionsReused", "QAreused");
 Statistic stats::queriesInvalid("QueriesInvalid", "Qiv");
 Statistic stats::queriesValid("QueriesValid", "Qv");
 Statistic stats::queryCacheHits("QueryCacheHits", "QChits") ;
 Statistic stats::queryCacheMisses("QueryCacheMisses", "QCmisses");
 Statistic stats::queryCexCacheHits("QueryCexCacheHits", "QCexHits") ;
 Statistic stats::queryCexCacheMisses("QueryCexCacheMisses", "QCexMisses");
+Statistic stats::queryPersistentCacheHits("QueryPersistentCacheHits", "QPChits");
+Statistic stats::queryPersistentCacheMisses("QueryPersistentCacheMisses",
+                                            "QPCmisses");
 Statistic stats::queryConstructTime("QueryConstructTime", "QBtime") ;
 Statistic stats::queryConstructs("QueriesConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
@@ -0,0 +1,515 @@
+//===-- WorkerPoolSolver.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A core solver that runs the real SMT backend in long-lived worker processes.
+//
+// The forked STP mode forks the whole KLEE process for every query, which
+// costs a fork plus copy-on-write faults for every query in a large process.
+// Here the worker processes are forked once (normally while KLEE is still
+// small), keep their own solver context warm across queries and receive
+// queries serialized into a shared memory buffer. A pipe pair is used to
+// signal requests and replies. Timeouts are enforced by killing the worker,
+// which is transparently replaced for the next query, so crash isolation is
+// kept without paying for a fork on every query.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Config/config.h"
+#include "klee/CommandLine.h"
+#include "klee/Constraints.h"
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+#include "klee/TimerStatIncrementer.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprPPrinter.h"
+#include "klee/util/ExprSerializer.h"
+#include "klee/util/ExprUtil.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+using namespace klee;
+
+namespace {
+  llvm::cl::opt<unsigned>
+  SolverWorkerPoolSize("solver-worker-pool-size",
+                       llvm::cl::init(1),
+                       llvm::cl::desc("Number of solver worker processes "
+                                      "started by --use-solver-worker-pool. "
+                                      "Extra workers are kept as warm spares "
+                                      "that replace a worker killed on a "
+                                      "timeout (default=1)"));
+
+  llvm::cl::opt<unsigned>
+  SolverWorkerBufferSize("solver-worker-buffer-size",
+                         llvm::cl::init(4),
+                         llvm::cl::value_desc("MB"),
+                         llvm::cl::desc("Initial size of the shared buffer "
+                                        "used to pass queries to a solver "
+                                        "worker. It is grown on demand "
+                                        "(default=4)"));
+
+  llvm::cl::opt<unsigned>
+  SolverWorkerMaxQueries("solver-worker-max-queries",
+                         llvm::cl::init(1000),
+                         llvm::cl::desc("Number of queries after which a "
+                                        "solver worker recreates its solver "
+                                        "and array cache, to release the "
+                                        "arrays of earlier queries. 0 means "
+                                        "never (default=1000)"));
+}
+
+namespace {
+  /// Header at the start of the buffer shared with a worker. The serialized
+  /// query follows it, and the worker overwrites the query with the
+  /// counterexample bytes once it has been read.
+  struct WorkerBufferHeader {
+    uint64_t requestSize;
+    double timeout;
+
+    // Written by the worker.
+    int32_t status;
+    uint32_t hasSolution;
+  };
+
+  struct SolverWorker {
+    pid_t pid;
+    int requestFd, responseFd;
+    unsigned char *buffer;
+    size_t bufferSize;
+
+    SolverWorker() : pid(-1), requestFd(-1), responseFd(-1), buffer(0),
+                     bufferSize(0) {}
+
+    bool isAlive() const { return pid > 0; }
+    WorkerBufferHeader *header() const {
+      return (WorkerBufferHeader*) buffer;
+    }
+    unsigned char *data() const { return buffer + sizeof(WorkerBufferHeader); }
+    size_t dataSize() const { return bufferSize - sizeof(WorkerBufferHeader); }
+  };
+}
+
+static Solver *createWorkerCoreSolver(CoreSolverType cst) {
+  switch (cst) {
+#ifdef ENABLE_STP
+  case STP_SOLVER:
+    return new STPSolver(/*useForkedSTP=*/false, CoreSolverOptimizeDivides,
+                         UseIncrementalSolver);
+#endif
+#ifdef ENABLE_Z3
+  case Z3_SOLVER:
+    return new Z3Solver(UseIncrementalSolver);
+#endif
+  default:
+    return 0;
+  }
+}
+
+/// Main loop of a worker process. Never returns.
+static void runSolverWorker(CoreSolverType cst, const SolverWorker &w) {
+  // The parent handles interrupts and owns the timers.
+  ::signal(SIGINT, SIG_IGN);
+  ::signal(SIGALRM, SIG_IGN);
+
+  Solver *solver = createWorkerCoreSolver(cst);
+  if (!solver)
+    _exit(1);
+
+  // Arrays must outlive the solver, whose builder caches them by address.
+  // Every query adds its constant arrays to the cache, so both are
+  // recreated together after SolverWorkerMaxQueries queries.
+  ArrayCache *arrayCache = new ArrayCache();
+  unsigned numQueries = 0;
+
+  for (;;) {
+    if (SolverWorkerMaxQueries && numQueries == SolverWorkerMaxQueries) {
+      delete solver;
+      delete arrayCache;
+      solver = createWorkerCoreSolver(cst);
+      arrayCache = new ArrayCache();
+      numQueries = 0;
+    }
+
+    char token;
+    ssize_t n = ::read(w.requestFd, &token, 1);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break; // The parent went away.
+
+    WorkerBufferHeader *header = w.header();
+    std::vector<ref<Expr> > constraints;
+    ref<Expr> expr;
+    std::vector<const Array*> objects;
+    {
+      ExprDeserializer d(w.data(), w.data() + header->requestSize,
+                         *arrayCache);
+      constraints.resize(d.readU32());
+      for (unsigned i = 0, e = constraints.size(); i != e; ++i)
+        constraints[i] = d.readExpr();
+      expr = d.readExpr();
+      objects.resize(d.readU32());
+      for (unsigned i = 0, e = objects.size(); i != e; ++i)
+        objects[i] = d.readArray();
+    }
+
+    ++numQueries;
+    solver->setCoreSolverTimeout(header->timeout);
+
+    ConstraintManager cm(constraints);
+    std::vector< std::vector<unsigned char> > values;
+    bool hasSolution = false;
+    solver->impl->computeInitialValues(Query(cm, expr), objects, values,
+                                       hasSolution);
+    header->status = solver->impl->getOperationStatusCode();
+    header->hasSolution = hasSolution;
+
+    unsigned char *pos = w.data();
+    for (unsigned i = 0, e = values.size(); i != e; ++i) {
+      if (values[i].empty())
+        continue;
+      memcpy(pos, &values[i][0], values[i].size());
+      pos += values[i].size();
+    }
+
+    do {
+      n = ::write(w.responseFd, &token, 1);
+    } while (n < 0 && errno == EINTR);
+    if (n != 1)
+      break;
+  }
+
+  _exit(0);
+}
+
+/***/
+
+namespace klee {
+
+class WorkerPoolSolverImpl : public SolverImpl {
+private:
+  CoreSolverType coreSolverType;
+  std::vector<SolverWorker> workers;
+  double timeout;
+  SolverRunStatus runStatusCode;
+
+  bool spawn(SolverWorker &w, size_t minDataSize);
+  void kill(SolverWorker &w);
+  SolverWorker *getWorker(size_t minDataSize);
+
+public:
+  WorkerPoolSolverImpl(CoreSolverType cst, unsigned poolSize);
+  ~WorkerPoolSolverImpl();
+
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(double _timeout) { timeout = _timeout; }
+
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+};
+
+WorkerPoolSolverImpl::WorkerPoolSolverImpl(CoreSolverType cst,
+                                           unsigned poolSize)
+    : coreSolverType(cst), workers(std::max(1U, poolSize)), timeout(0.0),
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+  // Start the workers now, while the process is still small, so that
+  // later queries do not pay for forking a large address space.
+  size_t dataSize = (size_t) SolverWorkerBufferSize << 20;
+  for (unsigned i = 0, e = workers.size(); i != e; ++i)
+    if (!spawn(workers[i], dataSize))
+      klee_warning("unable to start solver worker %u", i);
+}
+
+WorkerPoolSolverImpl::~WorkerPoolSolverImpl() {
+  for (unsigned i = 0, e = workers.size(); i != e; ++i) {
+    kill(workers[i]);
+    if (workers[i].buffer)
+      ::munmap(workers[i].buffer, workers[i].bufferSize);
+  }
+}
+
+bool WorkerPoolSolverImpl::spawn(SolverWorker &w, size_t minDataSize) {
+  assert(!w.isAlive() && "worker is already running");
+
+  size_t size = minDataSize + sizeof(WorkerBufferHeader);
+  if (w.bufferSize < size) {
+    if (w.buffer)
+      ::munmap(w.buffer, w.bufferSize);
+    void *buffer = ::mmap(0, size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED) {
+      w.buffer = 0;
+      w.bufferSize = 0;
+      return false;
+    }
+    w.buffer = (unsigned char*) buffer;
+    w.bufferSize = size;
+  }
+
+  int request[2], response[2];
+  if (::pipe(request) < 0)
+    return false;
+  if (::pipe(response) < 0) {
+    ::close(request[0]);
+    ::close(request[1]);
+    return false;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = ::fork();
+  if (pid < 0) {
+    ::close(request[0]);
+    ::close(request[1]);
+    ::close(response[0]);
+    ::close(response[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    ::close(request[1]);
+    ::close(response[0]);
+    for (unsigned i = 0, e = workers.size(); i != e; ++i) {
+      if (workers[i].isAlive()) {
+        ::close(workers[i].requestFd);
+        ::close(workers[i].responseFd);
+      }
+    }
+    SolverWorker self = w;
+    self.requestFd = request[0];
+    self.responseFd = response[1];
+    runSolverWorker(coreSolverType, self);
+  }
+
+  ::close(request[0]);
+  ::close(response[1]);
+  w.pid = pid;
+  w.requestFd = request[1];
+  w.responseFd = response[0];
+  return true;
+}
+
+void WorkerPoolSolverImpl::kill(SolverWorker &w) {
+  if (!w.isAlive())
+    return;
+
+  ::kill(w.pid, SIGKILL);
+  pid_t res;
+  do {
+    res = ::waitpid(w.pid, 0, 0);
+  } while (res < 0 && errno == EINTR);
+
+  ::close(w.requestFd);
+  ::close(w.responseFd);
+  w.pid = -1;
+  w.requestFd = w.responseFd = -1;
+}
+
+SolverWorker *WorkerPoolSolverImpl::getWorker(size_t minDataSize) {
+  // Always prefer the first live worker so that its solver context stays
+  // warm; the remaining ones are only spares.
+  SolverWorker *w = 0;
+  for (unsigned i = 0, e = workers.size(); i != e; ++i) {
+    if (workers[i].isAlive()) {
+      w = &workers[i];
+      break;
+    }
+  }
+
+  if (w && w->dataSize() >= minDataSize)
+    return w;
+
+  if (w) {
+    kill(*w);
+  } else {
+    w = &workers[0];
+  }
+  if (!spawn(*w, std::max(minDataSize, 2 * w->dataSize())))
+    return 0;
+  return w;
+}
+
+char *WorkerPoolSolverImpl::getConstraintLog(const Query &query) {
+  // The backend lives in another process, so the best we can offer is the
+  // query in KQuery form.
+  std::string str;
+  llvm::raw_string_ostream os(str);
+  ExprPPrinter::printQuery(os, query.constraints, query.expr);
+  os.flush();
+  return strdup(str.c_str());
+}
+
+bool WorkerPoolSolverImpl::computeTruth(const Query &query, bool &isValid) {
+  std::vector<const Array *> objects;
+  std::vector<std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  if (!computeInitialValues(query, objects, values, hasSolution))
+    return false;
+
+  isValid = !hasSolution;
+  return true;
+}
+
+bool WorkerPoolSolverImpl::computeValue(const Query &query,
+                                        ref<Expr> &result) {
+  std::vector<const Array *> objects;
+  std::vector<std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  // Find the object used in the expression, and compute an assignment
+  // for them.
+  findSymbolicObjects(query.expr, objects);
+  if (!computeInitialValues(query.withFalse(), objects, values, hasSolution))
+    return false;
+  assert(hasSolution && "state has invalid constraint set");
+
+  // Evaluate the expression with the computed assignment.
+  Assignment a(objects, values);
+  result = a.evaluate(query.expr);
+
+  return true;
+}
+
+bool WorkerPoolSolverImpl::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  TimerStatIncrementer t(stats::queryTime);
+
+  std::vector<unsigned char> request;
+  ExprSerializer s(request);
+  s.writeU32(query.constraints.size());
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                         ie = query.constraints.end();
+       it != ie; ++it)
+    s.write(*it);
+  s.write(query.expr);
+  s.writeU32(objects.size());
+  size_t responseSize = 0;
+  for (std::vector<const Array *>::const_iterator it = objects.begin(),
+                                                  ie = objects.end();
+       it != ie; ++it) {
+    s.write(*it);
+    responseSize += (*it)->size;
+  }
+
+  ++stats::queries;
+  if (!objects.empty())
+    ++stats::queryCounterexamples;
+
+  SolverWorker *w = getWorker(std::max(request.size(), responseSize));
+  if (!w) {
+    klee_warning("unable to start solver worker");
+    runStatusCode = SOLVER_RUN_STATUS_FORK_FAILED;
+    return false;
+  }
+
+  WorkerBufferHeader *header = w->header();
+  header->requestSize = request.size();
+  header->timeout = timeout;
+  header->status = SOLVER_RUN_STATUS_FAILURE;
+  header->hasSolution = 0;
+  memcpy(w->data(), &request[0], request.size());
+
+  char token = 0;
+  ssize_t n;
+  do {
+    n = ::write(w->requestFd, &token, 1);
+  } while (n < 0 && errno == EINTR);
+  if (n != 1) {
+    klee_warning("solver worker died, restarting it");
+    kill(*w);
+    runStatusCode = SOLVER_RUN_STATUS_INTERRUPTED;
+    return false;
+  }
+
+  // Give the backend a moment to report its own timeout before we kill it,
+  // which keeps the worker (and its caches) alive.
+  double deadline = timeout ? util::getWallTime() + timeout + .1 : 0;
+  for (;;) {
+    int ms = -1;
+    if (deadline) {
+      double remaining = deadline - util::getWallTime();
+      ms = remaining > 0 ? (int) (remaining * 1000) + 1 : 0;
+    }
+    struct pollfd pfd;
+    pfd.fd = w->responseFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int res = ::poll(&pfd, 1, ms);
+    if (res < 0 && errno == EINTR)
+      continue;
+    if (res == 0) {
+      klee_warning("solver worker timed out, restarting it");
+      kill(*w);
+      runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+      return false;
+    }
+    if (res > 0)
+      n = ::read(w->responseFd, &token, 1);
+    if (res < 0 || n != 1) {
+      if (n < 0 && errno == EINTR)
+        continue;
+      klee_warning("solver worker exited without replying, restarting it");
+      kill(*w);
+      runStatusCode = SOLVER_RUN_STATUS_INTERRUPTED;
+      return false;
+    }
+    break;
+  }
+
+  runStatusCode = (SolverRunStatus) header->status;
+  if (runStatusCode != SOLVER_RUN_STATUS_SUCCESS_SOLVABLE &&
+      runStatusCode != SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE)
+    return false;
+
+  hasSolution = header->hasSolution;
+  if (hasSolution) {
+    ++stats::queriesInvalid;
+    values = std::vector<std::vector<unsigned char> >(objects.size());
+    unsigned char *pos = w->data();
+    for (unsigned i = 0, e = objects.size(); i != e; ++i) {
+      values[i].insert(values[i].begin(), pos, pos + objects[i]->size);
+      pos += objects[i]->size;
+    }
+  } else {
+    ++stats::queriesValid;
+  }
+
+  return true;
+}
+
+SolverImpl::SolverRunStatus WorkerPoolSolverImpl::getOperationStatusCode() {
+  return runStatusCode;
+}
+
+Solver *createWorkerPoolSolver(CoreSolverType cst) {
+  return new Solver(new WorkerPoolSolverImpl(cst, SolverWorkerPoolSize));
+}
+}
@@ -9,6 +9,7 @@
 #include "klee/Config/config.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #ifdef ENABLE_Z3
+#include "AssertionStack.h"
 #include "Z3Builder.h"
 #include "klee/Constraints.h"
 #include "klee/Solver.h"
@@ -16,8 +17,17 @@
 #include "klee/util/Assignment.h"
 #include "klee/util/ExprUtil.h"
 
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 
+namespace {
+llvm::cl::opt<unsigned> Z3IncrementalContexts(
+    "z3-incremental-contexts", llvm::cl::init(4),
+    llvm::cl::desc("Number of Z3 solver contexts kept by "
+                   "--use-incremental-solver, each following a different "
+                   "constraint prefix (default=4)"));
+}
+
 namespace klee {
 
 class Z3SolverImpl : public SolverImpl {
@@ -29,13 +39,26 @@ private:
   // Parameter symbols
   ::Z3_symbol timeoutParamStrSymbol;
 
+  /// IncrementalContext - A solver which keeps the constraints of earlier
+  /// queries asserted between calls.
+  struct IncrementalContext {
+    ::Z3_solver solver;
+    AssertionStack assertions;
+  };
+  bool incremental;
+  std::vector<IncrementalContext> incrementalContexts;
+  uint64_t incrementalTick;
+
+  IncrementalContext &getIncrementalContext(const ConstraintManager &);
+  ::Z3_solver prepareIncrementalSolver(const ConstraintManager &);
+
   bool internalRunSolver(const Query &,
                          const std::vector<const Array *> *objects,
                          std::vector<std::vector<unsigned char> > *values,
                          bool &hasSolution);
 
 public:
-  Z3SolverImpl();
+  Z3SolverImpl(bool _incremental);
   ~Z3SolverImpl();
 
   char *getConstraintLog(const Query &);
@@ -64,9 +87,10 @@ public:
   SolverRunStatus getOperationStatusCode();
 };
 
-Z3SolverImpl::Z3SolverImpl()
+Z3SolverImpl::Z3SolverImpl(bool _incremental)
     : builder(new Z3Builder(/*autoClearConstructCache=*/false)), timeout(0.0),
-      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE), incremental(_incremental),
+      incrementalTick(0) {
   assert(builder && "unable to create Z3Builder");
   solverParameters = Z3_mk_params(builder->ctx);
   Z3_params_inc_ref(builder->ctx, solverParameters);
@@ -75,11 +99,14 @@ Z3SolverImpl::Z3SolverImpl()
 }
 
 Z3SolverImpl::~Z3SolverImpl() {
+  for (unsigned i = 0, e = incrementalContexts.size(); i != e; ++i)
+    Z3_solver_dec_ref(builder->ctx, incrementalContexts[i].solver);
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
 }
 
-Z3Solver::Z3Solver() : Solver(new Z3SolverImpl()) {}
+Z3Solver::Z3Solver(bool incremental)
+    : Solver(new Z3SolverImpl(incremental)) {}
 
 char *Z3Solver::getConstraintLog(const Query &query) {
   return impl->getConstraintLog(query);
@@ -91,8 +118,8 @@ void Z3Solver::setCoreSolverTimeout(double timeout) {
 
 char *Z3SolverImpl::getConstraintLog(const Query &query) {
   std::vector<Z3ASTHandle> assumptions;
-  for (std::vector<ref<Expr> >::const_iterator it = query.constraints.begin(),
-                                               ie = query.constraints.end();
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                         ie = query.constraints.end();
        it != ie; ++it) {
     assumptions.push_back(builder->construct(*it));
   }
@@ -166,20 +193,26 @@ bool Z3SolverImpl::internalRunSolver(
     const Query &query, const std::vector<const Array *> *objects,
     std::vector<std::vector<unsigned char> > *values, bool &hasSolution) {
   TimerStatIncrementer t(stats::queryTime);
-  // TODO: Does making a new solver for each query have a performance
-  // impact vs making one global solver and using push and pop?
-  // TODO: is the "simple_solver" the right solver to use for
-  // best performance?
-  Z3_solver theSolver = Z3_mk_simple_solver(builder->ctx);
-  Z3_solver_inc_ref(builder->ctx, theSolver);
-  Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
-
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
 
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
-       it != ie; ++it) {
-    Z3_solver_assert(builder->ctx, theSolver, builder->construct(*it));
+  // Queries without constraints have nothing to share, don't let them
+  // disturb the incremental contexts.
+  bool useIncremental = incremental && !query.constraints.empty();
+  Z3_solver theSolver;
+  if (useIncremental) {
+    theSolver = prepareIncrementalSolver(query.constraints);
+  } else {
+    // TODO: is the "simple_solver" the right solver to use for
+    // best performance?
+    theSolver = Z3_mk_simple_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, theSolver);
+    Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                           ie = query.constraints.end();
+         it != ie; ++it) {
+      Z3_solver_assert(builder->ctx, theSolver, builder->construct(*it));
+    }
   }
   ++stats::queries;
   if (objects)
@@ -201,7 +234,12 @@ bool Z3SolverImpl::internalRunSolver(
   runStatusCode = handleSolverResponse(theSolver, satisfiable, objects, values,
                                        hasSolution);
 
-  Z3_solver_dec_ref(builder->ctx, theSolver);
+  if (useIncremental) {
+    // Drop the negated query expression, keep the constraints.
+    Z3_solver_pop(builder->ctx, theSolver, 1);
+  } else {
+    Z3_solver_dec_ref(builder->ctx, theSolver);
+  }
   // Clear the builder's cache to prevent memory usage exploding.
   // By using ``autoClearConstructCache=false`` and clearning now
   // we allow Z3_ast expressions to be shared from an entire
@@ -221,6 +259,73 @@ bool Z3SolverImpl::internalRunSolver(
   return false; // failed
 }
 
+Z3SolverImpl::IncrementalContext &
+Z3SolverImpl::getIncrementalContext(const ConstraintManager &constraints) {
+  // Prefer the context sharing the longest prefix with the query, then the
+  // most recently used one.
+  IncrementalContext *best = 0;
+  unsigned bestPrefix = 0;
+  for (unsigned i = 0, e = incrementalContexts.size(); i != e; ++i) {
+    IncrementalContext &ic = incrementalContexts[i];
+    unsigned prefix = ic.assertions.commonPrefix(constraints);
+    if (!best || prefix > bestPrefix ||
+        (prefix == bestPrefix &&
+         ic.assertions.lastUse > best->assertions.lastUse)) {
+      best = &ic;
+      bestPrefix = prefix;
+    }
+  }
+  if (best && (bestPrefix || best->assertions.size() == 0))
+    return *best;
+
+  // Nothing in common with any context, start a new lineage if there is
+  // room, otherwise recycle the least recently used context.
+  if (incrementalContexts.size() <
+      std::max(1U, (unsigned)Z3IncrementalContexts)) {
+    IncrementalContext ic;
+    ic.solver = Z3_mk_simple_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, ic.solver);
+    incrementalContexts.push_back(ic);
+    return incrementalContexts.back();
+  }
+  IncrementalContext *lru = &incrementalContexts[0];
+  for (unsigned i = 1, e = incrementalContexts.size(); i != e; ++i)
+    if (incrementalContexts[i].assertions.lastUse < lru->assertions.lastUse)
+      lru = &incrementalContexts[i];
+  Z3_solver_reset(builder->ctx, lru->solver);
+  lru->assertions.truncate(0);
+  return *lru;
+}
+
+/// prepareIncrementalSolver - Bring an incremental context in line with the
+/// constraints of the query and open a scope for the query expression.
+::Z3_solver
+Z3SolverImpl::prepareIncrementalSolver(const ConstraintManager &constraints) {
+  IncrementalContext &ic = getIncrementalContext(constraints);
+  ic.assertions.lastUse = ++incrementalTick;
+
+  unsigned prefix = ic.assertions.commonPrefix(constraints);
+  if (ic.assertions.size() > prefix) {
+    Z3_solver_pop(builder->ctx, ic.solver, ic.assertions.size() - prefix);
+    ic.assertions.truncate(prefix);
+  }
+  stats::queryAssertionsReused += prefix;
+
+  for (ConstraintManager::const_iterator it = constraints.begin() + prefix,
+                                         ie = constraints.end();
+       it != ie; ++it) {
+    Z3_solver_push(builder->ctx, ic.solver);
+    Z3_solver_assert(builder->ctx, ic.solver, builder->construct(*it));
+    ic.assertions.push(*it);
+    ++stats::queryAssertionsPushed;
+  }
+
+  // The timeout may have changed since the solver was created.
+  Z3_solver_set_params(builder->ctx, ic.solver, solverParameters);
+  Z3_solver_push(builder->ctx, ic.solver);
+  return ic.solver;
+}
+
 SolverImpl::SolverRunStatus Z3SolverImpl::handleSolverResponse(
     ::Z3_solver theSolver, ::Z3_lbool satisfiable,
     const std::vector<const Array *> *objects,
@@ -0,0 +1,35 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --lazy-globals --exit-on-error %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --lazy-globals --state-prune --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+#include <assert.h>
+
+int table[4] = { 1, 2, 3, 4 };
+int next[4] = { 9, 9, 9, 9 };
+int *ptr = &table[2];
+const char *msg = "lazy";
+int untouched[1024] = { 5 };
+
+int main() {
+  unsigned i;
+  klee_make_symbolic(&i, sizeof i, "i");
+
+  assert(*ptr == 3);
+  assert(msg[1] == 'a');
+
+  if (i < 4) {
+    // symbolic pointer into a global next to one not accessed yet
+    table[i] = 7;
+    assert(table[i] == 7);
+    assert(next[0] == 9 && next[3] == 9);
+  } else {
+    assert(table[0] == 1);
+  }
+
+  return 0;
+}
+
+// CHECK-NOT: terminating state
+// CHECK: KLEE: done: completed paths = 2
@@ -0,0 +1,74 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --native-calls --exit-on-error %t1.bc
+// RUN: FileCheck %s < %t.klee-out/info
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error %t1.bc
+// RUN: FileCheck --check-prefix=CHECK-INTERPRETED %s < %t.klee-out/info
+
+// CHECK: KLEE: done: native calls = {{[1-9][0-9]*}}
+// CHECK-INTERPRETED-NOT: native calls
+
+#include <assert.h>
+
+unsigned regs[8];
+
+static unsigned mix(unsigned a, unsigned b) {
+  return (a << 3) ^ (b >> 1) ^ (a / (b | 1));
+}
+
+unsigned step(unsigned in) {
+  unsigned i;
+  for (i = 0; i < 8; ++i)
+    regs[i] = mix(regs[i] + in, i);
+  return regs[7];
+}
+
+void fill(unsigned *buf, unsigned n) {
+  unsigned i;
+  for (i = 0; i < n; ++i)
+    buf[i] = mix(i, n);
+}
+
+unsigned target;
+unsigned *targetp = &target;
+
+// reads a pointer from the bytes of targetp, so that it accesses target
+// without referring to it, interpreted
+unsigned bump(void) {
+  unsigned long bits = *(unsigned long *) &targetp;
+  unsigned *p;
+  *(unsigned long *) &p = bits;
+  return ++*p;
+}
+
+int main() {
+  unsigned buf[4];
+  unsigned x;
+
+  // all memory is concrete, run natively
+  assert(step(5) == mix(5, 7));
+  assert(regs[0] == mix(5, 0));
+
+  // only the object the argument points to is accessed
+  fill(buf, 4);
+  assert(buf[3] == mix(3, 4));
+
+  // x is symbolic but not accessed, run natively
+  klee_make_symbolic(&x, sizeof x, "x");
+  fill(buf, 2);
+  assert(buf[1] == mix(1, 2));
+
+  target = 2;
+  assert(bump() == 3);
+  assert(target == 3);
+
+  // regs is partly symbolic, interpreted
+  regs[1] = x;
+  step(1);
+  assert(regs[0] == mix(mix(5, 0) + 1, 0));
+  if (x == 0)
+    assert(regs[1] == mix(1, 1));
+
+  return 0;
+}
@@ -0,0 +1,58 @@
+// Check that the object a memory instruction last resolved to, which is
+// cached on the instruction for all states, is only reused while the
+// bindings of the executing state are those it was cached for.
+
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=random-state --exit-on-error %t1.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-INFO %s < %t.klee-out/info
+
+// CHECK: KLEE: done: completed paths = 2
+// CHECK-INFO: KLEE: done: resolution cache hits = {{[1-9][0-9]*}}
+
+#include <assert.h>
+#include <stdlib.h>
+
+int g;
+
+void set(int v) {
+  g = v;
+}
+
+int get(void) {
+  return g;
+}
+
+int first(int *p) {
+  return p[0];
+}
+
+int main() {
+  int x, v, i;
+  int *p, *q;
+
+  klee_make_symbolic(&x, sizeof x, "x");
+  v = x > 0 ? 1 : 2;
+
+  // Both states run the same loads and stores of g, interleaved, and must
+  // each see their own value.
+  for (i = 0; i != 100; ++i) {
+    set(v * 1000 + i);
+    assert(get() == v * 1000 + i);
+  }
+
+  // The same load reads a freed object and then one that may be allocated
+  // at its address.
+  for (i = 0; i != 10; ++i) {
+    p = malloc(4 * sizeof *p);
+    p[0] = v * 1000 + i;
+    assert(first(p) == v * 1000 + i);
+    free(p);
+    q = malloc(4 * sizeof *q);
+    q[0] = -i;
+    assert(first(q) == -i);
+    free(q);
+  }
+
+  return 0;
+}
@@ -0,0 +1,40 @@
+// Check that states swapped out at the memory cap continue correctly once
+// swapped back in, with their constraints, registers and memory restored.
+
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --swap-states --max-memory=1 --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+#include <assert.h>
+#include <stdlib.h>
+
+unsigned counts[16];
+
+int main() {
+  unsigned char bits;
+  unsigned i, path = 0;
+  unsigned *buf = calloc(64, sizeof *buf);
+
+  klee_make_symbolic(&bits, sizeof bits, "bits");
+
+  // Fork all states before memory usage is first checked, as forking is
+  // inhibited at the memory cap.
+  for (i = 0; i != 4; ++i)
+    if (bits & (1 << i))
+      path |= 1 << i;
+
+  // Run long enough for the states to be swapped out and back in.
+  for (i = 0; i != 64 * 100; ++i) {
+    buf[i & 63] += path;
+    ++counts[path];
+  }
+
+  for (i = 0; i != 64; ++i)
+    assert(buf[i] == 100 * path);
+  assert(counts[path] == 64 * 100);
+  assert((bits & 15) == path);
+  return 0;
+}
+
+// CHECK: swapped out
+// CHECK: KLEE: done: completed paths = 16
@@ -323,6 +323,15 @@ static bool EvaluateInputAST(const char *Filename,
       << *theStatisticManager->getStatisticByName("QueriesCEX") << "\n";
   }
 
+  uint64_t persistentCacheHits =
+    *theStatisticManager->getStatisticByName("QueryPersistentCacheHits");
+  if (uint64_t lookups = persistentCacheHits +
+      *theStatisticManager->getStatisticByName("QueryPersistentCacheMisses")) {
+    llvm::outs()
+      << "persistent query cache hits = " << persistentCacheHits
+      << " (" << 100 * persistentCacheHits / lookups << "%)\n";
+  }
+
   return success;
 }
 
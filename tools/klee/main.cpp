@@ -21,6 +21,8 @@
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/Support/PrintVersion.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/util/ExprRewriter.h"
+#include "klee/util/SlabAllocator.h"
 
 #if LLVM_VERSION_CODE > LLVM_VERSION(3, 2)
 #include "llvm/IR/Constants.h"
@@ -1537,6 +1539,14 @@ int main(int argc, char **argv, char **envp) {
     *theStatisticManager->getStatisticByName("Instructions");
   uint64_t forks =
     *theStatisticManager->getStatisticByName("Forks");
+  uint64_t persistentCacheHits =
+    *theStatisticManager->getStatisticByName("QueryPersistentCacheHits");
+  uint64_t persistentCacheLookups = persistentCacheHits +
+    *theStatisticManager->getStatisticByName("QueryPersistentCacheMisses");
+  uint64_t nativeCalls =
+    *theStatisticManager->getStatisticByName("NativeCalls");
+  uint64_t resolutionCacheHits =
+    *theStatisticManager->getStatisticByName("ResolutionCacheHits");
 
   handler->getInfoStream()
     << "KLEE: done: explored paths = " << 1 + forks << "\n";
@@ -1552,6 +1562,25 @@ int main(int argc, char **argv, char **envp) {
     << "KLEE: done: valid queries = " << queriesValid << "\n"
     << "KLEE: done: invalid queries = " << queriesInvalid << "\n"
     << "KLEE: done: query cex = " << queryCounterexamples << "\n";
+  if (persistentCacheLookups)
+    handler->getInfoStream()
+      << "KLEE: done: persistent query cache hits = " << persistentCacheHits
+      << " (" << 100 * persistentCacheHits / persistentCacheLookups
+      << "%)\n";
+  if (nativeCalls)
+    handler->getInfoStream()
+      << "KLEE: done: native calls = " << nativeCalls << "\n";
+  if (resolutionCacheHits)
+    handler->getInfoStream()
+      << "KLEE: done: resolution cache hits = " << resolutionCacheHits
+      << "\n";
+  getExprAllocator().printStats(handler->getInfoStream(), "KLEE: done: ");
+  Expr::printKindStats(handler->getInfoStream(), "KLEE: done: ");
+  getUpdateNodeAllocator().printStats(handler->getInfoStream(),
+                                      "KLEE: done: ");
+  getMemoryAllocator().printStats(handler->getInfoStream(), "KLEE: done: ");
+  ExprRewriter::getDefault().printStats(handler->getInfoStream(),
+                                        "KLEE: done: ");
 
   std::stringstream stats;
   stats << "\n";
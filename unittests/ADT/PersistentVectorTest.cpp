@@ -0,0 +1,115 @@
+//===-- PersistentVectorTest.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Internal/ADT/PersistentVector.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+typedef PersistentVector<unsigned> Vector;
+
+/// Check that \a v holds exactly \a expected, by index and by iteration.
+void expectElements(const Vector &v, const std::vector<unsigned> &expected) {
+  ASSERT_EQ(expected.size(), v.size());
+  for (unsigned i = 0; i != expected.size(); ++i)
+    ASSERT_EQ(expected[i], v[i]) << "index " << i;
+  unsigned i = 0;
+  for (Vector::const_iterator it = v.begin(), ie = v.end(); it != ie; ++it)
+    ASSERT_EQ(expected[i++], *it) << "index " << i;
+  ASSERT_EQ(expected.size(), (size_t) (v.end() - v.begin()));
+}
+
+TEST(PersistentVectorTest, PushBackAcrossLevels) {
+  // Enough elements for the tail, a root of leaves, a root of branches of
+  // leaves and one more level above that.
+  const unsigned n = 32 * 32 * 32 + 32 * 32 + 33;
+  Vector v;
+  std::vector<unsigned> expected;
+  EXPECT_TRUE(v.empty());
+  for (unsigned i = 0; i != n; ++i) {
+    v.push_back(i * 7);
+    expected.push_back(i * 7);
+    ASSERT_EQ(i + 1, v.size());
+    ASSERT_EQ(i * 7, v.back());
+    // Check everything at the boundaries where the tail moves into the trie
+    // and where the trie grows a level.
+    if ((i & 31) == 0 || i == 32 * 32 + 32 || i == 32 * 32 * 32 + 32)
+      expectElements(v, expected);
+  }
+  expectElements(v, expected);
+}
+
+TEST(PersistentVectorTest, PushBackOnSharedCopies) {
+  // Copy at sizes where the tail is partly filled, where it is full and
+  // about to move into a shared trie, and where that trie is about to grow.
+  const unsigned sizes[] = { 1, 17, 32, 64, 1056, 1057, 2000 };
+  for (unsigned s = 0; s != sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    Vector a;
+    std::vector<unsigned> expectedA;
+    for (unsigned i = 0; i != sizes[s]; ++i) {
+      a.push_back(i);
+      expectedA.push_back(i);
+    }
+
+    Vector b(a);
+    std::vector<unsigned> expectedB(expectedA);
+    EXPECT_TRUE(a == b);
+    for (unsigned i = 0; i != 100; ++i) {
+      a.push_back(1000000 + i);
+      expectedA.push_back(1000000 + i);
+      b.push_back(2000000 + i);
+      expectedB.push_back(2000000 + i);
+    }
+    expectElements(a, expectedA);
+    expectElements(b, expectedB);
+    EXPECT_TRUE(a != b);
+  }
+}
+
+TEST(PersistentVectorTest, CopiesAreIndependent) {
+  // Keep a copy at every size, then append different elements to each.
+  const unsigned n = 1200;
+  std::vector<Vector> copies;
+  Vector v;
+  for (unsigned i = 0; i != n; ++i) {
+    copies.push_back(v);
+    v.push_back(i);
+  }
+  for (unsigned i = 0; i < n; i += 7)
+    for (unsigned j = 0; j != 40; ++j)
+      copies[i].push_back(n + i + j);
+
+  std::vector<unsigned> expected;
+  for (unsigned i = 0; i != n; ++i)
+    expected.push_back(i);
+  expectElements(v, expected);
+
+  for (unsigned i = 0; i != n; ++i) {
+    std::vector<unsigned> prefix(expected.begin(), expected.begin() + i);
+    if (i % 7 == 0)
+      for (unsigned j = 0; j != 40; ++j)
+        prefix.push_back(n + i + j);
+    expectElements(copies[i], prefix);
+  }
+
+  // Assigning and clearing a copy leaves the original alone.
+  Vector w;
+  w = v;
+  w.push_back(42);
+  w.clear();
+  EXPECT_TRUE(w.empty());
+  expectElements(v, expected);
+}
+
+}
@@ -0,0 +1,119 @@
+//===-- ExprJITTest.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ExprJIT.h"
+#include "ExternalDispatcher.h"
+
+#include "klee/util/ArrayCache.h"
+#include "klee/util/Assignment.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> readByte(const UpdateList &ul, ref<Expr> index) {
+  return ReadExpr::create(ul, ZExtExpr::create(index, Expr::Int32));
+}
+
+/// Check that the compiled \a e agrees with Assignment::evaluate() under an
+/// assignment binding \a index to each byte value in [0, 8) and \a array to
+/// \a bytes, with and without free values.
+void checkAgainstAssignment(ExprJIT &jit, const ref<Expr> &e,
+                            const Array *index, const Array *array,
+                            const std::vector<unsigned char> &bytes) {
+  std::vector<Assignment*> owned;
+  std::vector<const Assignment*> assignments;
+  for (unsigned allowFree = 0; allowFree != 2; ++allowFree) {
+    for (unsigned i = 0; i != 8; ++i) {
+      Assignment *a = new Assignment(allowFree);
+      a->bindings[index] = std::vector<unsigned char>(1, i);
+      if (array)
+        a->bindings[array] = bytes;
+      owned.push_back(a);
+      assignments.push_back(a);
+    }
+  }
+
+  std::vector<uint64_t> values;
+  std::vector<unsigned char> known;
+  ASSERT_TRUE(jit.evaluate(e, assignments, values, known));
+  for (unsigned i = 0; i != owned.size(); ++i) {
+    ref<Expr> expected = owned[i]->evaluate(e);
+    if (ConstantExpr *ce = dyn_cast<ConstantExpr>(expected)) {
+      EXPECT_TRUE(known[i]) << "assignment " << i;
+      EXPECT_EQ(ce->getZExtValue(), values[i]) << "assignment " << i;
+    } else {
+      EXPECT_FALSE(known[i]) << "assignment " << i;
+    }
+    delete owned[i];
+  }
+}
+
+class ExprJITTest : public ::testing::Test {
+protected:
+  ExternalDispatcher dispatcher;
+  ExprJIT jit;
+  ArrayCache ac;
+  const Array *index;
+
+  ExprJITTest()
+    : jit(dispatcher.getExecutionEngine(), /*threshold=*/1),
+      index(ac.CreateArray("index", 1)) {}
+
+  ref<Expr> readIndex() {
+    return Expr::createTempRead(index, Expr::Int8);
+  }
+};
+
+TEST_F(ExprJITTest, ConstantArray) {
+  std::vector<ref<ConstantExpr> > contents;
+  for (unsigned i = 0; i != 4; ++i)
+    contents.push_back(ConstantExpr::create(10 + i, Expr::Int8));
+  const Array *table = ac.CreateArray("table", contents.size(),
+                                      &contents[0],
+                                      &contents[0] + contents.size());
+
+  // Indices 4 to 7 are beyond the constant values.
+  checkAgainstAssignment(jit, readByte(UpdateList(table, 0), readIndex()),
+                         index, 0, std::vector<unsigned char>());
+}
+
+TEST_F(ExprJITTest, UpdateList) {
+  const Array *array = ac.CreateArray("array", 2);
+  UpdateList ul(array, 0);
+  ul.extend(ConstantExpr::create(5, Expr::Int32),
+            ConstantExpr::create(7, Expr::Int8));
+  ul.extend(ConstantExpr::create(1, Expr::Int32),
+            ConstantExpr::create(8, Expr::Int8));
+  ul.extend(ConstantExpr::create(5, Expr::Int32),
+            ConstantExpr::create(9, Expr::Int8));
+
+  // Index 5 is written beyond the bound bytes, and indices 2 to 4, 6 and 7
+  // read unbound bytes.
+  checkAgainstAssignment(jit, readByte(ul, readIndex()), index, array,
+                         std::vector<unsigned char>(2, 3));
+}
+
+TEST_F(ExprJITTest, OutOfRange) {
+  const Array *array = ac.CreateArray("array", 8);
+  ref<Expr> e = AddExpr::create(readByte(UpdateList(array, 0), readIndex()),
+                                ConstantExpr::create(1, Expr::Int8));
+
+  // Only three of the eight bytes are bound.
+  std::vector<unsigned char> bytes;
+  bytes.push_back(20);
+  bytes.push_back(21);
+  bytes.push_back(22);
+  checkAgainstAssignment(jit, e, index, array, bytes);
+}
+
+}
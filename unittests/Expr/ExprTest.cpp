@@ -10,8 +10,13 @@
 #include <iostream>
 #include "gtest/gtest.h"
 
+#include "klee/Constraints.h"
 #include "klee/Expr.h"
 #include "klee/util/ArrayCache.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprBatchEvaluator.h"
+#include "klee/util/ExprSerializer.h"
+#include "klee/util/SlabAllocator.h"
 
 using namespace klee;
 
@@ -113,4 +118,343 @@ TEST(ExprTest, ExtractConcat) {
   EXPECT_EQ(Expr::Extract, concat2->getKid(1)->getKind());
 }
 
+TEST(ExprTest, SerializeRoundTrip) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr4", 256);
+  ref<Expr> read32 = Expr::createTempRead(array, 32);
+
+  UpdateList ul(array, 0);
+  ul.extend(getConstant(3, 32), getConstant(7, 8));
+  ul.extend(ExtractExpr::create(read32, 0, 32), getConstant(9, 8));
+  ref<Expr> read8 = ReadExpr::create(ul, getConstant(1, 32));
+
+  ref<Expr> e1 = AddExpr::create(read32, ZExtExpr::create(read8, 32));
+  ref<Expr> e2 = UltExpr::create(e1, getConstant(17, 32));
+
+  std::vector<unsigned char> buffer;
+  ExprSerializer s(buffer);
+  s.write(e1);
+  s.write(e2);
+  s.write(array);
+
+  ArrayCache ac2;
+  ExprDeserializer d(&buffer[0], &buffer[0] + buffer.size(), ac2);
+  ref<Expr> r1 = d.readExpr();
+  ref<Expr> r2 = d.readExpr();
+  const Array *r3 = d.readArray();
+  EXPECT_TRUE(d.atEnd());
+
+  EXPECT_EQ(array->name, r3->name);
+  EXPECT_EQ(array->size, r3->size);
+  EXPECT_EQ(e1->hash(), r1->hash());
+  EXPECT_EQ(e2->hash(), r2->hash());
+  // Shared nodes are shared again after deserialization.
+  EXPECT_EQ(r1.get(), r2->getKid(0).get());
+  EXPECT_EQ(r3, cast<ReadExpr>(r1->getKid(1)->getKid(0))->updates.root);
+}
+
+TEST(ExprTest, SerializeUpdateListsByAddress) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr7", 16);
+
+  UpdateList ul(array, 0);
+  ul.extend(getConstant(3, 32), getConstant(7, 8));
+  ul.extend(getConstant(4, 32), getConstant(9, 8));
+
+  std::vector<unsigned char> buffer;
+  ExprSerializer s(buffer, /*anonymousArrays=*/false,
+                   /*arraysByAddress=*/true);
+  s.write(ul);
+  s.write(UpdateList(0, 0));
+
+  ArrayCache ac2;
+  ExprDeserializer d(&buffer[0], &buffer[0] + buffer.size(), ac2);
+  UpdateList r1 = d.readUpdateList();
+  UpdateList r2 = d.readUpdateList();
+  EXPECT_TRUE(d.atEnd());
+
+  EXPECT_EQ(array, r1.root);
+  EXPECT_EQ(0, ul.compare(r1));
+  EXPECT_TRUE(r2.root == 0 && r2.head == 0);
+}
+
+TEST(ExprTest, ConstraintPartition) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("arr5", 4);
+  const Array *b = ac.CreateArray("arr6", 4);
+  ref<Expr> a0 = ReadExpr::create(UpdateList(a, 0), getConstant(0, 32));
+  ref<Expr> a1 = ReadExpr::create(UpdateList(a, 0), getConstant(1, 32));
+  ref<Expr> b1 = ReadExpr::create(UpdateList(b, 0), getConstant(1, 32));
+
+  ConstraintManager cm;
+  cm.addConstraint(UltExpr::create(a0, getConstant(5, 8)));
+  cm.addConstraint(UltExpr::create(b1, getConstant(7, 8)));
+  cm.addConstraint(UltExpr::create(a1, getConstant(3, 8)));
+
+  const ConstraintPartition &p = cm.getPartition();
+  EXPECT_NE(p.getClass(0), p.getClass(1));
+  EXPECT_NE(p.getClass(0), p.getClass(2));
+  EXPECT_NE(p.getClass(1), p.getClass(2));
+
+  std::set<unsigned> classes;
+  p.getClasses(AddExpr::create(a0, b1), classes);
+  EXPECT_EQ(2U, classes.size());
+  EXPECT_TRUE(classes.count(p.getClass(0)));
+  EXPECT_TRUE(classes.count(p.getClass(1)));
+
+  // Reading a at a symbolic index merges all bytes of a, and b[1] with them,
+  // without affecting the copy which shares the partition.
+  ConstraintManager copy(cm);
+  ref<Expr> ax = ReadExpr::create(UpdateList(a, 0),
+                                  ZExtExpr::create(b1, Expr::Int32));
+  cm.addConstraint(UltExpr::create(ax, getConstant(2, 8)));
+
+  const ConstraintPartition &p2 = cm.getPartition();
+  for (unsigned i = 1; i != 4; ++i)
+    EXPECT_EQ(p2.getClass(0), p2.getClass(i));
+  const ConstraintPartition &p3 = copy.getPartition();
+  EXPECT_EQ(3U, p3.size());
+  EXPECT_NE(p3.getClass(0), p3.getClass(2));
+}
+
+TEST(ExprTest, ConstraintKnownBits) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("arr7", 8);
+  ref<Expr> bytes[8];
+  for (unsigned i = 0; i != 8; ++i)
+    bytes[i] = ReadExpr::create(UpdateList(a, 0), getConstant(i, 32));
+  ref<Expr> x = ConcatExpr::create4(bytes[3], bytes[2], bytes[1], bytes[0]);
+
+  ConstraintManager cm;
+  cm.addConstraint(EqExpr::create(getConstant(6, 32),
+                                  AndExpr::create(getConstant(6, 32), x)));
+  cm.addConstraint(UltExpr::create(bytes[4], getConstant(16, 8)));
+  cm.addConstraint(Expr::createIsZero(EqExpr::create(getConstant(0, 8),
+                                                     bytes[5])));
+
+  const ConstraintKnownBits &kb = cm.getKnownBits();
+  // Bits fixed by a mask, also through the bytes of the concatenation.
+  EXPECT_TRUE(kb.evaluate(Expr::createIsZero(
+      AndExpr::create(getConstant(4, 32), x))).isFalse());
+  EXPECT_TRUE(kb.evaluate(EqExpr::create(
+      getConstant(2, 8), AndExpr::create(getConstant(2, 8), bytes[0])))
+      .isTrue());
+  // Bits and ranges implied by an unsigned bound.
+  EXPECT_TRUE(kb.evaluate(Expr::createIsZero(
+      AndExpr::create(getConstant(0x20, 8), bytes[4]))).isTrue());
+  ref<Expr> scaled = MulExpr::create(ZExtExpr::create(bytes[4], Expr::Int32),
+                                     getConstant(3, 32));
+  EXPECT_TRUE(kb.evaluate(UltExpr::create(scaled, getConstant(48, 32)))
+              .isTrue());
+  EXPECT_TRUE(kb.evaluate(SltExpr::create(
+      ZExtExpr::create(bytes[4], Expr::Int32), getConstant(0, 32))).isFalse());
+  EXPECT_TRUE(kb.evaluate(EqExpr::create(getConstant(0, 8), bytes[5]))
+              .isFalse());
+
+  // Nothing is known about unconstrained bytes.
+  KnownBits v = kb.evaluate(UltExpr::create(bytes[6], getConstant(5, 8)));
+  EXPECT_FALSE(v.isTrue() || v.isFalse());
+
+  // A copy learns new facts without affecting the original.
+  ConstraintManager copy(cm);
+  copy.addConstraint(UltExpr::create(bytes[6], getConstant(5, 8)));
+  EXPECT_TRUE(copy.getKnownBits().evaluate(
+      UleExpr::create(bytes[6], getConstant(4, 8))).isTrue());
+  v = cm.getKnownBits().evaluate(UleExpr::create(bytes[6], getConstant(4, 8)));
+  EXPECT_FALSE(v.isTrue() || v.isFalse());
+}
+
+TEST(ExprTest, HashConsing) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr7", 256);
+
+  Expr::hashConsing = true;
+  ref<Expr> e1 = AddExpr::create(Expr::createTempRead(array, 32),
+                                 getConstant(3, 32));
+  ref<Expr> e2 = AddExpr::create(Expr::createTempRead(array, 32),
+                                 getConstant(3, 32));
+  ref<Expr> e3 = AddExpr::create(Expr::createTempRead(array, 32),
+                                 getConstant(4, 32));
+  Expr::hashConsing = false;
+  ref<Expr> e4 = AddExpr::create(Expr::createTempRead(array, 32),
+                                 getConstant(3, 32));
+
+  EXPECT_EQ(e1.get(), e2.get());
+  EXPECT_NE(e1.get(), e3.get());
+  EXPECT_EQ(e1->getKid(1).get(), e3->getKid(1).get());
+  EXPECT_NE(e1.get(), e4.get());
+  EXPECT_EQ(e1, e4);
+}
+
+TEST(ExprTest, RewriteRules) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr9", 256);
+  ref<Expr> x = Expr::createTempRead(array, 16);
+  ref<Expr> y = Expr::createTempRead(array, 32);
+  Expr::rewriting = true;
+
+  // The bits of a ZExt are either the operand's or zeros.
+  ref<Expr> zx = ZExtExpr::create(x, 32);
+  EXPECT_EQ(ExtractExpr::create(x, 4, 8), ExtractExpr::create(zx, 4, 8));
+  EXPECT_EQ(getConstant(0, 8), ExtractExpr::create(zx, 20, 8));
+  EXPECT_EQ(ZExtExpr::create(ExtractExpr::create(x, 8, 8), 16),
+            ExtractExpr::create(zx, 8, 16));
+  EXPECT_EQ(zx, ConcatExpr::create(getConstant(0, 16), x));
+
+  // Masked shifts become bit slices.
+  ref<Expr> slice = AndExpr::create(LShrExpr::create(y, getConstant(8, 32)),
+                                    getConstant(0xFF, 32));
+  EXPECT_EQ(ZExtExpr::create(ExtractExpr::create(y, 8, 8), 32), slice);
+  EXPECT_EQ(getConstant(0, 32),
+            AndExpr::create(ShlExpr::create(y, getConstant(8, 32)),
+                            getConstant(0xFF, 32)));
+
+  // Comparisons of a ZExt with a constant are done at the operand's width,
+  // or decided.
+  EXPECT_EQ(UltExpr::create(x, getConstant(300, 16)),
+            UltExpr::create(zx, getConstant(300, 32)));
+  EXPECT_TRUE(UltExpr::create(zx, getConstant(0x10000, 32))->isTrue());
+  EXPECT_TRUE(UleExpr::create(getConstant(0x10000, 32), zx)->isFalse());
+
+  // Nothing is rewritten when rewriting is disabled, the default.
+  Expr::rewriting = false;
+  ref<Expr> unrewritten = ExtractExpr::create(zx, 4, 8);
+  EXPECT_EQ(Expr::Extract, unrewritten->getKind());
+}
+
+TEST(ExprTest, UpdateListLookup) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 64);
+  ref<Expr> sym = Expr::createTempRead(ac.CreateArray("idx", 4), 32);
+  UpdateList ul(array, 0);
+  ul.extend(ConstantExpr::create(3, 32), ConstantExpr::create(1, 8));
+  ul.extend(sym, ConstantExpr::create(2, 8));
+  for (unsigned i = 0; i != 100; ++i) {
+    ul.extend(ConstantExpr::create(i % 40, 32), ConstantExpr::create(i, 8));
+    // Reads of an extended list use the index of the shorter one.
+    UpdateList copy(ul);
+    for (unsigned j = 0; j < 45; j += 5) {
+      ref<Expr> read = ReadExpr::create(copy, ConstantExpr::create(j, 32));
+      if (j < 40 && j <= i)
+        EXPECT_EQ(ref<Expr>(ConstantExpr::create(i - (i - j) % 40, 8)), read);
+      else
+        EXPECT_EQ(Expr::Read, read->getKind());
+    }
+  }
+}
+
+TEST(ExprTest, BatchEvaluator) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 4);
+  ref<Expr> x = Expr::createTempRead(array, 16);
+  ref<Expr> y = ReadExpr::create(UpdateList(array, 0),
+                                 ConstantExpr::create(3, Expr::Int32));
+  ref<Expr> e = UDivExpr::create(SubExpr::create(x, ConstantExpr::create(7, 16)),
+                                 ZExtExpr::create(y, 16));
+
+  // Many assignments, so that more than one block is evaluated, some of
+  // which only bind part of the array.
+  std::vector<Assignment*> assignments;
+  std::vector<const Assignment*> batch;
+  for (unsigned i = 0; i != 150; ++i) {
+    Assignment *a = new Assignment(i % 3 == 0);
+    std::vector<unsigned char> bytes(i % 5 ? 4 : 2);
+    for (unsigned j = 0; j != bytes.size(); ++j)
+      bytes[j] = i * 31 + j * 7;
+    a->bindings.insert(std::make_pair(array, bytes));
+    assignments.push_back(a);
+    batch.push_back(a);
+  }
+
+  ExprBatchEvaluator evaluator(e);
+  ASSERT_TRUE(evaluator.isSupported());
+  std::vector<uint64_t> values;
+  std::vector<unsigned char> known;
+  evaluator.evaluate(batch, values, known);
+  for (unsigned i = 0; i != assignments.size(); ++i) {
+    ref<Expr> value = assignments[i]->evaluate(e);
+    // Unbound bytes are free under a third of the assignments, and the
+    // division is by zero under some others.
+    EXPECT_EQ(isa<ConstantExpr>(value), !!known[i]);
+    if (known[i])
+      EXPECT_EQ(cast<ConstantExpr>(value)->getZExtValue(), values[i]);
+    delete assignments[i];
+  }
+
+  EXPECT_FALSE(ExprBatchEvaluator(ZExtExpr::create(x, 128)).isSupported());
+}
+
+TEST(ExprTest, SlabAllocator) {
+  SlabAllocator allocator("test");
+  void *a = allocator.allocate(24);
+  void *b = allocator.allocate(20);
+  EXPECT_NE(a, b);
+  allocator.deallocate(a, 24);
+  // Blocks are reused within their size class.
+  EXPECT_EQ(a, allocator.allocate(17));
+  // Blocks of the size of a full page of an object state, masks
+  // included, have a size class as well.
+  void *d = allocator.allocate(352);
+  allocator.deallocate(d, 352);
+  EXPECT_EQ(d, allocator.allocate(345));
+  void *c = allocator.allocate(SlabAllocator::MaxSize + 1);
+  allocator.deallocate(c, SlabAllocator::MaxSize + 1);
+}
+
+TEST(ExprTest, LiveCountsPerKind) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("arr", 8);
+  uint64_t reads = Expr::getNumLive(Expr::Read);
+  uint64_t adds = Expr::getNumLive(Expr::Add);
+  {
+    ref<Expr> r0 = ReadExpr::create(UpdateList(a, 0),
+                                    ConstantExpr::alloc(0, Expr::Int32));
+    ref<Expr> r1 = ReadExpr::create(UpdateList(a, 0),
+                                    ConstantExpr::alloc(1, Expr::Int32));
+    ref<Expr> sum = AddExpr::alloc(r0, r1);
+    EXPECT_EQ(reads + 2, Expr::getNumLive(Expr::Read));
+    EXPECT_EQ(adds + 1, Expr::getNumLive(Expr::Add));
+  }
+  EXPECT_EQ(reads, Expr::getNumLive(Expr::Read));
+  EXPECT_EQ(adds, Expr::getNumLive(Expr::Add));
+}
+
+TEST(ExprTest, SmallConstantFolding) {
+  // The folding of constants of up to 64 bits must agree with APInt.
+  uint64_t seed = 1;
+  const unsigned widths[] = { 1, 7, 8, 31, 32, 33, 63, 64 };
+  for (unsigned i = 0; i != sizeof(widths) / sizeof(widths[0]); ++i) {
+    Expr::Width w = widths[i];
+    for (unsigned j = 0; j != 64; ++j) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      llvm::APInt a(w, seed >> (j % 64));
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      llvm::APInt b(w, j < 8 ? j : seed);
+      ref<ConstantExpr> l = ConstantExpr::alloc(a), r = ConstantExpr::alloc(b);
+
+      EXPECT_EQ(a + b, l->Add(r)->getAPValue());
+      EXPECT_EQ(a - b, l->Sub(r)->getAPValue());
+      EXPECT_EQ(a * b, l->Mul(r)->getAPValue());
+      EXPECT_EQ(-a, l->Neg()->getAPValue());
+      EXPECT_EQ(~a, l->Not()->getAPValue());
+      if (b != 0) {
+        EXPECT_EQ(a.udiv(b), l->UDiv(r)->getAPValue());
+        EXPECT_EQ(a.sdiv(b), l->SDiv(r)->getAPValue());
+        EXPECT_EQ(a.urem(b), l->URem(r)->getAPValue());
+        EXPECT_EQ(a.srem(b), l->SRem(r)->getAPValue());
+      }
+      EXPECT_EQ(a.shl(b), l->Shl(r)->getAPValue());
+      EXPECT_EQ(a.lshr(b), l->LShr(r)->getAPValue());
+      EXPECT_EQ(a.ashr(b), l->AShr(r)->getAPValue());
+      EXPECT_EQ(a.slt(b), l->Slt(r)->isTrue());
+      EXPECT_EQ(a.uge(b), l->Uge(r)->isTrue());
+      EXPECT_EQ(a.sext(w + 16).trunc(w + 3), l->SExt(w + 3)->getAPValue());
+      EXPECT_EQ(a.lshr(w / 2).trunc(w - w / 2),
+                l->Extract(w / 2, w - w / 2)->getAPValue());
+      EXPECT_EQ(a.zext(2 * w).shl(w) | b.zext(2 * w),
+                l->Concat(r)->getAPValue());
+    }
+  }
+}
+
 }
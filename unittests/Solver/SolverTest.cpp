@@ -14,7 +14,9 @@
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
 #include "klee/Solver.h"
+#include "klee/SolverImpl.h"
 #include "klee/util/ArrayCache.h"
+#include "klee/util/ExprUtil.h"
 #include "llvm/ADT/StringExtras.h"
 
 using namespace klee;
@@ -166,4 +168,109 @@ TEST(SolverTest, Evaluation) {
   delete solver;
 }
 
+/// Records the queries passed on to the core solver.
+class RecordingSolver : public SolverImpl {
+  Solver *solver;
+
+  void record(const Query &query) {
+    exprs.insert(exprs.end(), query.constraints.begin(),
+                 query.constraints.end());
+    exprs.push_back(query.expr);
+  }
+
+public:
+  std::vector< ref<Expr> > exprs;
+
+  RecordingSolver(Solver *s) : solver(s) {}
+  ~RecordingSolver() { delete solver; }
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    record(query);
+    return solver->impl->computeTruth(query, isValid);
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    record(query);
+    return solver->impl->computeValue(query, result);
+  }
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    record(query);
+    return solver->impl->computeInitialValues(query, objects, values,
+                                              hasSolution);
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+};
+
+/// Whether any of \a exprs reads \a array at a symbolic index.
+bool readsSymbolically(const std::vector< ref<Expr> > &exprs,
+                       const Array *array) {
+  for (unsigned i = 0, e = exprs.size(); i != e; ++i) {
+    std::vector< ref<ReadExpr> > reads;
+    findReads(exprs[i], /*visitUpdates=*/true, reads);
+    for (unsigned j = 0, n = reads.size(); j != n; ++j)
+      if (reads[j]->updates.root == array &&
+          !isa<ConstantExpr>(reads[j]->index))
+        return true;
+  }
+  return false;
+}
+
+TEST(SolverTest, ArrayExpansion) {
+  RecordingSolver *recorder =
+    new RecordingSolver(klee::createCoreSolver(CoreSolverToUse));
+  Solver *solver = createArrayExpansionSolver(new Solver(recorder), 4);
+
+  const Array *array = ac.CreateArray("expanded", 4);
+  const Array *indices = ac.CreateArray("indices", 8);
+  ref<Expr> i = Expr::createTempRead(indices, Expr::Int32);
+  ref<Expr> j = ReadExpr::create(UpdateList(indices, 0),
+                                 ConstantExpr::create(4, Expr::Int32));
+  j = ZExtExpr::create(j, Expr::Int32);
+  ref<Expr> ai = ReadExpr::create(UpdateList(array, 0), i);
+  ref<Expr> aj = ReadExpr::create(UpdateList(array, 0), j);
+  bool res;
+
+  // Reads at equal indices agree, also beyond the end of the array.
+  ConstraintManager constraints;
+  constraints.addConstraint(EqExpr::create(i, j));
+  ASSERT_TRUE(solver->mustBeTrue(Query(constraints, EqExpr::create(ai, aj)),
+                                 res));
+  EXPECT_TRUE(res);
+
+  // Reads at distinct indices need not.
+  ASSERT_TRUE(solver->mustBeTrue(Query(ConstraintManager(),
+                                       EqExpr::create(ai, aj)), res));
+  EXPECT_FALSE(res);
+
+  // A read through an update sees the written value.
+  UpdateList ul(array, 0);
+  ul.extend(j, ConstantExpr::create(42, Expr::Int8));
+  ref<Expr> read = ReadExpr::create(ul, i);
+  ASSERT_TRUE(solver->mustBeTrue(
+                Query(constraints,
+                      EqExpr::create(read, ConstantExpr::create(42,
+                                                                Expr::Int8))),
+                res));
+  EXPECT_TRUE(res);
+
+  // The core solver only saw the elements of the array.
+  ASSERT_FALSE(recorder->exprs.empty());
+  EXPECT_FALSE(readsSymbolically(recorder->exprs, array));
+
+  // Larger arrays are left alone.
+  const Array *large = ac.CreateArray("unexpanded", 8);
+  ref<Expr> li = ReadExpr::create(UpdateList(large, 0), i);
+  ref<Expr> lj = ReadExpr::create(UpdateList(large, 0), j);
+  ASSERT_TRUE(solver->mustBeTrue(Query(constraints, EqExpr::create(li, lj)),
+                                 res));
+  EXPECT_TRUE(res);
+  EXPECT_TRUE(readsSymbolically(recorder->exprs, large));
+
+  delete solver;
+}
+
 }